@@ -356,6 +356,8 @@ void CL_ParseServerInfo (void)
 
 	// copy the naked name of the map file to the cl structure -- O.S
 	COM_StripExtension (COM_SkipPath(model_precache[1]), cl.mapname, sizeof(cl.mapname));
+	if (!sv.active)	// the local server started the record already
+		Memory_BeginMap (cl.mapname);
 
 	for (i = 1; i < nummodels; i++)
 	{
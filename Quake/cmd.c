@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // cmd.c -- Quake script command processing module
 
 #include "quakedef.h"
+#include "q_ctype.h"
 
 void Cmd_ForwardToServer (void);
 
@@ -35,12 +36,283 @@ typedef struct cmdalias_s
 	struct cmdalias_s	*next;
 	char	name[MAX_ALIAS_NAME];
 	char	*value;
+	struct cmdalias_s	*hash_next;
 } cmdalias_t;
 
 cmdalias_t	*cmd_alias;
 
 qboolean	cmd_wait;
 
+typedef struct cmd_function_s
+{
+	struct cmd_function_s	*next;
+	const char		*name;
+	xcommand_t		function;
+	struct cmd_function_s	*hash_next;
+} cmd_function_t;
+
+/*
+=============================================================================
+
+					NAME LOOKUP
+
+Commands and aliases are found through hash tables of their lowercased names,
+so Cmd_ExecuteString can match them regardless of case; cvar.c does the same
+for the cvars.  All three also go into one prefix trie for command line
+completion, which hands back the names in alphabetical order.
+
+=============================================================================
+*/
+
+static cmd_function_t	*cmd_hash[CMD_HASH_SIZE];
+static cmdalias_t	*cmd_aliashash[CMD_HASH_SIZE];
+
+static lookupstats_t	cmd_stats, cmd_aliasstats;
+static int		cmd_lines;	// executed by Cmd_ExecuteString
+
+typedef struct
+{
+	const char	*name;		// of the command, alias or cvar ending here
+	int		child, sibling;	// nodes, 0 for none; siblings are sorted
+	byte		kinds;		// CMDNAME_ bits
+	char		ch;
+} trienode_t;
+
+static trienode_t	*cmd_trie;	// node 0 is the root
+static int		cmd_trienodes, cmd_triemax;
+
+/*
+============
+Cmd_HashName
+============
+*/
+unsigned int Cmd_HashName (const char *name)
+{
+	unsigned int	hash = 2166136261u;
+
+	while (*name)
+		hash = (hash ^ (byte) q_tolower (*name++)) * 16777619u;
+	return hash;
+}
+
+/*
+============
+Cmd_TrieNode -- returns the child of parent for ch, or 0 if there isn't one and add is false
+============
+*/
+static int Cmd_TrieNode (int parent, char ch, qboolean add)
+{
+	int	prev, n, added;
+
+	prev = 0;
+	for (n = cmd_trie[parent].child ; n && (byte) cmd_trie[n].ch < (byte) ch ; n = cmd_trie[n].sibling)
+		prev = n;
+	if (n && cmd_trie[n].ch == ch)
+		return n;
+	if (!add)
+		return 0;
+
+	if (cmd_trienodes == cmd_triemax)
+	{
+		cmd_triemax *= 2;
+		cmd_trie = (trienode_t *) realloc (cmd_trie, cmd_triemax * sizeof(trienode_t));
+		if (!cmd_trie)
+			Sys_Error ("Cmd_TrieNode: out of memory");
+	}
+	added = cmd_trienodes++;
+	memset (&cmd_trie[added], 0, sizeof(trienode_t));
+	cmd_trie[added].ch = ch;
+	cmd_trie[added].sibling = n;
+	if (prev)
+		cmd_trie[prev].sibling = added;
+	else
+		cmd_trie[parent].child = added;
+
+	return added;
+}
+
+/*
+============
+Cmd_TrieFind -- returns the node for name, or -1
+============
+*/
+static int Cmd_TrieFind (const char *name, qboolean add)
+{
+	int	n;
+
+	if (!cmd_trie)
+	{
+		if (!add)
+			return -1;
+		cmd_triemax = 1024;
+		cmd_trie = (trienode_t *) calloc (cmd_triemax, sizeof(trienode_t));
+		if (!cmd_trie)
+			Sys_Error ("Cmd_TrieFind: out of memory");
+		cmd_trienodes = 1;
+	}
+
+	for (n = 0 ; *name ; name++)
+	{
+		n = Cmd_TrieNode (n, *name, add);
+		if (!n)
+			return -1;
+	}
+	return n;
+}
+
+/*
+============
+Cmd_IndexName
+============
+*/
+void Cmd_IndexName (const char *name, int kind)
+{
+	trienode_t	*node;
+	int		n;
+
+	n = Cmd_TrieFind (name, true);	// may move cmd_trie
+	node = &cmd_trie[n];
+	if (!node->kinds || kind != CMDNAME_ALIAS)	// alias names go away again, the others don't
+		node->name = name;
+	node->kinds |= kind;
+}
+
+/*
+============
+Cmd_UnindexName
+============
+*/
+void Cmd_UnindexName (const char *name, int kind)
+{
+	int	n;
+
+	n = Cmd_TrieFind (name, false);
+	if (n <= 0)
+		return;
+	cmd_trie[n].kinds &= ~kind;
+	if (!cmd_trie[n].kinds)
+		cmd_trie[n].name = NULL;
+}
+
+/*
+============
+Cmd_WalkTrie -- calls func for every name of the given kinds under node, in order
+============
+*/
+static const char *Cmd_WalkTrie (int n, int kinds, void (*func) (const char *name, int kind))
+{
+	static const int order[3] = {CMDNAME_CVAR, CMDNAME_COMMAND, CMDNAME_ALIAS};
+	const char	*found;
+	int		i;
+
+	if (cmd_trie[n].kinds & kinds)
+	{
+		if (!func)
+			return cmd_trie[n].name;
+		for (i = 0 ; i < 3 ; i++)
+			if (cmd_trie[n].kinds & kinds & order[i])
+				func (cmd_trie[n].name, order[i]);
+	}
+
+	for (n = cmd_trie[n].child ; n ; n = cmd_trie[n].sibling)
+	{
+		found = Cmd_WalkTrie (n, kinds, func);
+		if (found)
+			return found;
+	}
+	return NULL;
+}
+
+/*
+============
+Cmd_CompleteName
+============
+*/
+const char *Cmd_CompleteName (const char *partial, int kinds)
+{
+	int	n;
+
+	n = Cmd_TrieFind (partial, false);
+	if (n < 0)
+		return NULL;
+	return Cmd_WalkTrie (n, kinds, NULL);
+}
+
+/*
+============
+Cmd_ListCompletions
+============
+*/
+void Cmd_ListCompletions (const char *partial, int kinds, void (*func) (const char *name, int kind))
+{
+	int	n;
+
+	n = Cmd_TrieFind (partial, false);
+	if (n >= 0)
+		Cmd_WalkTrie (n, kinds, func);
+}
+
+/*
+============
+Cmd_FindCommand
+============
+*/
+static cmd_function_t *Cmd_FindCommand (const char *name, qboolean anycase)
+{
+	cmd_function_t	*cmd;
+
+	cmd_stats.lookups++;
+	for (cmd = cmd_hash[Cmd_HashName (name) & (CMD_HASH_SIZE - 1)] ; cmd ; cmd = cmd->hash_next)
+	{
+		if (anycase ? !q_strcasecmp (name, cmd->name) : !Q_strcmp (name, cmd->name))
+			return cmd;
+	}
+	cmd_stats.misses++;
+	return NULL;
+}
+
+/*
+============
+Cmd_FindAlias
+============
+*/
+static cmdalias_t *Cmd_FindAlias (const char *name, qboolean anycase)
+{
+	cmdalias_t	*a;
+
+	cmd_aliasstats.lookups++;
+	for (a = cmd_aliashash[Cmd_HashName (name) & (CMD_HASH_SIZE - 1)] ; a ; a = a->hash_next)
+	{
+		if (anycase ? !q_strcasecmp (name, a->name) : !strcmp (name, a->name))
+			return a;
+	}
+	cmd_aliasstats.misses++;
+	return NULL;
+}
+
+/*
+============
+Cmd_RemoveAlias -- takes an alias out of the hash and the trie, the caller unlinks it from cmd_alias
+============
+*/
+static void Cmd_RemoveAlias (cmdalias_t *a)
+{
+	cmdalias_t	**link;
+
+	for (link = &cmd_aliashash[Cmd_HashName (a->name) & (CMD_HASH_SIZE - 1)] ; *link ; link = &(*link)->hash_next)
+	{
+		if (*link == a)
+		{
+			*link = a->hash_next;
+			break;
+		}
+	}
+	Cmd_UnindexName (a->name, CMDNAME_ALIAS);
+
+	Z_Free (a->value);
+	Z_Free (a);
+}
+
 //=============================================================================
 
 /*
@@ -65,7 +337,23 @@ void Cmd_Wait_f (void)
 =============================================================================
 */
 
-sizebuf_t	cmd_text;
+/*
+The unexecuted text is cmd_text.text[start..end). Cbuf_Execute consumes it
+in place by moving start past each command, and Cbuf_InsertText writes in
+front of start, into the space the executed commands left. The text is only
+moved when one end runs out of room, so long scripts run in linear time.
+*/
+
+#define	CBUF_SIZE		(1 << 18)	// was 8192, configs with thousands of binds and aliases don't fit that
+#define	CBUF_MAXLINE		1024
+
+typedef struct
+{
+	char	*text;		// CBUF_SIZE + 1 bytes, for the terminator of the last command
+	int	start, end;
+} cmdbuf_t;
+
+static cmdbuf_t	cmd_text;
 
 /*
 ============
@@ -74,9 +362,23 @@ Cbuf_Init
 */
 void Cbuf_Init (void)
 {
-	SZ_Alloc (&cmd_text, 8192);		// space for commands and script files
+	cmd_text.text = (char *) Hunk_AllocName (CBUF_SIZE + 1, "cmd_text");	// space for commands and script files
+	cmd_text.start = cmd_text.end = 0;
 }
 
+/*
+============
+Cbuf_Move -- moves the unexecuted text to start at ofs
+============
+*/
+static void Cbuf_Move (int ofs)
+{
+	int	len = cmd_text.end - cmd_text.start;
+
+	memmove (cmd_text.text + ofs, cmd_text.text + cmd_text.start, len);
+	cmd_text.start = ofs;
+	cmd_text.end = ofs + len;
+}
 
 /*
 ============
@@ -91,13 +393,16 @@ void Cbuf_AddText (const char *text)
 
 	l = Q_strlen (text);
 
-	if (cmd_text.cursize + l >= cmd_text.maxsize)
+	if (cmd_text.end - cmd_text.start + l >= CBUF_SIZE)
 	{
 		Con_Printf ("Cbuf_AddText: overflow\n");
 		return;
 	}
 
-	SZ_Write (&cmd_text, text, Q_strlen (text));
+	if (cmd_text.end + l > CBUF_SIZE)
+		Cbuf_Move (0);
+	memcpy (cmd_text.text + cmd_text.end, text, l);
+	cmd_text.end += l;
 }
 
 
@@ -107,34 +412,28 @@ Cbuf_InsertText
 
 Adds command text immediately after the current command
 Adds a \n to the text
-FIXME: actually change the command buffer to do less copying
 ============
 */
 void Cbuf_InsertText (const char *text)
 {
-	char	*temp;
-	int		templen;
+	int		l, len;
 
-// copy off any commands still remaining in the exec buffer
-	templen = cmd_text.cursize;
-	if (templen)
-	{
-		temp = (char *) Z_Malloc (templen);
-		Q_memcpy (temp, cmd_text.data, templen);
-		SZ_Clear (&cmd_text);
-	}
-	else
-		temp = NULL;	// shut up compiler
+	l = Q_strlen (text) + 1;
+	len = cmd_text.end - cmd_text.start;
 
-// add the entire text of the file
-	Cbuf_AddText (text);
-	SZ_Write (&cmd_text, "\n", 1);
-// add the copied off data
-	if (templen)
+	if (len + l >= CBUF_SIZE)
 	{
-		SZ_Write (&cmd_text, temp, templen);
-		Z_Free (temp);
+		Con_Printf ("Cbuf_InsertText: overflow\n");
+		return;
 	}
+
+// make room in front, leaving half the free space there for the next inserts
+	if (cmd_text.start < l)
+		Cbuf_Move (l + (CBUF_SIZE - len - l) / 2);
+
+	cmd_text.start -= l;
+	memcpy (cmd_text.text + cmd_text.start, text, l - 1);
+	cmd_text.text[cmd_text.start + l - 1] = '\n';
 }
 
 /*
@@ -144,18 +443,18 @@ Cbuf_Execute
 */
 void Cbuf_Execute (void)
 {
-	int		i;
+	int		i, len;
 	char	*text;
-	char	line[1024];
 	int		quotes;
 
-	while (cmd_text.cursize)
+	while (cmd_text.start < cmd_text.end)
 	{
 // find a \n or ; line break
-		text = (char *)cmd_text.data;
+		text = cmd_text.text + cmd_text.start;
+		len = cmd_text.end - cmd_text.start;
 
 		quotes = 0;
-		for (i=0 ; i< cmd_text.cursize ; i++)
+		for (i=0 ; i< len ; i++)
 		{
 			if (text[i] == '"')
 				quotes++;
@@ -165,32 +464,19 @@ void Cbuf_Execute (void)
 				break;
 		}
 
-		if (i > (int)sizeof(line) - 1)
-		{
-			memcpy (line, text, sizeof(line) - 1);
-			line[sizeof(line) - 1] = 0;
-		}
-		else
-		{
-			memcpy (line, text, i);
-			line[i] = 0;
-		}
+// consume the line before executing it, commands (exec, alias) can insert
+// text in front of the rest. the line only has to last until it's tokenized.
+		text[i] = 0;
+		if (i > CBUF_MAXLINE - 1)
+			text[CBUF_MAXLINE - 1] = 0;
 
-// delete the text from the command buffer and move remaining commands down
-// this is necessary because commands (exec, alias) can insert data at the
-// beginning of the text buffer
-
-		if (i == cmd_text.cursize)
-			cmd_text.cursize = 0;
+		if (i == len)
+			cmd_text.start = cmd_text.end = 0;
 		else
-		{
-			i++;
-			cmd_text.cursize -= i;
-			memmove (text, text + i, cmd_text.cursize);
-		}
+			cmd_text.start += i + 1;
 
 // execute the command line
-		Cmd_ExecuteString (line, src_command);
+		Cmd_ExecuteString (text, src_command);
 
 		if (cmd_wait)
 		{	// skip out while text still remains in buffer, leaving it
@@ -201,6 +487,63 @@ void Cbuf_Execute (void)
 	}
 }
 
+/*
+============
+Cbuf_Bench_f -- runs a generated script through the buffer, like a big exec'd config
+
+done at two sizes, so the time per line shows whether it scales linearly
+============
+*/
+static void Cbuf_Bench_f (void)
+{
+	char		line[64], *script;
+	int		lines, size, pass, i, len;
+	double		time1, time2;
+
+	if (cmd_text.start < cmd_text.end)
+	{
+		Con_Printf ("cbuf_bench: the command buffer isn't empty\n");
+		return;
+	}
+
+	lines = Cmd_Argc() > 1 ? Q_atoi (Cmd_Argv(1)) : 1000;
+	lines = CLAMP (1, lines, CBUF_SIZE / (4 * 48));
+
+	for (pass = 1 ; pass <= 4 ; pass *= 4)
+	{
+		script = (char *) malloc (lines * pass * 48 + 1);
+		if (!script)
+			return;
+		for (i = 0, size = 0 ; i < lines * pass ; i++)
+		{
+			if (i & 1)
+				len = q_snprintf (line, sizeof(line), "alias _cbuf_bench%i \"echo %i\"\n", i & 63, i);
+			else
+				len = q_snprintf (line, sizeof(line), "alias _cbuf_bench%i \"echo %i;wait\"; unalias _cbuf_bench%i\n", i & 63, i, i & 63);
+			memcpy (script + size, line, len);
+			size += len;
+		}
+		script[size] = 0;
+
+		time1 = Sys_DoubleTime ();
+		Cbuf_InsertText (script);	// as exec does
+		time2 = Sys_DoubleTime ();
+		Cbuf_Execute ();
+		time2 = Sys_DoubleTime () - time2;
+		time1 = Sys_DoubleTime () - time1;
+
+		Con_Printf ("%6i lines, %7i bytes: %8.3f ms, %6.0f ns per line, %8.3f ms inserting\n",
+				lines * pass, size, time1 * 1000.0, time1 * 1e9 / (lines * pass), (time1 - time2) * 1000.0);
+		free (script);
+	}
+
+	for (i = 1 ; i < 64 ; i += 2)	// the odd ones are left defined
+	{
+		q_snprintf (line, sizeof(line), "unalias _cbuf_bench%i\n", i);
+		Cmd_ExecuteString (line, src_command);
+	}
+}
+
 /*
 ==============================================================================
 
@@ -322,9 +665,9 @@ void Cmd_Alias_f (void)
 			Con_SafePrintf ("no alias commands found\n");
 		break;
 	case 2: //output current alias string
-		for (a = cmd_alias ; a ; a=a->next)
-			if (!strcmp(Cmd_Argv(1), a->name))
-				Con_Printf ("   %s: %s", a->name, a->value);
+		a = Cmd_FindAlias (Cmd_Argv(1), false);
+		if (a)
+			Con_Printf ("   %s: %s", a->name, a->value);
 		break;
 	default: //set alias string
 		s = Cmd_Argv(1);
@@ -335,22 +678,20 @@ void Cmd_Alias_f (void)
 		}
 
 		// if the alias allready exists, reuse it
-		for (a = cmd_alias ; a ; a=a->next)
-		{
-			if (!strcmp(s, a->name))
-			{
-				Z_Free (a->value);
-				break;
-			}
-		}
-
-		if (!a)
+		a = Cmd_FindAlias (s, false);
+		if (a)
+			Z_Free (a->value);
+		else
 		{
 			a = (cmdalias_t *) Z_Malloc (sizeof(cmdalias_t));
 			a->next = cmd_alias;
 			cmd_alias = a;
+			strcpy (a->name, s);
+			i = Cmd_HashName (s) & (CMD_HASH_SIZE - 1);
+			a->hash_next = cmd_aliashash[i];
+			cmd_aliashash[i] = a;
+			Cmd_IndexName (a->name, CMDNAME_ALIAS);
 		}
-		strcpy (a->name, s);
 
 		// copy the rest of the command line
 		cmd[0] = 0;		// start out with a null string
@@ -399,8 +740,7 @@ void Cmd_Unalias_f (void)
 				else
 					cmd_alias  = a->next;
 
-				Z_Free (a->value);
-				Z_Free (a);
+				Cmd_RemoveAlias (a);
 				return;
 			}
 			prev = a;
@@ -422,8 +762,7 @@ void Cmd_Unaliasall_f (void)
 	while (cmd_alias)
 	{
 		blah = cmd_alias->next;
-		Z_Free(cmd_alias->value);
-		Z_Free(cmd_alias);
+		Cmd_RemoveAlias (cmd_alias);
 		cmd_alias = blah;
 	}
 }
@@ -436,20 +775,14 @@ void Cmd_Unaliasall_f (void)
 =============================================================================
 */
 
-typedef struct cmd_function_s
-{
-	struct cmd_function_s	*next;
-	const char		*name;
-	xcommand_t		function;
-} cmd_function_t;
-
-
 #define	MAX_ARGS		80
+#define	CMD_ARENA_SIZE		16384	// the argv strings and a copy of the args
 
 static	int			cmd_argc;
 static	char		*cmd_argv[MAX_ARGS];
 static	char		cmd_null_string[] = "";
 static	const char	*cmd_args = NULL;
+static	char		cmd_arena[CMD_ARENA_SIZE];
 
 cmd_source_t	cmd_source;
 
@@ -499,6 +832,136 @@ void Cmd_List_f (void)
 	Con_SafePrintf ("\n");
 }
 
+/*
+============
+Cmd_PrintStats
+============
+*/
+static void Cmd_PrintStats (const char *what, int names, const lookupstats_t *stats, int used, int longest)
+{
+	Con_Printf ("%-9s %6i %9i %8i %4i/%i %7i\n", what, names, stats->lookups, stats->misses,
+			used, CMD_HASH_SIZE, longest);
+}
+
+/*
+============
+Cmd_BenchLookups -- ns per lookup of every command and cvar, hashed and by walking the lists
+============
+*/
+static void Cmd_BenchLookups (int passes)
+{
+	lookupstats_t	savedcmd = cmd_stats, savedcvar = cvar_stats;
+	cmd_function_t	*cmd, *c;
+	cvar_t		*var, *v, *first;
+	double		time1, hashed, walked;
+	int		i, count, found;
+
+	first = Cvar_FindVarAfter ("", CVAR_NONE);
+	found = 0;
+
+	hashed = walked = 0;
+	for (count = 0, cmd = cmd_functions ; cmd ; cmd = cmd->next, count++)
+	{
+		time1 = Sys_DoubleTime ();
+		for (i = 0 ; i < passes ; i++)
+			found += Cmd_FindCommand (cmd->name, true) != NULL;
+		hashed += Sys_DoubleTime () - time1;
+
+		time1 = Sys_DoubleTime ();
+		for (i = 0 ; i < passes ; i++)
+		{
+			for (c = cmd_functions ; c && q_strcasecmp (cmd->name, c->name) ; c = c->next)
+				;
+			found += c != NULL;
+		}
+		walked += Sys_DoubleTime () - time1;
+	}
+	if (count)
+		Con_Printf ("commands: %4.0f ns hashed, %5.0f ns walking the list\n",
+				hashed * 1e9 / (count * passes), walked * 1e9 / (count * passes));
+
+	hashed = walked = 0;
+	for (count = 0, var = first ; var ; var = var->next, count++)
+	{
+		time1 = Sys_DoubleTime ();
+		for (i = 0 ; i < passes ; i++)
+			found += Cvar_FindVar (var->name) != NULL;
+		hashed += Sys_DoubleTime () - time1;
+
+		time1 = Sys_DoubleTime ();
+		for (i = 0 ; i < passes ; i++)
+		{
+			for (v = first ; v && Q_strcmp (var->name, v->name) ; v = v->next)
+				;
+			found += v != NULL;
+		}
+		walked += Sys_DoubleTime () - time1;
+	}
+	if (count)
+		Con_Printf ("cvars:    %4.0f ns hashed, %5.0f ns walking the list\n",
+				hashed * 1e9 / (count * passes), walked * 1e9 / (count * passes));
+
+	Con_DPrintf ("%i found\n", found);
+	cmd_stats = savedcmd;
+	cvar_stats = savedcvar;
+}
+
+/*
+============
+Cmd_Stats_f -- hash table usage and lookup counts; "cmdstats reset" clears the counts, "cmdstats bench [passes]" times the lookups
+============
+*/
+static void Cmd_Stats_f (void)
+{
+	cmd_function_t	*cmd;
+	cmdalias_t	*a;
+	int		i, n, names, used, longest;
+
+	if (Cmd_Argc() > 1 && !strcmp (Cmd_Argv(1), "reset"))
+	{
+		memset (&cmd_stats, 0, sizeof(cmd_stats));
+		memset (&cmd_aliasstats, 0, sizeof(cmd_aliasstats));
+		memset (&cvar_stats, 0, sizeof(cvar_stats));
+		cmd_lines = 0;
+		return;
+	}
+	if (Cmd_Argc() > 1 && !strcmp (Cmd_Argv(1), "bench"))
+	{
+		Cmd_BenchLookups (Cmd_Argc() > 2 ? q_max (Q_atoi (Cmd_Argv(2)), 1) : 1000);
+		return;
+	}
+
+	Con_Printf ("           names   lookups   misses  buckets longest\n");
+
+	names = used = longest = 0;
+	for (i = 0 ; i < CMD_HASH_SIZE ; i++)
+	{
+		for (n = 0, cmd = cmd_hash[i] ; cmd ; cmd = cmd->hash_next)
+			n++;
+		names += n;
+		used += n > 0;
+		longest = q_max (longest, n);
+	}
+	Cmd_PrintStats ("commands", names, &cmd_stats, used, longest);
+
+	names = used = longest = 0;
+	for (i = 0 ; i < CMD_HASH_SIZE ; i++)
+	{
+		for (n = 0, a = cmd_aliashash[i] ; a ; a = a->hash_next)
+			n++;
+		names += n;
+		used += n > 0;
+		longest = q_max (longest, n);
+	}
+	Cmd_PrintStats ("aliases", names, &cmd_aliasstats, used, longest);
+
+	Cvar_HashUsage (&names, &used, &longest);
+	Cmd_PrintStats ("cvars", names, &cvar_stats, used, longest);
+
+	Con_Printf ("%i lines executed, time the lookups with \"cmdstats bench\"\n", cmd_lines);
+	Con_Printf ("%i completion trie nodes, %i KB\n", cmd_trienodes, (int) (cmd_triemax * sizeof(trienode_t) / 1024));
+}
+
 /*
 ============
 Cmd_Init
@@ -507,6 +970,7 @@ Cmd_Init
 void Cmd_Init (void)
 {
 	Cmd_AddCommand ("cmdlist", Cmd_List_f); //johnfitz
+	Cmd_AddCommand ("cmdstats", Cmd_Stats_f);
 	Cmd_AddCommand ("unalias", Cmd_Unalias_f); //johnfitz
 	Cmd_AddCommand ("unaliasall", Cmd_Unaliasall_f); //johnfitz
 
@@ -516,6 +980,7 @@ void Cmd_Init (void)
 	Cmd_AddCommand ("alias",Cmd_Alias_f);
 	Cmd_AddCommand ("cmd", Cmd_ForwardToServer);
 	Cmd_AddCommand ("wait", Cmd_Wait_f);
+	Cmd_AddCommand ("cbuf_bench", Cbuf_Bench_f);
 }
 
 /*
@@ -560,14 +1025,12 @@ Parses the given string into command line tokens.
 */
 void Cmd_TokenizeString (const char *text)
 {
-	int		i;
-
-// clear the args from the last string
-	for (i=0 ; i<cmd_argc ; i++)
-		Z_Free (cmd_argv[i]);
+	int		used, len;
 
+// the args from the last string are overwritten
 	cmd_argc = 0;
 	cmd_args = NULL;
+	used = 0;
 
 	while (1)
 	{
@@ -587,7 +1050,13 @@ void Cmd_TokenizeString (const char *text)
 			return;
 
 		if (cmd_argc == 1)
-			 cmd_args = text;
+		{	// copied, the text may be overwritten by the time the command asks for it
+			len = q_min ((int) strlen (text), CMD_ARENA_SIZE / 2 - 1);
+			memcpy (cmd_arena + used, text, len);
+			cmd_arena[used + len] = 0;
+			cmd_args = cmd_arena + used;
+			used += len + 1;
+		}
 
 		text = COM_Parse (text);
 		if (!text)
@@ -595,7 +1064,14 @@ void Cmd_TokenizeString (const char *text)
 
 		if (cmd_argc < MAX_ARGS)
 		{
-			cmd_argv[cmd_argc] = Z_Strdup (com_token);
+			len = strlen (com_token) + 1;
+			if (used + len > CMD_ARENA_SIZE)
+			{
+				Con_DPrintf ("Cmd_TokenizeString: line too long\n");
+				return;
+			}
+			cmd_argv[cmd_argc] = (char *) memcpy (cmd_arena + used, com_token, len);
+			used += len;
 			cmd_argc++;
 		}
 	}
@@ -611,6 +1087,7 @@ void	Cmd_AddCommand (const char *cmd_name, xcommand_t function)
 {
 	cmd_function_t	*cmd;
 	cmd_function_t	*cursor,*prev; //johnfitz -- sorted list insert
+	unsigned int	hash;
 
 	if (host_initialized)	// because hunk allocation would get stomped
 		Sys_Error ("Cmd_AddCommand after host_initialized");
@@ -623,19 +1100,21 @@ void	Cmd_AddCommand (const char *cmd_name, xcommand_t function)
 	}
 
 // fail if the command already exists
-	for (cmd=cmd_functions ; cmd ; cmd=cmd->next)
+	if (Cmd_FindCommand (cmd_name, false))
 	{
-		if (!Q_strcmp (cmd_name, cmd->name))
-		{
-			Con_Printf ("Cmd_AddCommand: %s already defined\n", cmd_name);
-			return;
-		}
+		Con_Printf ("Cmd_AddCommand: %s already defined\n", cmd_name);
+		return;
 	}
 
 	cmd = (cmd_function_t *) Hunk_Alloc (sizeof(cmd_function_t));
 	cmd->name = cmd_name;
 	cmd->function = function;
 
+	hash = Cmd_HashName (cmd_name) & (CMD_HASH_SIZE - 1);
+	cmd->hash_next = cmd_hash[hash];
+	cmd_hash[hash] = cmd;
+	Cmd_IndexName (cmd_name, CMDNAME_COMMAND);
+
 	//johnfitz -- insert each entry in alphabetical order
 	if (cmd_functions == NULL || strcmp(cmd->name, cmd_functions->name) < 0) //insert at front
 	{
@@ -664,15 +1143,7 @@ Cmd_Exists
 */
 qboolean	Cmd_Exists (const char *cmd_name)
 {
-	cmd_function_t	*cmd;
-
-	for (cmd=cmd_functions ; cmd ; cmd=cmd->next)
-	{
-		if (!Q_strcmp (cmd_name,cmd->name))
-			return true;
-	}
-
-	return false;
+	return Cmd_FindCommand (cmd_name, false) != NULL;
 }
 
 
@@ -684,20 +1155,10 @@ Cmd_CompleteCommand
 */
 const char *Cmd_CompleteCommand (const char *partial)
 {
-	cmd_function_t	*cmd;
-	int		len;
-
-	len = Q_strlen(partial);
-
-	if (!len)
+	if (!*partial)
 		return NULL;
 
-// check functions
-	for (cmd=cmd_functions ; cmd ; cmd=cmd->next)
-		if (!Q_strncmp (partial,cmd->name, len))
-			return cmd->name;
-
-	return NULL;
+	return Cmd_CompleteName (partial, CMDNAME_COMMAND);
 }
 
 /*
@@ -705,7 +1166,6 @@ const char *Cmd_CompleteCommand (const char *partial)
 Cmd_ExecuteString
 
 A complete command line has been parsed, so try to execute it
-FIXME: lookupnoadd the token to speed search?
 ============
 */
 void	Cmd_ExecuteString (const char *text, cmd_source_t src)
@@ -720,24 +1180,22 @@ void	Cmd_ExecuteString (const char *text, cmd_source_t src)
 	if (!Cmd_Argc())
 		return;		// no tokens
 
+	cmd = Cmd_FindCommand (cmd_argv[0], true);
+	a = cmd ? NULL : Cmd_FindAlias (cmd_argv[0], true);
+	cmd_lines++;
+
 // check functions
-	for (cmd=cmd_functions ; cmd ; cmd=cmd->next)
+	if (cmd)
 	{
-		if (!q_strcasecmp (cmd_argv[0],cmd->name))
-		{
-			cmd->function ();
-			return;
-		}
+		cmd->function ();
+		return;
 	}
 
 // check alias
-	for (a=cmd_alias ; a ; a=a->next)
+	if (a)
 	{
-		if (!q_strcasecmp (cmd_argv[0], a->name))
-		{
-			Cbuf_InsertText (a->value);
-			return;
-		}
+		Cbuf_InsertText (a->value);
+		return;
 	}
 
 // check cvars
@@ -95,6 +95,26 @@ const char	*Cmd_CompleteCommand (const char *partial);
 // attempts to match a partial command for automatic command line completion
 // returns NULL if nothing fits
 
+#define	CMD_HASH_SIZE	512	// buckets for commands, aliases and cvars, must be power of 2
+
+unsigned int Cmd_HashName (const char *name);
+// case insensitive, so commands and aliases can be matched regardless of case
+
+#define	CMDNAME_COMMAND	1
+#define	CMDNAME_ALIAS	2
+#define	CMDNAME_CVAR	4
+#define	CMDNAME_ALL	(CMDNAME_COMMAND|CMDNAME_ALIAS|CMDNAME_CVAR)
+
+void Cmd_IndexName (const char *name, int kind);
+void Cmd_UnindexName (const char *name, int kind);
+// keeps the completion trie in step with the commands, aliases and cvars.
+// the name is referenced until it's unindexed
+
+const char *Cmd_CompleteName (const char *partial, int kinds);
+void Cmd_ListCompletions (const char *partial, int kinds, void (*func) (const char *name, int kind));
+// the first, or every, name of the given kinds starting with partial, in
+// alphabetical order. names that are several kinds come once for each
+
 int		Cmd_Argc (void);
 const char	*Cmd_Argv (int arg);
 const char	*Cmd_Args (void);
@@ -1526,6 +1526,24 @@ long COM_filelength (FILE *f)
 	return end;
 }
 
+/*
+===========
+COM_MapPackFile
+
+maps a whole pak on first use, returns false if it can't be mapped
+===========
+*/
+static qboolean COM_MapPackFile (pack_t *pak)
+{
+	if (!pak->mapsize)
+	{
+		pak->mapping = (byte *) Sys_MapFile (pak->filename, &pak->mapsize);
+		if (!pak->mapping)
+			pak->mapsize = -1; //don't try again
+	}
+	return pak->mapping != NULL;
+}
+
 /*
 ===========
 COM_FindFile
@@ -1534,10 +1552,12 @@ Finds the file in the search path.
 Sets com_filesize and one of handle or file
 If neither of file or handle is set, this
 can be used for detecting a file's presence.
+With data set as well as file, a file inside
+a packfile is mapped instead of opened.
 ===========
 */
 static int COM_FindFile (const char *filename, int *handle, FILE **file,
-							unsigned int *path_id)
+							const byte **data, unsigned int *path_id)
 {
 	searchpath_t	*search;
 	char		netpath[MAX_OSPATH];
@@ -1548,6 +1568,8 @@ static int COM_FindFile (const char *filename, int *handle, FILE **file,
 		Sys_Error ("COM_FindFile: both handle and file set");
 
 	file_from_pak = 0;
+	if (data)
+		*data = NULL;
 
 //
 // search through the path, one element at a time
@@ -1573,7 +1595,16 @@ static int COM_FindFile (const char *filename, int *handle, FILE **file,
 					return com_filesize;
 				}
 				else if (file)
-				{ /* open a new file on the pakfile */
+				{
+					if (data && COM_MapPackFile (pak) &&
+					    pak->files[i].filepos >= 0 && com_filesize >= 0 &&
+					    pak->files[i].filepos <= pak->mapsize - com_filesize)
+					{
+						*data = pak->mapping + pak->files[i].filepos;
+						*file = NULL;
+						return com_filesize;
+					}
+					/* open a new file on the pakfile */
 					*file = fopen (pak->filename, "rb");
 					if (*file)
 						fseek (*file, pak->files[i].filepos, SEEK_SET);
@@ -1645,7 +1676,7 @@ Returns whether the file is found in the quake filesystem.
 */
 qboolean COM_FileExists (const char *filename, unsigned int *path_id)
 {
-	int ret = COM_FindFile (filename, NULL, NULL, path_id);
+	int ret = COM_FindFile (filename, NULL, NULL, NULL, path_id);
 	return (ret == -1) ? false : true;
 }
 
@@ -1660,7 +1691,7 @@ it may actually be inside a pak file
 */
 int COM_OpenFile (const char *filename, int *handle, unsigned int *path_id)
 {
-	return COM_FindFile (filename, handle, NULL, path_id);
+	return COM_FindFile (filename, handle, NULL, NULL, path_id);
 }
 
 /*
@@ -1673,7 +1704,21 @@ into the file.
 */
 int COM_FOpenFile (const char *filename, FILE **file, unsigned int *path_id)
 {
-	return COM_FindFile (filename, NULL, file, path_id);
+	return COM_FindFile (filename, NULL, file, NULL, path_id);
+}
+
+/*
+===========
+COM_MapFile
+
+Like COM_FOpenFile, but a file inside a packfile comes back in *data,
+pointing into a read-only mapping of the pak, and *file is NULL. The
+mapping lasts until the pak is closed.
+===========
+*/
+int COM_MapFile (const char *filename, FILE **file, const byte **data, unsigned int *path_id)
+{
+	return COM_FindFile (filename, NULL, file, data, path_id);
 }
 
 /*
@@ -1884,6 +1929,8 @@ static pack_t *COM_LoadPackFile (const char *packfile)
 	pack->handle = packhandle;
 	pack->numfiles = numpackfiles;
 	pack->files = newfiles;
+	pack->mapping = NULL; //mapped on first use by COM_MapFile
+	pack->mapsize = 0;
 
 	//Sys_Printf ("Added packfile %s (%i files)\n", packfile, numpackfiles);
 	return pack;
@@ -2029,6 +2076,7 @@ static void COM_Game_f (void)
 			if (com_searchpaths->pack)
 			{
 				Sys_FileClose (com_searchpaths->pack->handle);
+				Sys_UnmapFile (com_searchpaths->pack->mapping, com_searchpaths->pack->mapsize);
 				Z_Free (com_searchpaths->pack->files);
 				Z_Free (com_searchpaths->pack);
 			}
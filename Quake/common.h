@@ -204,6 +204,8 @@ typedef struct pack_s
 	int		handle;
 	int		numfiles;
 	packfile_t	*files;
+	byte	*mapping;	//whole pak, see COM_MapFile
+	int		mapsize;	//0 if not mapped yet, -1 if it can't be
 } pack_t;
 
 typedef struct searchpath_s
@@ -229,6 +231,7 @@ extern	int	file_from_pak;	// global indicating that file came from a pak
 void COM_WriteFile (const char *filename, const void *data, int len);
 int COM_OpenFile (const char *filename, int *handle, unsigned int *path_id);
 int COM_FOpenFile (const char *filename, FILE **file, unsigned int *path_id);
+int COM_MapFile (const char *filename, FILE **file, const byte **data, unsigned int *path_id);
 qboolean COM_FileExists (const char *filename, unsigned int *path_id);
 void COM_CloseFile (int h);
 
@@ -32,31 +32,64 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 #include "quakedef.h"
 
+#if defined(USE_SDL2)
+#if defined(SDL_FRAMEWORK) || defined(NO_SDL_CONFIG)
+#include <SDL2/SDL.h>
+#else
+#include "SDL.h"
+#endif
+#define	LOG_ASYNC	/* the log ring needs SDL2's atomics */
+#endif
+
 int 		con_linewidth;
 
 float		con_cursorspeed = 4;
 
-#define		CON_TEXTSIZE 65536 //johnfitz -- new default size
+#define		CON_TEXTSIZE (1024*1024) //default scrollback, in bytes
 #define		CON_MINSIZE  16384 //johnfitz -- old default, now the minimum size
+#define		CON_MAXSIZE  (64*1024*1024)
+#define		CON_MAXLINE  1024 //longer lines are broken up
+
+/*
+The scrollback is a ring of lines, each kept whole in con_text, which is
+filled from the start again when it runs out. Lines are wrapped to the
+console width as they're drawn, and remember how many rows that took, so
+a resize doesn't touch the text.
+*/
+typedef struct
+{
+	int		start;		// in con_text
+	int		length;
+	float		time;		// realtime the line was started, for notify lines
+	int		rows;		// when wrapped to rowwidth characters
+	int		rowwidth;
+} conline_t;
 
 int		con_buffersize; //johnfitz -- user can now override default
 
 qboolean 	con_forcedup;		// because no entities to refresh
 
-int		con_totallines;		// total lines in console scrollback
-int		con_backscroll;		// lines up from bottom to display
-int		con_current;		// where next message will be printed
-int		con_x;				// offset in current line for next print
-char		*con_text = NULL;
+int		con_backscroll;		// rows up from bottom to display
+static char	*con_text = NULL;
+static conline_t	*con_lines;		// line n is con_lines[n % con_maxlines]
+static int	con_maxlines;
+static int	con_firstline;		// oldest line kept
+static int	con_current;		// line being printed to
+static qboolean	con_newline;		// the next character starts a new line
+static int	con_totalrows;		// rows of all lines, when wrapped to con_totalwidth
+static int	con_totalwidth;		// con_totalrows needs counting unless this is con_linewidth
+static int	con_rowsadded;		// by the current Con_Print
+static int	con_changes;		// bumped whenever the text or its layout changes
+
+#define	CON_LINE(n)	(&con_lines[(n) % con_maxlines])
 
 cvar_t		con_notifytime = {"con_notifytime","3",CVAR_NONE};	//seconds
 cvar_t		con_logcenterprint = {"con_logcenterprint", "1", CVAR_NONE}; //johnfitz
+cvar_t		con_scrollback = {"con_scrollback", "1024", CVAR_ARCHIVE}; //kilobytes
 
 char		con_lastcenterstring[1024]; //johnfitz
 
-#define	NUM_CON_TIMES 4
-float		con_times[NUM_CON_TIMES];	// realtime time the line was generated
-						// for transparent notify lines
+#define	NUM_CON_TIMES 4		// notify lines
 
 int			con_vislines;
 
@@ -129,7 +162,7 @@ void Con_ToggleConsole_f (void)
 	}
 
 	SCR_EndLoadingPlaque ();
-	memset (con_times, 0, sizeof(con_times));
+	Con_ClearNotify ();
 }
 
 /*
@@ -139,8 +172,20 @@ Con_Clear_f
 */
 static void Con_Clear_f (void)
 {
-	if (con_text)
-		Q_memset (con_text, ' ', con_buffersize); //johnfitz -- con_buffersize replaces CON_TEXTSIZE
+	conline_t	*line;
+
+	if (!con_text)
+		return;
+
+	con_firstline = con_current = 0;
+	con_newline = false;
+	line = CON_LINE(0);
+	line->start = line->length = 0;
+	line->time = 0;
+	line->rows = 1;
+	line->rowwidth = con_linewidth;
+	con_totalwidth = 0;
+	con_changes++;
 	con_backscroll = 0; //johnfitz -- if console is empty, being scrolled up is confusing
 }
 
@@ -151,10 +196,9 @@ Con_Dump_f -- johnfitz -- adapted from quake2 source
 */
 static void Con_Dump_f (void)
 {
-	int		l, x;
-	const char	*line;
+	int		i, x;
+	const conline_t	*line;
 	FILE	*f;
-	char	buffer[1024];
 	char	name[MAX_OSPATH];
 
 	q_snprintf (name, sizeof(name), "%s/condump.txt", com_gamedir);
@@ -167,33 +211,19 @@ static void Con_Dump_f (void)
 	}
 
 	// skip initial empty lines
-	for (l = con_current - con_totallines + 1; l <= con_current; l++)
+	for (i = con_firstline; i < con_current; i++)
 	{
-		line = con_text + (l % con_totallines)*con_linewidth;
-		for (x = 0; x < con_linewidth; x++)
-			if (line[x] != ' ')
-				break;
-		if (x != con_linewidth)
+		if (CON_LINE(i)->length)
 			break;
 	}
 
 	// write the remaining lines
-	buffer[con_linewidth] = 0;
-	for ( ; l <= con_current; l++)
+	for ( ; i <= con_current; i++)
 	{
-		line = con_text + (l%con_totallines)*con_linewidth;
-		strncpy (buffer, line, con_linewidth);
-		for (x = con_linewidth - 1; x >= 0; x--)
-		{
-			if (buffer[x] == ' ')
-				buffer[x] = 0;
-			else
-				break;
-		}
-		for (x = 0; buffer[x]; x++)
-			buffer[x] &= 0x7f;
-
-		fprintf (f, "%s\n", buffer);
+		line = CON_LINE(i);
+		for (x = 0; x < line->length; x++)
+			fputc (con_text[line->start + x] & 0x7f, f);
+		fputc ('\n', f);
 	}
 
 	fclose (f);
@@ -209,8 +239,11 @@ void Con_ClearNotify (void)
 {
 	int		i;
 
-	for (i = 0; i < NUM_CON_TIMES; i++)
-		con_times[i] = 0;
+	if (!con_text)
+		return;
+
+	for (i = q_max(con_firstline, con_current - NUM_CON_TIMES + 1); i <= con_current; i++)
+		CON_LINE(i)->time = 0;
 }
 
 
@@ -241,61 +274,285 @@ static void Con_MessageMode2_f (void)
 }
 
 
+/*
+================
+Con_WrapLine -- splits a line into rows of at most width characters, returns the number of rows
+
+fills in the offset of each row if rowstarts isn't NULL
+================
+*/
+static int Con_WrapLine (const char *text, int length, int width, int *rowstarts)
+{
+	int		i, l, x, rows;
+	qboolean	boundary;
+
+	rows = 1;
+	if (rowstarts)
+		rowstarts[0] = 0;
+	boundary = true;
+
+	for (i = 0, x = 0; i < length; i++, x++)
+	{
+		if ((text[i] & 127) <= ' ')
+		{
+			boundary = true;
+		}
+		else if (boundary)
+		{
+			// count word length
+			for (l = 0; l < width && i + l < length; l++)
+				if ((text[i+l] & 127) <= ' ')
+					break;
+
+			// word wrap
+			if (l != width && (x + l > width))
+				x = width;
+
+			boundary = false;
+		}
+
+		if (x >= width)
+		{
+			if (rowstarts)
+				rowstarts[rows] = i;
+			rows++;
+			x = 0;
+		}
+	}
+
+	return rows;
+}
+
+/*
+================
+Con_LineRows -- rows a line takes at the current width
+================
+*/
+static int Con_LineRows (conline_t *line)
+{
+	if (line->rowwidth != con_linewidth)
+	{
+		line->rows = Con_WrapLine (con_text + line->start, line->length, con_linewidth, NULL);
+		line->rowwidth = con_linewidth;
+	}
+	return line->rows;
+}
+
+/*
+================
+Con_TotalRows -- only counts the lines again after a resize
+================
+*/
+static int Con_TotalRows (void)
+{
+	int	i;
+
+	if (con_totalwidth != con_linewidth)
+	{
+		con_totalrows = 0;
+		for (i = con_firstline; i <= con_current; i++)
+			con_totalrows += Con_LineRows (CON_LINE(i));
+		con_totalwidth = con_linewidth;
+	}
+	return con_totalrows;
+}
+
+/*
+================
+Con_UpdateRows -- after text was added to a line
+================
+*/
+static void Con_UpdateRows (conline_t *line)
+{
+	int	rows;
+
+	rows = Con_WrapLine (con_text + line->start, line->length, con_linewidth, NULL);
+	if (line->rowwidth == con_linewidth)
+	{
+		con_rowsadded += rows - line->rows;
+		if (con_totalwidth == con_linewidth)
+			con_totalrows += rows - line->rows;
+	}
+	line->rows = rows;
+	line->rowwidth = con_linewidth;
+}
+
+/*
+================
+Con_MaxBackscroll
+================
+*/
+static int Con_MaxBackscroll (void)
+{
+	int	rows;
+
+	// the text rows left when scrolled back: no input, version or arrow lines
+	rows = (((con_vislines > 0) ? con_vislines : vid.conheight) + 7) / 8 - 4;
+	return q_max(0, Con_TotalRows () - q_max(rows, 1));
+}
+
+/*
+================
+Con_Scroll -- positive rows scroll back
+================
+*/
+void Con_Scroll (int rows)
+{
+	con_backscroll = CLAMP(0, con_backscroll + rows, Con_MaxBackscroll ());
+}
+
+/*
+================
+Con_ScrollToTop
+================
+*/
+void Con_ScrollToTop (void)
+{
+	con_backscroll = Con_MaxBackscroll ();
+}
+
+/*
+================
+Con_DropLine -- forgets the oldest line
+================
+*/
+static void Con_DropLine (void)
+{
+	if (con_totalwidth == con_linewidth)
+		con_totalrows -= Con_LineRows (CON_LINE(con_firstline));
+	con_firstline++;
+}
+
+/*
+================
+Con_NewLine
+
+starts a line after the current one, with room for CON_MAXLINE characters
+================
+*/
+static void Con_NewLine (void)
+{
+	conline_t	*line;
+	int		start, end;
+
+	line = CON_LINE(con_current);
+	start = line->start + line->length;
+	if (start + CON_MAXLINE > con_buffersize)
+	{
+		// start over at the beginning, the lines left in the tail are the oldest
+		while (con_firstline < con_current && CON_LINE(con_firstline)->start >= start)
+			Con_DropLine ();
+		start = 0;
+	}
+
+	// drop the old lines in the way
+	end = start + CON_MAXLINE;
+	while (con_firstline < con_current)
+	{
+		line = CON_LINE(con_firstline);
+		if (line->start >= end || (line->start < start && line->start + line->length <= start))
+			break;
+		Con_DropLine ();
+	}
+	if (con_current + 1 - con_firstline >= con_maxlines)
+		Con_DropLine ();
+
+	con_current++;
+	line = CON_LINE(con_current);
+	line->start = start;
+	line->length = 0;
+	line->time = realtime;
+	line->rows = 1;
+	line->rowwidth = con_linewidth;
+
+	con_rowsadded++;
+	if (con_totalwidth == con_linewidth)
+		con_totalrows++;
+}
+
 /*
 ================
 Con_CheckResize
 
-If the line width has changed, reformat the buffer.
+If the line width has changed, the lines get wrapped again as they're drawn.
 ================
 */
 void Con_CheckResize (void)
 {
-	int	i, j, width, oldwidth, oldtotallines, numlines, numchars;
-	char	*tbuf; //johnfitz -- tbuf no longer a static array
-	int mark; //johnfitz
+	int	width;
 
 	width = (vid.conwidth >> 3) - 2; //johnfitz -- use vid.conwidth instead of vid.width
 
 	if (width == con_linewidth)
 		return;
 
-	oldwidth = con_linewidth;
 	con_linewidth = width;
-	oldtotallines = con_totallines;
-	con_totallines = con_buffersize / con_linewidth; //johnfitz -- con_buffersize replaces CON_TEXTSIZE
-	numlines = oldtotallines;
-
-	if (con_totallines < numlines)
-		numlines = con_totallines;
-
-	numchars = oldwidth;
+	con_changes++;
+	con_backscroll = 0;
+}
 
-	if (con_linewidth < numchars)
-		numchars = con_linewidth;
+/*
+================
+Con_Alloc -- sets up a scrollback of size bytes, keeping the newest lines that fit
+================
+*/
+static void Con_Alloc (int size)
+{
+	char		*oldtext;
+	conline_t	*oldlines, *old, *line;
+	int		i, oldmax, oldfirst, oldcurrent;
+	qboolean	oldnewline;
 
-	mark = Hunk_LowMark (); //johnfitz
-	tbuf = (char *) Hunk_Alloc (con_buffersize); //johnfitz
+	size = CLAMP(CON_MINSIZE, size, CON_MAXSIZE);
+	if (con_text && size == con_buffersize)
+		return;
 
-	Q_memcpy (tbuf, con_text, con_buffersize);//johnfitz -- con_buffersize replaces CON_TEXTSIZE
-	Q_memset (con_text, ' ', con_buffersize);//johnfitz -- con_buffersize replaces CON_TEXTSIZE
+	oldtext = con_text;
+	oldlines = con_lines;
+	oldmax = con_maxlines;
+	oldfirst = con_firstline;
+	oldcurrent = con_current;
+	oldnewline = con_newline;
+
+	con_buffersize = size;
+	con_maxlines = size / 16;
+	con_text = (char *) malloc (con_buffersize);
+	con_lines = (conline_t *) malloc (con_maxlines * sizeof(conline_t));
+	if (!con_text || !con_lines)
+		Sys_Error ("Con_Alloc: out of memory");
+
+	Con_Clear_f ();
+	if (!oldtext)
+		return;
 
-	for (i = 0; i < numlines; i++)
+	// add the old lines again, the oldest drop out if they don't fit
+	for (i = oldfirst; i <= oldcurrent; i++)
 	{
-		for (j = 0; j < numchars; j++)
-		{
-			con_text[(con_totallines - 1 - i) * con_linewidth + j] =
-					tbuf[((con_current - i + oldtotallines) % oldtotallines) * oldwidth + j];
-		}
+		old = &oldlines[i % oldmax];
+		if (i > oldfirst)
+			Con_NewLine ();
+		line = CON_LINE(con_current);
+		memcpy (con_text + line->start, oldtext + old->start, old->length);
+		line->length = old->length;
+		line->time = old->time;
+		line->rowwidth = 0;
 	}
+	con_rowsadded = 0;
+	con_newline = oldnewline; //Con_Clear_f reset it
 
-	Hunk_FreeToLowMark (mark); //johnfitz
-
-	Con_ClearNotify ();
-
-	con_backscroll = 0;
-	con_current = con_totallines - 1;
+	free (oldtext);
+	free (oldlines);
 }
 
+/*
+================
+Con_Scrollback_f -- called when con_scrollback changes
+================
+*/
+static void Con_Scrollback_f (cvar_t *var)
+{
+	Con_Alloc ((int) q_min(var->value, (float)(CON_MAXSIZE / 1024)) * 1024);
+}
 
 /*
 ================
@@ -309,26 +566,27 @@ void Con_Init (void)
 	//johnfitz -- user settable console buffer size
 	i = COM_CheckParm("-consize");
 	if (i && i < com_argc-1)
-		con_buffersize = q_max(CON_MINSIZE,Q_atoi(com_argv[i+1])*1024);
+		Con_Alloc (q_max(CON_MINSIZE,Q_atoi(com_argv[i+1])*1024));
 	else
-		con_buffersize = CON_TEXTSIZE;
+		Con_Alloc (CON_TEXTSIZE);
 	//johnfitz
 
-	con_text = (char *) Hunk_AllocName (con_buffersize, "context");//johnfitz -- con_buffersize replaces CON_TEXTSIZE
-	Q_memset (con_text, ' ', con_buffersize);//johnfitz -- con_buffersize replaces CON_TEXTSIZE
-	con_linewidth = -1;
-
 	//johnfitz -- no need to run Con_CheckResize here
 	con_linewidth = 38;
-	con_totallines = con_buffersize / con_linewidth;//johnfitz -- con_buffersize replaces CON_TEXTSIZE
 	con_backscroll = 0;
-	con_current = con_totallines - 1;
 	//johnfitz
 
 	Con_Printf ("Console initialized.\n");
 
 	Cvar_RegisterVariable (&con_notifytime);
 	Cvar_RegisterVariable (&con_logcenterprint); //johnfitz
+	Cvar_RegisterVariable (&con_scrollback);
+	Cvar_SetCallback (&con_scrollback, Con_Scrollback_f);
+	if (i && i < com_argc-1)
+	{	// -consize wins over a con_scrollback saved in config.cfg
+		Cvar_SetValueQuick (&con_scrollback, con_buffersize / 1024);
+		Cvar_LockVar (con_scrollback.name);
+	}
 
 	Cmd_AddCommand ("toggleconsole", Con_ToggleConsole_f);
 	Cmd_AddCommand ("messagemode", Con_MessageMode_f);
@@ -338,26 +596,6 @@ void Con_Init (void)
 	con_initialized = true;
 }
 
-
-/*
-===============
-Con_Linefeed
-===============
-*/
-static void Con_Linefeed (void)
-{
-	//johnfitz -- improved scrolling
-	if (con_backscroll)
-		con_backscroll++;
-	if (con_backscroll > con_totallines - (glheight>>3) - 1)
-		con_backscroll = con_totallines - (glheight>>3) - 1;
-	//johnfitz
-
-	con_x = 0;
-	con_current++;
-	Q_memset (&con_text[(con_current%con_totallines)*con_linewidth], ' ', con_linewidth);
-}
-
 /*
 ================
 Con_Print
@@ -369,11 +607,9 @@ If no console is visible, the notify window will pop up.
 */
 static void Con_Print (const char *txt)
 {
-	int		y;
-	int		c, l;
-	static int	cr;
-	int		mask;
-	qboolean	boundary;
+	static qboolean	cr;
+	conline_t	*line;
+	int		c, mask;
 
 	//con_backscroll = 0; //johnfitz -- better console scrolling
 
@@ -391,64 +627,52 @@ static void Con_Print (const char *txt)
 	else
 		mask = 0;
 
-	boundary = true;
+	line = CON_LINE(con_current);
 
-	while ( (c = *txt) )
+	while ( (c = *txt++) )
 	{
-		if (c <= ' ')
+		if (con_newline)
 		{
-			boundary = true;
+			Con_UpdateRows (line);
+			Con_NewLine ();
+			line = CON_LINE(con_current);
+			con_newline = false;
 		}
-		else if (boundary)
-		{
-			// count word length
-			for (l = 0; l < con_linewidth; l++)
-				if (txt[l] <= ' ')
-					break;
-
-			// word wrap
-			if (l != con_linewidth && (con_x + l > con_linewidth))
-				con_x = 0;
-
-			boundary = false;
-		}
-
-		txt++;
 
 		if (cr)
 		{
-			con_current--;
+			// the line gets printed over
+			line->length = 0;
+			line->time = realtime;
 			cr = false;
 		}
 
-		if (!con_x)
-		{
-			Con_Linefeed ();
-		// mark time for transparent overlay
-			if (con_current >= 0)
-				con_times[con_current % NUM_CON_TIMES] = realtime;
-		}
-
 		switch (c)
 		{
 		case '\n':
-			con_x = 0;
+			con_newline = true;
 			break;
 
 		case '\r':
-			con_x = 0;
-			cr = 1;
+			cr = true;
 			break;
 
-		default:	// display character and advance
-			y = con_current % con_totallines;
-			con_text[y*con_linewidth+con_x] = c | mask;
-			con_x++;
-			if (con_x >= con_linewidth)
-				con_x = 0;
+		default:	// store character and advance
+			con_text[line->start + line->length++] = c | mask;
+			if (line->length == CON_MAXLINE)
+				con_newline = true;
 			break;
 		}
 	}
+
+	Con_UpdateRows (line);
+
+	//johnfitz -- improved scrolling
+	if (con_backscroll)
+		Con_Scroll (con_rowsadded);
+	//johnfitz
+	con_rowsadded = 0;
+	con_changes++;
 }
 
 
@@ -457,6 +681,184 @@ static void Con_Print (const char *txt)
 static char	logfilename[MAX_OSPATH];	// current logfile name
 static int	log_fd = -1;			// log file descriptor
 
+/*
+Every line of the log is stamped with the seconds since LOG_Init and the
+host frame. Unless -condebugsync is given, Con_DebugLog only copies the
+text into a ring that a writer thread drains with as few write calls as
+it can, so a slow disk can't stall the frame. The main thread is the only
+producer and the writer the only consumer, so the two counters are all
+the locking there is. When the ring is full whole messages are dropped,
+and a note with the number of dropped lines goes in once there is room.
+*/
+
+#define	LOG_RINGSIZE	(1<<18)		// bytes, must be power of 2
+#define	LOG_STAMPSIZE	24		// room for a line stamp
+#define	LOG_FLUSHMS	100		// the writer wakes up at least this often
+
+static double	log_starttime;
+static qboolean	log_linestart = true;	// the next text starts a line
+
+static int	log_calls;		// Con_DebugLog calls, for logstats
+static double	log_time, log_maxtime;	// seconds spent in them
+static int	log_lines;		// lines logged
+static int	log_dropped;		// lines dropped since the last note
+static int	log_droppedtotal;
+static int	log_highwater;		// most bytes waiting in the ring
+
+#ifdef LOG_ASYNC
+static char		log_ring[LOG_RINGSIZE];
+static SDL_atomic_t	log_head;	// bytes queued, only moved by the main thread
+static SDL_atomic_t	log_tail;	// bytes written, only moved by the writer
+static SDL_atomic_t	log_quit;
+static SDL_sem		*log_wake;
+static SDL_Thread	*log_thread;	// NULL when writing synchronously
+
+/*
+================
+LOG_Writer -- the writer thread
+================
+*/
+static int SDLCALL LOG_Writer (void *unused)
+{
+	unsigned	head, tail, ofs, len;
+	int		quit, written;
+
+	for (;;)
+	{
+		quit = SDL_AtomicGet (&log_quit);
+		head = SDL_AtomicGet (&log_head);
+		tail = SDL_AtomicGet (&log_tail);
+
+		// one write up to the end of the ring, another for what wrapped around
+		while (tail != head)
+		{
+			ofs = tail & (LOG_RINGSIZE - 1);
+			len = q_min(head - tail, LOG_RINGSIZE - ofs);
+			written = write (log_fd, log_ring + ofs, len);
+			if (written > 0)
+				len = written;	// the rest goes on the next pass
+			// else nothing to be done about it, drop the span
+			tail += len;
+			SDL_AtomicSet (&log_tail, tail);
+		}
+
+		if (quit)
+			return 0;
+		SDL_SemWaitTimeout (log_wake, LOG_FLUSHMS);
+	}
+}
+
+/*
+================
+LOG_Put -- appends to the ring, the caller has made sure there is room
+================
+*/
+static void LOG_Put (unsigned *head, const char *text, int len)
+{
+	unsigned	ofs, part;
+
+	ofs = *head & (LOG_RINGSIZE - 1);
+	part = q_min((unsigned) len, LOG_RINGSIZE - ofs);
+	memcpy (log_ring + ofs, text, part);
+	memcpy (log_ring, text + part, len - part);
+	*head += len;
+}
+#endif
+
+/*
+================
+LOG_Stamp -- the prefix of a new line
+================
+*/
+static int LOG_Stamp (char *stamp)
+{
+	int	len;
+
+	len = q_snprintf (stamp, LOG_STAMPSIZE, "%10.3f %7i  ", Sys_DoubleTime () - log_starttime, host_framecount);
+	return CLAMP(0, len, LOG_STAMPSIZE - 1);
+}
+
+/*
+================
+LOG_WriteDirect -- stamps msg and writes it out right away
+================
+*/
+static void LOG_WriteDirect (const char *msg)
+{
+	char		stamp[LOG_STAMPSIZE];
+	const char	*end;
+
+	for ( ; *msg; msg = end)
+	{
+		if (log_linestart)
+			write (log_fd, stamp, LOG_Stamp (stamp));
+		end = strchr (msg, '\n');
+		end = end ? end + 1 : msg + strlen (msg);
+		write (log_fd, msg, end - msg);
+		log_linestart = (end[-1] == '\n');
+		log_lines += log_linestart;
+	}
+}
+
+#ifdef LOG_ASYNC
+/*
+================
+LOG_Queue -- stamps msg into the ring, or drops it if it doesn't fit
+================
+*/
+static void LOG_Queue (const char *msg)
+{
+	char		stamp[LOG_STAMPSIZE + 32];
+	const char	*end;
+	unsigned	head, used;
+	int		len, lines, need;
+
+	len = strlen (msg);
+	for (end = msg, lines = 0; (end = strchr (end, '\n')); end++)
+		lines++;
+
+	need = len + (lines + 1) * LOG_STAMPSIZE;
+	if (log_dropped)
+		need += sizeof(stamp);
+
+	head = SDL_AtomicGet (&log_head);
+	used = head - (unsigned) SDL_AtomicGet (&log_tail);
+	if (used + need > LOG_RINGSIZE)
+	{
+		log_dropped += q_max(lines, 1);
+		SDL_SemPost (log_wake);
+		return;
+	}
+
+	if (log_dropped)
+	{
+		len = q_snprintf (stamp, sizeof(stamp), "%s[%i lines dropped]\n", log_linestart ? "" : "\n", log_dropped);
+		LOG_Put (&head, stamp, CLAMP(0, len, (int) sizeof(stamp) - 1));
+		log_droppedtotal += log_dropped;
+		log_dropped = 0;
+		log_linestart = true;
+	}
+
+	for ( ; *msg; msg = end)
+	{
+		if (log_linestart)
+			LOG_Put (&head, stamp, LOG_Stamp (stamp));
+		end = strchr (msg, '\n');
+		end = end ? end + 1 : msg + strlen (msg);
+		LOG_Put (&head, msg, end - msg);
+		log_linestart = (end[-1] == '\n');
+		log_lines += log_linestart;
+	}
+
+	SDL_AtomicSet (&log_head, head);
+
+	used = head - (unsigned) SDL_AtomicGet (&log_tail);
+	log_highwater = q_max(log_highwater, (int) used);
+	if (used > LOG_RINGSIZE / 2 && !SDL_SemValue (log_wake))
+		SDL_SemPost (log_wake);
+}
+#endif
+
 /*
 ================
 Con_DebugLog
@@ -464,10 +866,23 @@ Con_DebugLog
 */
 void Con_DebugLog(const char *msg)
 {
+	double	start, elapsed;
+
 	if (log_fd == -1)
 		return;
 
-	write(log_fd, msg, strlen(msg));
+	start = Sys_DoubleTime ();
+#ifdef LOG_ASYNC
+	if (log_thread)
+		LOG_Queue (msg);
+	else
+#endif
+		LOG_WriteDirect (msg);
+
+	elapsed = Sys_DoubleTime () - start;
+	log_calls++;
+	log_time += elapsed;
+	log_maxtime = q_max(log_maxtime, elapsed);
 }
 
 
@@ -717,21 +1132,6 @@ tab_t	*tablist;
 
 //defs from elsewhere
 extern qboolean	keydown[256];
-typedef struct cmd_function_s
-{
-	struct cmd_function_s	*next;
-	const char		*name;
-	xcommand_t		function;
-} cmd_function_t;
-extern	cmd_function_t	*cmd_functions;
-#define	MAX_ALIAS_NAME	32
-typedef struct cmdalias_s
-{
-	struct cmdalias_s	*next;
-	char	name[MAX_ALIAS_NAME];
-	char	*value;
-} cmdalias_t;
-extern	cmdalias_t	*cmd_alias;
 
 /*
 ============
@@ -781,6 +1181,13 @@ void AddToTabList (const char *name, const char *type)
 		t->next = t;
 		t->prev = t;
 	}
+	else if (strcmp(name, tablist->prev->name) >= 0) //append, the names come in order
+	{
+		t->next = tablist;
+		t->prev = tablist->prev;
+		t->next->prev = t;
+		t->prev->next = t;
+	}
 	else if (strcmp(name, tablist->name) < 0) //insert at front
 	{
 		t->next = tablist;
@@ -891,6 +1298,21 @@ const char *FindCompletion (const char *partial, filelist_item_t *filelist, int
 	return matched;
 }
 
+/*
+============
+AddCompletion
+============
+*/
+static void AddCompletion (const char *name, int kind)
+{
+	if (kind == CMDNAME_CVAR)
+		AddToTabList (name, "cvar");
+	else if (kind == CMDNAME_COMMAND)
+		AddToTabList (name, "command");
+	else
+		AddToTabList (name, "alias");
+}
+
 /*
 ============
 BuildTabList -- johnfitz
@@ -898,29 +1320,12 @@ BuildTabList -- johnfitz
 */
 void BuildTabList (const char *partial)
 {
-	cmdalias_t		*alias;
-	cvar_t			*cvar;
-	cmd_function_t		*cmd;
-	int		len;
-
 	tablist = NULL;
-	len = strlen(partial);
 
 	bash_partial[0] = 0;
 	bash_singlematch = 1;
 
-	cvar = Cvar_FindVarAfter ("", CVAR_NONE);
-	for ( ; cvar ; cvar=cvar->next)
-		if (!Q_strncmp (partial, cvar->name, len))
-			AddToTabList (cvar->name, "cvar");
-
-	for (cmd=cmd_functions ; cmd ; cmd=cmd->next)
-		if (!Q_strncmp (partial,cmd->name, len))
-			AddToTabList (cmd->name, "command");
-
-	for (alias=cmd_alias ; alias ; alias=alias->next)
-		if (!Q_strncmp (partial, alias->name, len))
-			AddToTabList (alias->name, "alias");
+	Cmd_ListCompletions (partial, CMDNAME_ALL, AddCompletion);
 }
 
 /*
@@ -1076,6 +1481,30 @@ DRAWING
 ==============================================================================
 */
 
+static glyphvert_t	*con_verts;		// the visible scrollback, see Con_DrawText
+static int		con_maxverts, con_numverts;
+static int		con_vertskey[5];	// what con_verts were built for
+static glyphvert_t	*con_notifyverts;
+static int		con_maxnotifyverts;
+static int		con_rowstarts[CON_MAXLINE + 1];
+
+/*
+================
+Con_ReserveVerts
+================
+*/
+static glyphvert_t *Con_ReserveVerts (glyphvert_t **verts, int *maxverts, int count)
+{
+	if (count > *maxverts)
+	{
+		*maxverts = count;
+		*verts = (glyphvert_t *) realloc (*verts, count * sizeof(glyphvert_t));
+		if (!*verts)
+			Sys_Error ("Con_ReserveVerts: out of memory");
+	}
+	return *verts;
+}
+
 /*
 ================
 Con_DrawNotify
@@ -1085,32 +1514,40 @@ Draws the last few lines of output transparently over the game top
 */
 void Con_DrawNotify (void)
 {
-	int	i, x, v;
-	const char	*text;
-	float	time;
+	int	i, r, x, v, rows, count, numverts;
+	const char	*text, *rowtext[NUM_CON_TIMES];
+	int	rowlength[NUM_CON_TIMES];
+	conline_t	*line;
+	glyphvert_t	*verts;
 
 	GL_SetCanvas (CANVAS_CONSOLE); //johnfitz
 	v = vid.conheight; //johnfitz
 
-	for (i = con_current-NUM_CON_TIMES+1; i <= con_current; i++)
+	// collect the newest rows, bottom up
+	rows = 0;
+	for (i = con_current; i >= con_firstline && rows < NUM_CON_TIMES; i--)
 	{
-		if (i < 0)
-			continue;
-		time = con_times[i % NUM_CON_TIMES];
-		if (time == 0)
-			continue;
-		time = realtime - time;
-		if (time > con_notifytime.value)
-			continue;
-		text = con_text + (i % con_totallines)*con_linewidth;
-
-		clearnotify = 0;
+		line = CON_LINE(i);
+		if (line->time == 0 || realtime - line->time > con_notifytime.value)
+			break;
 
-		for (x = 0; x < con_linewidth; x++)
-			Draw_Character ((x+1)<<3, v, text[x]);
+		text = con_text + line->start;
+		count = Con_WrapLine (text, line->length, con_linewidth, con_rowstarts);
+		for (r = count - 1; r >= 0 && rows < NUM_CON_TIMES; r--, rows++)
+		{
+			rowtext[rows] = text + con_rowstarts[r];
+			rowlength[rows] = ((r + 1 < count) ? con_rowstarts[r + 1] : line->length) - con_rowstarts[r];
+		}
+	}
 
-		v += 8;
+	if (rows)
+	{
+		verts = Con_ReserveVerts (&con_notifyverts, &con_maxnotifyverts, NUM_CON_TIMES * con_linewidth * 4);
+		for (numverts = 0; rows-- > 0; v += 8)
+			numverts += Draw_StringQuads (verts + numverts, 8, v, rowtext[rows], rowlength[rows]);
+		Draw_GlyphBatch (verts, numverts);
 
+		clearnotify = 0;
 		scr_tileclear_updates = 0; //johnfitz
 	}
 
@@ -1160,6 +1597,7 @@ extern	qpic_t *pic_ovr, *pic_ins; //johnfitz -- new cursor handling
 void Con_DrawInput (void)
 {
 	int	i, ofs;
+	glyphvert_t	verts[MAXCMDLINE * 4];
 
 	if (key_dest != key_console && !con_forcedup)
 		return;		// don't draw anything
@@ -1172,7 +1610,8 @@ void Con_DrawInput (void)
 
 // draw input string
 	for (i = 0; key_lines[edit_line][i+ofs] && i < con_linewidth; i++)
-		Draw_Character ((i+1)<<3, vid.conheight - 16, key_lines[edit_line][i+ofs]);
+		;
+	Draw_GlyphBatch (verts, Draw_StringQuads (verts, 8, vid.conheight - 16, key_lines[edit_line] + ofs, i));
 
 // johnfitz -- new cursor handling
 	if (!((int)((realtime-key_blinktime)*con_cursorspeed) & 1))
@@ -1182,6 +1621,66 @@ void Con_DrawInput (void)
 	}
 }
 
+/*
+================
+Con_DrawText
+
+draws rows rows of scrollback starting at y, and the scrollback arrows
+under them, in one call. the verts are only built again when the text,
+the scroll position or the console size has changed.
+================
+*/
+static void Con_DrawText (int y, int rows)
+{
+	conline_t	*line;
+	int		i, r, x, row, skip, count, end;
+	int		key[5];
+
+	key[0] = con_changes;
+	key[1] = con_backscroll;
+	key[2] = y;
+	key[3] = rows;
+	key[4] = con_linewidth;
+	if (memcmp (key, con_vertskey, sizeof(key)))
+	{
+		memcpy (con_vertskey, key, sizeof(key));
+		Con_ReserveVerts (&con_verts, &con_maxverts, (rows + 2) * con_linewidth * 4);
+		con_numverts = 0;
+
+		// fill in the rows bottom up
+		skip = con_backscroll;
+		row = rows - 1;
+		for (i = con_current; i >= con_firstline && row >= 0; i--)
+		{
+			line = CON_LINE(i);
+			count = Con_LineRows (line);
+			if (count <= skip)
+			{
+				skip -= count;
+				continue;
+			}
+
+			Con_WrapLine (con_text + line->start, line->length, con_linewidth, con_rowstarts);
+			for (r = count - 1 - skip; r >= 0 && row >= 0; r--, row--)
+			{
+				end = (r + 1 < count) ? con_rowstarts[r + 1] : line->length;
+				con_numverts += Draw_StringQuads (con_verts + con_numverts, 8, y + row*8,
+						con_text + line->start + con_rowstarts[r], end - con_rowstarts[r]);
+			}
+			skip = 0;
+		}
+
+		// scrollback arrows, after a blank line
+		if (con_backscroll)
+		{
+			for (x = 0; x < con_linewidth; x += 4)
+				con_numverts += Draw_StringQuads (con_verts + con_numverts, (x + 1)<<3, y + (rows + 1)*8, "^", 1);
+		}
+	}
+
+	Draw_GlyphBatch (con_verts, con_numverts);
+}
+
 /*
 ================
 Con_DrawConsole -- johnfitz -- heavy revision
@@ -1192,8 +1691,7 @@ The typing input line at the bottom should only be drawn if typing is allowed
 */
 void Con_DrawConsole (int lines, qboolean drawinput)
 {
-	int	i, x, y, j, sb, rows;
-	const char	*text;
+	int	y, sb, rows;
 	char	ver[32];
 
 	if (lines <= 0)
@@ -1210,26 +1708,10 @@ void Con_DrawConsole (int lines, qboolean drawinput)
 	y = vid.conheight - rows*8;
 	rows -= 2; //for input and version lines
 	sb = (con_backscroll) ? 2 : 0;
+	rows = q_max(rows - sb, 0);
 
-	for (i = con_current - rows + 1; i <= con_current - sb; i++, y += 8)
-	{
-		j = i - con_backscroll;
-		if (j < 0)
-			j = 0;
-		text = con_text + (j % con_totallines)*con_linewidth;
-
-		for (x = 0; x < con_linewidth; x++)
-			Draw_Character ( (x + 1)<<3, y, text[x]);
-	}
-
-// draw scrollback arrows
-	if (con_backscroll)
-	{
-		y += 8; // blank line
-		for (x = 0; x < con_linewidth; x += 4)
-			Draw_Character ((x + 1)<<3, y, '^');
-		y += 8;
-	}
+	Con_DrawText (y, rows);
+	y += (rows + sb) * 8;
 
 // draw the input prompt, user text, and cursor
 	if (drawinput)
@@ -1238,8 +1720,7 @@ void Con_DrawConsole (int lines, qboolean drawinput)
 //draw version number in bottom right
 	y += 8;
 	sprintf (ver, "QuakeSpasm %1.2f.%d", (float)QUAKESPASM_VERSION, QUAKESPASM_VER_PATCH);
-	for (x = 0; x < (int)strlen(ver); x++)
-		Draw_Character ((con_linewidth - strlen(ver) + x + 2)<<3, y, ver[x] /*+ 128*/);
+	Draw_String ((con_linewidth - (int)strlen(ver) + 2)<<3, y, ver);
 }
 
 
@@ -1282,15 +1763,85 @@ void Con_NotifyBox (const char *text)
 }
 
 
+/*
+================
+LOG_Bench -- seconds per Con_DebugLog of a typical line
+================
+*/
+static double LOG_Bench (int lines)
+{
+	double	start;
+	int	i;
+
+	start = Sys_DoubleTime ();
+	for (i = 0; i < lines; i++)
+		Con_DebugLog (va("logstats bench: line %i of %i, some text to make it a typical length\n", i + 1, lines));
+	return (Sys_DoubleTime () - start) / lines;
+}
+
+/*
+================
+LOG_Stats_f -- logstats [bench [lines]]
+================
+*/
+static void LOG_Stats_f (void)
+{
+	int	lines, dropped;
+	double	sync, async;
+#ifdef LOG_ASYNC
+	SDL_Thread	*thread;
+#endif
+
+	if (log_fd == -1)
+	{
+		Con_Printf ("Not logging, start with -condebug\n");
+		return;
+	}
+
+	if (Cmd_Argc () > 1 && !q_strcasecmp (Cmd_Argv (1), "bench"))
+	{
+		lines = (Cmd_Argc () > 2) ? q_max(Q_atoi (Cmd_Argv (2)), 1) : 10000;
+		dropped = log_droppedtotal + log_dropped;
+#ifdef LOG_ASYNC
+		thread = log_thread;
+		log_thread = NULL;
+		sync = LOG_Bench (lines);
+		log_thread = thread;
+		async = thread ? LOG_Bench (lines) : sync;
+#else
+		sync = async = LOG_Bench (lines);
+#endif
+		Con_Printf ("%i lines: %.2f us per line written directly, %.2f us queued, %i dropped\n",
+			lines, sync * 1e6, async * 1e6, log_droppedtotal + log_dropped - dropped);
+		return;
+	}
+
+	Con_Printf ("%s writes, %i lines, %i dropped\n",
+#ifdef LOG_ASYNC
+		log_thread ? "queued" :
+#endif
+		"direct", log_lines, log_droppedtotal + log_dropped);
+	Con_Printf ("%i calls, %.2f us average, %.2f us max\n", log_calls,
+		log_calls ? log_time / log_calls * 1e6 : 0.0, log_maxtime * 1e6);
+#ifdef LOG_ASYNC
+	if (log_thread)
+		Con_Printf ("ring: %i of %i bytes at most, %i waiting\n", log_highwater, LOG_RINGSIZE,
+			(int) ((unsigned) SDL_AtomicGet (&log_head) - (unsigned) SDL_AtomicGet (&log_tail)));
+#endif
+}
+
 void LOG_Init (quakeparms_t *parms)
 {
 	time_t	inittime;
 	char	session[24];
 
+	Cmd_AddCommand ("logstats", LOG_Stats_f);
+
 	if (!COM_CheckParm("-condebug"))
 		return;
 
 	inittime = time (NULL);
+	log_starttime = Sys_DoubleTime ();
 	strftime (session, sizeof(session), "%m/%d/%Y %H:%M:%S", localtime(&inittime));
 	q_snprintf (logfilename, sizeof(logfilename), "%s/qconsole.log", parms->basedir);
 
@@ -1304,14 +1855,52 @@ void LOG_Init (quakeparms_t *parms)
 	}
 
 	con_debuglog = true;
+
+#ifdef LOG_ASYNC
+	if (!COM_CheckParm("-condebugsync"))
+	{
+		SDL_AtomicSet (&log_head, 0);
+		SDL_AtomicSet (&log_tail, 0);
+		SDL_AtomicSet (&log_quit, 0);
+		log_wake = SDL_CreateSemaphore (0);
+		if (log_wake)
+			log_thread = SDL_CreateThread (LOG_Writer, "log writer", NULL);
+		if (!log_thread)
+			fprintf (stderr, "Error: Unable to start log writer, logging synchronously\n");
+	}
+#endif
+
 	Con_DebugLog (va("LOG started on: %s \n", session));
 
 }
 
+/*
+================
+LOG_Close -- lets the writer finish the ring first
+================
+*/
 void LOG_Close (void)
 {
 	if (log_fd == -1)
 		return;
+
+#ifdef LOG_ASYNC
+	if (log_thread)
+	{
+		SDL_AtomicSet (&log_quit, 1);
+		SDL_SemPost (log_wake);
+		SDL_WaitThread (log_thread, NULL);
+		log_thread = NULL;
+	}
+	if (log_wake)
+	{
+		SDL_DestroySemaphore (log_wake);
+		log_wake = NULL;
+	}
+	if (log_dropped)
+		LOG_WriteDirect (va("%s[%i lines dropped]\n", log_linestart ? "" : "\n", log_dropped));
+#endif
+
 	close (log_fd);
 	log_fd = -1;
 }
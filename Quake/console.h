@@ -26,7 +26,6 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 //
 // console
 //
-extern int con_totallines;
 extern int con_backscroll;
 extern	qboolean con_forcedup;	// because no entities to refresh
 extern qboolean con_initialized;
@@ -37,6 +36,8 @@ extern char con_lastcenterstring[]; //johnfitz
 void Con_DrawCharacter (int cx, int line, int num);
 
 void Con_CheckResize (void);
+void Con_Scroll (int rows);	/* positive rows scroll back */
+void Con_ScrollToTop (void);
 void Con_Init (void);
 void Con_DrawConsole (int lines, qboolean drawinput);
 void Con_Printf (const char *fmt, ...) __attribute__((__format__(__printf__,1,2)));
@@ -24,8 +24,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 
 static cvar_t	*cvar_vars;
+static cvar_t	*cvar_hash[CMD_HASH_SIZE];
 static char	cvar_null_string[] = "";
 
+lookupstats_t	cvar_stats;
+
 //==============================================================================
 //
 //  USER COMMANDS
@@ -249,15 +252,38 @@ cvar_t *Cvar_FindVar (const char *var_name)
 {
 	cvar_t	*var;
 
-	for (var = cvar_vars ; var ; var = var->next)
+	cvar_stats.lookups++;
+	for (var = cvar_hash[Cmd_HashName (var_name) & (CMD_HASH_SIZE - 1)] ; var ; var = var->hash_next)
 	{
 		if (!Q_strcmp(var_name, var->name))
 			return var;
 	}
 
+	cvar_stats.misses++;
 	return NULL;
 }
 
+/*
+============
+Cvar_HashUsage
+============
+*/
+void Cvar_HashUsage (int *names, int *buckets, int *longest)
+{
+	cvar_t	*var;
+	int	i, n;
+
+	*names = *buckets = *longest = 0;
+	for (i = 0 ; i < CMD_HASH_SIZE ; i++)
+	{
+		for (n = 0, var = cvar_hash[i] ; var ; var = var->hash_next)
+			n++;
+		*names += n;
+		*buckets += n > 0;
+		*longest = q_max (*longest, n);
+	}
+}
+
 cvar_t *Cvar_FindVarAfter (const char *prev_name, unsigned int with_flags)
 {
 	cvar_t	*var;
@@ -350,21 +376,10 @@ Cvar_CompleteVariable
 */
 const char *Cvar_CompleteVariable (const char *partial)
 {
-	cvar_t	*cvar;
-	int	len;
-
-	len = Q_strlen(partial);
-	if (!len)
+	if (!*partial)
 		return NULL;
 
-// check functions
-	for (cvar = cvar_vars ; cvar ; cvar = cvar->next)
-	{
-		if (!Q_strncmp(partial, cvar->name, len))
-			return cvar->name;
-	}
-
-	return NULL;
+	return Cmd_CompleteName (partial, CMDNAME_CVAR);
 }
 
 /*
@@ -534,6 +549,7 @@ void Cvar_RegisterVariable (cvar_t *variable)
 	char	value[512];
 	qboolean	set_rom;
 	cvar_t	*cursor,*prev; //johnfitz -- sorted list insert
+	unsigned int	hash;
 
 // first check to see if it has already been defined
 	if (Cvar_FindVar (variable->name))
@@ -572,6 +588,11 @@ void Cvar_RegisterVariable (cvar_t *variable)
 	//johnfitz
 	variable->flags |= CVAR_REGISTERED;
 
+	hash = Cmd_HashName (variable->name) & (CMD_HASH_SIZE - 1);
+	variable->hash_next = cvar_hash[hash];
+	cvar_hash[hash] = variable;
+	Cmd_IndexName (variable->name, CMDNAME_CVAR);
+
 // copy the value off, because future sets will Z_Free it
 	q_strlcpy (value, variable->string, sizeof(value));
 	variable->string = NULL;
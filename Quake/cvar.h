@@ -86,6 +86,7 @@ typedef struct cvar_s
 	const char	*default_string; //johnfitz -- remember defaults for reset function
 	cvarcallback_t	callback;
 	struct cvar_s	*next;
+	struct cvar_s	*hash_next;
 } cvar_t;
 
 void	Cvar_RegisterVariable (cvar_t *variable);
@@ -129,6 +130,15 @@ void	Cvar_WriteVariables (FILE *f);
 cvar_t	*Cvar_FindVar (const char *var_name);
 cvar_t	*Cvar_FindVarAfter (const char *prev_name, unsigned int with_flags);
 
+typedef struct
+{
+	int	lookups, misses;
+} lookupstats_t;
+
+extern	lookupstats_t	cvar_stats;
+void	Cvar_HashUsage (int *names, int *buckets, int *longest);
+// for cmdstats
+
 void	Cvar_LockVar (const char *var_name);
 void	Cvar_UnlockVar (const char *var_name);
 void	Cvar_UnlockAll (void);
@@ -0,0 +1,464 @@
+/*
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+//diskcache.c -- append-only, memory-mapped cache files
+
+#include "quakedef.h"
+
+/*
+A cache is a single file in the game directory, a header followed by
+entries: the key, the size of the data, then the data padded to 4 bytes.
+Entries are only ever appended. The file is mapped into memory when the
+cache is opened, and lookups only read that mapping. Entries written
+during a session are found from the next time the cache is opened.
+
+When the file has grown past its limit it is rewritten on open, keeping
+the newest entries. Hits in the oldest part of the file are appended
+again, so entries that are still in use survive the pruning.
+*/
+
+#define	DISKCACHE_BYTEORDER	0x01020304
+
+typedef struct
+{
+	int	ident;
+	int	version;
+	int	byteorder;	//the cache is only for this machine, so it's in native byte order
+	int	keysize;
+} diskcacheheader_t;
+
+struct diskcacheslot_s
+{
+	byte		key[DISKCACHE_MAX_KEY];
+	int		offset;		//of the entry in the mapping, -1 if it's only in the file
+	qboolean	written;	//appended this session, don't write it again
+	int		next;
+};
+
+#define	ENTRY_SIZE(cache,datasize)	((cache)->keysize + 4 + (((datasize) + 3) & ~3))
+
+/*
+================
+DiskCache_HashData -- 64 bit FNV-1a
+================
+*/
+void DiskCache_HashData (const byte *data, int size, unsigned *hash)
+{
+	uint64_t h = 14695981039346656037ULL;
+
+	while (size--)
+		h = (h ^ *data++) * 1099511628211ULL;
+
+	hash[0] = (unsigned) h;
+	hash[1] = (unsigned) (h >> 32);
+}
+
+/*
+================================================================================
+
+	INDEX
+
+================================================================================
+*/
+
+static int DiskCache_HashKey (diskcache_t *cache, const void *key)
+{
+	const unsigned	*words = (const unsigned *) key;
+	unsigned	h = 0;
+	int		i;
+
+	for (i = 0; i < cache->keysize / 4; i++)
+		h ^= words[i];
+	return h & (DISKCACHE_HASH_SIZE - 1);
+}
+
+/*
+================
+DiskCache_FindSlot
+================
+*/
+static diskcacheslot_t *DiskCache_FindSlot (diskcache_t *cache, const void *key)
+{
+	int i;
+
+	for (i = cache->hash[DiskCache_HashKey (cache, key)]; i != -1; i = cache->slots[i].next)
+		if (!memcmp (cache->slots[i].key, key, cache->keysize))
+			return &cache->slots[i];
+	return NULL;
+}
+
+/*
+================
+DiskCache_AddSlot -- a later entry with the same key replaces the earlier one
+================
+*/
+static diskcacheslot_t *DiskCache_AddSlot (diskcache_t *cache, const void *key, int offset)
+{
+	diskcacheslot_t *slot;
+	int h;
+
+	slot = DiskCache_FindSlot (cache, key);
+	if (slot)
+	{
+		if (offset != -1)
+			slot->offset = offset;
+		return slot;
+	}
+
+	if (cache->numslots == cache->maxslots)
+	{
+		cache->maxslots = q_max (cache->maxslots * 2, 1024);
+		cache->slots = (diskcacheslot_t *) realloc (cache->slots, cache->maxslots * sizeof(diskcacheslot_t));
+		if (!cache->slots)
+			Sys_Error ("DiskCache_AddSlot: out of memory");
+	}
+
+	h = DiskCache_HashKey (cache, key);
+	slot = &cache->slots[cache->numslots];
+	memcpy (slot->key, key, cache->keysize);
+	slot->offset = offset;
+	slot->written = false;
+	slot->next = cache->hash[h];
+	cache->hash[h] = cache->numslots++;
+	return slot;
+}
+
+/*
+================
+DiskCache_ClearIndex
+================
+*/
+static void DiskCache_ClearIndex (diskcache_t *cache)
+{
+	free (cache->slots);
+	cache->slots = NULL;
+	cache->numslots = cache->maxslots = 0;
+	memset (cache->hash, -1, sizeof(cache->hash));
+}
+
+/*
+================
+DiskCache_EntrySize -- of the data of the entry at offset, -1 if it's broken
+================
+*/
+static int DiskCache_EntrySize (diskcache_t *cache, int offset)
+{
+	int size;
+
+	if (offset + cache->keysize + 4 > cache->mapsize)
+		return -1;
+	memcpy (&size, cache->base + offset + cache->keysize, 4);
+	if (size < 0 || ENTRY_SIZE (cache, size) > cache->mapsize - offset)
+		return -1;
+	if (cache->validate && !cache->validate (cache->base + offset + cache->keysize + 4, size))
+		return -1;
+	return size;
+}
+
+/*
+================
+DiskCache_BuildIndex -- indexes the mapping, returns the size of its valid part
+================
+*/
+static int DiskCache_BuildIndex (diskcache_t *cache)
+{
+	const diskcacheheader_t	*header = (const diskcacheheader_t *) cache->base;
+	int	offset, size;
+
+	DiskCache_ClearIndex (cache);
+
+	if (cache->mapsize < (int) sizeof(diskcacheheader_t) || header->ident != cache->ident ||
+	    header->version != cache->version || header->byteorder != DISKCACHE_BYTEORDER ||
+	    header->keysize != cache->keysize)
+		return 0;
+
+	for (offset = sizeof(diskcacheheader_t); offset < cache->mapsize; )
+	{
+		size = DiskCache_EntrySize (cache, offset);
+		if (size == -1)
+			break; //cut short by a crash, most likely
+		DiskCache_AddSlot (cache, cache->base + offset, offset);
+		offset += ENTRY_SIZE (cache, size);
+	}
+
+	return offset;
+}
+
+/*
+================
+DiskCache_WriteHeader
+================
+*/
+static void DiskCache_WriteHeader (diskcache_t *cache, FILE *f)
+{
+	diskcacheheader_t header;
+
+	header.ident = cache->ident;
+	header.version = cache->version;
+	header.byteorder = DISKCACHE_BYTEORDER;
+	header.keysize = cache->keysize;
+	fwrite (&header, sizeof(header), 1, f);
+}
+
+static diskcache_t *sortcache;
+
+static int DiskCache_SlotCompare (const void *a, const void *b)
+{
+	return sortcache->slots[*(const int *)b].offset - sortcache->slots[*(const int *)a].offset;
+}
+
+/*
+================
+DiskCache_Rewrite -- writes the newest entries that fit in keep bytes to a new file
+================
+*/
+static qboolean DiskCache_Rewrite (diskcache_t *cache, const char *path, int keep)
+{
+	char	temppath[MAX_OSPATH];
+	int	*order, count, i, offset, size, total;
+	FILE	*f;
+
+	q_snprintf (temppath, sizeof(temppath), "%s.tmp", path);
+	f = fopen (temppath, "wb");
+	if (!f)
+		return false;
+	DiskCache_WriteHeader (cache, f);
+
+	// newest first, as far as they fit
+	order = (int *) malloc (q_max (cache->numslots, 1) * sizeof(int));
+	if (!order)
+		Sys_Error ("DiskCache_Rewrite: out of memory");
+	for (i = count = 0; i < cache->numslots; i++)
+		if (cache->slots[i].offset != -1)
+			order[count++] = i;
+	sortcache = cache;
+	qsort (order, count, sizeof(int), DiskCache_SlotCompare);
+
+	for (i = total = 0; i < count; i++)
+	{
+		offset = cache->slots[order[i]].offset;
+		size = ENTRY_SIZE (cache, DiskCache_EntrySize (cache, offset));
+		if (total + size > keep)
+			break;
+		total += size;
+	}
+
+	// and written back oldest first
+	while (i--)
+	{
+		offset = cache->slots[order[i]].offset;
+		fwrite (cache->base + offset, ENTRY_SIZE (cache, DiskCache_EntrySize (cache, offset)), 1, f);
+	}
+
+	free (order);
+	if (ferror (f))
+	{
+		fclose (f);
+		remove (temppath);
+		return false;
+	}
+	fclose (f);
+
+	Con_DPrintf ("%s pruned from %i to %i KB\n", cache->description, cache->mapsize / 1024, total / 1024);
+
+	Sys_UnmapFile (cache->base, cache->mapsize);
+	cache->base = NULL;
+	cache->mapsize = 0;
+	remove (path);
+	return rename (temppath, path) == 0;
+}
+
+/*
+================================================================================
+
+	INTERFACE
+
+================================================================================
+*/
+
+/*
+================
+DiskCache_Close
+================
+*/
+void DiskCache_Close (diskcache_t *cache)
+{
+	if (cache->writer)
+		fclose (cache->writer);
+	cache->writer = NULL;
+	Sys_UnmapFile (cache->base, cache->mapsize);
+	cache->base = NULL;
+	cache->mapsize = 0;
+	cache->written = 0;
+	cache->hits = cache->misses = 0;
+	DiskCache_ClearIndex (cache);
+}
+
+/*
+================
+DiskCache_Open
+================
+*/
+void DiskCache_Open (diskcache_t *cache, int limit)
+{
+	char	path[MAX_OSPATH];
+	int	validsize, keep;
+
+	DiskCache_Close (cache);
+	if (limit <= 0)
+		return;
+
+	q_snprintf (path, sizeof(path), "%s/%s", com_gamedir, cache->filename);
+	cache->keep = limit / 4 * 3;
+
+	cache->base = (byte *) Sys_MapFile (path, &cache->mapsize);
+	validsize = cache->base ? DiskCache_BuildIndex (cache) : 0;
+
+	if (cache->base && (validsize != cache->mapsize || cache->mapsize > limit))
+	{
+		// drop the oldest entries, and whatever is past the first broken one
+		keep = (cache->mapsize > limit) ? cache->keep : validsize;
+		if (validsize && DiskCache_Rewrite (cache, path, keep))
+			cache->base = (byte *) Sys_MapFile (path, &cache->mapsize);
+		else
+		{
+			Sys_UnmapFile (cache->base, cache->mapsize);
+			cache->base = NULL;
+			cache->mapsize = 0;
+			remove (path);
+		}
+		validsize = cache->base ? DiskCache_BuildIndex (cache) : 0;
+	}
+
+	if (cache->base)
+		cache->writer = fopen (path, "ab");
+	else
+	{
+		DiskCache_ClearIndex (cache);
+		cache->writer = fopen (path, "wb");
+		if (cache->writer)
+			DiskCache_WriteHeader (cache, cache->writer);
+	}
+
+	if (!cache->writer)
+		Con_DPrintf ("%s %s is read only\n", cache->description, path);
+	Con_DPrintf ("%s: %i entries, %i KB\n", cache->description, cache->numslots, cache->mapsize / 1024);
+}
+
+/*
+================
+DiskCache_Enabled
+================
+*/
+qboolean DiskCache_Enabled (diskcache_t *cache)
+{
+	return cache->base || cache->writer;
+}
+
+/*
+================
+DiskCache_Find
+================
+*/
+const void *DiskCache_Find (diskcache_t *cache, const void *key, int *size)
+{
+	diskcacheslot_t	*slot;
+	const byte	*entry;
+
+	if (!cache->base)
+		return NULL;
+	slot = DiskCache_FindSlot (cache, key);
+	if (!slot || slot->offset == -1)
+		return NULL;
+
+	entry = cache->base + slot->offset + cache->keysize;
+	memcpy (size, entry, 4);
+	return entry + 4;
+}
+
+/*
+================
+DiskCache_Store
+================
+*/
+void DiskCache_Store (diskcache_t *cache, const void *key, const void *head, int headsize,
+		const void *data, int datasize, qboolean hit)
+{
+	static const byte pad[4];
+	diskcacheslot_t	*slot;
+	int	size;
+
+	if (hit)
+		cache->hits++;
+	else
+		cache->misses++;
+
+	if (!cache->writer)
+		return;
+
+	slot = DiskCache_FindSlot (cache, key);
+	if (slot && (slot->written || (slot->offset != -1 && slot->offset >= cache->mapsize - cache->keep)))
+		return; //already written, or safe from the next pruning
+
+	size = headsize + datasize;
+	if (fwrite (key, cache->keysize, 1, cache->writer) != 1 ||
+	    fwrite (&size, 4, 1, cache->writer) != 1 ||
+	    (headsize && fwrite (head, headsize, 1, cache->writer) != 1) ||
+	    (datasize && fwrite (data, datasize, 1, cache->writer) != 1) ||
+	    ((size & 3) && fwrite (pad, 4 - (size & 3), 1, cache->writer) != 1))
+	{
+		Con_Warning ("Couldn't write to the %s, disabling writes\n", cache->description);
+		fclose (cache->writer);
+		cache->writer = NULL;
+		return;
+	}
+	cache->written += ENTRY_SIZE (cache, size);
+
+	slot = DiskCache_AddSlot (cache, key, -1);
+	slot->written = true;
+}
+
+/*
+================
+DiskCache_Flush
+================
+*/
+void DiskCache_Flush (diskcache_t *cache)
+{
+	if (cache->writer)
+		fflush (cache->writer);
+}
+
+/*
+================
+DiskCache_PrintInfo
+================
+*/
+void DiskCache_PrintInfo (diskcache_t *cache)
+{
+	if (!DiskCache_Enabled (cache))
+	{
+		Con_Printf ("%s is off\n", cache->description);
+		return;
+	}
+
+	Con_Printf ("%s: %i entries, %.1f MB mapped, %.1f MB written this session\n", cache->description,
+			cache->numslots, cache->mapsize / (1024.0 * 1024.0), cache->written / (1024.0 * 1024.0));
+	Con_Printf ("%i hits, %i misses\n", cache->hits, cache->misses);
+}
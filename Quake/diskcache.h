@@ -0,0 +1,77 @@
+/*
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef __DISKCACHE_H
+#define __DISKCACHE_H
+
+/* append-only, memory-mapped cache files in the game directory.
+ * entries are looked up by a fixed size key. lookups only read the
+ * mapping, so they are safe on worker threads as long as nothing is
+ * stored meanwhile; everything else is main thread only. */
+
+#define	DISKCACHE_HASH_SIZE	4096	/* must be power of 2 */
+#define	DISKCACHE_MAX_KEY	64	/* bytes */
+
+typedef struct diskcacheslot_s diskcacheslot_t;
+
+typedef struct
+{
+	const char	*filename;	/* in com_gamedir */
+	const char	*description;	/* for messages */
+	int		ident;
+	int		version;	/* bump when the entry layout changes */
+	int		keysize;	/* bytes, a multiple of 4 */
+	/* sanity check of a mapped entry, may be NULL */
+	qboolean	(*validate) (const void *data, int size);
+
+	/* private */
+	byte		*base;		/* the mapping */
+	int		mapsize;
+	FILE		*writer;
+	int		written;	/* bytes appended this session */
+	int		keep;		/* bytes kept when the file is pruned */
+	diskcacheslot_t	*slots;
+	int		numslots, maxslots;
+	int		hash[DISKCACHE_HASH_SIZE];
+	int		hits, misses;
+} diskcache_t;
+
+/* 64 bit FNV-1a into hash[0..1], for keys: the CRC alone is too short
+ * to tell thousands of files apart */
+void DiskCache_HashData (const byte *data, int size, unsigned *hash);
+
+/* maps the cache of the current game directory, and prunes it to 3/4
+ * of limit bytes if it has grown past that. limit 0 just closes it. */
+void DiskCache_Open (diskcache_t *cache, int limit);
+void DiskCache_Close (diskcache_t *cache);
+qboolean DiskCache_Enabled (diskcache_t *cache);
+
+/* returns the mapped entry and its size, or NULL */
+const void *DiskCache_Find (diskcache_t *cache, const void *key, int *size);
+
+/* books a lookup, and appends head + data unless the file already has a
+ * fresh copy of the entry */
+void DiskCache_Store (diskcache_t *cache, const void *key, const void *head, int headsize,
+		const void *data, int datasize, qboolean hit);
+void DiskCache_Flush (diskcache_t *cache);
+void DiskCache_PrintInfo (diskcache_t *cache);
+
+#endif	/* __DISKCACHE_H */
+
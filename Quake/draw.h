@@ -38,6 +38,24 @@ void Draw_TileClear (int x, int y, int w, int h);
 void Draw_Fill (int x, int y, int w, int h, int c, float alpha); //johnfitz -- added alpha
 void Draw_FadeScreen (void);
 void Draw_String (int x, int y, const char *str);
+
+/* text drawn from a vertex array in one call: Draw_StringQuads writes
+ * four verts per visible character of str[0..len) and returns how many
+ * it wrote, Draw_GlyphBatch draws them with conchars */
+typedef struct
+{
+	float	x, y, s, t;
+} glyphvert_t;
+
+int Draw_StringQuads (glyphvert_t *verts, int x, int y, const char *str, int len);
+void Draw_GlyphBatch (const glyphvert_t *verts, int numverts);
+
+/* 2D quads are queued and drawn in batches. Draw_Flush draws what's
+ * queued, call it before changing any GL state the queued quads depend
+ * on. Draw_EndFrame flushes and returns the draw calls made since the
+ * last call */
+void Draw_Flush (void);
+int Draw_EndFrame (void);
 qpic_t *Draw_PicFromWad (const char *name);
 qpic_t *Draw_CachePic (const char *path);
 void Draw_NewGame (void);
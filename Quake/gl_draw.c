@@ -34,7 +34,6 @@ extern cvar_t vr_enabled;
 qpic_t		*draw_disc;
 qpic_t		*draw_backtile;
 
-gltexture_t *char_texture; //johnfitz
 qpic_t		*pic_ovr, *pic_ins; //johnfitz -- new cursor handling
 qpic_t		*pic_nul; //johnfitz -- for missing gfx, don't crash
 
@@ -132,7 +131,7 @@ byte		menuplyr_pixels[4096];
 //  Allocate all the little status bar obejcts into a single texture
 //  to crutch up stupid hardware / drivers
 
-#define	MAX_SCRAPS		2
+#define	MAX_SCRAPS		3	// conchars takes a quarter of the first one
 #define	BLOCK_WIDTH		256
 #define	BLOCK_HEIGHT	256
 
@@ -141,6 +140,8 @@ byte		scrap_texels[MAX_SCRAPS][BLOCK_WIDTH*BLOCK_HEIGHT]; //johnfitz -- removed
 qboolean	scrap_dirty;
 gltexture_t	*scrap_textures[MAX_SCRAPS]; //johnfitz
 
+glpic_t		conchars;	// where conchars sits in the scrap, so text and sbar pics batch together
+
 
 /*
 ================
@@ -200,11 +201,12 @@ void Scrap_Upload (void)
 	char name[8];
 	int	i;
 
+	// nearest filtering, like conchars always had: linear would bleed neighbouring glyphs and pics
 	for (i=0; i<MAX_SCRAPS; i++)
 	{
 		sprintf (name, "scrap%i", i);
 		scrap_textures[i] = TexMgr_LoadImage (NULL, name, BLOCK_WIDTH, BLOCK_HEIGHT, SRC_INDEXED, scrap_texels[i],
-			"", (src_offset_t)scrap_texels[i], TEXPREF_ALPHA | TEXPREF_OVERWRITE | TEXPREF_NOPICMIP);
+			"", (src_offset_t)scrap_texels[i], TEXPREF_ALPHA | TEXPREF_NEAREST | TEXPREF_OVERWRITE | TEXPREF_NOPICMIP);
 	}
 
 	scrap_dirty = false;
@@ -355,13 +357,24 @@ Draw_LoadPics -- johnfitz
 void Draw_LoadPics (void)
 {
 	byte		*data;
-	src_offset_t	offset;
+	int		x = 0, y = 0, i, j, texnum;
 
+	// conchars goes into the scrap first. index 0 is transparent in conchars,
+	// 255 is in the scrap
 	data = (byte *) W_GetLumpName ("conchars");
 	if (!data) Sys_Error ("Draw_LoadPics: couldn't load conchars");
-	offset = (src_offset_t)data - (src_offset_t)wad_base;
-	char_texture = TexMgr_LoadImage (NULL, WADFILENAME":conchars", 128, 128, SRC_INDEXED, data,
-		WADFILENAME, offset, TEXPREF_ALPHA | TEXPREF_NEAREST | TEXPREF_NOPICMIP | TEXPREF_CONCHARS);
+	texnum = Scrap_AllocBlock (128, 128, &x, &y);
+	scrap_dirty = true;
+	for (i=0 ; i<128 ; i++)
+	{
+		for (j=0 ; j<128 ; j++, data++)
+			scrap_texels[texnum][(y+i)*BLOCK_WIDTH + x + j] = *data ? *data : 255;
+	}
+	conchars.gltexture = scrap_textures[texnum];
+	conchars.sl = x/(float)BLOCK_WIDTH;
+	conchars.sh = (x+128)/(float)BLOCK_WIDTH;
+	conchars.tl = y/(float)BLOCK_HEIGHT;
+	conchars.th = (y+128)/(float)BLOCK_HEIGHT;
 
 	draw_disc = Draw_PicFromWad ("disc");
 	draw_backtile = Draw_PicFromWad ("backtile");
@@ -380,7 +393,7 @@ void Draw_NewGame (void)
 	// empty scrap and reallocate gltextures
 	memset(&scrap_allocated, 0, sizeof(scrap_allocated));
 	memset(&scrap_texels, 255, sizeof(scrap_texels));
-	Scrap_Upload (); //creates 2 empty gltextures
+	Scrap_Upload (); //creates the empty scrap gltextures
 
 	// reload wad pics
 	W_LoadWadFile (); //johnfitz -- filename is now hard-coded for honesty
@@ -406,7 +419,7 @@ void Draw_Init (void)
 	// clear scrap and allocate gltextures
 	memset(&scrap_allocated, 0, sizeof(scrap_allocated));
 	memset(&scrap_texels, 255, sizeof(scrap_texels));
-	Scrap_Upload (); //creates 2 empty textures
+	Scrap_Upload (); //creates the empty scrap textures
 
 	// create internal pics
 	pic_ins = Draw_MakePic ("ins", 8, 9, &pic_ins_data[0][0]);
@@ -423,40 +436,154 @@ void Draw_Init (void)
 //
 //==============================================================================
 
+/*
+2D quads are queued and drawn a batch at a time. A batch ends when the
+texture changes, when it's full, and at Draw_Flush, which anything that
+changes GL state under queued quads (the canvas, blending, the color,
+the matrix of the VR HUD) has to call first. Fills are untextured
+batches with a color per vertex. With conchars and the little wad pics
+sharing the scrap, a status bar or a menu is a handful of draw calls.
+*/
+
+typedef struct
+{
+	float	x, y, s, t;
+	byte	color[4];
+} drawvert_t;
+
+#define	MAX_DRAW_VERTS	4096	// 1024 quads
+
+static drawvert_t	draw_verts[MAX_DRAW_VERTS];
+static int		draw_numverts;
+static gltexture_t	*draw_texture;	// of the queued quads, NULL for fills
+static int		draw_calls;	// since the last Draw_EndFrame
+
 /*
 ================
-Draw_CharacterQuad -- johnfitz -- seperate function to spit out verts
+Draw_Flush -- draws the queued quads
 ================
 */
-void Draw_CharacterQuad (int x, int y, char num)
-{
-	int				row, col;
-	float			frow, fcol, size;
-
-	row = num>>4;
-	col = num&15;
-
-	frow = row*0.0625;
-	fcol = col*0.0625;
-	size = 0.0625;
-
-	glTexCoord2f (fcol, frow);
-	glVertex2f (x, y);
-	glTexCoord2f (fcol + size, frow);
-	glVertex2f (x+8, y);
-	glTexCoord2f (fcol + size, frow + size);
-	glVertex2f (x+8, y+8);
-	glTexCoord2f (fcol, frow + size);
-	glVertex2f (x, y+8);
+void Draw_Flush (void)
+{
+	if (!draw_numverts)
+		return;
+
+	GL_BindBuffer (GL_ARRAY_BUFFER, 0);
+	if (gl_mtexable)
+		GL_ClientActiveTextureFunc (GL_TEXTURE0_ARB);
+
+	glVertexPointer (2, GL_FLOAT, sizeof(drawvert_t), &draw_verts[0].x);
+	glEnableClientState (GL_VERTEX_ARRAY);
+
+	if (draw_texture)
+	{
+		GL_Bind (draw_texture);
+		glTexCoordPointer (2, GL_FLOAT, sizeof(drawvert_t), &draw_verts[0].s);
+		glEnableClientState (GL_TEXTURE_COORD_ARRAY);
+		glDrawArrays (GL_QUADS, 0, draw_numverts);
+		glDisableClientState (GL_TEXTURE_COORD_ARRAY);
+	}
+	else
+	{
+		glDisable (GL_TEXTURE_2D);
+		glEnable (GL_BLEND);
+		glDisable (GL_ALPHA_TEST);
+		glColorPointer (4, GL_UNSIGNED_BYTE, sizeof(drawvert_t), draw_verts[0].color);
+		glEnableClientState (GL_COLOR_ARRAY);
+		glDrawArrays (GL_QUADS, 0, draw_numverts);
+		glDisableClientState (GL_COLOR_ARRAY);
+		glColor4f (1,1,1,1); // the current color is undefined after a color array
+		glDisable (GL_BLEND);
+		glEnable (GL_ALPHA_TEST);
+		glEnable (GL_TEXTURE_2D);
+	}
+
+	glDisableClientState (GL_VERTEX_ARRAY);
+
+	draw_numverts = 0;
+	draw_calls++;
 }
 
 /*
 ================
-Draw_Character -- johnfitz -- modified to call Draw_CharacterQuad
+Draw_EndFrame -- flushes, and returns the 2D draw calls made since the last call
+================
+*/
+int Draw_EndFrame (void)
+{
+	int	calls;
+
+	Draw_Flush ();
+	calls = draw_calls;
+	draw_calls = 0;
+	return calls;
+}
+
+/*
+================
+Draw_QueueQuad -- returns room for 4 verts in the batch for texture
+================
+*/
+static drawvert_t *Draw_QueueQuad (gltexture_t *texture)
+{
+	if (texture != draw_texture || draw_numverts + 4 > MAX_DRAW_VERTS)
+	{
+		Draw_Flush ();
+		draw_texture = texture;
+	}
+
+	draw_numverts += 4;
+	return draw_verts + draw_numverts - 4;
+}
+
+/*
+================
+Draw_TexturedQuad
+================
+*/
+static void Draw_TexturedQuad (gltexture_t *texture, float x, float y, float w, float h,
+		float sl, float tl, float sh, float th)
+{
+	drawvert_t	*v = Draw_QueueQuad (texture);
+
+	v[0].x = x;	v[0].y = y;	v[0].s = sl;	v[0].t = tl;
+	v[1].x = x+w;	v[1].y = y;	v[1].s = sh;	v[1].t = tl;
+	v[2].x = x+w;	v[2].y = y+h;	v[2].s = sh;	v[2].t = th;
+	v[3].x = x;	v[3].y = y+h;	v[3].s = sl;	v[3].t = th;
+}
+
+/*
+================
+Draw_FillQuad
+================
+*/
+static void Draw_FillQuad (float x, float y, float w, float h, const byte *rgb, float alpha)
+{
+	drawvert_t	*v = Draw_QueueQuad (NULL);
+	int		i;
+
+	v[0].x = x;	v[0].y = y;
+	v[1].x = x+w;	v[1].y = y;
+	v[2].x = x+w;	v[2].y = y+h;
+	v[3].x = x;	v[3].y = y+h;
+	for (i = 0; i < 4; i++)
+	{
+		v[i].color[0] = rgb[0];
+		v[i].color[1] = rgb[1];
+		v[i].color[2] = rgb[2];
+		v[i].color[3] = (byte) CLAMP (0, (int)(alpha * 255.0 + 0.5), 255);
+	}
+}
+
+/*
+================
+Draw_Character -- johnfitz -- modified; queues a quad from conchars in the scrap
 ================
 */
 void Draw_Character (int x, int y, int num)
 {
+	float	s, t, size;
+
 	if (y <= -8)
 		return;			// totally off screen
 
@@ -465,17 +592,17 @@ void Draw_Character (int x, int y, int num)
 	if (num == 32)
 		return; //don't waste verts on spaces
 
-	GL_Bind (char_texture);
-	glBegin (GL_QUADS);
-
-	Draw_CharacterQuad (x, y, (char) num);
-
-	glEnd ();
+	if (scrap_dirty)
+		Scrap_Upload ();
+	size = (conchars.sh - conchars.sl) * 0.0625;
+	s = conchars.sl + (num & 15) * size;
+	t = conchars.tl + (num >> 4) * size;
+	Draw_TexturedQuad (conchars.gltexture, x, y, 8, 8, s, t, s + size, t + size);
 }
 
 /*
 ================
-Draw_String -- johnfitz -- modified to call Draw_CharacterQuad
+Draw_String -- johnfitz -- modified
 ================
 */
 void Draw_String (int x, int y, const char *str)
@@ -483,18 +610,80 @@ void Draw_String (int x, int y, const char *str)
 	if (y <= -8)
 		return;			// totally off screen
 
-	GL_Bind (char_texture);
-	glBegin (GL_QUADS);
-
 	while (*str)
 	{
-		if (*str != 32) //don't waste verts on spaces
-			Draw_CharacterQuad (x, y, *str);
+		Draw_Character (x, y, *str);
 		str++;
 		x += 8;
 	}
+}
+
+/*
+================
+Draw_StringQuads -- fills in verts for the visible characters of str, returns the number of verts
+================
+*/
+int Draw_StringQuads (glyphvert_t *verts, int x, int y, const char *str, int len)
+{
+	glyphvert_t	*v = verts;
+	int		i, num;
+	float		s, t, size;
+
+	if (y <= -8)
+		return 0;		// totally off screen
+
+	size = (conchars.sh - conchars.sl) * 0.0625;
+	for (i = 0; i < len; i++, x += 8)
+	{
+		num = (byte) str[i];
+		if (num == 32)
+			continue;	//don't waste verts on spaces
+
+		s = conchars.sl + (num & 15) * size;
+		t = conchars.tl + (num >> 4) * size;
+
+		v[0].x = x;	v[0].y = y;	v[0].s = s;		v[0].t = t;
+		v[1].x = x+8;	v[1].y = y;	v[1].s = s + size;	v[1].t = t;
+		v[2].x = x+8;	v[2].y = y+8;	v[2].s = s + size;	v[2].t = t + size;
+		v[3].x = x;	v[3].y = y+8;	v[3].s = s;		v[3].t = t + size;
+		v += 4;
+	}
 
-	glEnd ();
+	return v - verts;
+}
+
+/*
+================
+Draw_GlyphBatch -- draws verts from Draw_StringQuads in one call
+
+the verts are drawn from where they are, they can be too many to queue
+================
+*/
+void Draw_GlyphBatch (const glyphvert_t *verts, int numverts)
+{
+	if (!numverts)
+		return;
+
+	Draw_Flush ();
+	if (scrap_dirty)
+		Scrap_Upload ();
+
+	GL_Bind (conchars.gltexture);
+	GL_BindBuffer (GL_ARRAY_BUFFER, 0);
+	if (gl_mtexable)
+		GL_ClientActiveTextureFunc (GL_TEXTURE0_ARB);
+
+	glVertexPointer (2, GL_FLOAT, sizeof(glyphvert_t), &verts->x);
+	glEnableClientState (GL_VERTEX_ARRAY);
+	glTexCoordPointer (2, GL_FLOAT, sizeof(glyphvert_t), &verts->s);
+	glEnableClientState (GL_TEXTURE_COORD_ARRAY);
+
+	glDrawArrays (GL_QUADS, 0, numverts);
+
+	glDisableClientState (GL_VERTEX_ARRAY);
+	glDisableClientState (GL_TEXTURE_COORD_ARRAY);
+
+	draw_calls++;
 }
 
 /*
@@ -509,17 +698,7 @@ void Draw_Pic (int x, int y, qpic_t *pic)
 	if (scrap_dirty)
 		Scrap_Upload ();
 	gl = (glpic_t *)pic->data;
-	GL_Bind (gl->gltexture);
-	glBegin (GL_QUADS);
-	glTexCoord2f (gl->sl, gl->tl);
-	glVertex2f (x, y);
-	glTexCoord2f (gl->sh, gl->tl);
-	glVertex2f (x+pic->width, y);
-	glTexCoord2f (gl->sh, gl->th);
-	glVertex2f (x+pic->width, y+pic->height);
-	glTexCoord2f (gl->sl, gl->th);
-	glVertex2f (x, y+pic->height);
-	glEnd ();
+	Draw_TexturedQuad (gl->gltexture, x, y, pic->width, pic->height, gl->sl, gl->tl, gl->sh, gl->th);
 }
 
 /*
@@ -540,6 +719,7 @@ void Draw_TransPicTranslate (int x, int y, qpic_t *pic, int top, int bottom)
 		gltexture_t *glt = p->gltexture;
 		oldtop = top;
 		oldbottom = bottom;
+		Draw_Flush (); //queued quads may still use the old colors
 		TexMgr_ReloadImage (glt, top, bottom);
 	}
 	Draw_Pic (x, y, pic);
@@ -567,6 +747,7 @@ void Draw_ConsoleBackground (void)
 	{
 		if (alpha < 1.0)
 		{
+			Draw_Flush ();
 			glEnable (GL_BLEND);
 			glColor4f (1,1,1,alpha);
 			glDisable (GL_ALPHA_TEST);
@@ -577,6 +758,7 @@ void Draw_ConsoleBackground (void)
 
 		if (alpha < 1.0)
 		{
+			Draw_Flush ();
 			glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
 			glEnable (GL_ALPHA_TEST);
 			glDisable (GL_BLEND);
@@ -600,18 +782,7 @@ void Draw_TileClear (int x, int y, int w, int h)
 
 	gl = (glpic_t *)draw_backtile->data;
 
-	glColor3f (1,1,1);
-	GL_Bind (gl->gltexture);
-	glBegin (GL_QUADS);
-	glTexCoord2f (x/64.0, y/64.0);
-	glVertex2f (x, y);
-	glTexCoord2f ( (x+w)/64.0, y/64.0);
-	glVertex2f (x+w, y);
-	glTexCoord2f ( (x+w)/64.0, (y+h)/64.0);
-	glVertex2f (x+w, y+h);
-	glTexCoord2f ( x/64.0, (y+h)/64.0 );
-	glVertex2f (x, y+h);
-	glEnd ();
+	Draw_TexturedQuad (gl->gltexture, x, y, w, h, x/64.0, y/64.0, (x+w)/64.0, (y+h)/64.0);
 }
 
 /*
@@ -625,22 +796,7 @@ void Draw_Fill (int x, int y, int w, int h, int c, float alpha) //johnfitz -- ad
 {
 	byte *pal = (byte *)d_8to24table; //johnfitz -- use d_8to24table instead of host_basepal
 
-	glDisable (GL_TEXTURE_2D);
-	glEnable (GL_BLEND); //johnfitz -- for alpha
-	glDisable (GL_ALPHA_TEST); //johnfitz -- for alpha
-	glColor4f (pal[c*4]/255.0, pal[c*4+1]/255.0, pal[c*4+2]/255.0, alpha); //johnfitz -- added alpha
-
-	glBegin (GL_QUADS);
-	glVertex2f (x,y);
-	glVertex2f (x+w, y);
-	glVertex2f (x+w, y+h);
-	glVertex2f (x, y+h);
-	glEnd ();
-
-	glColor3f (1,1,1);
-	glDisable (GL_BLEND); //johnfitz -- for alpha
-	glEnable (GL_ALPHA_TEST); //johnfitz -- for alpha
-	glEnable (GL_TEXTURE_2D);
+	Draw_FillQuad (x, y, w, h, &pal[(c & 255)*4], alpha); //johnfitz -- added alpha
 }
 
 /*
@@ -650,27 +806,14 @@ Draw_FadeScreen -- johnfitz -- revised
 */
 void Draw_FadeScreen (void)
 {
+	static const byte black[3] = {0, 0, 0};
+
 	if (vr_enabled.value)
 		return;
 
 	GL_SetCanvas (CANVAS_DEFAULT);
 
-	glEnable (GL_BLEND);
-	glDisable (GL_ALPHA_TEST);
-	glDisable (GL_TEXTURE_2D);
-	glColor4f (0, 0, 0, 0.5);
-	glBegin (GL_QUADS);
-
-	glVertex2f (0,0);
-	glVertex2f (glwidth, 0);
-	glVertex2f (glwidth, glheight);
-	glVertex2f (0, glheight);
-
-	glEnd ();
-	glColor4f (1,1,1,1);
-	glEnable (GL_TEXTURE_2D);
-	glEnable (GL_ALPHA_TEST);
-	glDisable (GL_BLEND);
+	Draw_FillQuad (0, 0, glwidth, glheight, black, 0.5);
 
 	Sbar_Changed();
 }
@@ -694,6 +837,8 @@ void GL_SetCanvas (canvastype newcanvas)
 	if (vr_enabled.value && !con_forcedup)
 		return;
 
+	Draw_Flush (); //queued quads are for the old projection
+
 	glMatrixMode(GL_PROJECTION);
     glLoadIdentity ();
 
@@ -766,6 +911,8 @@ GL_Set2D -- johnfitz -- rewritten
 */
 void GL_Set2D (void)
 {
+	Draw_Flush ();
+
 	currentcanvas = CANVAS_INVALID;
 	GL_SetCanvas (CANVAS_DEFAULT);
 
@@ -356,6 +356,235 @@ void GL_MakeAliasModelDisplayLists (qmodel_t *m, aliashdr_t *hdr)
 unsigned int r_meshindexbuffer = 0;
 unsigned int r_meshvertexbuffer = 0;
 
+static cvar_t	gl_meshoptimize = {"gl_meshoptimize", "1", CVAR_ARCHIVE};
+
+/*
+=================================================================
+
+VERTEX CACHE OPTIMIZATION
+
+=================================================================
+*/
+
+#define	ACMR_CACHE_SIZE		16	// fifo, like most post-transform caches
+#define	FORSYTH_CACHE_SIZE	32	// lru that the scores are tuned for
+
+/*
+================
+GLMesh_ACMR -- average cache miss ratio: vertexes transformed per triangle
+================
+*/
+float GLMesh_ACMR (const unsigned short *indexes, int numindexes, int numverts)
+{
+	int	*stamp;
+	int	i, misses;
+
+	if (numindexes < 3)
+		return 0;
+
+	// a vertex is in the fifo if it went in less than ACMR_CACHE_SIZE misses ago
+	stamp = (int *) malloc (numverts * sizeof(int));
+	if (!stamp)
+		Sys_Error ("GLMesh_ACMR: out of memory");
+	for (i = 0; i < numverts; i++)
+		stamp[i] = -ACMR_CACHE_SIZE - 1;
+
+	for (i = misses = 0; i < numindexes; i++)
+	{
+		if (misses - stamp[indexes[i]] > ACMR_CACHE_SIZE)
+			stamp[indexes[i]] = misses++;
+	}
+
+	free (stamp);
+	return (float) misses / (numindexes / 3);
+}
+
+/*
+================
+GLMesh_VertexScore -- Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+================
+*/
+static float GLMesh_VertexScore (int cachepos, int remaining)
+{
+	float score;
+
+	if (!remaining)
+		return -1;
+
+	if (cachepos < 0)
+		score = 0;
+	else if (cachepos < 3)
+		score = 0.75f; // the last triangle's verts, so there's no point favouring one of them
+	else
+		score = pow (1.f - (cachepos - 3) * (1.f / (FORSYTH_CACHE_SIZE - 3)), 1.5f);
+
+	// favour verts with few triangles left, so they don't get stranded
+	return score + 2.f / sqrt ((float) remaining);
+}
+
+/*
+================
+GLMesh_OptimizeTriangles
+
+Reorders the triangles so that the ones sharing verts with the last few
+drawn go next: greedily picks the triangle whose verts score highest
+against a simulated lru cache.
+================
+*/
+static void GLMesh_OptimizeTriangles (unsigned short *indexes, int numtris, int numverts)
+{
+	int		*remaining, *firsttri, *trilist, *cachepos;
+	int		cache[FORSYTH_CACHE_SIZE + 3], newcache[FORSYTH_CACHE_SIZE + 3];
+	int		cachesize, newsize;
+	float	*vertscore, *triscore, bestscore;
+	byte	*added;
+	unsigned short	*out;
+	int		i, j, k, n, v, t, best;
+
+	remaining = (int *) calloc (numverts * 3 + 1, sizeof(int));
+	trilist = (int *) malloc (numtris * 3 * sizeof(int));
+	vertscore = (float *) malloc (numverts * sizeof(float));
+	triscore = (float *) malloc (numtris * sizeof(float));
+	added = (byte *) calloc (numtris, 1);
+	out = (unsigned short *) malloc (numtris * 3 * sizeof(unsigned short));
+	if (!remaining || !trilist || !vertscore || !triscore || !added || !out)
+		Sys_Error ("GLMesh_OptimizeTriangles: out of memory");
+	firsttri = remaining + numverts;
+	cachepos = firsttri + numverts + 1;
+
+	// the triangles using each vert
+	for (i = 0; i < numtris * 3; i++)
+		remaining[indexes[i]]++;
+	for (v = 0; v < numverts; v++)
+		firsttri[v + 1] = firsttri[v] + remaining[v];
+	memset (remaining, 0, numverts * sizeof(int));
+	for (i = 0; i < numtris * 3; i++)
+	{
+		v = indexes[i];
+		trilist[firsttri[v] + remaining[v]++] = i / 3;
+	}
+
+	for (v = 0; v < numverts; v++)
+	{
+		cachepos[v] = -1;
+		vertscore[v] = GLMesh_VertexScore (-1, remaining[v]);
+	}
+	for (t = 0; t < numtris; t++)
+		triscore[t] = vertscore[indexes[t*3]] + vertscore[indexes[t*3+1]] + vertscore[indexes[t*3+2]];
+
+	cachesize = 0;
+	best = -1;
+	for (n = 0; n < numtris; n++)
+	{
+		// nothing left around the cache, start somewhere else
+		if (best == -1)
+		{
+			bestscore = -1;
+			for (t = 0; t < numtris; t++)
+				if (!added[t] && triscore[t] > bestscore)
+				{
+					bestscore = triscore[t];
+					best = t;
+				}
+		}
+
+		added[best] = true;
+		for (j = 0; j < 3; j++)
+		{
+			v = indexes[best*3+j];
+			out[n*3+j] = v;
+
+			// take the triangle out of the vert's list
+			for (k = firsttri[v]; trilist[k] != best; k++)
+				;
+			trilist[k] = trilist[firsttri[v] + --remaining[v]];
+			newcache[j] = v;
+		}
+
+		// the triangle's verts go to the front of the cache
+		newsize = 3;
+		for (i = 0; i < cachesize; i++)
+		{
+			v = cache[i];
+			if (v != newcache[0] && v != newcache[1] && v != newcache[2])
+				newcache[newsize++] = v;
+		}
+
+		// rescore the verts that moved, and the triangles using them
+		for (i = 0; i < newsize; i++)
+		{
+			v = newcache[i];
+			cachepos[v] = (i < FORSYTH_CACHE_SIZE) ? i : -1;
+			vertscore[v] = GLMesh_VertexScore (cachepos[v], remaining[v]);
+		}
+
+		best = -1;
+		bestscore = -1;
+		for (i = 0; i < newsize; i++)
+		{
+			v = newcache[i];
+			for (k = firsttri[v]; k < firsttri[v] + remaining[v]; k++)
+			{
+				t = trilist[k];
+				triscore[t] = vertscore[indexes[t*3]] + vertscore[indexes[t*3+1]] + vertscore[indexes[t*3+2]];
+				if (triscore[t] > bestscore)
+				{
+					bestscore = triscore[t];
+					best = t;
+				}
+			}
+		}
+
+		cachesize = q_min (newsize, FORSYTH_CACHE_SIZE);
+		memcpy (cache, newcache, cachesize * sizeof(int));
+	}
+
+	memcpy (indexes, out, numtris * 3 * sizeof(unsigned short));
+
+	free (remaining);
+	free (trilist);
+	free (vertscore);
+	free (triscore);
+	free (added);
+	free (out);
+}
+
+/*
+================
+GLMesh_ReorderVertexes -- renumbers the verts in the order they're first used, so fetches go forward
+================
+*/
+static void GLMesh_ReorderVertexes (aliasmesh_t *desc, unsigned short *indexes, int numindexes, int numverts)
+{
+	aliasmesh_t	*newdesc;
+	int		*remap;
+	int		i, v, count;
+
+	newdesc = (aliasmesh_t *) malloc (numverts * sizeof(aliasmesh_t));
+	remap = (int *) malloc (numverts * sizeof(int));
+	if (!newdesc || !remap)
+		Sys_Error ("GLMesh_ReorderVertexes: out of memory");
+
+	for (v = 0; v < numverts; v++)
+		remap[v] = -1;
+	for (i = count = 0; i < numindexes; i++)
+	{
+		v = indexes[i];
+		if (remap[v] == -1)
+		{
+			remap[v] = count;
+			newdesc[count++] = desc[v];
+		}
+		indexes[i] = remap[v];
+	}
+
+	memcpy (desc, newdesc, count * sizeof(aliasmesh_t));
+	free (newdesc);
+	free (remap);
+}
+
+#define	MESH_HASH_SIZE	4096 //must be power of 2
+
 /*
 ================
 GL_MakeAliasModelDisplayLists_VBO
@@ -373,6 +602,9 @@ void GL_MakeAliasModelDisplayLists_VBO (void)
 	trivertx_t *verts;
 	unsigned short *indexes;
 	aliasmesh_t *desc;
+	static int hash[MESH_HASH_SIZE];
+	static int chain[MAXALIASTRIS * 3];
+	float acmr;
 
 	if (!gl_glsl_alias_able)
 		return;
@@ -396,11 +628,13 @@ void GL_MakeAliasModelDisplayLists_VBO (void)
 	pheader->numindexes = 0;
 	pheader->numverts_vbo = 0;
 
+	memset (hash, -1, sizeof(hash));
+
 	for (i = 0; i < pheader->numtris; i++)
 	{
 		for (j = 0; j < 3; j++)
 		{
-			int v;
+			int v, h;
 
 			// index into hdr->vertexes
 			unsigned short vertindex = triangles[i].vertindex[j];
@@ -413,30 +647,40 @@ void GL_MakeAliasModelDisplayLists_VBO (void)
 			if (!triangles[i].facesfront && stverts[vertindex].onseam) s += pheader->skinwidth / 2;
 
 			// see does this vert already exist
-			for (v = 0; v < pheader->numverts_vbo; v++)
-			{
-				// it could use the same xyz but have different s and t
+			// it could use the same xyz but have different s and t
+			h = (vertindex * 73 + (unsigned) s * 19 + (unsigned) t) & (MESH_HASH_SIZE - 1);
+			for (v = hash[h]; v != -1; v = chain[v])
 				if (desc[v].vertindex == vertindex && (int) desc[v].st[0] == s && (int) desc[v].st[1] == t)
-				{
-					// exists; emit an index for it
-					indexes[pheader->numindexes++] = v;
-
-					// no need to check any more
 					break;
-				}
-			}
 
-			if (v == pheader->numverts_vbo)
+			if (v != -1)
+			{
+				// exists; emit an index for it
+				indexes[pheader->numindexes++] = v;
+			}
+			else
 			{
 				// doesn't exist; emit a new vert and index
 				indexes[pheader->numindexes++] = pheader->numverts_vbo;
 
+				chain[pheader->numverts_vbo] = hash[h];
+				hash[h] = pheader->numverts_vbo;
 				desc[pheader->numverts_vbo].vertindex = vertindex;
 				desc[pheader->numverts_vbo].st[0] = s;
 				desc[pheader->numverts_vbo++].st[1] = t;
 			}
 		}
 	}
+
+	// reorder for the post-transform vertex cache
+	if (gl_meshoptimize.value)
+	{
+		acmr = GLMesh_ACMR (indexes, pheader->numindexes, pheader->numverts_vbo);
+		GLMesh_OptimizeTriangles (indexes, pheader->numtris, pheader->numverts_vbo);
+		GLMesh_ReorderVertexes (desc, indexes, pheader->numindexes, pheader->numverts_vbo);
+		Con_DPrintf2 ("%3i vbo vert, acmr %.3f -> %.3f\n", pheader->numverts_vbo, acmr,
+				GLMesh_ACMR (indexes, pheader->numindexes, pheader->numverts_vbo));
+	}
 	
 	// upload immediately
 	GLMesh_LoadVertexBuffer (aliasmodel, pheader);
@@ -447,25 +691,22 @@ extern	float	r_avertexnormals[NUMVERTEXNORMALS][3];
 
 /*
 ================
-GLMesh_LoadVertexBuffer
+GLMesh_BuildVertexData
 
-Upload the given alias model's mesh to a VBO
+Fills in the model's vbo offsets and returns the vertex buffer contents
+for the given alias model, malloc'd, or NULL if it has no mesh
 
 Original code by MH from RMQEngine
 ================
 */
-static void GLMesh_LoadVertexBuffer (qmodel_t *m, const aliashdr_t *hdr)
+byte *GLMesh_BuildVertexData (qmodel_t *m, const aliashdr_t *hdr, int *size)
 {
 	int totalvbosize = 0;
 	const aliasmesh_t *desc;
-	const short *indexes;
 	const trivertx_t *trivertexes;
 	byte *vbodata;
 	int f;
 
-	if (!gl_glsl_alias_able)
-		return;
-	
 // count the sizes we need
 	
 	// ericw -- RMQEngine stored these vbo*ofs values in aliashdr_t, but we must not
@@ -479,22 +720,15 @@ static void GLMesh_LoadVertexBuffer (qmodel_t *m, const aliashdr_t *hdr)
 	m->vbostofs = totalvbosize;
 	totalvbosize += (hdr->numverts_vbo * sizeof (meshst_t));
 	
-	if (!hdr->numindexes) return;
-	if (!totalvbosize) return;
+	*size = totalvbosize;
+	if (!hdr->numindexes) return NULL;
+	if (!totalvbosize) return NULL;
 	
 // grab the pointers to data in the extradata
 
 	desc = (aliasmesh_t *) ((byte *) hdr + hdr->meshdesc);
-	indexes = (short *) ((byte *) hdr + hdr->indexes);
 	trivertexes = (trivertx_t *) ((byte *)hdr + hdr->vertexes);
 
-// upload indices buffer
-
-	GL_DeleteBuffersFunc (1, &m->meshindexesvbo);
-	GL_GenBuffersFunc (1, &m->meshindexesvbo);
-	GL_BindBufferFunc (GL_ELEMENT_ARRAY_BUFFER, m->meshindexesvbo);
-	GL_BufferDataFunc (GL_ELEMENT_ARRAY_BUFFER, hdr->numindexes * sizeof (unsigned short), indexes, GL_STATIC_DRAW);
-
 // create the vertex buffer (empty)
 
 	vbodata = (byte *) malloc(totalvbosize);
@@ -544,18 +778,55 @@ static void GLMesh_LoadVertexBuffer (qmodel_t *m, const aliashdr_t *hdr)
 		}
 	}
 
+	return vbodata;
+}
+
+/*
+================
+GLMesh_UploadVertexBuffer
+================
+*/
+static void GLMesh_UploadVertexBuffer (qmodel_t *m, const aliashdr_t *hdr, const void *indexes, const void *vbodata, int size)
+{
+// upload indices buffer
+	GL_DeleteBuffersFunc (1, &m->meshindexesvbo);
+	GL_GenBuffersFunc (1, &m->meshindexesvbo);
+	GL_BindBufferFunc (GL_ELEMENT_ARRAY_BUFFER, m->meshindexesvbo);
+	GL_BufferDataFunc (GL_ELEMENT_ARRAY_BUFFER, hdr->numindexes * sizeof (unsigned short), indexes, GL_STATIC_DRAW);
+
 // upload vertexes buffer
 	GL_DeleteBuffersFunc (1, &m->meshvbo);
 	GL_GenBuffersFunc (1, &m->meshvbo);
 	GL_BindBufferFunc (GL_ARRAY_BUFFER, m->meshvbo);
-	GL_BufferDataFunc (GL_ARRAY_BUFFER, totalvbosize, vbodata, GL_STATIC_DRAW);
-
-	free (vbodata);
+	GL_BufferDataFunc (GL_ARRAY_BUFFER, size, vbodata, GL_STATIC_DRAW);
 
 // invalidate the cached bindings
 	GL_ClearBufferBindings ();
 }
 
+/*
+================
+GLMesh_LoadVertexBuffer
+
+Upload the given alias model's mesh to a VBO
+================
+*/
+static void GLMesh_LoadVertexBuffer (qmodel_t *m, const aliashdr_t *hdr)
+{
+	byte *vbodata;
+	int size;
+
+	if (!gl_glsl_alias_able)
+		return;
+
+	vbodata = GLMesh_BuildVertexData (m, hdr, &size);
+	if (!vbodata)
+		return;
+
+	GLMesh_UploadVertexBuffer (m, hdr, (byte *) hdr + hdr->indexes, vbodata, size);
+	free (vbodata);
+}
+
 /*
 ================
 GLMesh_LoadVertexBuffers
@@ -612,3 +883,276 @@ void GLMesh_DeleteVertexBuffers (void)
 	
 	GL_ClearBufferBindings ();
 }
+
+/*
+=================================================================
+
+ALIAS MESH CACHE
+
+=================================================================
+*/
+
+/*
+The draw lists, vbo contents and bounds of each alias model are kept in a
+diskcache file, keyed by a hash and the CRC of the mdl file. A hit copies
+the lists onto the hunk and uploads the vbo straight from the mapping, so
+BuildTris, the vbo vertex search and the bounds pass are skipped.
+
+An entry is a meshcacheinfo_t, then the commands, the posedata, and with
+a vbo the vertexes, the vbo contents, the meshdesc and the indexes.
+*/
+
+#define	MESHCACHE_FILENAME	"meshcache.dat"
+#define	MESHCACHE_IDENT		(('C'<<24)+('M'<<16)+('S'<<8)+'Q') // little-endian "QSMC"
+#define	MESHCACHE_VERSION	2
+
+typedef struct
+{
+	unsigned	hash[2];	//64 bit hash of the mdl file
+	unsigned	size;		//of the mdl file
+	unsigned	crc;		//CRC_Block of the mdl file
+	unsigned	settings;	//hash of the skin padding, vbo support and gl_meshoptimize, which change the lists
+} meshcachekey_t;
+
+typedef struct
+{
+	int		poseverts;
+	int		numcommands;
+	int		numverts_vbo;
+	int		numindexes;	//0 without a vbo
+	int		vbosize;
+	vec3_t	mins, maxs, ymins, ymaxs, rmins, rmaxs;
+} meshcacheinfo_t;
+
+static cvar_t	gl_meshcache = {"gl_meshcache", "1", CVAR_ARCHIVE};
+static cvar_t	gl_meshcache_size = {"gl_meshcache_size", "64", CVAR_ARCHIVE}; //megabytes
+
+static qboolean GLMesh_ValidCacheEntry (const void *data, int size)
+{
+	const meshcacheinfo_t *info = (const meshcacheinfo_t *) data;
+
+	return size >= (int) sizeof(meshcacheinfo_t) && info->poseverts > 0 && info->numcommands > 0 &&
+		info->numverts_vbo >= 0 && info->numindexes >= 0 && info->vbosize >= 0;
+}
+
+static diskcache_t meshcache = {MESHCACHE_FILENAME, "mesh cache", MESHCACHE_IDENT, MESHCACHE_VERSION,
+		sizeof(meshcachekey_t), GLMesh_ValidCacheEntry};
+
+static meshcachekey_t	meshcache_key;	//of the model being loaded
+static qboolean		meshcache_keyvalid;
+
+/*
+================
+GLMesh_CacheDataSize -- bytes following the meshcacheinfo_t
+================
+*/
+static int GLMesh_CacheDataSize (const aliashdr_t *hdr, const meshcacheinfo_t *info)
+{
+	int size;
+
+	size = info->numcommands * sizeof(int) + hdr->numposes * info->poseverts * sizeof(trivertx_t);
+	if (info->numindexes)
+		size += hdr->numposes * hdr->numverts * sizeof(trivertx_t) + info->vbosize +
+			info->numverts_vbo * sizeof(aliasmesh_t) + info->numindexes * sizeof(unsigned short);
+	return size;
+}
+
+/*
+================
+GLMesh_HunkCopy -- returns the offset of the copy from hdr
+================
+*/
+static intptr_t GLMesh_HunkCopy (aliashdr_t *hdr, const byte **data, int size)
+{
+	byte *copy;
+
+	copy = (byte *) Hunk_Alloc (size);
+	memcpy (copy, *data, size);
+	*data += size;
+	return copy - (byte *)hdr;
+}
+
+/*
+================
+GLMesh_LoadCachedMesh
+
+Fills in hdr's draw lists, the vbo and m's bounds from the mesh cache.
+Returns false if the model isn't cached; the lists must be built and
+handed to GLMesh_StoreCachedMesh then. hdr must be on the hunk, with its
+skins and frames loaded.
+================
+*/
+qboolean GLMesh_LoadCachedMesh (qmodel_t *m, aliashdr_t *hdr, const byte *file, int filesize)
+{
+	const meshcacheinfo_t	*info;
+	const byte	*data, *vbodata;
+	unsigned	settings[4], hash[2];
+	int		size;
+
+	meshcache_keyvalid = false;
+	if (!DiskCache_Enabled (&meshcache) || filesize <= 0)
+		return false;
+
+	DiskCache_HashData (file, filesize, meshcache_key.hash);
+	meshcache_key.size = filesize;
+	meshcache_key.crc = CRC_Block ((byte *) file, filesize);
+	settings[0] = TexMgr_PadConditional (hdr->skinwidth);
+	settings[1] = TexMgr_PadConditional (hdr->skinheight);
+	settings[2] = gl_glsl_alias_able;
+	settings[3] = (gl_meshoptimize.value != 0);
+	DiskCache_HashData ((byte *)settings, sizeof(settings), hash);
+	meshcache_key.settings = hash[0];
+	meshcache_keyvalid = true;
+
+	info = (const meshcacheinfo_t *) DiskCache_Find (&meshcache, &meshcache_key, &size);
+	if (!info || size != (int) sizeof(*info) + GLMesh_CacheDataSize (hdr, info) ||
+	    (info->numindexes != 0) != (gl_glsl_alias_able != 0))
+		return false;
+
+	data = (const byte *) (info + 1);
+	hdr->poseverts = info->poseverts;
+	hdr->commands = GLMesh_HunkCopy (hdr, &data, info->numcommands * sizeof(int));
+	hdr->posedata = GLMesh_HunkCopy (hdr, &data, hdr->numposes * hdr->poseverts * sizeof(trivertx_t));
+
+	VectorCopy (info->mins, m->mins);
+	VectorCopy (info->maxs, m->maxs);
+	VectorCopy (info->ymins, m->ymins);
+	VectorCopy (info->ymaxs, m->ymaxs);
+	VectorCopy (info->rmins, m->rmins);
+	VectorCopy (info->rmaxs, m->rmaxs);
+
+	if (info->numindexes)
+	{
+		hdr->numverts_vbo = info->numverts_vbo;
+		hdr->numindexes = info->numindexes;
+		hdr->vertexes = GLMesh_HunkCopy (hdr, &data, hdr->numposes * hdr->numverts * sizeof(trivertx_t));
+		vbodata = data;
+		data += info->vbosize;
+		hdr->meshdesc = GLMesh_HunkCopy (hdr, &data, hdr->numverts_vbo * sizeof(aliasmesh_t));
+		hdr->indexes = GLMesh_HunkCopy (hdr, &data, hdr->numindexes * sizeof(unsigned short));
+
+		m->vboindexofs = 0;
+		m->vboxyzofs = 0;
+		m->vbostofs = hdr->numposes * hdr->numverts_vbo * sizeof (meshxyz_t);
+		GLMesh_UploadVertexBuffer (m, hdr, (byte *) hdr + hdr->indexes, vbodata, info->vbosize);
+	}
+
+	DiskCache_Store (&meshcache, &meshcache_key, info, size, NULL, 0, true);
+	meshcache_keyvalid = false;
+	return true;
+}
+
+/*
+================
+GLMesh_StoreCachedMesh -- appends the lists GL_MakeAliasModelDisplayLists just built
+================
+*/
+void GLMesh_StoreCachedMesh (qmodel_t *m, aliashdr_t *hdr)
+{
+	meshcacheinfo_t	info;
+	byte	*data, *out, *vbodata;
+	int	size, vbosize;
+
+	if (!meshcache_keyvalid)
+		return;
+	meshcache_keyvalid = false;
+
+	vbodata = NULL;
+	vbosize = 0;
+	if (gl_glsl_alias_able)
+	{
+		vbodata = GLMesh_BuildVertexData (m, hdr, &vbosize);
+		if (!vbodata)
+			return;
+	}
+
+	memset (&info, 0, sizeof(info));
+	info.poseverts = hdr->poseverts;
+	info.numcommands = numcommands;
+	if (vbodata)
+	{
+		info.numverts_vbo = hdr->numverts_vbo;
+		info.numindexes = hdr->numindexes;
+		info.vbosize = vbosize;
+	}
+	VectorCopy (m->mins, info.mins);
+	VectorCopy (m->maxs, info.maxs);
+	VectorCopy (m->ymins, info.ymins);
+	VectorCopy (m->ymaxs, info.ymaxs);
+	VectorCopy (m->rmins, info.rmins);
+	VectorCopy (m->rmaxs, info.rmaxs);
+
+	size = GLMesh_CacheDataSize (hdr, &info);
+	out = data = (byte *) malloc (size);
+	if (!data)
+		Sys_Error ("GLMesh_StoreCachedMesh: out of memory");
+
+	memcpy (out, (byte *)hdr + hdr->commands, numcommands * sizeof(int));
+	out += numcommands * sizeof(int);
+	memcpy (out, (byte *)hdr + hdr->posedata, hdr->numposes * hdr->poseverts * sizeof(trivertx_t));
+	out += hdr->numposes * hdr->poseverts * sizeof(trivertx_t);
+	if (vbodata)
+	{
+		memcpy (out, (byte *)hdr + hdr->vertexes, hdr->numposes * hdr->numverts * sizeof(trivertx_t));
+		out += hdr->numposes * hdr->numverts * sizeof(trivertx_t);
+		memcpy (out, vbodata, vbosize);
+		out += vbosize;
+		memcpy (out, (byte *)hdr + hdr->meshdesc, hdr->numverts_vbo * sizeof(aliasmesh_t));
+		out += hdr->numverts_vbo * sizeof(aliasmesh_t);
+		memcpy (out, (byte *)hdr + hdr->indexes, hdr->numindexes * sizeof(unsigned short));
+		free (vbodata);
+	}
+
+	DiskCache_Store (&meshcache, &meshcache_key, &info, sizeof(info), data, size, false);
+	DiskCache_Flush (&meshcache);
+	free (data);
+}
+
+/*
+================
+GLMesh_OpenCache -- maps the mesh cache of the current game directory
+================
+*/
+void GLMesh_OpenCache (void)
+{
+	if (!gl_meshcache.value || isDedicated)
+		DiskCache_Close (&meshcache);
+	else
+		DiskCache_Open (&meshcache, (int) q_min (q_max (gl_meshcache_size.value, 1.f), 2047.f) * 1024 * 1024);
+}
+
+/*
+================
+GLMesh_CacheInfo_f
+================
+*/
+static void GLMesh_CacheInfo_f (void)
+{
+	DiskCache_PrintInfo (&meshcache);
+}
+
+/*
+================
+GLMesh_CacheToggle_f
+================
+*/
+static void GLMesh_CacheToggle_f (cvar_t *var)
+{
+	GLMesh_OpenCache ();
+}
+
+/*
+================
+GLMesh_Init
+================
+*/
+void GLMesh_Init (void)
+{
+	Cvar_RegisterVariable (&gl_meshcache);
+	Cvar_SetCallback (&gl_meshcache, GLMesh_CacheToggle_f);
+	Cvar_RegisterVariable (&gl_meshcache_size);
+	Cvar_RegisterVariable (&gl_meshoptimize);
+	Cmd_AddCommand ("meshcacheinfo", GLMesh_CacheInfo_f);
+
+	GLMesh_OpenCache ();
+}
@@ -33,6 +33,7 @@ void Mod_LoadSpriteModel (qmodel_t *mod, void *buffer);
 void Mod_LoadBrushModel (qmodel_t *mod, void *buffer);
 void Mod_LoadAliasModel (qmodel_t *mod, void *buffer);
 qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash);
+static void Mod_Benchmark_f (void);
 
 cvar_t	external_ents = {"external_ents", "1", CVAR_ARCHIVE};
 
@@ -54,6 +55,7 @@ void Mod_Init (void)
 {
 	Cvar_RegisterVariable (&gl_subdivide_size);
 	Cvar_RegisterVariable (&external_ents);
+	Cmd_AddCommand ("modelbench", Mod_Benchmark_f);
 
 	memset (mod_novis, 0xff, sizeof(mod_novis));
 
@@ -398,9 +400,8 @@ void Mod_LoadTextures (lump_t *l)
 	char		texturename[64];
 	int			nummiptex;
 	src_offset_t		offset;
-	int			mark, fwidth, fheight;
+	int			mark;
 	char		filename[MAX_OSPATH], filename2[MAX_OSPATH], mapname[MAX_OSPATH];
-	byte		*data;
 	extern byte *hunk_base;
 //johnfitz
 
@@ -422,6 +423,7 @@ void Mod_LoadTextures (lump_t *l)
 	loadmodel->numtextures = nummiptex + 2; //johnfitz -- need 2 dummy texture chains for missing textures
 	loadmodel->textures = (texture_t **) Hunk_AllocName (loadmodel->numtextures * sizeof(*loadmodel->textures) , loadname);
 
+	TexMgr_BeginBatch (); //decode and mipmap the textures on the worker threads
 	for (i=0 ; i<nummiptex ; i++)
 	{
 		m->dataofs[i] = LittleLong(m->dataofs[i]);
@@ -472,20 +474,16 @@ void Mod_LoadTextures (lump_t *l)
 				mark = Hunk_LowMark();
 				COM_StripExtension (loadmodel->name + 5, mapname, sizeof(mapname));
 				q_snprintf (filename, sizeof(filename), "textures/%s/#%s", mapname, tx->name+1); //this also replaces the '*' with a '#'
-				data = Image_LoadImage (filename, &fwidth, &fheight);
-				if (!data)
+				tx->gltexture = TexMgr_LoadImageFile (loadmodel, filename, filename, TEXPREF_NONE);
+				if (!tx->gltexture)
 				{
 					q_snprintf (filename, sizeof(filename), "textures/#%s", tx->name+1);
-					data = Image_LoadImage (filename, &fwidth, &fheight);
+					tx->gltexture = TexMgr_LoadImageFile (loadmodel, filename, filename, TEXPREF_NONE);
 				}
 
 				//now load whatever we found
-				if (data) //load external image
-				{
+				if (tx->gltexture) //external image
 					q_strlcpy (texturename, filename, sizeof(texturename));
-					tx->gltexture = TexMgr_LoadImage (loadmodel, texturename, fwidth, fheight,
-						SRC_RGBA, data, filename, 0, TEXPREF_NONE);
-				}
 				else //use the texture from the bsp file
 				{
 					q_snprintf (texturename, sizeof(texturename), "%s:%s", loadmodel->name, tx->name);
@@ -513,35 +511,26 @@ void Mod_LoadTextures (lump_t *l)
 				// ericw
 
 				//external textures -- first look in "textures/mapname/" then look in "textures/"
-				mark = Hunk_LowMark ();
 				COM_StripExtension (loadmodel->name + 5, mapname, sizeof(mapname));
 				q_snprintf (filename, sizeof(filename), "textures/%s/%s", mapname, tx->name);
-				data = Image_LoadImage (filename, &fwidth, &fheight);
-				if (!data)
+				tx->gltexture = TexMgr_LoadImageFile (loadmodel, filename, filename, TEXPREF_MIPMAP | extraflags);
+				if (!tx->gltexture)
 				{
 					q_snprintf (filename, sizeof(filename), "textures/%s", tx->name);
-					data = Image_LoadImage (filename, &fwidth, &fheight);
+					tx->gltexture = TexMgr_LoadImageFile (loadmodel, filename, filename, TEXPREF_MIPMAP | extraflags);
 				}
 
 				//now load whatever we found
-				if (data) //load external image
+				if (tx->gltexture) //external image
 				{
-					tx->gltexture = TexMgr_LoadImage (loadmodel, filename, fwidth, fheight,
-						SRC_RGBA, data, filename, 0, TEXPREF_MIPMAP | extraflags );
-
 					//now try to load glow/luma image from the same place
-					Hunk_FreeToLowMark (mark);
 					q_snprintf (filename2, sizeof(filename2), "%s_glow", filename);
-					data = Image_LoadImage (filename2, &fwidth, &fheight);
-					if (!data)
+					tx->fullbright = TexMgr_LoadImageFile (loadmodel, filename2, filename2, TEXPREF_MIPMAP | extraflags);
+					if (!tx->fullbright)
 					{
 						q_snprintf (filename2, sizeof(filename2), "%s_luma", filename);
-						data = Image_LoadImage (filename2, &fwidth, &fheight);
+						tx->fullbright = TexMgr_LoadImageFile (loadmodel, filename2, filename2, TEXPREF_MIPMAP | extraflags);
 					}
-
-					if (data)
-						tx->fullbright = TexMgr_LoadImage (loadmodel, filename2, fwidth, fheight,
-							SRC_RGBA, data, filename, 0, TEXPREF_MIPMAP | extraflags );
 				}
 				else //use the texture from the bsp file
 				{
@@ -561,11 +550,11 @@ void Mod_LoadTextures (lump_t *l)
 							SRC_INDEXED, (byte *)(tx+1), loadmodel->name, offset, TEXPREF_MIPMAP | extraflags);
 					}
 				}
-				Hunk_FreeToLowMark (mark);
 			}
 		}
 		//johnfitz
 	}
+	TexMgr_EndBatch ();
 
 	//johnfitz -- last 2 slots in array should be filled with dummy textures
 	loadmodel->textures[loadmodel->numtextures-2] = r_notexture_mip; //for lightmapped surfs
@@ -2046,6 +2035,17 @@ void Mod_LoadBrushModel (qmodel_t *mod, void *buffer)
 		mod->firstmodelsurface = bm->firstface;
 		mod->nummodelsurfaces = bm->numfaces;
 
+		// sky, water and untextured surfaces keep the model out of instanced drawing
+		mod->flags &= ~MOD_NOINSTANCING;
+		for (j=0 ; j<mod->nummodelsurfaces ; j++)
+		{
+			if (mod->surfaces[mod->firstmodelsurface + j].flags & (SURF_DRAWSKY | SURF_DRAWTURB | SURF_NOTEXTURE))
+			{
+				mod->flags |= MOD_NOINSTANCING;
+				break;
+			}
+		}
+
 		VectorCopy (bm->maxs, mod->maxs);
 		VectorCopy (bm->mins, mod->mins);
 
@@ -2104,6 +2104,9 @@ int			posenum;
 byte		**player_8bit_texels_tbl;
 byte		*player_8bit_texels;
 
+static qboolean	mod_nomeshcache;	// set by modelbench to time the uncached path
+static double	mod_meshtime;		// seconds spent on bounds and draw lists
+
 /*
 =================
 Mod_LoadAliasFrame
@@ -2501,6 +2504,8 @@ void Mod_LoadAliasModel (qmodel_t *mod, void *buffer)
 	daliasframetype_t	*pframetype;
 	daliasskintype_t	*pskintype;
 	int					start, end, total;
+	int					filesize = com_filesize;
+	double				meshstart;
 
 	start = Hunk_LowMark ();
 
@@ -2620,12 +2625,20 @@ void Mod_LoadAliasModel (qmodel_t *mod, void *buffer)
 
 	Mod_SetExtraFlags (mod); //johnfitz
 
-	Mod_CalcAliasBounds (pheader); //johnfitz
-
 	//
-	// build the draw lists
+	// take the bounds and draw lists from the mesh cache, or build them
 	//
-	GL_MakeAliasModelDisplayLists (mod, pheader);
+	meshstart = Sys_DoubleTime ();
+	if (mod_nomeshcache || !GLMesh_LoadCachedMesh (mod, pheader, (byte *)buffer, filesize))
+	{
+		Mod_CalcAliasBounds (pheader); //johnfitz
+
+		GL_MakeAliasModelDisplayLists (mod, pheader);
+
+		if (!mod_nomeshcache)
+			GLMesh_StoreCachedMesh (mod, pheader);
+	}
+	mod_meshtime += Sys_DoubleTime () - meshstart;
 
 //
 // move the complete, relocatable alias model to the cache
@@ -2838,3 +2851,149 @@ void Mod_Print (void)
 	Con_Printf ("%i models\n",mod_numknown); //johnfitz -- print the total too
 }
 
+
+//==============================================================================
+//
+//  BENCHMARK
+//
+//==============================================================================
+
+#define	MAX_BENCH_MODELS	2048
+
+/*
+================
+Mod_BenchLoad -- loads an mdl into a scratch model and throws it away again
+
+returns the file size, 0 if it's not an mdl
+================
+*/
+static int Mod_BenchLoad (const char *name, qboolean nocache, double *readtime, double *loadtime)
+{
+	static qmodel_t	benchmod;
+	qmodel_t	*oldloadmodel;
+	mdl_t	*pinmodel;
+	byte	*buf;
+	double	start;
+	int	size;
+
+	start = Sys_DoubleTime ();
+	buf = COM_LoadMallocFile (name, NULL);
+	size = com_filesize;
+	*readtime += Sys_DoubleTime () - start;
+	if (!buf)
+		return 0;
+
+	pinmodel = (mdl_t *)buf;
+	if (size < (int) sizeof(mdl_t) || LittleLong (pinmodel->ident) != IDPOLYHEADER ||
+	    LittleLong (pinmodel->version) != ALIAS_VERSION)
+	{
+		free (buf);
+		return 0;
+	}
+
+	memset (&benchmod, 0, sizeof(benchmod));
+	q_strlcpy (benchmod.name, name, sizeof(benchmod.name));
+	oldloadmodel = loadmodel;
+	loadmodel = &benchmod;
+	COM_FileBase (name, loadname, sizeof(loadname));
+
+	start = Sys_DoubleTime ();
+	mod_nomeshcache = nocache;
+	Mod_LoadAliasModel (&benchmod, buf);
+	mod_nomeshcache = false;
+	*loadtime += Sys_DoubleTime () - start;
+
+	loadmodel = oldloadmodel;
+	free (buf);
+
+	if (benchmod.cache.data)
+		Cache_Free (&benchmod.cache, false);
+	TexMgr_FreeTexturesForOwner (&benchmod);
+	if (gl_glsl_alias_able)
+	{
+		GL_DeleteBuffersFunc (1, &benchmod.meshvbo);
+		GL_DeleteBuffersFunc (1, &benchmod.meshindexesvbo);
+		GL_ClearBufferBindings ();
+	}
+	return size;
+}
+
+/*
+================
+Mod_Benchmark_f -- modelbench [passes]
+
+loads every mdl inside the loaded paks, building the draw lists and
+through the mesh cache, and reports the time spent on each.
+================
+*/
+static void Mod_Benchmark_f (void)
+{
+	char	(*names)[MAX_QPATH];
+	searchpath_t	*search;
+	const char	*name;
+	int	numnames, passes, pass, mode, i, j, count, size, bytes;
+	double	readtime, loadtime[2], meshtime[2];
+
+	passes = (Cmd_Argc () > 1) ? q_max (atoi (Cmd_Argv (1)), 1) : 3;
+
+	names = (char (*)[MAX_QPATH]) malloc (MAX_BENCH_MODELS * MAX_QPATH);
+	if (!names)
+		return;
+	numnames = 0;
+	for (search = com_searchpaths; search; search = search->next)
+	{
+		if (!search->pack)
+			continue;
+		for (i = 0; i < search->pack->numfiles && numnames < MAX_BENCH_MODELS; i++)
+		{
+			name = search->pack->files[i].name;
+			if (q_strcasecmp (COM_FileGetExtension (name), "mdl"))
+				continue;
+			for (j = 0; j < numnames; j++)
+				if (!q_strcasecmp (names[j], name))
+					break;
+			if (j == numnames)
+				q_strlcpy (names[numnames++], name, MAX_QPATH);
+		}
+	}
+
+	if (!numnames)
+	{
+		Con_Printf ("usage: modelbench [passes]\nno mdl files found\n");
+		free (names);
+		return;
+	}
+
+	// fill the mesh cache, and the os file cache
+	readtime = loadtime[0] = loadtime[1] = 0;
+	for (i = count = bytes = 0; i < numnames; i++)
+		if ((size = Mod_BenchLoad (names[i], false, &readtime, &loadtime[1])))
+		{
+			count++;
+			bytes += size;
+		}
+
+	readtime = loadtime[0] = loadtime[1] = 0;
+	meshtime[0] = meshtime[1] = 0;
+	for (pass = 0; pass < passes; pass++)
+	{
+		for (mode = 0; mode < 2; mode++)
+		{
+			mod_meshtime = 0;
+			for (i = 0; i < numnames; i++)
+				Mod_BenchLoad (names[i], !mode, &readtime, &loadtime[mode]);
+			meshtime[mode] += mod_meshtime;
+		}
+	}
+	readtime /= 2;
+
+	Con_Printf ("%i models, %.1f MB of files, %i passes\n", count, bytes / (1024.0 * 1024.0), passes);
+	Con_Printf ("read   %7.2f ms  %6.1f MB/s\n", readtime * 1000.0 / passes,
+			bytes / (1024.0 * 1024.0) / q_max (readtime / passes, 1e-6));
+	Con_Printf ("built  %7.2f ms  %7.2f ms of it bounds and draw lists\n",
+			loadtime[0] * 1000.0 / passes, meshtime[0] * 1000.0 / passes);
+	Con_Printf ("cached %7.2f ms  %7.2f ms of it bounds and draw lists\n",
+			loadtime[1] * 1000.0 / passes, meshtime[1] * 1000.0 / passes);
+
+	free (names);
+}
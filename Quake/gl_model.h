@@ -403,6 +403,7 @@ typedef enum {mod_brush, mod_sprite, mod_alias} modtype_t;
 #define	MOD_NOLERP		256		//don't lerp when animating
 #define	MOD_NOSHADOW	512		//don't cast a shadow
 #define	MOD_FBRIGHTHACK	1024	//when fullbrights are disabled, use a hack to render this model brighter
+#define	MOD_NOINSTANCING	2048	//brush model with surfaces the instanced path can't draw
 //johnfitz
 
 typedef struct qmodel_s
@@ -490,6 +491,8 @@ typedef struct qmodel_s
 	int			vboindexofs;    // offset in vbo of the hdr->numindexes unsigned shorts
 	int			vboxyzofs;      // offset in vbo of hdr->numposes*hdr->numverts_vbo meshxyz_t
 	int			vbostofs;       // offset in vbo of hdr->numverts_vbo meshst_t
+	int			posetexel;      // first texel of the poses in the instancing pose texture
+	int			posegeneration; // of the pose texture that posetexel is valid for
 
 //
 // additional model data
@@ -114,6 +114,7 @@ void R_RenderDlight (dlight_t *light)
 		glVertex3fv (v);
 	}
 	glEnd ();
+	rs_drawcalls++;
 }
 
 /*
@@ -38,6 +38,8 @@ mplane_t	frustum[4];
 int rs_brushpolys, rs_aliaspolys, rs_skypolys, rs_particles, rs_fogpolys;
 int rs_dynamiclightmaps, rs_brushpasses, rs_aliaspasses, rs_skypasses;
 float rs_megatexels;
+int rs_drawcalls;
+double rs_entitytime;
 
 //
 // view origin
@@ -97,6 +99,7 @@ cvar_t	r_showtris = {"r_showtris", "0", CVAR_NONE};
 cvar_t	r_showbboxes = {"r_showbboxes", "0", CVAR_NONE};
 cvar_t	r_lerpmodels = {"r_lerpmodels", "1", CVAR_NONE};
 cvar_t	r_lerpmove = {"r_lerpmove", "1", CVAR_NONE};
+cvar_t	r_instancing = {"r_instancing", "1", CVAR_ARCHIVE};
 cvar_t	r_nolerp_list = {"r_nolerp_list", "progs/flame.mdl,progs/flame2.mdl,progs/braztall.mdl,progs/brazshrt.mdl,progs/longtrch.mdl,progs/flame_pyre.mdl,progs/v_saw.mdl,progs/v_xfist.mdl,progs/h2stuff/newfire.mdl", CVAR_NONE};
 cvar_t	r_noshadow_list = {"r_noshadow_list", "progs/flame2.mdl,progs/flame.mdl,progs/bolt1.mdl,progs/bolt2.mdl,progs/bolt3.mdl,progs/laser.mdl", CVAR_NONE};
 
@@ -258,6 +261,7 @@ void GLSLGamma_GammaCorrect (void)
 	glTexCoord2f (0, tmax);
 	glVertex2f (-1, 1);
 	glEnd ();
+	rs_drawcalls++;
 	
 	GL_UseProgramFunc (0);
 	
@@ -359,6 +363,37 @@ void R_RotateForEntity (vec3_t origin, vec3_t angles)
 	glRotatef (angles[2],  1, 0, 0);
 }
 
+/*
+=============
+R_EntityTransformRows -- the matrix R_RotateForEntity multiplies in, as three rows, for instance buffers
+=============
+*/
+void R_EntityTransformRows (const vec3_t origin, const vec3_t angles, float rows[3][4])
+{
+	float	sa, ca, sb, cb, sc, cc;
+
+	sa = sin (angles[1] * M_PI_DIV_180);
+	ca = cos (angles[1] * M_PI_DIV_180);
+	sb = sin (-angles[0] * M_PI_DIV_180);
+	cb = cos (-angles[0] * M_PI_DIV_180);
+	sc = sin (angles[2] * M_PI_DIV_180);
+	cc = cos (angles[2] * M_PI_DIV_180);
+
+	rows[0][0] = ca * cb;
+	rows[1][0] = sa * cb;
+	rows[2][0] = -sb;
+	rows[0][1] = -sa * cc + ca * sb * sc;
+	rows[1][1] = ca * cc + sa * sb * sc;
+	rows[2][1] = cb * sc;
+	rows[0][2] = sa * sc + ca * sb * cc;
+	rows[1][2] = -ca * sc + sa * sb * cc;
+	rows[2][2] = cb * cc;
+
+	rows[0][3] = origin[0];
+	rows[1][3] = origin[1];
+	rows[2][3] = origin[2];
+}
+
 /*
 =============
 GL_PolygonOffset -- johnfitz
@@ -629,10 +664,13 @@ R_DrawEntitiesOnList
 void R_DrawEntitiesOnList (qboolean alphapass) //johnfitz -- added parameter
 {
 	int		i;
+	double	time1;
 
 	if (!r_drawentities.value)
 		return;
 
+	time1 = r_speeds.value ? Sys_DoubleTime () : 0;
+
 	//johnfitz -- sprites are not a special case
 	for (i=0 ; i<cl_numvisedicts ; i++)
 	{
@@ -662,6 +700,12 @@ void R_DrawEntitiesOnList (qboolean alphapass) //johnfitz -- added parameter
 				break;
 		}
 	}
+
+	R_FlushAliasInstances ();
+	R_FlushBrushInstances ();
+
+	if (r_speeds.value)
+		rs_entitytime += Sys_DoubleTime () - time1;
 }
 
 /*
@@ -712,6 +756,7 @@ void R_EmitWirePoint (vec3_t origin)
 	glVertex3f (origin[0], origin[1], origin[2]-size);
 	glVertex3f (origin[0], origin[1], origin[2]+size);
 	glEnd ();
+	rs_drawcalls++;
 }
 
 /*
@@ -733,6 +778,7 @@ void R_EmitWireBox (vec3_t mins, vec3_t maxs)
 	glVertex3f (mins[0], mins[1], mins[2]);
 	glVertex3f (mins[0], mins[1], maxs[2]);
 	glEnd ();
+	rs_drawcalls++;
 }
 
 /*
@@ -977,7 +1023,8 @@ void R_RenderView (void)
 
 		//johnfitz -- rendering statistics
 		rs_brushpolys = rs_aliaspolys = rs_skypolys = rs_particles = rs_fogpolys = rs_megatexels =
-		rs_dynamiclightmaps = rs_aliaspasses = rs_skypasses = rs_brushpasses = 0;
+		rs_dynamiclightmaps = rs_aliaspasses = rs_skypasses = rs_brushpasses = rs_drawcalls = 0;
+		rs_entitytime = 0;
 	}
 	else if (gl_finish.value)
 		glFinish ();
@@ -1031,7 +1078,7 @@ void R_RenderView (void)
 			(int)cl.viewangles[YAW],
 			(int)cl.viewangles[ROLL]);
 	else if (r_speeds.value == 2)
-		Con_Printf ("%3i ms  %4i/%4i wpoly %4i/%4i epoly %3i lmap %4i/%4i sky %1.1f mtex\n",
+		Con_Printf ("%3i ms  %4i/%4i wpoly %4i/%4i epoly %3i lmap %4i/%4i sky %1.1f mtex %4i calls %4.1f ms ents\n",
 					(int)((time2-time1)*1000),
 					rs_brushpolys,
 					rs_brushpasses,
@@ -1040,13 +1087,16 @@ void R_RenderView (void)
 					rs_dynamiclightmaps,
 					rs_skypolys,
 					rs_skypasses,
-					TexMgr_FrameUsage ());
+					TexMgr_FrameUsage (),
+					rs_drawcalls,
+					rs_entitytime * 1000);
 	else if (r_speeds.value)
-		Con_Printf ("%3i ms  %4i wpoly %4i epoly %3i lmap\n",
+		Con_Printf ("%3i ms  %4i wpoly %4i epoly %3i lmap %4i calls\n",
 					(int)((time2-time1)*1000),
 					rs_brushpolys,
 					rs_aliaspolys,
-					rs_dynamiclightmaps);
+					rs_dynamiclightmaps,
+					rs_drawcalls);
 	//johnfitz
 }
 
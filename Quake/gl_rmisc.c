@@ -44,6 +44,7 @@ extern cvar_t r_showtris;
 extern cvar_t r_showbboxes;
 extern cvar_t r_lerpmodels;
 extern cvar_t r_lerpmove;
+extern cvar_t r_instancing;
 extern cvar_t r_nolerp_list;
 extern cvar_t r_noshadow_list;
 //johnfitz
@@ -179,6 +180,7 @@ void R_Init (void)
 
 	Cmd_AddCommand ("timerefresh", R_TimeRefresh_f);
 	Cmd_AddCommand ("pointfile", R_ReadPointFile_f);
+	Cmd_AddCommand ("aliasbench", R_AliasBench_f);
 
 	Cvar_RegisterVariable (&r_norefresh);
 	Cvar_RegisterVariable (&r_lightmap);
@@ -227,6 +229,7 @@ void R_Init (void)
 	Cvar_RegisterVariable (&gl_overbright_models);
 	Cvar_RegisterVariable (&r_lerpmodels);
 	Cvar_RegisterVariable (&r_lerpmove);
+	Cvar_RegisterVariable (&r_instancing);
 	Cvar_RegisterVariable (&r_nolerp_list);
 	Cvar_SetCallback (&r_nolerp_list, R_Model_ExtraFlags_List_f);
 	Cvar_RegisterVariable (&r_noshadow_list);
@@ -246,6 +249,7 @@ void R_Init (void)
 
 	Sky_Init (); //johnfitz
 	Fog_Init (); //johnfitz
+	GLMesh_Init ();
 	VR_Init(); //phoboslab
 }
 
@@ -321,6 +325,8 @@ void R_NewGame (void)
 	//clear playertexture pointers (the textures themselves were freed by texmgr_newgame)
 	for (i=0; i<MAX_SCOREBOARD; i++)
 		playertextures[i] = NULL;
+
+	GLMesh_OpenCache (); //the game dir changed
 }
 
 /*
@@ -401,6 +407,7 @@ void R_NewMap (void)
 	GL_BuildLightmaps ();
 	GL_BuildBModelVertexBuffer ();
 	//ericw -- no longer load alias models into a VBO here, it's done in Mod_LoadAliasModel
+	GLAlias_ResetPoses (); //the pose texture fills up with this map's models as they're drawn
 
 	r_framecount = 0; //johnfitz -- paranoid?
 	r_visframecount = 0; //johnfitz -- paranoid?
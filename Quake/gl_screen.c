@@ -519,7 +519,7 @@ SCR_DrawDevStats
 void SCR_DrawDevStats (void)
 {
 	char	str[40];
-	int		y = 25-9; //9=number of lines to print
+	int		y = 25-10; //10=number of lines to print
 	int		x = 0; //margin
 
 	if (!devstats.value)
@@ -527,7 +527,7 @@ void SCR_DrawDevStats (void)
 
 	GL_SetCanvas (CANVAS_BOTTOMLEFT);
 
-	Draw_Fill (x, y*8, 19*8, 9*8, 0, 0.5); //dark rectangle
+	Draw_Fill (x, y*8, 19*8, 10*8, 0, 0.5); //dark rectangle
 
 	sprintf (str, "devstats |Curr Peak");
 	Draw_String (x, (y++)*8-x, str);
@@ -555,6 +555,9 @@ void SCR_DrawDevStats (void)
 
 	sprintf (str, "Tempents |%4i %4i", dev_stats.tempents, dev_peakstats.tempents);
 	Draw_String (x, (y++)*8-x, str);
+
+	sprintf (str, "2D calls |%4i %4i", dev_stats.drawcalls, dev_peakstats.drawcalls);
+	Draw_String (x, (y++)*8-x, str);
 }
 
 /*
@@ -1050,6 +1053,8 @@ void SCR_UpdateScreenContent(void)
 		}
 	}
 
+	Draw_Flush ();
+
 	V_UpdateBlend(); //johnfitz -- V_UpdatePalette cleaned up and renamed
 
 	GLSLGamma_GammaCorrect();
@@ -1111,6 +1116,11 @@ void SCR_UpdateScreen (void)
 		SCR_UpdateScreenContent();
 	}
 
+	dev_stats.drawcalls = Draw_EndFrame ();
+	dev_peakstats.drawcalls = q_max (dev_stats.drawcalls, dev_peakstats.drawcalls);
+
 	GL_EndRendering ();
+
+	TexMgr_UpdateResidency ();
 }
 
@@ -151,9 +151,8 @@ Sky_LoadSkyBox
 const char	*suf[6] = {"rt", "bk", "lf", "ft", "up", "dn"};
 void Sky_LoadSkyBox (const char *name)
 {
-	int		i, mark, width, height;
+	int		i;
 	char	filename[MAX_OSPATH];
-	byte	*data;
 	qboolean nonefound = true;
 
 	if (strcmp(skybox_name, name) == 0)
@@ -175,23 +174,20 @@ void Sky_LoadSkyBox (const char *name)
 	}
 
 	//load textures
+	TexMgr_BeginBatch ();
 	for (i=0; i<6; i++)
 	{
-		mark = Hunk_LowMark ();
 		q_snprintf (filename, sizeof(filename), "gfx/env/%s%s", name, suf[i]);
-		data = Image_LoadImage (filename, &width, &height);
-		if (data)
-		{
-			skybox_textures[i] = TexMgr_LoadImage (cl.worldmodel, filename, width, height, SRC_RGBA, data, filename, 0, TEXPREF_NONE);
+		skybox_textures[i] = TexMgr_LoadImageFile (cl.worldmodel, filename, filename, TEXPREF_NONE);
+		if (skybox_textures[i])
 			nonefound = false;
-		}
 		else
 		{
 			Con_Printf ("Couldn't load %s\n", filename);
 			skybox_textures[i] = notexture;
 		}
-		Hunk_FreeToLowMark (mark);
 	}
+	TexMgr_EndBatch ();
 
 	if (nonefound) // go back to scrolling sky if skybox is totally missing
 	{
@@ -713,6 +709,7 @@ void Sky_DrawSkyBox (void)
 		Sky_EmitSkyBoxVertex (skymaxs[0][i], skymaxs[1][i], i);
 		Sky_EmitSkyBoxVertex (skymaxs[0][i], skymins[1][i], i);
 		glEnd ();
+		rs_drawcalls++;
 
 		rs_skypolys++;
 		rs_skypasses++;
@@ -732,6 +729,7 @@ void Sky_DrawSkyBox (void)
 			Sky_EmitSkyBoxVertex (skymaxs[0][i], skymaxs[1][i], i);
 			Sky_EmitSkyBoxVertex (skymaxs[0][i], skymins[1][i], i);
 			glEnd ();
+			rs_drawcalls++;
 
 			glColor3f (1, 1, 1);
 			glEnable (GL_TEXTURE_2D);
@@ -825,6 +823,7 @@ void Sky_DrawFaceQuad (glpoly_t *p)
 			glVertex3fv (v);
 		}
 		glEnd ();
+		rs_drawcalls++;
 
 		GL_DisableMultitexture();
 
@@ -846,6 +845,7 @@ void Sky_DrawFaceQuad (glpoly_t *p)
 			glVertex3fv (v);
 		}
 		glEnd ();
+		rs_drawcalls++;
 
 		GL_Bind (alphaskytexture);
 		glEnable (GL_BLEND);
@@ -861,6 +861,7 @@ void Sky_DrawFaceQuad (glpoly_t *p)
 			glVertex3fv (v);
 		}
 		glEnd ();
+		rs_drawcalls++;
 
 		glDisable (GL_BLEND);
 
@@ -881,6 +882,7 @@ void Sky_DrawFaceQuad (glpoly_t *p)
 		for (i=0, v=p->verts[0] ; i<4 ; i++, v+=VERTEXSIZE)
 			glVertex3fv (v);
 		glEnd ();
+		rs_drawcalls++;
 
 		glColor3f (1, 1, 1);
 		glEnable (GL_TEXTURE_2D);
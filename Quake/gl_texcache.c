@@ -0,0 +1,420 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2002-2009 John Fitzgibbons and others
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+//gl_texcache.c -- on-disk cache of prepared texture images
+
+#include "quakedef.h"
+
+/*
+The cache is a diskcache file in the game directory. Each entry is keyed
+by a texcachekey_t, and holds a texcacheinfo_t followed by the mip chain
+ready for upload. Lookups only read the mapping, so texture jobs can use
+it from the worker threads. The file is pruned to 3/4 of gl_texcache_size
+when it has grown past it.
+*/
+
+#define	TEXCACHE_FILENAME	"texcache.dat"
+#define	TEXCACHE_IDENT		(('C'<<24)+('T'<<16)+('S'<<8)+'Q') // little-endian "QSTC"
+#define	TEXCACHE_VERSION	2
+
+static cvar_t	gl_texcache = {"gl_texcache", "1", CVAR_ARCHIVE};
+static cvar_t	gl_texcache_size = {"gl_texcache_size", "256", CVAR_ARCHIVE}; //megabytes
+static cvar_t	gl_texcache_compress = {"gl_texcache_compress", "0", CVAR_ARCHIVE};
+
+/*
+================
+TexCache_LevelSize -- bytes in one mip level
+================
+*/
+int TexCache_LevelSize (int width, int height, int format)
+{
+	switch (format)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		return ((width + 3) / 4) * ((height + 3) / 4) * 16;
+	default:
+		return width * height * 4;
+	}
+}
+
+/*
+================
+TexCache_ImageSize -- bytes in a whole mip chain
+================
+*/
+int TexCache_ImageSize (int width, int height, int format, qboolean mipmap)
+{
+	int size = TexCache_LevelSize (width, height, format);
+
+	while (mipmap && (width > 1 || height > 1))
+	{
+		width = q_max (width >> 1, 1);
+		height = q_max (height >> 1, 1);
+		size += TexCache_LevelSize (width, height, format);
+	}
+	return size;
+}
+
+/*
+================================================================================
+
+	BC1/BC3 ENCODER
+
+A quick range fit: the endpoints are the corners of the block's bounding
+box, pulled in a little, and each pixel takes the nearest palette entry.
+
+================================================================================
+*/
+
+static int TexCache_To565 (int r, int g, int b)
+{
+	return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+static void TexCache_From565 (int c, int *rgb)
+{
+	rgb[0] = ((c >> 11) & 31) * 255 / 31;
+	rgb[1] = ((c >> 5) & 63) * 255 / 63;
+	rgb[2] = (c & 31) * 255 / 31;
+}
+
+/*
+================
+TexCache_ColorBlock -- 8 bytes of BC1 color for 16 RGBA pixels, always in 4 color mode
+================
+*/
+static void TexCache_ColorBlock (const byte *block, byte *out)
+{
+	int	mins[3] = {255, 255, 255}, maxs[3] = {0, 0, 0};
+	int	palette[4][3], c0, c1, inset, i, j, best, bestdist, dist, d;
+	unsigned	indices;
+
+	for (i = 0; i < 16; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			mins[j] = q_min (mins[j], block[i*4+j]);
+			maxs[j] = q_max (maxs[j], block[i*4+j]);
+		}
+	}
+	for (j = 0; j < 3; j++)
+	{
+		inset = (maxs[j] - mins[j]) >> 4;
+		mins[j] += inset;
+		maxs[j] -= inset;
+	}
+
+	c0 = TexCache_To565 (maxs[0], maxs[1], maxs[2]);
+	c1 = TexCache_To565 (mins[0], mins[1], mins[2]);
+	if (c0 < c1)
+	{
+		i = c0;
+		c0 = c1;
+		c1 = i;
+	}
+
+	out[0] = c0 & 255;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 255;
+	out[3] = c1 >> 8;
+
+	if (c0 == c1) //flat block, all indices 0
+	{
+		out[4] = out[5] = out[6] = out[7] = 0;
+		return;
+	}
+
+	TexCache_From565 (c0, palette[0]);
+	TexCache_From565 (c1, palette[1]);
+	for (j = 0; j < 3; j++)
+	{
+		palette[2][j] = (2 * palette[0][j] + palette[1][j]) / 3;
+		palette[3][j] = (palette[0][j] + 2 * palette[1][j]) / 3;
+	}
+
+	indices = 0;
+	for (i = 0; i < 16; i++)
+	{
+		best = 0;
+		bestdist = 0x7fffffff;
+		for (j = 0; j < 4; j++)
+		{
+			d = block[i*4+0] - palette[j][0];
+			dist = d * d;
+			d = block[i*4+1] - palette[j][1];
+			dist += d * d;
+			d = block[i*4+2] - palette[j][2];
+			dist += d * d;
+			if (dist < bestdist)
+			{
+				bestdist = dist;
+				best = j;
+			}
+		}
+		indices |= (unsigned) best << (i * 2);
+	}
+
+	out[4] = indices & 255;
+	out[5] = (indices >> 8) & 255;
+	out[6] = (indices >> 16) & 255;
+	out[7] = indices >> 24;
+}
+
+/*
+================
+TexCache_AlphaBlock -- 8 bytes of BC3 alpha for 16 RGBA pixels, in 8 level mode
+================
+*/
+static void TexCache_AlphaBlock (const byte *block, byte *out)
+{
+	int	a0 = 0, a1 = 255, levels[8], i, j, best, bestdist, dist;
+	uint64_t	indices;
+
+	for (i = 0; i < 16; i++)
+	{
+		a0 = q_max (a0, block[i*4+3]);
+		a1 = q_min (a1, block[i*4+3]);
+	}
+
+	out[0] = a0;
+	out[1] = a1;
+	if (a0 == a1)
+	{
+		memset (out + 2, 0, 6);
+		return;
+	}
+
+	levels[0] = a0;
+	levels[1] = a1;
+	for (j = 2; j < 8; j++)
+		levels[j] = ((8 - j) * a0 + (j - 1) * a1) / 7;
+
+	indices = 0;
+	for (i = 0; i < 16; i++)
+	{
+		best = 0;
+		bestdist = 256;
+		for (j = 0; j < 8; j++)
+		{
+			dist = abs (block[i*4+3] - levels[j]);
+			if (dist < bestdist)
+			{
+				bestdist = dist;
+				best = j;
+			}
+		}
+		indices |= (uint64_t) best << (i * 3);
+	}
+
+	for (i = 0; i < 6; i++)
+		out[2+i] = (byte) (indices >> (i * 8));
+}
+
+/*
+================
+TexCache_CompressImage -- encodes one mip level, returns the bytes written
+
+edge blocks of small mips repeat their last row and column
+================
+*/
+int TexCache_CompressImage (const byte *data, int width, int height, int format, byte *out)
+{
+	byte	block[64];
+	int	x, y, bx, by, sx, sy;
+	byte	*start = out;
+
+	for (y = 0; y < height; y += 4)
+	{
+		for (x = 0; x < width; x += 4)
+		{
+			for (by = 0; by < 4; by++)
+			{
+				sy = q_min (y + by, height - 1);
+				for (bx = 0; bx < 4; bx++)
+				{
+					sx = q_min (x + bx, width - 1);
+					memcpy (block + (by*4 + bx) * 4, data + (sy * width + sx) * 4, 4);
+				}
+			}
+
+			if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+			{
+				TexCache_AlphaBlock (block, out);
+				out += 8;
+			}
+			TexCache_ColorBlock (block, out);
+			out += 8;
+		}
+	}
+
+	return out - start;
+}
+
+/*
+================================================================================
+
+	INTERFACE
+
+================================================================================
+*/
+
+/*
+================
+TexCache_ValidEntry
+================
+*/
+static qboolean TexCache_ValidEntry (const void *data, int size)
+{
+	const texcacheinfo_t *info = (const texcacheinfo_t *) data;
+
+	if (size < (int) sizeof(texcacheinfo_t) || info->datasize != size - (int) sizeof(texcacheinfo_t))
+		return false;
+	if (info->width < 1 || info->width > 16384 || info->height < 1 || info->height > 16384)
+		return false;
+	if (info->format && info->format != GL_COMPRESSED_RGB_S3TC_DXT1_EXT && info->format != GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+		return false;
+	return info->datasize == TexCache_ImageSize (info->width, info->height, info->format, info->flags & TEXPREF_MIPMAP);
+}
+
+static diskcache_t texcache = {TEXCACHE_FILENAME, "texture cache", TEXCACHE_IDENT, TEXCACHE_VERSION,
+		sizeof(texcachekey_t), TexCache_ValidEntry};
+
+/*
+================
+TexCache_Close
+================
+*/
+void TexCache_Close (void)
+{
+	DiskCache_Close (&texcache);
+}
+
+/*
+================
+TexCache_Open -- maps the cache of the current game directory, and prunes it if it's too big
+================
+*/
+void TexCache_Open (void)
+{
+	if (!gl_texcache.value || isDedicated)
+		DiskCache_Close (&texcache);
+	else
+		DiskCache_Open (&texcache, (int) q_min (q_max (gl_texcache_size.value, 1.f), 2047.f) * 1024 * 1024);
+}
+
+/*
+================
+TexCache_Enabled
+================
+*/
+qboolean TexCache_Enabled (void)
+{
+	return DiskCache_Enabled (&texcache);
+}
+
+/*
+================
+TexCache_Compress -- whether new entries get BC1/BC3 compressed
+================
+*/
+qboolean TexCache_Compress (void)
+{
+	return gl_texcache_compress.value && gl_texture_s3tc && TexCache_Enabled ();
+}
+
+/*
+================
+TexCache_Find -- returns the cached mip chain, or NULL
+
+only reads the mapping, so it's safe on worker threads as long as nothing is stored meanwhile
+================
+*/
+const byte *TexCache_Find (const texcachekey_t *key, texcacheinfo_t *info)
+{
+	const byte	*entry;
+	int		size;
+
+	entry = (const byte *) DiskCache_Find (&texcache, key, &size);
+	if (!entry)
+		return NULL;
+
+	memcpy (info, entry, sizeof(texcacheinfo_t));
+	return entry + sizeof(texcacheinfo_t);
+}
+
+/*
+================
+TexCache_Store -- books a lookup, and appends the image unless the file already has a fresh copy
+
+main thread only
+================
+*/
+void TexCache_Store (const texcachekey_t *key, const texcacheinfo_t *info, const void *data, qboolean hit)
+{
+	DiskCache_Store (&texcache, key, info, sizeof(texcacheinfo_t), data, info->datasize, hit);
+}
+
+/*
+================
+TexCache_Flush
+================
+*/
+void TexCache_Flush (void)
+{
+	DiskCache_Flush (&texcache);
+}
+
+/*
+================
+TexCache_Info_f
+================
+*/
+static void TexCache_Info_f (void)
+{
+	DiskCache_PrintInfo (&texcache);
+}
+
+/*
+================
+TexCache_Toggle_f
+================
+*/
+static void TexCache_Toggle_f (cvar_t *var)
+{
+	TexCache_Open ();
+}
+
+/*
+================
+TexCache_Init
+================
+*/
+void TexCache_Init (void)
+{
+	Cvar_RegisterVariable (&gl_texcache);
+	Cvar_SetCallback (&gl_texcache, TexCache_Toggle_f);
+	Cvar_RegisterVariable (&gl_texcache_size);
+	Cvar_RegisterVariable (&gl_texcache_compress);
+	Cmd_AddCommand ("texcacheinfo", TexCache_Info_f);
+
+	TexCache_Open ();
+}
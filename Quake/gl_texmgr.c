@@ -23,6 +23,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 //gl_texmgr.c -- fitzquake's texture manager. manages opengl texture images
 
 #include "quakedef.h"
+#include <setjmp.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXMGR_SSE2 1
+#include <emmintrin.h>
+#endif
 
 const int	gl_solid_format = 3;
 const int	gl_alpha_format = 4;
@@ -31,11 +37,26 @@ static cvar_t	gl_texturemode = {"gl_texturemode", "", CVAR_ARCHIVE};
 static cvar_t	gl_texture_anisotropy = {"gl_texture_anisotropy", "1", CVAR_ARCHIVE};
 static cvar_t	gl_max_size = {"gl_max_size", "0", CVAR_NONE};
 static cvar_t	gl_picmip = {"gl_picmip", "0", CVAR_NONE};
+static cvar_t	gl_texture_budget = {"gl_texture_budget", "0", CVAR_ARCHIVE}; //megabytes, 0 is unlimited
 static GLint	gl_hardware_maxsize;
 
-#define	MAX_GLTEXTURES	2048
+#define	GLTEXTURES_PER_BLOCK	512	//the pool grows by this many textures at a time
+#define	TEXTURE_HASH_SIZE	1024	//owner+name buckets, power of two
+#define	OWNER_HASH_SIZE		64	//owner buckets, power of two
 static int numgltextures;
+static int maxgltextures; //size of the pool
 static gltexture_t	*active_gltextures, *free_gltextures;
+static gltexture_t	*texture_hash[TEXTURE_HASH_SIZE];
+static gltexture_t	*owner_hash[OWNER_HASH_SIZE];
+static int texture_lookups, texture_probes; //for imagelist
+static int numtexjobs; //textures waiting in the batch queue
+static qboolean texmgr_nosimd; //use the plain C kernels, for texbench
+static unsigned texmgr_palettehash[2]; //for texture cache keys
+static int texmgr_residentbytes; //uploaded image sizes, for the texture budget
+static int texmgr_framecount; //frames finished, for residency. r_framecount counts each eye in VR
+
+static void TexMgr_Benchmark_f (void);
+static void TexMgr_Stats_f (void);
 gltexture_t		*notexture, *nulltexture;
 
 unsigned int d_8to24table[256];
@@ -198,7 +219,51 @@ static void TexMgr_Anisotropy_f (cvar_t *var)
 
 /*
 ===============
-TexMgr_Imagelist_f -- report loaded textures
+TexMgr_BenchLookups -- ns per lookup of every loaded texture, hashed and by walking the list
+===============
+*/
+static void TexMgr_BenchLookups (int passes)
+{
+	int		savedlookups = texture_lookups, savedprobes = texture_probes;
+	gltexture_t	*glt, *g;
+	double		time1, hashed, walked;
+	int		i, count, found;
+
+	found = 0;
+	hashed = walked = 0;
+	for (count = 0, glt = active_gltextures; glt; glt = glt->next, count++)
+	{
+		time1 = Sys_DoubleTime ();
+		for (i = 0; i < passes; i++)
+			found += TexMgr_FindTexture (glt->owner, glt->name) != NULL;
+		hashed += Sys_DoubleTime () - time1;
+
+		// the linear search TexMgr_FindTexture used to do
+		time1 = Sys_DoubleTime ();
+		for (i = 0; i < passes; i++)
+		{
+			for (g = active_gltextures; g && (g->owner != glt->owner || strcmp (g->name, glt->name)); g = g->next)
+				;
+			found += g != NULL;
+		}
+		walked += Sys_DoubleTime () - time1;
+	}
+	if (count)
+	{
+		Con_Printf ("%i textures: %4.0f ns hashed, %6.0f ns walking the list\n", count,
+				hashed * 1e9 / (count * passes), walked * 1e9 / (count * passes));
+		Con_Printf ("one lookup of each: %.3f ms hashed, %.3f ms walking the list\n",
+				hashed * 1000.0 / passes, walked * 1000.0 / passes);
+	}
+
+	Con_DPrintf ("%i found\n", found);
+	texture_lookups = savedlookups;
+	texture_probes = savedprobes;
+}
+
+/*
+===============
+TexMgr_Imagelist_f -- report loaded textures; "imagelist bench [passes]" times the lookups
 ===============
 */
 static void TexMgr_Imagelist_f (void)
@@ -206,6 +271,13 @@ static void TexMgr_Imagelist_f (void)
 	float mb;
 	float texels = 0;
 	gltexture_t	*glt;
+	int i, used, chain, longest;
+
+	if (Cmd_Argc() > 1 && !strcmp (Cmd_Argv(1), "bench"))
+	{
+		TexMgr_BenchLookups ((Cmd_Argc() > 2) ? q_max (Q_atoi (Cmd_Argv(2)), 1) : 100);
+		return;
+	}
 
 	for (glt = active_gltextures; glt; glt = glt->next)
 	{
@@ -218,6 +290,18 @@ static void TexMgr_Imagelist_f (void)
 
 	mb = texels * (Cvar_VariableValue("vid_bpp") / 8.0f) / 0x100000;
 	Con_Printf ("%i textures %i pixels %1.1f megabytes\n", numgltextures, (int)texels, mb);
+
+	for (i = 0, used = 0, longest = 0; i < TEXTURE_HASH_SIZE; i++)
+	{
+		for (glt = texture_hash[i], chain = 0; glt; glt = glt->hashnext)
+			chain++;
+		if (chain)
+			used++;
+		longest = q_max (longest, chain);
+	}
+	Con_Printf ("%i of %i slots, %i of %i buckets used, longest chain %i\n", numgltextures, maxgltextures, used, TEXTURE_HASH_SIZE, longest);
+	if (texture_lookups)
+		Con_Printf ("%i lookups, %.2f compares per lookup\n", texture_lookups, (float)texture_probes / texture_lookups);
 }
 
 /*
@@ -298,6 +382,82 @@ float TexMgr_FrameUsage (void)
 ================================================================================
 */
 
+/*
+================
+TexMgr_HashName -- bucket for an owner+name pair
+================
+*/
+static unsigned int TexMgr_HashName (qmodel_t *owner, const char *name)
+{
+	unsigned int hash = (unsigned int)((uintptr_t)owner >> 4) * 2654435761u;
+
+	while (*name)
+		hash = hash * 31 + (unsigned char)*name++;
+
+	return (hash ^ (hash >> 16)) & (TEXTURE_HASH_SIZE - 1);
+}
+
+/*
+================
+TexMgr_HashOwner -- bucket for an owner
+================
+*/
+static unsigned int TexMgr_HashOwner (qmodel_t *owner)
+{
+	unsigned int hash = (unsigned int)((uintptr_t)owner >> 4) * 2654435761u;
+
+	return (hash >> 16) & (OWNER_HASH_SIZE - 1);
+}
+
+/*
+================
+TexMgr_LinkTexture -- adds a texture to the owner+name and owner indexes
+================
+*/
+static void TexMgr_LinkTexture (gltexture_t *glt)
+{
+	unsigned int bucket;
+
+	bucket = TexMgr_HashName (glt->owner, glt->name);
+	glt->hashnext = texture_hash[bucket];
+	texture_hash[bucket] = glt;
+
+	bucket = TexMgr_HashOwner (glt->owner);
+	glt->ownerprev = NULL;
+	glt->ownernext = owner_hash[bucket];
+	if (glt->ownernext)
+		glt->ownernext->ownerprev = glt;
+	owner_hash[bucket] = glt;
+}
+
+/*
+================
+TexMgr_UnlinkTexture -- removes a texture from the indexes, returns false if it wasn't there
+================
+*/
+static qboolean TexMgr_UnlinkTexture (gltexture_t *glt)
+{
+	gltexture_t **link;
+
+	for (link = &texture_hash[TexMgr_HashName (glt->owner, glt->name)]; *link; link = &(*link)->hashnext)
+	{
+		if (*link == glt)
+			break;
+	}
+	if (!*link)
+		return false;
+	*link = glt->hashnext;
+
+	if (glt->ownerprev)
+		glt->ownerprev->ownernext = glt->ownernext;
+	else
+		owner_hash[TexMgr_HashOwner (glt->owner)] = glt->ownernext;
+	if (glt->ownernext)
+		glt->ownernext->ownerprev = glt->ownerprev;
+
+	return true;
+}
+
 /*
 ================
 TexMgr_FindTexture
@@ -309,8 +469,10 @@ gltexture_t *TexMgr_FindTexture (qmodel_t *owner, const char *name)
 
 	if (name)
 	{
-		for (glt = active_gltextures; glt; glt = glt->next)
+		texture_lookups++;
+		for (glt = texture_hash[TexMgr_HashName (owner, name)]; glt; glt = glt->hashnext)
 		{
+			texture_probes++;
 			if (glt->owner == owner && !strcmp (glt->name, name))
 				return glt;
 		}
@@ -319,6 +481,27 @@ gltexture_t *TexMgr_FindTexture (qmodel_t *owner, const char *name)
 	return NULL;
 }
 
+/*
+================
+TexMgr_GrowPool -- adds another block of free textures
+================
+*/
+static void TexMgr_GrowPool (void)
+{
+	gltexture_t *block;
+	int i;
+
+	block = (gltexture_t *) calloc (GLTEXTURES_PER_BLOCK, sizeof(gltexture_t));
+	if (!block)
+		Sys_Error ("TexMgr_GrowPool: out of memory (%i textures)", maxgltextures);
+
+	for (i = 0; i < GLTEXTURES_PER_BLOCK - 1; i++)
+		block[i].next = &block[i+1];
+	block[i].next = free_gltextures;
+	free_gltextures = block;
+	maxgltextures += GLTEXTURES_PER_BLOCK;
+}
+
 /*
 ================
 TexMgr_NewTexture
@@ -328,20 +511,32 @@ gltexture_t *TexMgr_NewTexture (void)
 {
 	gltexture_t *glt;
 
-	if (numgltextures == MAX_GLTEXTURES)
-		Sys_Error("numgltextures == MAX_GLTEXTURES\n");
+	if (!free_gltextures)
+		TexMgr_GrowPool ();
 
 	glt = free_gltextures;
 	free_gltextures = glt->next;
 	glt->next = active_gltextures;
+	glt->prev = NULL;
+	if (active_gltextures)
+		active_gltextures->prev = glt;
 	active_gltextures = glt;
 
+	glt->owner = NULL;
+	glt->name[0] = 0;
+	glt->demote = 0;
+	glt->residentbytes = 0;
+	glt->visframe = r_framecount;
+	glt->usedframe = texmgr_framecount;
+	TexMgr_LinkTexture (glt);
+
 	glGenTextures(1, &glt->texnum);
 	numgltextures++;
 	return glt;
 }
 
 static void GL_DeleteTexture (gltexture_t *texture);
+static void TexMgr_FlushJobs (void);
 
 //ericw -- workaround for preventing TexMgr_FreeTexture during TexMgr_ReloadImages
 static qboolean in_reload_images;
@@ -353,8 +548,6 @@ TexMgr_FreeTexture
 */
 void TexMgr_FreeTexture (gltexture_t *kill)
 {
-	gltexture_t *glt;
-
 	if (in_reload_images)
 		return;
 	
@@ -364,32 +557,28 @@ void TexMgr_FreeTexture (gltexture_t *kill)
 		return;
 	}
 
-	if (active_gltextures == kill)
-	{
-		active_gltextures = kill->next;
-		kill->next = free_gltextures;
-		free_gltextures = kill;
+	// don't let a queued job outlive its texture
+	if (numtexjobs)
+		TexMgr_FlushJobs ();
 
-		GL_DeleteTexture(kill);
-		numgltextures--;
+	if (!TexMgr_UnlinkTexture (kill))
+	{
+		Con_Printf ("TexMgr_FreeTexture: not found\n");
 		return;
 	}
 
-	for (glt = active_gltextures; glt; glt = glt->next)
-	{
-		if (glt->next == kill)
-		{
-			glt->next = kill->next;
-			kill->next = free_gltextures;
-			free_gltextures = kill;
+	if (kill->prev)
+		kill->prev->next = kill->next;
+	else
+		active_gltextures = kill->next;
+	if (kill->next)
+		kill->next->prev = kill->prev;
 
-			GL_DeleteTexture(kill);
-			numgltextures--;
-			return;
-		}
-	}
+	kill->next = free_gltextures;
+	free_gltextures = kill;
 
-	Con_Printf ("TexMgr_FreeTexture: not found\n");
+	GL_DeleteTexture(kill);
+	numgltextures--;
 }
 
 /*
@@ -420,10 +609,10 @@ void TexMgr_FreeTexturesForOwner (qmodel_t *owner)
 {
 	gltexture_t *glt, *next;
 
-	for (glt = active_gltextures; glt; glt = next)
+	for (glt = owner_hash[TexMgr_HashOwner (owner)]; glt; glt = next)
 	{
-		next = glt->next;
-		if (glt && glt->owner == owner)
+		next = glt->ownernext;
+		if (glt->owner == owner)
 			TexMgr_FreeTexture (glt);
 	}
 }
@@ -529,6 +718,9 @@ void TexMgr_LoadPalette (void)
 	memcpy(d_8to24table_conchars, d_8to24table, 256*4);
 	((byte *) &d_8to24table_conchars[0]) [3] = 0;
 
+	//all the tables above derive from it
+	DiskCache_HashData (pal, 768, texmgr_palettehash);
+
 	Hunk_FreeToLowMark (mark);
 }
 
@@ -541,6 +733,7 @@ void TexMgr_NewGame (void)
 {
 	TexMgr_FreeTextures (0, TEXPREF_PERSIST); //deletes all textures where TEXPREF_PERSIST is unset
 	TexMgr_LoadPalette ();
+	TexCache_Open (); //the game dir changed
 }
 
 /*
@@ -601,18 +794,16 @@ must be called before any texture loading
 */
 void TexMgr_Init (void)
 {
-	int i;
 	static byte notexture_data[16] = {159,91,83,255,0,0,0,255,0,0,0,255,159,91,83,255}; //black and pink checker
 	static byte nulltexture_data[16] = {127,191,255,255,0,0,0,255,0,0,0,255,127,191,255,255}; //black and blue checker
 	extern texture_t *r_notexture_mip, *r_notexture_mip2;
 
 	// init texture list
-	free_gltextures = (gltexture_t *) Hunk_AllocName (MAX_GLTEXTURES * sizeof(gltexture_t), "gltextures");
+	free_gltextures = NULL;
 	active_gltextures = NULL;
-	for (i = 0; i < MAX_GLTEXTURES - 1; i++)
-		free_gltextures[i].next = &free_gltextures[i+1];
-	free_gltextures[i].next = NULL;
+	maxgltextures = 0;
 	numgltextures = 0;
+	TexMgr_GrowPool ();
 
 	// palette
 	TexMgr_LoadPalette ();
@@ -627,10 +818,16 @@ void TexMgr_Init (void)
 	Cmd_AddCommand ("gl_describetexturemodes", &TexMgr_DescribeTextureModes_f);
 	Cmd_AddCommand ("imagelist", &TexMgr_Imagelist_f);
 	Cmd_AddCommand ("imagedump", &TexMgr_Imagedump_f);
+	Cmd_AddCommand ("texbench", &TexMgr_Benchmark_f);
+	Cmd_AddCommand ("texstats", &TexMgr_Stats_f);
+	Image_Init ();
+	Cvar_RegisterVariable (&gl_texture_budget);
 
 	// poll max size from hardware
 	glGetIntegerv (GL_MAX_TEXTURE_SIZE, &gl_hardware_maxsize);
 
+	TexCache_Init ();
+
 	// load notexture images
 	notexture = TexMgr_LoadImage (NULL, "notexture", 2, 2, SRC_RGBA, notexture_data, "", (src_offset_t)notexture_data, TEXPREF_NEAREST | TEXPREF_PERSIST | TEXPREF_NOPICMIP);
 	nulltexture = TexMgr_LoadImage (NULL, "nulltexture", 2, 2, SRC_RGBA, nulltexture_data, "", (src_offset_t)nulltexture_data, TEXPREF_NEAREST | TEXPREF_PERSIST | TEXPREF_NOPICMIP);
@@ -692,6 +889,130 @@ int TexMgr_PadConditional (int s)
 		return s;
 }
 
+/*
+================================================================================
+
+	IMAGE PREPARATION
+
+Everything between the source data and glTexImage2D is done on a texjob_t,
+without touching the hunk or GL, so that jobs can run on worker threads.
+Only TexMgr_UploadJob has to run on the main thread.
+
+================================================================================
+*/
+
+enum {TEXPHASE_READ, TEXPHASE_CACHE, TEXPHASE_DECODE, TEXPHASE_CONVERT, TEXPHASE_RESAMPLE, TEXPHASE_MIPMAP, TEXPHASE_UPLOAD, NUM_TEXPHASES};
+static const char *texphase_names[NUM_TEXPHASES] = {"read", "cache", "decode", "convert", "resample", "mipmap", "upload"};
+
+#define	MAX_JOB_ALLOCS	10
+
+typedef struct texjob_s
+{
+	gltexture_t	*glt;
+	byte		*data;		//source pixels in glt->source_format, or NULL to read from file
+	FILE		*file;		//image file opened by Image_OpenImage
+	const byte	*filedata;	//or the file itself, mapped from a pak
+	int		filetype;
+	int		filelength;
+	unsigned	*mips;		//prepared image, all mip levels back to back
+	int		mipformat;	//0 for RGBA, or the compressed GL format
+	int		mipsize;	//bytes in mips
+	texcachekey_t	cachekey;
+	qboolean	cacheable;	//cachekey is set
+	qboolean	cachehit;	//mips point into the texture cache
+	void		*allocs[MAX_JOB_ALLOCS];
+	int		numallocs;
+	qboolean	failed;
+	const char	*error;		//why a worker gave up on the job, reported by TexMgr_FinishJob
+	qboolean	running;	//inside TexMgr_RunJob, so errors can jump back out
+	jmp_buf		abort;
+	double		time[NUM_TEXPHASES];
+} texjob_t;
+
+/*
+================
+TexMgr_JobKeep -- frees a malloc'd block along with the job
+================
+*/
+static void *TexMgr_JobKeep (texjob_t *job, void *ptr)
+{
+	if (!ptr || job->numallocs == MAX_JOB_ALLOCS)
+	{
+		free (ptr);
+		job->error = ptr ? "too many allocations" : "out of memory";
+		// workers mustn't Sys_Error, the main thread does once the job is back
+		if (job->running)
+			longjmp (job->abort, 1);
+		Sys_Error ("TexMgr_JobKeep: %s for %s", job->error, job->glt->name);
+	}
+
+	job->allocs[job->numallocs++] = ptr;
+	return ptr;
+}
+
+/*
+================
+TexMgr_JobAlloc -- temporary memory for a job, replaces Hunk_Alloc
+================
+*/
+static void *TexMgr_JobAlloc (texjob_t *job, int size)
+{
+	return TexMgr_JobKeep (job, malloc (size > 0 ? size : 1));
+}
+
+/*
+================
+TexMgr_FreeJob
+================
+*/
+static void TexMgr_FreeJob (texjob_t *job)
+{
+	while (job->numallocs)
+		free (job->allocs[--job->numallocs]);
+	if (job->file)
+		fclose (job->file);
+	job->file = NULL;
+}
+
+/*
+================
+TexMgr_JobTime -- adds the time since *start to a phase, and restarts the clock
+================
+*/
+static void TexMgr_JobTime (texjob_t *job, int phase, double *start)
+{
+	double now = Sys_DoubleTime ();
+
+	job->time[phase] += now - *start;
+	*start = now;
+}
+
+#ifdef TEXMGR_SSE2
+/*
+================
+TexMgr_Average_SSE2 -- (a + b) >> 1 for each byte, truncating like the C code (_mm_avg_epu8 rounds up)
+================
+*/
+static inline __m128i TexMgr_Average_SSE2 (__m128i a, __m128i b)
+{
+	return _mm_add_epi8 (_mm_and_si128 (a, b),
+		_mm_and_si128 (_mm_srli_epi16 (_mm_xor_si128 (a, b), 1), _mm_set1_epi8 (0x7f)));
+}
+
+/*
+================
+TexMgr_PixelToFloat_SSE2 -- unpacks the four channels of a pixel
+================
+*/
+static inline __m128 TexMgr_PixelToFloat_SSE2 (const byte *pixel)
+{
+	__m128i zero = _mm_setzero_si128 ();
+	__m128i p = _mm_cvtsi32_si128 (*(const int *)pixel);
+
+	return _mm_cvtepi32_ps (_mm_unpacklo_epi16 (_mm_unpacklo_epi8 (p, zero), zero));
+}
+#endif
+
 /*
 ================
 TexMgr_MipMapW
@@ -704,8 +1025,25 @@ static unsigned *TexMgr_MipMapW (unsigned *data, int width, int height)
 
 	out = in = (byte *)data;
 	size = (width*height)>>1;
+	i = 0;
+
+#ifdef TEXMGR_SSE2
+	if (!texmgr_nosimd)
+	{
+		__m128 a, b;
+
+		for ( ; i + 4 <= size; i += 4, out += 16, in += 32)
+		{
+			a = _mm_castsi128_ps (_mm_loadu_si128 ((__m128i *)in));
+			b = _mm_castsi128_ps (_mm_loadu_si128 ((__m128i *)(in + 16)));
+			_mm_storeu_si128 ((__m128i *)out, TexMgr_Average_SSE2 (
+				_mm_castps_si128 (_mm_shuffle_ps (a, b, _MM_SHUFFLE (2, 0, 2, 0))),
+				_mm_castps_si128 (_mm_shuffle_ps (a, b, _MM_SHUFFLE (3, 1, 3, 1)))));
+		}
+	}
+#endif
 
-	for (i = 0; i < size; i++, out += 4, in += 8)
+	for ( ; i < size; i++, out += 4, in += 8)
 	{
 		out[0] = (in[0] + in[4])>>1;
 		out[1] = (in[1] + in[5])>>1;
@@ -732,7 +1070,16 @@ static unsigned *TexMgr_MipMapH (unsigned *data, int width, int height)
 
 	for (i = 0; i < height; i++, in += width)
 	{
-		for (j = 0; j < width; j += 4, out += 4, in += 4)
+		j = 0;
+#ifdef TEXMGR_SSE2
+		if (!texmgr_nosimd)
+		{
+			for ( ; j + 16 <= width; j += 16, out += 16, in += 16)
+				_mm_storeu_si128 ((__m128i *)out, TexMgr_Average_SSE2 (
+					_mm_loadu_si128 ((__m128i *)in), _mm_loadu_si128 ((__m128i *)(in + width))));
+		}
+#endif
+		for ( ; j < width; j += 4, out += 4, in += 4)
 		{
 			out[0] = (in[0] + in[width+0])>>1;
 			out[1] = (in[1] + in[width+1])>>1;
@@ -749,7 +1096,7 @@ static unsigned *TexMgr_MipMapH (unsigned *data, int width, int height)
 TexMgr_ResampleTexture -- bilinear resample
 ================
 */
-static unsigned *TexMgr_ResampleTexture (unsigned *in, int inwidth, int inheight, qboolean alpha)
+static unsigned *TexMgr_ResampleTexture (texjob_t *job, unsigned *in, int inwidth, int inheight, qboolean alpha)
 {
 	byte *nwpx, *nepx, *swpx, *sepx, *dest;
 	unsigned xfrac, yfrac, x, y, modx, mody, imodx, imody, injump, outjump;
@@ -761,7 +1108,7 @@ static unsigned *TexMgr_ResampleTexture (unsigned *in, int inwidth, int inheight
 
 	outwidth = TexMgr_Pad(inwidth);
 	outheight = TexMgr_Pad(inheight);
-	out = (unsigned *) Hunk_Alloc(outwidth*outheight*4);
+	out = (unsigned *) TexMgr_JobAlloc(job, outwidth*outheight*4);
 
 	xfrac = ((inwidth-1) << 16) / (outwidth-1);
 	yfrac = ((inheight-1) << 16) / (outheight-1);
@@ -774,6 +1121,37 @@ static unsigned *TexMgr_ResampleTexture (unsigned *in, int inwidth, int inheight
 		injump = (y>>16) * inwidth;
 		x = 0;
 
+#ifdef TEXMGR_SSE2
+		// the weighted sums stay below 2^24, so floats give the exact integer results
+		if (!texmgr_nosimd)
+		{
+			__m128 wy0 = _mm_set1_ps ((float)imody), wy1 = _mm_set1_ps ((float)mody);
+			__m128 wx0, wx1, top, bottom, scale = _mm_set1_ps (1.0f / 65536.0f);
+			__m128i result;
+			unsigned alphamask = alpha ? 0 : 0xff000000;
+
+			for (j = 0; j < outwidth; j++, x += xfrac)
+			{
+				modx = (x>>8) & 0xFF;
+				wx0 = _mm_set1_ps ((float)(256 - modx));
+				wx1 = _mm_set1_ps ((float)modx);
+
+				nwpx = (byte *)(in + (x>>16) + injump);
+				swpx = nwpx + inwidth*4;
+
+				top = _mm_add_ps (_mm_mul_ps (TexMgr_PixelToFloat_SSE2 (nwpx), wx0), _mm_mul_ps (TexMgr_PixelToFloat_SSE2 (nwpx + 4), wx1));
+				bottom = _mm_add_ps (_mm_mul_ps (TexMgr_PixelToFloat_SSE2 (swpx), wx0), _mm_mul_ps (TexMgr_PixelToFloat_SSE2 (swpx + 4), wx1));
+				result = _mm_cvttps_epi32 (_mm_mul_ps (_mm_add_ps (_mm_mul_ps (top, wy0), _mm_mul_ps (bottom, wy1)), scale));
+				result = _mm_packs_epi32 (result, result);
+				result = _mm_packus_epi16 (result, result);
+				out[outjump + j] = (unsigned)_mm_cvtsi128_si32 (result) | alphamask;
+			}
+			outjump += outwidth;
+			y += yfrac;
+			continue;
+		}
+#endif
+
 		for (j = 0; j < outwidth; j++)
 		{
 			modx = (x>>8) & 0xFF;
@@ -826,6 +1204,20 @@ static void TexMgr_AlphaEdgeFix (byte *data, int width, int height)
 
 		for (j = 0; j < width; j++, dest += 4)
 		{
+#ifdef TEXMGR_SSE2
+			// skip opaque pixels four at a time
+			if (!texmgr_nosimd)
+			{
+				while (j + 4 <= width && !(_mm_movemask_epi8 (_mm_cmpeq_epi8 (
+					_mm_loadu_si128 ((__m128i *)dest), _mm_setzero_si128 ())) & 0x8888))
+				{
+					j += 4;
+					dest += 16;
+				}
+				if (j == width)
+					break;
+			}
+#endif
 			if (dest[3]) //not transparent
 				continue;
 
@@ -938,25 +1330,257 @@ static void TexMgr_PadEdgeFixH (byte *data, int width, int height)
 TexMgr_8to32
 ================
 */
-static unsigned *TexMgr_8to32 (byte *in, int pixels, unsigned int *usepal)
+static unsigned *TexMgr_8to32 (texjob_t *job, byte *in, int pixels, unsigned int *usepal)
 {
 	int i;
 	unsigned *out, *data;
 
-	out = data = (unsigned *) Hunk_Alloc(pixels*4);
+	out = data = (unsigned *) TexMgr_JobAlloc(job, pixels*4);
 
-	for (i = 0; i < pixels; i++)
+	// there is no gather before AVX2, so just keep several lookups in flight
+	for (i = 0; i + 4 <= pixels; i += 4, in += 4, out += 4)
+	{
+		out[0] = usepal[in[0]];
+		out[1] = usepal[in[1]];
+		out[2] = usepal[in[2]];
+		out[3] = usepal[in[3]];
+	}
+	for ( ; i < pixels; i++)
 		*out++ = usepal[*in++];
 
 	return data;
 }
 
+/*
+================================================================================
+
+	KERNEL BENCHMARK
+
+================================================================================
+*/
+
+enum {BENCH_8TO32, BENCH_RESAMPLE, BENCH_EDGEFIX, BENCH_MIPMAP, NUM_BENCH};
+
+typedef struct
+{
+	int	width, height;
+	byte	*pixels;
+} benchtex_t;
+
+/*
+================
+TexMgr_BenchLap -- books the time since *start to a stage, or hashes its output
+================
+*/
+static void TexMgr_BenchLap (double *times, unsigned *hashes, int stage, void *data, int size, double *start)
+{
+	byte	*p = (byte *)data;
+	unsigned	hash;
+
+	if (times)
+		times[stage] += Sys_DoubleTime () - *start;
+	if (hashes)
+	{
+		for (hash = hashes[stage]; size > 0; size--)
+			hash = (hash ^ *p++) * 16777619u;
+		hashes[stage] = hash;
+	}
+	*start = Sys_DoubleTime ();
+}
+
+/*
+================
+TexMgr_BenchTexture -- runs one texture through the kernels, the way an alpha texture is loaded
+================
+*/
+static void TexMgr_BenchTexture (benchtex_t *tex, double *times, unsigned *hashes)
+{
+	gltexture_t	glt;
+	texjob_t	job;
+	unsigned	*data;
+	int	w, h;
+	double	start;
+
+	memset (&glt, 0, sizeof(glt));
+	memset (&job, 0, sizeof(job));
+	q_strlcpy (glt.name, "texbench", sizeof(glt.name));
+	job.glt = &glt;
+	w = tex->width;
+	h = tex->height;
+
+	start = Sys_DoubleTime ();
+	data = TexMgr_8to32 (&job, tex->pixels, w * h, d_8to24table);
+	TexMgr_BenchLap (times, hashes, BENCH_8TO32, data, w * h * 4, &start);
+
+	data = TexMgr_ResampleTexture (&job, data, w, h, true);
+	w = TexMgr_Pad (w);
+	h = TexMgr_Pad (h);
+	TexMgr_BenchLap (times, hashes, BENCH_RESAMPLE, data, w * h * 4, &start);
+
+	TexMgr_AlphaEdgeFix ((byte *)data, w, h);
+	TexMgr_BenchLap (times, hashes, BENCH_EDGEFIX, data, w * h * 4, &start);
+
+	while (w > 1 || h > 1)
+	{
+		if (w > 1)
+		{
+			TexMgr_MipMapW (data, w, h);
+			w >>= 1;
+		}
+		if (h > 1)
+		{
+			TexMgr_MipMapH (data, w, h);
+			h >>= 1;
+		}
+		TexMgr_BenchLap (times, hashes, BENCH_MIPMAP, data, w * h * 4, &start);
+	}
+
+	TexMgr_FreeJob (&job);
+}
+
+/*
+================
+TexMgr_BenchCollect -- adds the textures of a bsp file to the list
+================
+*/
+static int TexMgr_BenchCollect (byte *file, int filelen, benchtex_t **textures, int numtextures, int *maxtextures)
+{
+	dheader_t	*header = (dheader_t *)file;
+	dmiptexlump_t	*m;
+	miptex_t	*mt;
+	int	i, version, ofs, len, count, w, h, pixofs;
+
+	if (filelen < (int) sizeof(dheader_t))
+		return numtextures;
+	version = LittleLong (header->version);
+	if (version != BSPVERSION && version != BSP2VERSION_2PSB && version != BSP2VERSION_BSP2)
+		return numtextures;
+
+	ofs = LittleLong (header->lumps[LUMP_TEXTURES].fileofs);
+	len = LittleLong (header->lumps[LUMP_TEXTURES].filelen);
+	if (len < 4 || ofs < 0 || ofs + len > filelen)
+		return numtextures;
+
+	m = (dmiptexlump_t *)(file + ofs);
+	count = LittleLong (m->nummiptex);
+	for (i = 0; i < count && 4 + i * 4 < len; i++)
+	{
+		if (LittleLong (m->dataofs[i]) < 0 || LittleLong (m->dataofs[i]) + (int) sizeof(miptex_t) > len)
+			continue;
+		mt = (miptex_t *)((byte *)m + LittleLong (m->dataofs[i]));
+		w = LittleLong (mt->width);
+		h = LittleLong (mt->height);
+		pixofs = LittleLong (m->dataofs[i]) + LittleLong (mt->offsets[0]);
+		if (w <= 0 || h <= 0 || w > 4096 || h > 4096 || pixofs < 0 || pixofs + w * h > len)
+			continue;
+
+		if (numtextures == *maxtextures)
+		{
+			*maxtextures = q_max (*maxtextures * 2, 256);
+			*textures = (benchtex_t *) realloc (*textures, *maxtextures * sizeof(benchtex_t));
+			if (!*textures)
+				Sys_Error ("TexMgr_BenchCollect: out of memory");
+		}
+		(*textures)[numtextures].width = w;
+		(*textures)[numtextures].height = h;
+		(*textures)[numtextures].pixels = (byte *) malloc (w * h);
+		if (!(*textures)[numtextures].pixels)
+			Sys_Error ("TexMgr_BenchCollect: out of memory");
+		memcpy ((*textures)[numtextures].pixels, (byte *)m + pixofs, w * h);
+		numtextures++;
+	}
+
+	return numtextures;
+}
+
+/*
+================
+TexMgr_Benchmark_f -- texbench [iterations]
+
+runs the texture kernels over every bsp texture in the loaded paks, once
+with the plain C code and once with SIMD, and checks that both produce
+the same bytes
+================
+*/
+static void TexMgr_Benchmark_f (void)
+{
+	static const char *names[NUM_BENCH] = {"8to32", "resample", "alphaedgefix", "mipmap"};
+	double	times[2][NUM_BENCH];
+	unsigned	*hashes[2];
+	benchtex_t	*textures = NULL;
+	int	numtextures = 0, maxtextures = 0;
+	int	iterations, pass, iter, i, k;
+	searchpath_t	*search;
+	pack_t	*pak;
+	byte	*file;
+	qboolean	exact;
+
+	iterations = (Cmd_Argc () > 1) ? q_max (Q_atoi (Cmd_Argv (1)), 1) : 5;
+
+	for (search = com_searchpaths; search; search = search->next)
+	{
+		if (!(pak = search->pack))
+			continue;
+		for (i = 0; i < pak->numfiles; i++)
+		{
+			if (q_strcasecmp (COM_FileGetExtension (pak->files[i].name), "bsp"))
+				continue;
+			file = (byte *) malloc (pak->files[i].filelen);
+			if (!file)
+				continue;
+			Sys_FileSeek (pak->handle, pak->files[i].filepos);
+			if (Sys_FileRead (pak->handle, file, pak->files[i].filelen) == pak->files[i].filelen)
+				numtextures = TexMgr_BenchCollect (file, pak->files[i].filelen, &textures, numtextures, &maxtextures);
+			free (file);
+		}
+	}
+
+	if (!numtextures)
+	{
+		Con_Printf ("texbench: no bsp textures in the loaded paks\n");
+		return;
+	}
+
+	memset (times, 0, sizeof(times));
+	for (pass = 0; pass < 2; pass++)
+	{
+		hashes[pass] = (unsigned *) calloc (numtextures * NUM_BENCH, sizeof(unsigned));
+		texmgr_nosimd = (pass == 0);
+		// iteration 0 hashes the output of each stage, the others are timed
+		for (iter = 0; iter <= iterations; iter++)
+			for (i = 0; i < numtextures; i++)
+				TexMgr_BenchTexture (&textures[i], iter ? times[pass] : NULL, iter ? NULL : hashes[pass] + i * NUM_BENCH);
+	}
+	texmgr_nosimd = false;
+
+	Con_Printf ("%i textures, %i iterations, ms per pass over all textures:\n", numtextures, iterations);
+	Con_Printf ("kernel              C     SIMD  speedup\n");
+	for (k = 0; k < NUM_BENCH; k++)
+	{
+		for (i = 0, exact = true; i < numtextures; i++)
+			if (hashes[0][i * NUM_BENCH + k] != hashes[1][i * NUM_BENCH + k])
+				exact = false;
+		Con_Printf ("%-12s %8.2f %8.2f %7.2fx %s\n", names[k],
+			times[0][k] * 1000.0 / iterations, times[1][k] * 1000.0 / iterations,
+			times[1][k] > 0 ? times[0][k] / times[1][k] : 0.0, exact ? "" : "MISMATCH");
+	}
+#ifndef TEXMGR_SSE2
+	Con_Printf ("(built without SSE2, both passes ran the C code)\n");
+#endif
+
+	for (i = 0; i < numtextures; i++)
+		free (textures[i].pixels);
+	free (textures);
+	free (hashes[0]);
+	free (hashes[1]);
+}
+
 /*
 ================
 TexMgr_PadImageW -- return image with width padded up to power-of-two dimentions
 ================
 */
-static byte *TexMgr_PadImageW (byte *in, int width, int height, byte padbyte)
+static byte *TexMgr_PadImageW (texjob_t *job, byte *in, int width, int height, byte padbyte)
 {
 	int i, j, outwidth;
 	byte *out, *data;
@@ -966,7 +1590,7 @@ static byte *TexMgr_PadImageW (byte *in, int width, int height, byte padbyte)
 
 	outwidth = TexMgr_Pad(width);
 
-	out = data = (byte *) Hunk_Alloc(outwidth*height);
+	out = data = (byte *) TexMgr_JobAlloc(job, outwidth*height);
 
 	for (i = 0; i < height; i++)
 	{
@@ -984,7 +1608,7 @@ static byte *TexMgr_PadImageW (byte *in, int width, int height, byte padbyte)
 TexMgr_PadImageH -- return image with height padded up to power-of-two dimentions
 ================
 */
-static byte *TexMgr_PadImageH (byte *in, int width, int height, byte padbyte)
+static byte *TexMgr_PadImageH (texjob_t *job, byte *in, int width, int height, byte padbyte)
 {
 	int i, srcpix, dstpix;
 	byte *data, *out;
@@ -995,7 +1619,7 @@ static byte *TexMgr_PadImageH (byte *in, int width, int height, byte padbyte)
 	srcpix = width * height;
 	dstpix = width * TexMgr_Pad(height);
 
-	out = data = (byte *) Hunk_Alloc(dstpix);
+	out = data = (byte *) TexMgr_JobAlloc(job, dstpix);
 
 	for (i = 0; i < srcpix; i++)
 		*out++ = *in++;
@@ -1007,23 +1631,39 @@ static byte *TexMgr_PadImageH (byte *in, int width, int height, byte padbyte)
 
 /*
 ================
-TexMgr_LoadImage32 -- handles 32bit source data
+TexMgr_PicMip -- mip levels dropped from the top of a texture
+================
+*/
+static int TexMgr_PicMip (gltexture_t *glt)
+{
+	int picmip = (glt->flags & TEXPREF_NOPICMIP) ? 0 : q_max((int)gl_picmip.value, 0);
+
+	return picmip + glt->demote;
+}
+
+/*
+================
+TexMgr_PrepareImage32 -- handles 32bit source data, leaves the mip chain in job->mips
 ================
 */
-static void TexMgr_LoadImage32 (gltexture_t *glt, unsigned *data)
+static void TexMgr_PrepareImage32 (texjob_t *job, unsigned *data)
 {
-	int	internalformat,	miplevel, mipwidth, mipheight, picmip;
+	gltexture_t	*glt = job->glt;
+	int	mipwidth, mipheight, picmip, size, total;
+	unsigned	*mip;
+	double	time = Sys_DoubleTime ();
 
 	if (!gl_texture_NPOT)
 	{
 		// resample up
-		data = TexMgr_ResampleTexture (data, glt->width, glt->height, glt->flags & TEXPREF_ALPHA);
+		data = TexMgr_ResampleTexture (job, data, glt->width, glt->height, glt->flags & TEXPREF_ALPHA);
 		glt->width = TexMgr_Pad(glt->width);
 		glt->height = TexMgr_Pad(glt->height);
+		TexMgr_JobTime (job, TEXPHASE_RESAMPLE, &time);
 	}
 
 	// mipmap down
-	picmip = (glt->flags & TEXPREF_NOPICMIP) ? 0 : q_max((int)gl_picmip.value, 0);
+	picmip = TexMgr_PicMip (glt);
 	mipwidth = TexMgr_SafeTextureSize (glt->width >> picmip);
 	mipheight = TexMgr_SafeTextureSize (glt->height >> picmip);
 	while ((int) glt->width > mipwidth)
@@ -1041,18 +1681,29 @@ static void TexMgr_LoadImage32 (gltexture_t *glt, unsigned *data)
 			TexMgr_AlphaEdgeFix ((byte *)data, glt->width, glt->height);
 	}
 
-	// upload
-	GL_Bind (glt);
-	internalformat = (glt->flags & TEXPREF_ALPHA) ? gl_alpha_format : gl_solid_format;
-	glTexImage2D (GL_TEXTURE_2D, 0, internalformat, glt->width, glt->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	// lay out the mip chain
+	size = total = glt->width * glt->height;
+	if (glt->flags & TEXPREF_MIPMAP)
+	{
+		for (mipwidth = glt->width, mipheight = glt->height; mipwidth > 1 || mipheight > 1; )
+		{
+			mipwidth = q_max (mipwidth >> 1, 1);
+			mipheight = q_max (mipheight >> 1, 1);
+			total += mipwidth * mipheight;
+		}
+	}
+	job->mips = mip = (unsigned *) TexMgr_JobAlloc (job, total * 4);
+	job->mipformat = 0;
+	job->mipsize = total * 4;
+	memcpy (mip, data, size * 4);
 
-	// upload mipmaps
+	// make mipmaps
 	if (glt->flags & TEXPREF_MIPMAP)
 	{
 		mipwidth = glt->width;
 		mipheight = glt->height;
 
-		for (miplevel=1; mipwidth > 1 || mipheight > 1; miplevel++)
+		while (mipwidth > 1 || mipheight > 1)
 		{
 			if (mipwidth > 1)
 			{
@@ -1064,26 +1715,72 @@ static void TexMgr_LoadImage32 (gltexture_t *glt, unsigned *data)
 				TexMgr_MipMapH (data, mipwidth, mipheight);
 				mipheight >>= 1;
 			}
-			glTexImage2D (GL_TEXTURE_2D, miplevel, internalformat, mipwidth, mipheight, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			mip += size;
+			size = mipwidth * mipheight;
+			memcpy (mip, data, size * 4);
 		}
 	}
 
-	// set filter modes
-	TexMgr_SetFilterModes (glt);
+	TexMgr_JobTime (job, TEXPHASE_MIPMAP, &time);
 }
 
 /*
 ================
-TexMgr_LoadImage8 -- handles 8bit source data, then passes it to LoadImage32
+TexMgr_UploadJob -- hands a prepared image to GL, must run on the main thread
 ================
 */
-static void TexMgr_LoadImage8 (gltexture_t *glt, byte *data)
+static void TexMgr_UploadJob (texjob_t *job)
 {
-	extern cvar_t gl_fullbrights;
+	gltexture_t	*glt = job->glt;
+	int	internalformat, miplevel, mipwidth, mipheight, size;
+	byte	*mip = (byte *)job->mips;
+	double	time = Sys_DoubleTime ();
+
+	// upload, then the mipmaps
+	GL_Bind (glt);
+	internalformat = (glt->flags & TEXPREF_ALPHA) ? gl_alpha_format : gl_solid_format;
+	mipwidth = glt->width;
+	mipheight = glt->height;
+
+	for (miplevel = 0; ; miplevel++)
+	{
+		size = TexCache_LevelSize (mipwidth, mipheight, job->mipformat);
+		if (job->mipformat)
+			GL_CompressedTexImage2DFunc (GL_TEXTURE_2D, miplevel, job->mipformat, mipwidth, mipheight, 0, size, mip);
+		else
+			glTexImage2D (GL_TEXTURE_2D, miplevel, internalformat, mipwidth, mipheight, 0, GL_RGBA, GL_UNSIGNED_BYTE, mip);
+
+		if (!(glt->flags & TEXPREF_MIPMAP) || (mipwidth == 1 && mipheight == 1))
+			break;
+		mip += size;
+		if (mipwidth > 1)
+			mipwidth >>= 1;
+		if (mipheight > 1)
+			mipheight >>= 1;
+	}
+	texmgr_residentbytes += job->mipsize - glt->residentbytes;
+	glt->residentbytes = job->mipsize;
+
+	// set filter modes
+	TexMgr_SetFilterModes (glt);
+
+	TexMgr_JobTime (job, TEXPHASE_UPLOAD, &time);
+}
+
+/*
+================
+TexMgr_PrepareImage8 -- handles 8bit source data, then passes it to PrepareImage32
+================
+*/
+static void TexMgr_PrepareImage8 (texjob_t *job, byte *data)
+{
+	extern cvar_t gl_fullbrights;
+	gltexture_t *glt = job->glt;
 	qboolean padw = false, padh = false;
 	byte padbyte;
 	unsigned int *usepal;
 	int i;
+	double time = Sys_DoubleTime ();
 
 	// HACK HACK HACK -- taken from tomazquake
 	if (strstr(glt->name, "shot1sid") &&
@@ -1139,20 +1836,20 @@ static void TexMgr_LoadImage8 (gltexture_t *glt, byte *data)
 	{
 		if ((int) glt->width < TexMgr_SafeTextureSize(glt->width))
 		{
-			data = TexMgr_PadImageW (data, glt->width, glt->height, padbyte);
+			data = TexMgr_PadImageW (job, data, glt->width, glt->height, padbyte);
 			glt->width = TexMgr_Pad(glt->width);
 			padw = true;
 		}
 		if ((int) glt->height < TexMgr_SafeTextureSize(glt->height))
 		{
-			data = TexMgr_PadImageH (data, glt->width, glt->height, padbyte);
+			data = TexMgr_PadImageH (job, data, glt->width, glt->height, padbyte);
 			glt->height = TexMgr_Pad(glt->height);
 			padh = true;
 		}
 	}
 
 	// convert to 32bit
-	data = (byte *)TexMgr_8to32(data, glt->width * glt->height, usepal);
+	data = (byte *)TexMgr_8to32(job, data, glt->width * glt->height, usepal);
 
 	// fix edges
 	if (glt->flags & TEXPREF_ALPHA)
@@ -1165,8 +1862,10 @@ static void TexMgr_LoadImage8 (gltexture_t *glt, byte *data)
 			TexMgr_PadEdgeFixH (data, glt->source_width, glt->source_height);
 	}
 
-	// upload it
-	TexMgr_LoadImage32 (glt, (unsigned *)data);
+	TexMgr_JobTime (job, TEXPHASE_CONVERT, &time);
+
+	// on to 32bit processing
+	TexMgr_PrepareImage32 (job, (unsigned *)data);
 }
 
 /*
@@ -1179,11 +1878,396 @@ static void TexMgr_LoadLightmap (gltexture_t *glt, byte *data)
 	// upload it
 	GL_Bind (glt);
 	glTexImage2D (GL_TEXTURE_2D, 0, lightmap_bytes, glt->width, glt->height, 0, gl_lightmap_format, GL_UNSIGNED_BYTE, data);
+	texmgr_residentbytes += glt->width * glt->height * lightmap_bytes - glt->residentbytes;
+	glt->residentbytes = glt->width * glt->height * lightmap_bytes;
 
 	// set filter modes
 	TexMgr_SetFilterModes (glt);
 }
 
+/*
+================================================================================
+
+	BATCHED LOADING
+
+Between TexMgr_BeginBatch and TexMgr_EndBatch, texture loads only queue a
+job. Queued jobs are prepared on the worker threads and uploaded whenever
+the queue fills up, and at the end of the batch. The queue is kept short
+to bound the memory held by prepared images.
+
+================================================================================
+*/
+
+#define	MAX_TEXJOBS	32
+
+static texjob_t	texjobs[MAX_TEXJOBS];
+static int	texbatch; //nesting depth of TexMgr_BeginBatch
+static int	texbatch_count, texbatch_lookups;
+static double	texbatch_start, texbatch_time[NUM_TEXPHASES], texbatch_lookuptime;
+
+/*
+================
+TexMgr_CacheLookup -- keys the job's source bytes, and takes the prepared image from the texture cache if it's there
+================
+*/
+static qboolean TexMgr_CacheLookup (texjob_t *job, const byte *data, int size, unsigned format, double *time)
+{
+	extern cvar_t gl_fullbrights;
+	gltexture_t	*glt = job->glt;
+	texcachekey_t	*key = &job->cachekey;
+	texcacheinfo_t	info;
+	unsigned	settings[8], hash[2];
+	const byte	*cached;
+
+	// tiny images are quicker to prepare than to cache, warpimages are rendered to,
+	// colormapped skins change all the time, and shot1sid gets patched by name
+	if (!TexCache_Enabled () || size < 1024 || (glt->flags & TEXPREF_WARPIMAGE) ||
+	    (glt->shirt > -1 && glt->pants > -1) || strstr (glt->name, "shot1sid"))
+		return false;
+
+	DiskCache_HashData (data, size, key->hash);
+	key->size = size;
+	key->format = format;
+	key->width = (format & TEXCACHE_FILE) ? 0 : glt->source_width;
+	key->height = (format & TEXCACHE_FILE) ? 0 : glt->source_height;
+	key->flags = glt->flags & ~(TEXPREF_LINEAR | TEXPREF_NEAREST | TEXPREF_PERSIST | TEXPREF_OVERWRITE);
+
+	settings[0] = texmgr_palettehash[0];
+	settings[1] = texmgr_palettehash[1];
+	settings[2] = (unsigned) gl_fullbrights.value;
+	settings[3] = (unsigned) TexMgr_PicMip (glt);
+	settings[4] = (unsigned) gl_max_size.value;
+	settings[5] = (unsigned) gl_hardware_maxsize;
+	settings[6] = gl_texture_NPOT;
+	settings[7] = TexCache_Compress ();
+	DiskCache_HashData ((byte *)settings, sizeof(settings), hash);
+	key->settings = hash[0];
+	job->cacheable = true;
+
+	cached = TexCache_Find (key, &info);
+	TexMgr_JobTime (job, TEXPHASE_CACHE, time);
+	if (!cached)
+		return false;
+
+	glt->width = info.width;
+	glt->height = info.height;
+	glt->source_width = info.source_width;
+	glt->source_height = info.source_height;
+	glt->source_crc = info.source_crc;
+	glt->flags = (glt->flags & ~TEXPREF_ALPHA) | (info.flags & TEXPREF_ALPHA);
+	job->mips = (unsigned *)cached;
+	job->mipformat = info.format;
+	job->mipsize = info.datasize;
+	job->cachehit = true;
+	return true;
+}
+
+/*
+================
+TexMgr_CompressJob -- BC1/BC3 encodes a prepared image that is going into the texture cache
+================
+*/
+static void TexMgr_CompressJob (texjob_t *job)
+{
+	gltexture_t	*glt = job->glt;
+	int	format, mipwidth, mipheight;
+	byte	*in, *out;
+	double	time = Sys_DoubleTime ();
+
+	// mipmapped world and model textures only, 2D graphics would look blotchy
+	if (!job->cacheable || !TexCache_Compress () || !(glt->flags & TEXPREF_MIPMAP) ||
+	    (glt->flags & TEXPREF_CONCHARS) || (glt->width & 3) || (glt->height & 3))
+		return;
+
+	format = (glt->flags & TEXPREF_ALPHA) ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	job->mipsize = TexCache_ImageSize (glt->width, glt->height, format, true);
+	out = (byte *) TexMgr_JobAlloc (job, job->mipsize);
+	in = (byte *)job->mips;
+	job->mips = (unsigned *)out;
+	job->mipformat = format;
+
+	mipwidth = glt->width;
+	mipheight = glt->height;
+	for (;;)
+	{
+		out += TexCache_CompressImage (in, mipwidth, mipheight, format, out);
+		in += mipwidth * mipheight * 4;
+		if (mipwidth == 1 && mipheight == 1)
+			break;
+		mipwidth = q_max (mipwidth >> 1, 1);
+		mipheight = q_max (mipheight >> 1, 1);
+	}
+
+	TexMgr_JobTime (job, TEXPHASE_CACHE, &time);
+}
+
+/*
+================
+TexMgr_PrepareJob -- reads, decodes and prepares one texture, safe on worker threads
+================
+*/
+static void TexMgr_PrepareJob (texjob_t *job)
+{
+	//black and pink checker, for images that fail to load
+	static byte invalid_data[16] = {159,91,83,255,0,0,0,255,0,0,0,255,159,91,83,255};
+	gltexture_t	*glt = job->glt;
+	const byte	*file;
+	int	width, height;
+	double	time = Sys_DoubleTime ();
+
+	if (job->file || job->filedata)
+	{
+		file = job->filedata;
+		if (!file)
+		{
+			file = Image_ReadImage (job->file, job->filelength);
+			job->file = NULL;
+			if (file)
+				TexMgr_JobKeep (job, (void *)file);
+		}
+		TexMgr_JobTime (job, TEXPHASE_READ, &time);
+
+		job->data = NULL;
+		if (file)
+		{
+			if (TexMgr_CacheLookup (job, file, job->filelength, glt->source_format | TEXCACHE_FILE, &time))
+				return;
+			job->data = Image_DecodeImage (job->filetype, file, job->filelength, &width, &height);
+			TexMgr_JobTime (job, TEXPHASE_DECODE, &time);
+		}
+
+		if (job->data)
+		{
+			TexMgr_JobKeep (job, job->data);
+			glt->source_crc = CRC_Block (job->data, width * height * 4);
+		}
+		else
+		{
+			job->failed = true;
+			job->data = (byte *) TexMgr_JobAlloc (job, sizeof(invalid_data));
+			memcpy (job->data, invalid_data, sizeof(invalid_data));
+			width = height = 2;
+		}
+
+		glt->width = glt->source_width = width;
+		glt->height = glt->source_height = height;
+	}
+	else if (TexMgr_CacheLookup (job, job->data, glt->source_width * glt->source_height *
+				     (glt->source_format == SRC_RGBA ? 4 : 1), glt->source_format, &time))
+		return;
+
+	switch (glt->source_format)
+	{
+	case SRC_INDEXED:
+		TexMgr_PrepareImage8 (job, job->data);
+		break;
+	case SRC_RGBA:
+		TexMgr_PrepareImage32 (job, (unsigned *)job->data);
+		break;
+	default:
+		break;
+	}
+
+	TexMgr_CompressJob (job);
+}
+
+/*
+================
+TexMgr_RunJob -- TexMgr_PrepareJob, stopping at the first error
+================
+*/
+static void TexMgr_RunJob (texjob_t *job)
+{
+	job->running = true;
+	if (!setjmp (job->abort))
+		TexMgr_PrepareJob (job);
+	job->running = false;
+}
+
+static void TexMgr_RunJobTask (int index, void *data)
+{
+	TexMgr_RunJob (&((texjob_t *)data)[index]);
+}
+
+/*
+================
+TexMgr_FinishJob -- uploads a prepared texture and frees the job
+================
+*/
+static void TexMgr_FinishJob (texjob_t *job)
+{
+	gltexture_t *glt = job->glt;
+	texcacheinfo_t info;
+	int i;
+
+	if (job->error)
+		Sys_Error ("TexMgr_JobKeep: %s for %s", job->error, glt->name);
+
+	if (job->failed)
+		Con_Printf ("Couldn't load %s\n", glt->name);
+	else if (job->cacheable)
+	{
+		info.width = glt->width;
+		info.height = glt->height;
+		info.source_width = glt->source_width;
+		info.source_height = glt->source_height;
+		info.flags = glt->flags;
+		info.source_crc = glt->source_crc;
+		info.format = job->mipformat;
+		info.datasize = job->mipsize;
+		TexCache_Store (&job->cachekey, &info, job->mips, job->cachehit);
+	}
+
+	TexMgr_UploadJob (job);
+	TexMgr_FreeJob (job);
+
+	if (texbatch)
+	{
+		for (i = 0; i < NUM_TEXPHASES; i++)
+			texbatch_time[i] += job->time[i];
+		texbatch_count++;
+	}
+}
+
+/*
+================
+TexMgr_FlushJobs -- runs all queued jobs on the workers, then uploads them
+================
+*/
+static void TexMgr_FlushJobs (void)
+{
+	int i;
+
+	Tasks_ParallelFor (TexMgr_RunJobTask, numtexjobs, texjobs);
+
+	for (i = 0; i < numtexjobs; i++)
+		TexMgr_FinishJob (&texjobs[i]);
+	numtexjobs = 0;
+}
+
+/*
+================
+TexMgr_NewJob -- a queued job while batching, otherwise the caller's own
+================
+*/
+static texjob_t *TexMgr_NewJob (gltexture_t *glt, texjob_t *local)
+{
+	texjob_t *job = local;
+
+	if (texbatch)
+	{
+		if (numtexjobs == MAX_TEXJOBS)
+			TexMgr_FlushJobs ();
+		job = &texjobs[numtexjobs++];
+	}
+
+	memset (job, 0, sizeof(*job));
+	job->glt = glt;
+	return job;
+}
+
+/*
+================
+TexMgr_SubmitJob -- runs the job right away unless it was queued
+================
+*/
+static void TexMgr_SubmitJob (texjob_t *job, texjob_t *local)
+{
+	if (job != local)
+		return;
+
+	TexMgr_RunJob (job);
+	TexMgr_FinishJob (job);
+}
+
+/*
+================
+TexMgr_BeginBatch
+================
+*/
+void TexMgr_BeginBatch (void)
+{
+	if (texbatch++)
+		return;
+
+	texbatch_count = texbatch_lookups = 0;
+	texbatch_start = Sys_DoubleTime ();
+	texbatch_lookuptime = 0;
+	memset (texbatch_time, 0, sizeof(texbatch_time));
+}
+
+/*
+================
+TexMgr_EndBatch -- finishes all queued textures and reports where the time went
+================
+*/
+void TexMgr_EndBatch (void)
+{
+	char	phases[256];
+	int	i;
+
+	if (!texbatch || --texbatch)
+		return;
+
+	texbatch = 1; //so the last jobs still count
+	TexMgr_FlushJobs ();
+	texbatch = 0;
+	TexCache_Flush ();
+
+	if (!texbatch_count)
+		return;
+
+	phases[0] = 0;
+	for (i = 0; i < NUM_TEXPHASES; i++)
+		q_snprintf (phases + strlen(phases), sizeof(phases) - strlen(phases), "%s%s %.1f",
+				i ? ", " : "", texphase_names[i], texbatch_time[i] * 1000.0);
+	Con_DPrintf ("%i textures in %.1f ms (%s ms)\n", texbatch_count, (Sys_DoubleTime () - texbatch_start) * 1000.0, phases);
+	if (texbatch_lookups)
+		Con_DPrintf ("%i texture lookups in %.2f ms\n", texbatch_lookups, texbatch_lookuptime * 1000.0);
+}
+
+/*
+================================================================================
+
+	LOADING
+
+================================================================================
+*/
+
+/*
+================
+TexMgr_AllocTexture -- a new texture, filed under owner and name
+================
+*/
+static gltexture_t *TexMgr_AllocTexture (qmodel_t *owner, const char *name)
+{
+	gltexture_t *glt;
+
+	glt = TexMgr_NewTexture ();
+	TexMgr_UnlinkTexture (glt);
+	glt->owner = owner;
+	q_strlcpy (glt->name, name, sizeof(glt->name));
+	TexMgr_LinkTexture (glt);
+
+	return glt;
+}
+
+/*
+================
+TexMgr_LoadWarpImage -- warpimages are rendered into before they are drawn, so only the storage is made
+================
+*/
+static void TexMgr_LoadWarpImage (gltexture_t *glt)
+{
+	int size = glt->width * glt->height * 4;
+
+	GL_Bind (glt);
+	glTexImage2D (GL_TEXTURE_2D, 0, gl_solid_format, glt->width, glt->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	texmgr_residentbytes += size - glt->residentbytes;
+	glt->residentbytes = size;
+	TexMgr_SetFilterModes (glt);
+}
+
 /*
 ================
 TexMgr_LoadImage -- the one entry point for loading all textures
@@ -1194,7 +2278,9 @@ gltexture_t *TexMgr_LoadImage (qmodel_t *owner, const char *name, int width, int
 {
 	unsigned short crc;
 	gltexture_t *glt;
-	int mark;
+	texjob_t *job, local;
+	int size;
+	double time;
 
 	if (isDedicated)
 		return NULL;
@@ -1203,31 +2289,44 @@ gltexture_t *TexMgr_LoadImage (qmodel_t *owner, const char *name, int width, int
 	switch (format)
 	{
 	case SRC_INDEXED:
-		crc = CRC_Block(data, width * height);
+		size = width * height;
 		break;
 	case SRC_LIGHTMAP:
-		crc = CRC_Block(data, width * height * lightmap_bytes);
+		size = width * height * lightmap_bytes;
 		break;
 	case SRC_RGBA:
-		crc = CRC_Block(data, width * height * 4);
+		size = width * height * 4;
 		break;
 	default: /* not reachable but avoids compiler warnings */
-		crc = 0;
+		size = 0;
+	}
+	crc = (size && !(flags & TEXPREF_WARPIMAGE)) ? CRC_Block(data, size) : 0; //warpimage data is a dummy
+	glt = NULL;
+	if (flags & TEXPREF_OVERWRITE)
+	{
+		time = texbatch ? Sys_DoubleTime () : 0;
+		glt = TexMgr_FindTexture (owner, name);
+		if (texbatch)
+		{
+			texbatch_lookuptime += Sys_DoubleTime () - time;
+			texbatch_lookups++;
+		}
 	}
-	if ((flags & TEXPREF_OVERWRITE) && (glt = TexMgr_FindTexture (owner, name)))
+	if (glt)
 	{
 		if (glt->source_crc == crc)
 			return glt;
+		if (numtexjobs)
+			TexMgr_FlushJobs (); //it may still be queued
 	}
 	else
-		glt = TexMgr_NewTexture ();
+		glt = TexMgr_AllocTexture (owner, name);
 
 	// copy data
-	glt->owner = owner;
-	q_strlcpy (glt->name, name, sizeof(glt->name));
 	glt->width = width;
 	glt->height = height;
 	glt->flags = flags;
+	glt->demote = 0;
 	glt->shirt = -1;
 	glt->pants = -1;
 	q_strlcpy (glt->source_file, source_file, sizeof(glt->source_file));
@@ -1238,22 +2337,76 @@ gltexture_t *TexMgr_LoadImage (qmodel_t *owner, const char *name, int width, int
 	glt->source_crc = crc;
 
 	//upload it
-	mark = Hunk_LowMark();
-
-	switch (glt->source_format)
+	if (format == SRC_LIGHTMAP)
 	{
-	case SRC_INDEXED:
-		TexMgr_LoadImage8 (glt, data);
-		break;
-	case SRC_LIGHTMAP:
 		TexMgr_LoadLightmap (glt, data);
-		break;
-	case SRC_RGBA:
-		TexMgr_LoadImage32 (glt, (unsigned *)data);
-		break;
+		return glt;
+	}
+	if (flags & TEXPREF_WARPIMAGE)
+	{
+		TexMgr_LoadWarpImage (glt);
+		return glt;
 	}
 
-	Hunk_FreeToLowMark(mark);
+	job = TexMgr_NewJob (glt, &local);
+	if (job != &local)
+	{
+		// the caller's data may be gone by the time the job runs
+		job->data = (byte *) TexMgr_JobAlloc (job, size);
+		memcpy (job->data, data, size);
+	}
+	else
+		job->data = data;
+	TexMgr_SubmitJob (job, &local);
+
+	return glt;
+}
+
+/*
+================
+TexMgr_LoadImageFile -- loads an external image file, returns NULL if there is none
+
+the file is only opened here; reading and decoding it is part of the job
+================
+*/
+gltexture_t *TexMgr_LoadImageFile (qmodel_t *owner, const char *name, const char *filename, unsigned flags)
+{
+	gltexture_t *glt;
+	texjob_t *job, local;
+	FILE *f;
+	const byte *mapped;
+	int type, length, width, height;
+
+	if (isDedicated)
+		return NULL;
+
+	type = Image_OpenImage (filename, &f, &mapped, &length);
+	if (type == IMAGE_NONE)
+		return NULL;
+
+	// the size from the header, so it's right before a batched job has run
+	if (!Image_ImageSize (type, f, mapped, length, &width, &height))
+		width = height = 0; //known once decoded
+
+	glt = TexMgr_AllocTexture (owner, name);
+	glt->width = width;
+	glt->height = height;
+	glt->flags = flags & ~TEXPREF_OVERWRITE;
+	glt->shirt = -1;
+	glt->pants = -1;
+	q_strlcpy (glt->source_file, filename, sizeof(glt->source_file));
+	glt->source_offset = 0;
+	glt->source_format = SRC_RGBA;
+	glt->source_width = width;
+	glt->source_height = height;
+	glt->source_crc = 0;
+
+	job = TexMgr_NewJob (glt, &local);
+	job->file = f;
+	job->filedata = mapped;
+	job->filetype = type;
+	job->filelength = length;
+	TexMgr_SubmitJob (job, &local);
 
 	return glt;
 }
@@ -1276,6 +2429,7 @@ void TexMgr_ReloadImage (gltexture_t *glt, int shirt, int pants)
 	byte	translation[256];
 	byte	*src, *dst, *data = NULL, *translated;
 	int	mark, size, i;
+	texjob_t	job;
 //
 // get source data
 //
@@ -1373,17 +2527,15 @@ invalid:
 //
 // upload it
 //
-	switch (glt->source_format)
-	{
-	case SRC_INDEXED:
-		TexMgr_LoadImage8 (glt, data);
-		break;
-	case SRC_LIGHTMAP:
+	if (glt->source_format == SRC_LIGHTMAP)
 		TexMgr_LoadLightmap (glt, data);
-		break;
-	case SRC_RGBA:
-		TexMgr_LoadImage32 (glt, (unsigned *)data);
-		break;
+	else
+	{
+		memset (&job, 0, sizeof(job));
+		job.glt = glt;
+		job.data = data;
+		TexMgr_RunJob (&job);
+		TexMgr_FinishJob (&job);
 	}
 
 	Hunk_FreeToLowMark(mark);
@@ -1431,6 +2583,171 @@ void TexMgr_ReloadNobrightImages (void)
 			TexMgr_ReloadImage(glt, -1, -1);
 }
 
+/*
+================================================================================
+
+	RESIDENCY
+
+With gl_texture_budget set, mipmapped textures that haven't been bound for
+a while lose their top mip levels whenever the uploaded total is over the
+budget, and get them back as soon as they are bound again and the budget
+allows. Both go through TexMgr_ReloadImage, a few textures per frame.
+
+================================================================================
+*/
+
+#define	TEXRES_IDLE_FRAMES	300	//unused for this long before it can be demoted
+#define	TEXRES_MAX_DEMOTE	3	//mip levels
+#define	TEXRES_MIN_SIZE		32	//don't demote below this
+#define	TEXRES_PER_FRAME	4	//reloads per frame
+
+static int	texres_demoted; //textures with demote set, as of the last update
+static int	texres_demotions, texres_promotions;
+static double	texres_bytesout, texres_bytesin, texres_since;
+
+/*
+================
+TexMgr_Streamable -- whether a texture can be demoted and reloaded from its source
+================
+*/
+static qboolean TexMgr_Streamable (gltexture_t *glt)
+{
+	return (glt->flags & TEXPREF_MIPMAP) && !(glt->flags & TEXPREF_WARPIMAGE) &&
+		glt->source_format != SRC_LIGHTMAP && (glt->source_file[0] || glt->source_offset);
+}
+
+/*
+================
+TexMgr_SetDemote -- reuploads a texture with demote levels dropped
+================
+*/
+static void TexMgr_SetDemote (gltexture_t *glt, int demote)
+{
+	int usedframe = glt->usedframe; //reloading binds it, that isn't a use
+	int oldbytes = glt->residentbytes;
+
+	if (demote > glt->demote)
+		texres_demotions++;
+	else
+		texres_promotions++;
+
+	glt->demote = demote;
+	in_reload_images = true; //see TexMgr_ReloadImages, the caller is walking the list
+	TexMgr_ReloadImage (glt, -1, -1);
+	in_reload_images = false;
+	glt->usedframe = usedframe;
+
+	if (glt->residentbytes < oldbytes)
+		texres_bytesout += oldbytes - glt->residentbytes;
+	else
+		texres_bytesin += glt->residentbytes - oldbytes;
+}
+
+/*
+================
+TexMgr_UpdateResidency -- called once a frame, after rendering
+================
+*/
+void TexMgr_UpdateResidency (void)
+{
+	gltexture_t	*glt, *victim;
+	int	budget, reloads, demoted;
+
+	texmgr_framecount++;
+
+	budget = (int) (q_min (q_max (gl_texture_budget.value, 0.f), 2047.f) * 1024 * 1024);
+	if (!budget && !texres_demoted)
+		return;
+
+	// bring back what is in use again
+	reloads = demoted = 0;
+	for (glt = active_gltextures; glt; glt = glt->next)
+	{
+		if (!glt->demote)
+			continue;
+		if (reloads < TEXRES_PER_FRAME && texmgr_framecount - glt->usedframe <= 1 &&
+		    (!budget || texmgr_residentbytes + glt->residentbytes * ((1 << (2 * glt->demote)) - 1) <= budget))
+		{
+			TexMgr_SetDemote (glt, 0);
+			reloads++;
+		}
+		else
+			demoted++;
+	}
+	texres_demoted = demoted;
+
+	// and drop the top mip of the biggest idle texture while over budget
+	while (budget && texmgr_residentbytes > budget && reloads < TEXRES_PER_FRAME)
+	{
+		victim = NULL;
+		for (glt = active_gltextures; glt; glt = glt->next)
+		{
+			if (texmgr_framecount - glt->usedframe < TEXRES_IDLE_FRAMES || glt->demote >= TEXRES_MAX_DEMOTE ||
+			    (int) glt->width < TEXRES_MIN_SIZE * 2 || (int) glt->height < TEXRES_MIN_SIZE * 2 || !TexMgr_Streamable (glt))
+				continue;
+			if (!victim || glt->residentbytes > victim->residentbytes)
+				victim = glt;
+		}
+		if (!victim)
+			break;
+
+		TexMgr_SetDemote (victim, victim->demote + 1);
+		texres_demoted++;
+		reloads++;
+	}
+}
+
+/*
+================
+TexMgr_Stats_f -- the resident set, and how much moved since the last texstats
+================
+*/
+static void TexMgr_Stats_f (void)
+{
+	gltexture_t	*glt;
+	int	count, used, idle, demoted;
+	double	usedbytes, idlebytes, savedbytes, elapsed;
+
+	count = used = idle = demoted = 0;
+	usedbytes = idlebytes = savedbytes = 0;
+	for (glt = active_gltextures; glt; glt = glt->next)
+	{
+		count++;
+		if (texmgr_framecount - glt->usedframe <= 1)
+		{
+			used++;
+			usedbytes += glt->residentbytes;
+		}
+		else if (texmgr_framecount - glt->usedframe >= TEXRES_IDLE_FRAMES)
+		{
+			idle++;
+			idlebytes += glt->residentbytes;
+		}
+		if (glt->demote)
+		{
+			demoted++;
+			savedbytes += (double) glt->residentbytes * ((1 << (2 * glt->demote)) - 1);
+		}
+	}
+
+	Con_Printf ("%i textures, %.1f MB resident", count, texmgr_residentbytes / (1024.0 * 1024.0));
+	if (gl_texture_budget.value > 0)
+		Con_Printf (" of a %.0f MB budget\n", gl_texture_budget.value);
+	else
+		Con_Printf (", no budget\n");
+	Con_Printf ("%i used this frame (%.1f MB), %i idle for %i frames (%.1f MB)\n",
+			used, usedbytes / (1024.0 * 1024.0), idle, TEXRES_IDLE_FRAMES, idlebytes / (1024.0 * 1024.0));
+	Con_Printf ("%i demoted, saving %.1f MB\n", demoted, savedbytes / (1024.0 * 1024.0));
+
+	elapsed = realtime - texres_since;
+	if (texres_since)
+		Con_Printf ("last %.1f s: %i demotions (%.1f MB out), %i promotions (%.1f MB in)\n", elapsed,
+				texres_demotions, texres_bytesout / (1024.0 * 1024.0), texres_promotions, texres_bytesin / (1024.0 * 1024.0));
+	texres_demotions = texres_promotions = 0;
+	texres_bytesout = texres_bytesin = 0;
+	texres_since = realtime;
+}
+
 /*
 ================================================================================
 
@@ -1497,6 +2814,7 @@ void GL_Bind (gltexture_t *texture)
 	if (!texture)
 		texture = nulltexture;
 
+	texture->usedframe = texmgr_framecount; //even if it's still bound, for residency
 	if (texture->texnum != currenttexture[currenttarget - GL_TEXTURE0_ARB])
 	{
 		currenttexture[currenttarget - GL_TEXTURE0_ARB] = texture->texnum;
@@ -1522,6 +2840,8 @@ static void GL_DeleteTexture (gltexture_t *texture)
 	if (texture->texnum == currenttexture[2]) currenttexture[2] = GL_UNUSED_TEXTURE;
 
 	texture->texnum = 0;
+	texmgr_residentbytes -= texture->residentbytes;
+	texture->residentbytes = 0;
 }
 
 /*
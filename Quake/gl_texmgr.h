@@ -47,6 +47,10 @@ typedef struct gltexture_s {
 //managed by texture manager
 	GLuint			texnum;
 	struct gltexture_s	*next;
+	struct gltexture_s	*prev;
+	struct gltexture_s	*hashnext; //next texture in the same owner+name bucket
+	struct gltexture_s	*ownernext; //doubly linked list of textures in the same owner bucket
+	struct gltexture_s	*ownerprev;
 	qmodel_t		*owner;
 //managed by image loading
 	char			name[64];
@@ -63,6 +67,10 @@ typedef struct gltexture_s {
 	char				pants; //0-13 pants color, or -1 if never colormapped
 //used for rendering
 	int			visframe; //matches r_framecount if texture was bound this frame
+//managed by residency
+	int			demote; //top mip levels dropped to stay in the texture budget
+	int			residentbytes; //size of the uploaded image
+	int			usedframe; //texmgr frame count when last bound
 } gltexture_t;
 
 extern gltexture_t *notexture;
@@ -86,10 +94,14 @@ void TexMgr_FreeTexturesForOwner (qmodel_t *owner);
 void TexMgr_NewGame (void);
 void TexMgr_Init (void);
 void TexMgr_DeleteTextureObjects (void);
+void TexMgr_UpdateResidency (void);
 
 // IMAGE LOADING
 gltexture_t *TexMgr_LoadImage (qmodel_t *owner, const char *name, int width, int height, enum srcformat format,
 			       byte *data, const char *source_file, src_offset_t source_offset, unsigned flags);
+gltexture_t *TexMgr_LoadImageFile (qmodel_t *owner, const char *name, const char *filename, unsigned flags);
+void TexMgr_BeginBatch (void);
+void TexMgr_EndBatch (void);
 void TexMgr_ReloadImage (gltexture_t *glt, int shirt, int pants);
 void TexMgr_ReloadImages (void);
 void TexMgr_ReloadNobrightImages (void);
@@ -98,6 +110,42 @@ int TexMgr_Pad(int s);
 int TexMgr_SafeTextureSize (int s);
 int TexMgr_PadConditional (int s);
 
+// TEXTURE CACHE (gl_texcache.c)
+
+typedef struct
+{
+	unsigned	hash[2];	//64 bit hash of the source bytes
+	unsigned	size;		//of the source bytes
+	unsigned	format;		//source format, or'ed with TEXCACHE_FILE for image files
+	unsigned	width, height;	//of the source, 0 for image files
+	unsigned	flags;		//TEXPREF flags that change the prepared image
+	unsigned	settings;	//hash of the palette and cvars that change the prepared image
+} texcachekey_t;
+
+#define TEXCACHE_FILE	0x100
+
+typedef struct
+{
+	int		width, height;	//prepared image
+	int		source_width, source_height;
+	int		flags;		//after preparation, which may drop TEXPREF_ALPHA
+	int		source_crc;
+	int		format;		//0 for RGBA, or the compressed GL format
+	int		datasize;	//bytes in the mip chain
+} texcacheinfo_t;
+
+void TexCache_Init (void);
+void TexCache_Open (void);
+void TexCache_Close (void);
+void TexCache_Flush (void);
+qboolean TexCache_Enabled (void);
+qboolean TexCache_Compress (void);
+const byte *TexCache_Find (const texcachekey_t *key, texcacheinfo_t *info);
+void TexCache_Store (const texcachekey_t *key, const texcacheinfo_t *info, const void *data, qboolean hit);
+int TexCache_LevelSize (int width, int height, int format);
+int TexCache_ImageSize (int width, int height, int format, qboolean mipmap);
+int TexCache_CompressImage (const byte *data, int width, int height, int format, byte *out);
+
 // TEXTURE BINDING & TEXTURE UNIT SWITCHING
 
 void GL_SelectTexture (GLenum target);
@@ -100,11 +100,13 @@ qboolean gl_swap_control = false; //johnfitz
 qboolean gl_anisotropy_able = false; //johnfitz
 float gl_max_anisotropy; //johnfitz
 qboolean gl_texture_NPOT = false; //ericw
+qboolean gl_texture_s3tc = false;
 qboolean gl_vbo_able = false; //ericw
 qboolean gl_glsl_able = false; //ericw
 GLint gl_max_texture_units = 0; //ericw
 qboolean gl_glsl_gamma_able = false; //ericw
 qboolean gl_glsl_alias_able = false; //ericw
+qboolean gl_instancing_able = false;
 int gl_stencilbits;
 
 PFNGLMULTITEXCOORD2FARBPROC GL_MTexCoord2fFunc = NULL; //johnfitz
@@ -115,6 +117,9 @@ PFNGLBUFFERDATAARBPROC GL_BufferDataFunc = NULL; //ericw
 PFNGLBUFFERSUBDATAARBPROC GL_BufferSubDataFunc = NULL; //ericw
 PFNGLDELETEBUFFERSARBPROC GL_DeleteBuffersFunc = NULL; //ericw
 PFNGLGENBUFFERSARBPROC GL_GenBuffersFunc = NULL; //ericw
+QS_PFNGLCOMPRESSEDTEXIMAGE2DPROC GL_CompressedTexImage2DFunc = NULL;
+QS_PFNGLVERTEXATTRIBDIVISORPROC GL_VertexAttribDivisorFunc = NULL;
+QS_PFNGLDRAWELEMENTSINSTANCEDPROC GL_DrawElementsInstancedFunc = NULL;
 
 QS_PFNGLCREATESHADERPROC GL_CreateShaderFunc = NULL; //ericw
 QS_PFNGLDELETESHADERPROC GL_DeleteShaderFunc = NULL; //ericw
@@ -772,6 +777,8 @@ static void VID_Restart (void)
 	R_DeleteShaders ();
 	GL_DeleteBModelVertexBuffer ();
 	GLMesh_DeleteVertexBuffers ();
+	GLAlias_DeleteObjects ();
+	GLWorld_DeleteObjects ();
 
 //
 // set new mode
@@ -1122,6 +1129,28 @@ static void GL_CheckExtensions (void)
 	{
 		Con_Warning ("texture_non_power_of_two not supported\n");
 	}
+
+	// texture_compression_s3tc, for the texture cache
+	//
+	if (COM_CheckParm("-nos3tc"))
+		Con_Warning ("texture_compression_s3tc disabled at command line\n");
+	else if (GL_ParseExtensionList(gl_extensions, "GL_EXT_texture_compression_s3tc"))
+	{
+		GL_CompressedTexImage2DFunc = (QS_PFNGLCOMPRESSEDTEXIMAGE2DPROC) SDL_GL_GetProcAddress("glCompressedTexImage2DARB");
+		if (GL_CompressedTexImage2DFunc)
+		{
+			Con_Printf("FOUND: EXT_texture_compression_s3tc\n");
+			gl_texture_s3tc = true;
+		}
+		else
+		{
+			Con_Warning ("texture_compression_s3tc not supported\n");
+		}
+	}
+	else
+	{
+		Con_Warning ("texture_compression_s3tc not supported\n");
+	}
 	
 	// GLSL
 	//
@@ -1215,6 +1244,33 @@ static void GL_CheckExtensions (void)
 	{
 		Con_Warning ("GLSL alias model rendering not available, using Fitz renderer\n");
 	}
+
+	// instanced arrays, and pose textures read in the vertex shader
+	//
+	if (COM_CheckParm("-noinstancing"))
+		Con_Warning ("instanced alias models disabled at command line\n");
+	else if (gl_glsl_alias_able && GL_ParseExtensionList(gl_extensions, "GL_ARB_instanced_arrays") &&
+			GL_ParseExtensionList(gl_extensions, "GL_ARB_draw_instanced"))
+	{
+		GLint vertexunits = 0;
+
+		GL_VertexAttribDivisorFunc = (QS_PFNGLVERTEXATTRIBDIVISORPROC) SDL_GL_GetProcAddress("glVertexAttribDivisorARB");
+		GL_DrawElementsInstancedFunc = (QS_PFNGLDRAWELEMENTSINSTANCEDPROC) SDL_GL_GetProcAddress("glDrawElementsInstancedARB");
+		glGetIntegerv (GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS, &vertexunits);
+		if (GL_VertexAttribDivisorFunc && GL_DrawElementsInstancedFunc && vertexunits > 0)
+		{
+			Con_Printf("FOUND: ARB_instanced_arrays, ARB_draw_instanced\n");
+			gl_instancing_able = true;
+		}
+		else
+		{
+			Con_Warning ("instanced alias models not available\n");
+		}
+	}
+	else
+	{
+		Con_Warning ("instanced alias models not available\n");
+	}
 }
 
 /*
@@ -1292,6 +1348,7 @@ static void GL_Init (void)
 	//johnfitz
 
 	GLAlias_CreateShaders ();
+	GLWorld_CreateShaders ();
 	GL_ClearBufferBindings ();	
 }
 
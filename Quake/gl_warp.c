@@ -192,6 +192,7 @@ void DrawWaterPoly (glpoly_t *p)
 			glVertex3fv (v);
 		}
 		glEnd ();
+		rs_drawcalls++;
 	}
 	else
 	{
@@ -203,6 +204,7 @@ void DrawWaterPoly (glpoly_t *p)
 			glVertex3fv (v);
 		}
 		glEnd ();
+		rs_drawcalls++;
 	}
 }
 
@@ -251,6 +253,7 @@ void R_UpdateWarpTextures (void)
 				glVertex2f (x2,y);
 			}
 			glEnd();
+			rs_drawcalls++;
 		}
 
 		//copy to texture
@@ -50,6 +50,7 @@ extern	int glx, gly, glwidth, glheight;
 
 void R_TimeRefresh_f (void);
 void R_ReadPointFile_f (void);
+void R_AliasBench_f (void);
 texture_t *R_TextureAnimation (texture_t *base, int frame);
 
 typedef struct surfcache_s
@@ -234,9 +235,28 @@ extern	qboolean	gl_glsl_gamma_able;
 extern	qboolean	gl_glsl_alias_able;
 // ericw --
 
+// instanced alias models
+#ifndef GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS
+#define	GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS	0x8B4C
+#endif
+typedef void (APIENTRYP QS_PFNGLVERTEXATTRIBDIVISORPROC) (GLuint index, GLuint divisor);
+typedef void (APIENTRYP QS_PFNGLDRAWELEMENTSINSTANCEDPROC) (GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei primcount);
+extern QS_PFNGLVERTEXATTRIBDIVISORPROC GL_VertexAttribDivisorFunc;
+extern QS_PFNGLDRAWELEMENTSINSTANCEDPROC GL_DrawElementsInstancedFunc;
+extern	qboolean	gl_instancing_able;
+
 //ericw -- NPOT texture support
 extern	qboolean	gl_texture_NPOT;
 
+// S3TC compressed textures, uploaded from the texture cache
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define	GL_COMPRESSED_RGB_S3TC_DXT1_EXT		0x83F0
+#define	GL_COMPRESSED_RGBA_S3TC_DXT5_EXT	0x83F3
+#endif
+typedef void (APIENTRYP QS_PFNGLCOMPRESSEDTEXIMAGE2DPROC) (GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void *data);
+extern QS_PFNGLCOMPRESSEDTEXIMAGE2DPROC GL_CompressedTexImage2DFunc;
+extern	qboolean	gl_texture_s3tc;
+
 //johnfitz -- polygon offset
 #define OFFSET_BMODEL 1
 #define OFFSET_NONE 0
@@ -265,6 +285,8 @@ extern qboolean gl_texture_env_add; // for GL_EXT_texture_env_add
 extern int rs_brushpolys, rs_aliaspolys, rs_skypolys, rs_particles, rs_fogpolys;
 extern int rs_dynamiclightmaps, rs_brushpasses, rs_aliaspasses, rs_skypasses;
 extern float rs_megatexels;
+extern int rs_drawcalls;	// glBegin/glDrawElements and friends
+extern double rs_entitytime;	// seconds spent submitting entities
 
 //johnfitz -- track developer statistics that vary every frame
 extern cvar_t devstats;
@@ -276,6 +298,7 @@ typedef struct {
 	int		tempents;
 	int		beams;
 	int		dlights;
+	int		drawcalls;	// 2D ones, of the last frame
 } devstats_t;
 extern devstats_t dev_stats, dev_peakstats;
 
@@ -326,6 +349,7 @@ qboolean R_CullBox (vec3_t emins, vec3_t emaxs);
 void R_StoreEfrags (efrag_t **ppefrag);
 qboolean R_CullModelForEntity (entity_t *e);
 void R_RotateForEntity (vec3_t origin, vec3_t angles);
+void R_EntityTransformRows (const vec3_t origin, const vec3_t angles, float rows[3][4]);
 void R_MarkLights (dlight_t *light, int num, mnode_t *node);
 
 void R_InitParticles (void);
@@ -369,11 +393,24 @@ GLuint GL_CreateProgram (const GLchar *vertSource, const GLchar *fragSource, int
 void R_DeleteShaders (void);
 
 void GLAlias_CreateShaders (void);
+void GLAlias_DeleteObjects (void);
+void GLAlias_ResetPoses (void);
+void R_FlushAliasInstances (void);
+void GLWorld_CreateShaders (void);
+void GLWorld_DeleteObjects (void);
+qboolean R_QueueBrushInstance (entity_t *e);
+void R_FlushBrushInstances (void);
 void GL_DrawAliasShadow (entity_t *e);
 void DrawGLTriangleFan (glpoly_t *p);
 void DrawGLPoly (glpoly_t *p);
 void DrawWaterPoly (glpoly_t *p);
 void GL_MakeAliasModelDisplayLists (qmodel_t *m, aliashdr_t *hdr);
+void GLMesh_Init (void);
+void GLMesh_OpenCache (void);
+float GLMesh_ACMR (const unsigned short *indexes, int numindexes, int numverts);
+byte *GLMesh_BuildVertexData (qmodel_t *m, const aliashdr_t *hdr, int *size);
+qboolean GLMesh_LoadCachedMesh (qmodel_t *m, aliashdr_t *hdr, const byte *file, int filesize);
+void GLMesh_StoreCachedMesh (qmodel_t *m, aliashdr_t *hdr);
 
 void Sky_Init (void);
 void Sky_DrawSky (void);
@@ -646,7 +646,10 @@ void Host_ServerFrame (void)
 // move things around and think
 // always pause in single player if in console or menus
 	if (!sv.paused && (svs.maxclients > 1 || key_dest == key_game) )
+	{
 		SV_Physics ();
+		SV_RecordState ();
+	}
 
 //johnfitz -- devstats
 	if (cls.signon == SIGNONS)
@@ -703,6 +706,9 @@ void _Host_Frame (float time)
 // process console commands
 	Cbuf_Execute ();
 
+// report a savegame the background writer has finished
+	Host_SaveFinished (false);
+
 	NET_Poll();
 
 // if running the server locally, make intentions now
@@ -829,7 +835,7 @@ void Host_Init (void)
 	com_argc = host_parms->argc;
 	com_argv = host_parms->argv;
 
-	Memory_Init (host_parms->membase, host_parms->memsize);
+	Memory_Init (host_parms->membase, host_parms->memsize, host_parms->memreserved);
 	Cbuf_Init ();
 	Cmd_Init ();
 	LOG_Init (host_parms);
@@ -849,7 +855,12 @@ void Host_Init (void)
 	SV_Init ();
 
 	Con_Printf ("Exe: " __TIME__ " " __DATE__ "\n");
-	Con_Printf ("%4.1f megabyte heap\n", host_parms->memsize/ (1024*1024.0));
+	if (host_parms->memreserved)
+		Con_Printf ("%4.1f megabyte heap, %4.1f committed\n", host_parms->memsize/ (1024*1024.0), Hunk_Committed ()/ (1024*1024.0));
+	else
+		Con_Printf ("%4.1f megabyte heap\n", host_parms->memsize/ (1024*1024.0));
+
+	Tasks_Init ();
 
 	if (cls.state != ca_dedicated)
 	{
@@ -939,6 +950,9 @@ void Host_Shutdown(void)
 		VID_Shutdown();
 	}
 
+	Host_SaveFinished (true);
+	Tasks_Shutdown ();
+
 	LOG_Close ();
 }
 
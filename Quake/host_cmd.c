@@ -915,6 +915,35 @@ LOAD / SAVE GAME
 
 #define	SAVEGAME_VERSION	5
 
+/* binary savegames start with the same two text lines as the text ones,
+ * so the menu can list them, and go on with a savegamehead_t, the light
+ * styles, and an ED_SaveSnapshot block at a multiple of 4 bytes. they're
+ * written in the native byte order, and only load into the progs.dat
+ * they were saved with. */
+#define	SAVEGAME_BINARY_VERSION	1002
+#define	SAVEGAME_IDENT		(('V'<<24)+('S'<<16)+('S'<<8)+'Q') // little-endian "QSSV"
+
+typedef struct
+{
+	int	ident;
+	int	skill;
+	double	time;
+	float	spawn_parms[NUM_SPAWN_PARMS];
+	char	mapname[MAX_QPATH];
+} savegamehead_t;
+
+typedef struct
+{
+	char	name[MAX_OSPATH];
+	byte	*data;		// NULL when no save is being written
+	int	size;
+	qboolean	ok;
+} savejob_t;
+
+static savejob_t	save_job;
+
+cvar_t	sv_savebinary = {"sv_savebinary", "0", CVAR_ARCHIVE};
+
 /*
 ===============
 Host_SavegameComment
@@ -942,6 +971,116 @@ void Host_SavegameComment (char *text)
 }
 
 
+/*
+===============
+Host_WriteSave -- background task, writes out a binary savegame
+===============
+*/
+static void Host_WriteSave (int index, void *data)
+{
+	savejob_t	*job = (savejob_t *) data;
+	FILE		*f;
+
+	f = fopen (job->name, "wb");
+	job->ok = (f != NULL);
+	if (f)
+	{
+		if ((int) fwrite (job->data, 1, job->size, f) != job->size)
+			job->ok = false;
+		if (fclose (f))
+			job->ok = false;
+	}
+}
+
+/*
+===============
+Host_SaveFinished
+
+reports a binary savegame once its writer is done. with wait, waits for
+the writer rather than checking back next frame.
+===============
+*/
+void Host_SaveFinished (qboolean wait)
+{
+	if (!save_job.data)
+		return;
+
+	if (wait)
+		Tasks_WaitBackground ();
+	else if (Tasks_BackgroundBusy ())
+		return;
+
+	if (save_job.ok)
+		Con_Printf ("done.\n");
+	else
+		Con_Printf ("ERROR: couldn't write %s.\n", save_job.name);
+	free (save_job.data);
+	save_job.data = NULL;
+}
+
+/*
+===============
+Host_SavegameBinary
+
+builds the whole file from a snapshot of the edicts, and leaves the
+writing to a background thread
+===============
+*/
+static void Host_SavegameBinary (const char *name)
+{
+	char		comment[SAVEGAME_COMMENT_LENGTH+1];
+	char		prologue[64 + SAVEGAME_COMMENT_LENGTH];
+	savegamehead_t	head;
+	void		*snapshot;
+	double		start;
+	int		i, len, ofs, stylesize, snapsize;
+
+	Con_Printf ("Saving game to %s...\n", name);
+	start = Sys_DoubleTime ();
+
+	Host_SavegameComment (comment);
+	len = q_snprintf (prologue, sizeof(prologue), "%i\n%s\n", SAVEGAME_BINARY_VERSION, comment);
+
+	memset (&head, 0, sizeof(head));
+	head.ident = SAVEGAME_IDENT;
+	head.skill = current_skill;
+	head.time = sv.time;
+	for (i = 0; i < NUM_SPAWN_PARMS; i++)
+		head.spawn_parms[i] = svs.clients->spawn_parms[i];
+	q_strlcpy (head.mapname, sv.name, sizeof(head.mapname));
+
+	stylesize = 0;
+	for (i = 0; i < MAX_LIGHTSTYLES; i++)
+		stylesize += (sv.lightstyles[i] ? strlen (sv.lightstyles[i]) : 1) + 1;
+
+	snapshot = ED_SaveSnapshot (&snapsize);
+
+	ofs = (len + sizeof(head) + stylesize + 3) & ~3;
+	q_strlcpy (save_job.name, name, sizeof(save_job.name));
+	save_job.size = ofs + snapsize;
+	save_job.data = (byte *) calloc (1, save_job.size);
+	if (!save_job.data)
+		Sys_Error ("Host_SavegameBinary: out of memory");
+
+	memcpy (save_job.data, prologue, len);
+	memcpy (save_job.data + len, &head, sizeof(head));
+	len += sizeof(head);
+	for (i = 0; i < MAX_LIGHTSTYLES; i++)
+	{
+		const char *style = sv.lightstyles[i] ? sv.lightstyles[i] : "m";
+		memcpy (save_job.data + len, style, strlen (style) + 1);
+		len += strlen (style) + 1;
+	}
+	memcpy (save_job.data + ofs, snapshot, snapsize);
+	free (snapshot);
+
+	Con_DPrintf ("binary save: %i bytes, %.2f ms on the main thread\n",
+		save_job.size, (Sys_DoubleTime () - start) * 1000.0);
+
+	Tasks_Background (Host_WriteSave, &save_job);
+	Host_SaveFinished (false);
+}
+
 /*
 ===============
 Host_Savegame_f
@@ -999,6 +1138,13 @@ void Host_Savegame_f (void)
 	q_snprintf (name, sizeof(name), "%s/%s", com_gamedir, Cmd_Argv(1));
 	COM_AddExtension (name, ".sav", sizeof(name));
 
+	Host_SaveFinished (true);
+	if (sv_savebinary.value)
+	{
+		Host_SavegameBinary (name);
+		return;
+	}
+
 	Con_Printf ("Saving game to %s...\n", name);
 	f = fopen (name, "w");
 	if (!f)
@@ -1038,6 +1184,120 @@ void Host_Savegame_f (void)
 }
 
 
+/*
+===============
+Host_LoadgameBinary
+===============
+*/
+static void Host_LoadgameBinary (const char *name)
+{
+	FILE		*f;
+	byte		*data;
+	const char	*styles[MAX_LIGHTSTYLES];
+	savegamehead_t	head;
+	int		i, size, ofs, crc;
+	char		*end;
+
+	f = fopen (name, "rb");
+	if (!f)
+	{
+		Con_Printf ("ERROR: couldn't open.\n");
+		return;
+	}
+	fseek (f, 0, SEEK_END);
+	size = ftell (f);
+	fseek (f, 0, SEEK_SET);
+	data = (byte *) malloc (q_max (size, 1));
+	if (!data)
+		Sys_Error ("Host_LoadgameBinary: out of memory");
+	if ((int) fread (data, 1, size, f) != size)
+		size = 0;
+	fclose (f);
+
+// skip the version and the comment
+	ofs = 0;
+	for (i = 0; i < 2; i++)
+	{
+		end = (char *) memchr (data + ofs, '\n', size - ofs);
+		ofs = end ? end - (char *) data + 1 : size;
+	}
+	if (ofs + (int) sizeof(head) > size)
+	{
+		free (data);
+		Con_Printf ("Savegame is truncated\n");
+		return;
+	}
+	memcpy (&head, data + ofs, sizeof(head));
+	ofs += sizeof(head);
+	if (head.ident != SAVEGAME_IDENT)
+	{
+		free (data);
+		Con_Printf ("Savegame was written on a machine with another byte order\n");
+		return;
+	}
+	head.mapname[sizeof(head.mapname) - 1] = 0;
+
+	for (i = 0; i < MAX_LIGHTSTYLES; i++)
+	{
+		end = (char *) memchr (data + ofs, 0, size - ofs);
+		if (!end)
+		{
+			free (data);
+			Con_Printf ("Savegame is truncated\n");
+			return;
+		}
+		styles[i] = (const char *) data + ofs;
+		ofs = end - (char *) data + 1;
+	}
+	ofs = q_min ((ofs + 3) & ~3, size);
+
+// fail before the current game is gone if the progs.dat has changed
+	crc = ED_SnapshotCRC (data + ofs, size - ofs);
+	if (progs && crc != pr_crc)
+	{
+		free (data);
+		Con_Printf ("Savegame was made with a different progs.dat\n");
+		return;
+	}
+
+	current_skill = head.skill;
+	Cvar_SetValue ("skill", (float)current_skill);
+
+	CL_Disconnect_f ();
+
+	SV_SpawnServer (head.mapname);
+
+	if (!sv.active)
+	{
+		free (data);
+		Con_Printf ("Couldn't load map\n");
+		return;
+	}
+	sv.paused = true;		// pause until all clients connect
+	sv.loadgame = true;
+
+	for (i = 0; i < MAX_LIGHTSTYLES; i++)
+		sv.lightstyles[i] = (const char *)Hunk_Strdup (styles[i], "lightstyles");
+
+	if (!ED_LoadSnapshot (data + ofs, size - ofs))
+	{
+		free (data);
+		CL_Disconnect_f ();
+		return;
+	}
+	free (data);
+
+	sv.time = head.time;
+	for (i = 0; i < NUM_SPAWN_PARMS; i++)
+		svs.clients->spawn_parms[i] = head.spawn_parms[i];
+
+	if (cls.state != ca_dedicated)
+	{
+		CL_EstablishConnection ("local");
+		Host_Reconnect_f ();
+	}
+}
+
 /*
 ===============
 Host_Loadgame_f
@@ -1075,6 +1335,8 @@ void Host_Loadgame_f (void)
 // been used.  The menu calls it before stuffing loadgame command
 //	SCR_BeginLoadingPlaque ();
 
+	Host_SaveFinished (true);
+
 	Con_Printf ("Loading game from %s...\n", name);
 	f = fopen (name, "r");
 	if (!f)
@@ -1084,6 +1346,12 @@ void Host_Loadgame_f (void)
 	}
 
 	fscanf (f, "%i\n", &version);
+	if (version == SAVEGAME_BINARY_VERSION)
+	{
+		fclose (f);
+		Host_LoadgameBinary (name);
+		return;
+	}
 	if (version != SAVEGAME_VERSION)
 	{
 		fclose (f);
@@ -2258,6 +2526,7 @@ void Host_InitCommands (void)
 	Cmd_AddCommand ("ping", Host_Ping_f);
 	Cmd_AddCommand ("load", Host_Loadgame_f);
 	Cmd_AddCommand ("save", Host_Savegame_f);
+	Cvar_RegisterVariable (&sv_savebinary);
 	Cmd_AddCommand ("give", Host_Give_f);
 
 	Cmd_AddCommand ("startdemos", Host_Startdemos_f);
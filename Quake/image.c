@@ -25,37 +25,119 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 static char loadfilename[MAX_OSPATH]; //file scope so that error messages can use it
 
-typedef struct stdio_buffer_s {
-	FILE *f;
-	unsigned char buffer[1024];
-	int size;
-	int pos;
-} stdio_buffer_t;
-
-static stdio_buffer_t *Buf_Alloc(FILE *f)
+/*
+============
+Image_OpenImage
+
+looks for an image file in the supported formats. a file inside a pak
+comes back in *data, mapped; otherwise *f is left open at the start of
+the file. returns the image type, or IMAGE_NONE if there is no such file.
+
+TODO: search order: tga png jpg pcx lmp
+============
+*/
+int Image_OpenImage (const char *name, FILE **f, const byte **data, int *length)
 {
-	stdio_buffer_t *buf = (stdio_buffer_t *) calloc(1, sizeof(stdio_buffer_t));
-	buf->f = f;
-	return buf;
+	q_snprintf (loadfilename, sizeof(loadfilename), "%s.tga", name);
+	*length = COM_MapFile (loadfilename, f, data, NULL);
+	if (*f || *data)
+		return IMAGE_TGA;
+
+	q_snprintf (loadfilename, sizeof(loadfilename), "%s.pcx", name);
+	*length = COM_MapFile (loadfilename, f, data, NULL);
+	if (*f || *data)
+		return IMAGE_PCX;
+
+	return IMAGE_NONE;
 }
 
-static void Buf_Free(stdio_buffer_t *buf)
+/*
+============
+Image_ReadImage
+
+reads and closes a file opened by Image_OpenImage. returns malloc'd data,
+or NULL if the read failed. doesn't touch any globals, so it is safe to
+call from a worker thread.
+============
+*/
+byte *Image_ReadImage (FILE *f, int length)
 {
-	free(buf);
+	byte	*data;
+
+	data = (byte *) malloc (length > 0 ? length : 1);
+	if (data && (int) fread (data, 1, length, f) != length)
+	{
+		free (data);
+		data = NULL;
+	}
+	fclose (f);
+
+	return data;
 }
 
-static inline int Buf_GetC(stdio_buffer_t *buf)
+/*
+============
+Image_ImageSize
+
+reads just the size from the header of a file opened by Image_OpenImage,
+and leaves an open file where it was. returns false if it can't tell.
+============
+*/
+qboolean Image_ImageSize (int type, FILE *f, const byte *data, int length, int *width, int *height)
 {
-	if (buf->pos >= buf->size)
+	byte	header[18];	// TARGAHEADERSIZE, enough of a pcx header too
+	long	pos;
+
+	if (length < (int) sizeof(header))
+		return false;
+	if (data)
+		memcpy (header, data, sizeof(header));
+	else
+	{
+		pos = ftell (f);
+		if (fread (header, 1, sizeof(header), f) != sizeof(header))
+		{
+			fseek (f, pos, SEEK_SET);
+			return false;
+		}
+		fseek (f, pos, SEEK_SET);
+	}
+
+	switch (type)
 	{
-		buf->size = fread(buf->buffer, 1, sizeof(buf->buffer), buf->f);
-		buf->pos = 0;
-		
-		if (buf->size == 0)
-			return EOF;
+	case IMAGE_TGA:
+		*width = header[12] + header[13]*256;
+		*height = header[14] + header[15]*256;
+		break;
+	case IMAGE_PCX: // xmin, ymin, xmax, ymax from byte 4
+		*width = (header[8] + header[9]*256) - (header[4] + header[5]*256) + 1;
+		*height = (header[10] + header[11]*256) - (header[6] + header[7]*256) + 1;
+		break;
+	default:
+		return false;
 	}
+	return *width > 0 && *height > 0;
+}
 
-	return buf->buffer[buf->pos++];
+/*
+============
+Image_DecodeImage
+
+decodes a file read by Image_ReadImage into malloc'd RGBA data. returns
+NULL for bad or unsupported files. safe to call from a worker thread.
+============
+*/
+byte *Image_DecodeImage (int type, const byte *data, int length, int *width, int *height)
+{
+	switch (type)
+	{
+	case IMAGE_TGA:
+		return Image_DecodeTGA (data, length, width, height);
+	case IMAGE_PCX:
+		return Image_DecodePCX (data, length, width, height);
+	default:
+		return NULL;
+	}
 }
 
 /*
@@ -63,25 +145,39 @@ static inline int Buf_GetC(stdio_buffer_t *buf)
 Image_LoadImage
 
 returns a pointer to hunk allocated RGBA data
-
-TODO: search order: tga png jpg pcx lmp
 ============
 */
 byte *Image_LoadImage (const char *name, int *width, int *height)
 {
 	FILE	*f;
+	const byte	*mapped;
+	byte	*file, *data, *hunkdata;
+	int	type, length;
 
-	q_snprintf (loadfilename, sizeof(loadfilename), "%s.tga", name);
-	COM_FOpenFile (loadfilename, &f, NULL);
-	if (f)
-		return Image_LoadTGA (f, width, height);
+	type = Image_OpenImage (name, &f, &mapped, &length);
+	if (type == IMAGE_NONE)
+		return NULL;
 
-	q_snprintf (loadfilename, sizeof(loadfilename), "%s.pcx", name);
-	COM_FOpenFile (loadfilename, &f, NULL);
-	if (f)
-		return Image_LoadPCX (f, width, height);
+	file = mapped ? NULL : Image_ReadImage (f, length);
+	if (!mapped && !file)
+	{
+		Con_Printf ("Couldn't read %s\n", loadfilename);
+		return NULL;
+	}
+
+	data = Image_DecodeImage (type, mapped ? mapped : file, length, width, height);
+	free (file);
+	if (!data)
+	{
+		Con_Printf ("%s is not a supported image\n", loadfilename);
+		return NULL;
+	}
+
+	hunkdata = (byte *) Hunk_Alloc (*width * *height * 4);
+	memcpy (hunkdata, data, *width * *height * 4);
+	free (data);
 
-	return NULL;
+	return hunkdata;
 }
 
 //==============================================================================
@@ -100,7 +196,6 @@ typedef struct targaheader_s {
 
 #define TARGAHEADERSIZE 18 //size on disk
 
-targaheader_t targa_header;
 
 int fgetLittleShort (FILE *f)
 {
@@ -174,191 +269,167 @@ qboolean Image_WriteTGA (const char *name, byte *data, int width, int height, in
 
 /*
 =============
-Image_LoadTGA
+Image_TGAPixels -- converts BGR or BGRA pixels to RGBA
+=============
+*/
+static void Image_TGAPixels (byte *out, const byte *in, int count, int bytes)
+{
+	if (bytes == 4)
+	{
+		for ( ; count; count--, in += 4, out += 4)
+		{
+			out[0] = in[2];
+			out[1] = in[1];
+			out[2] = in[0];
+			out[3] = in[3];
+		}
+	}
+	else
+	{
+		for ( ; count; count--, in += 3, out += 4)
+		{
+			out[0] = in[2];
+			out[1] = in[1];
+			out[2] = in[0];
+			out[3] = 255;
+		}
+	}
+}
+
+/*
+=============
+Image_FillPixels -- repeats one RGBA pixel, for RLE runs
+=============
+*/
+static void Image_FillPixels (byte *out, const byte *pixel, int count)
+{
+	unsigned	value, *dst;
+
+	if (pixel[0] == pixel[1] && pixel[0] == pixel[2] && pixel[0] == pixel[3])
+	{
+		memset (out, pixel[0], count * 4); //black, white, and fully transparent black
+		return;
+	}
+
+	memcpy (&value, pixel, 4);
+	for (dst = (unsigned *)out; count; count--)
+		*dst++ = value;
+}
+
+/*
+=============
+Image_TGASpan -- where the pixel at pos in file order goes, and how many follow it in the same row
+=============
+*/
+static byte *Image_TGASpan (byte *rgba, int pos, int columns, int rows, qboolean upside_down, int *span)
+{
+	int	row = pos / columns, column = pos % columns;
+
+	if (upside_down)
+		row = rows - 1 - row;
+	*span = columns - column;
+	return rgba + (row * columns + column) * 4;
+}
+
+/*
+=============
+Image_DecodeTGA
+
+works on whole rows and packets: raw pixels are converted a row or a
+packet at a time, and runs are filled, split only where they wrap to the
+next row. a truncated file leaves the rest of the image black.
 =============
 */
-byte *Image_LoadTGA (FILE *fin, int *width, int *height)
+byte *Image_DecodeTGA (const byte *data, int size, int *width, int *height)
 {
-	int				columns, rows, numPixels;
-	byte			*pixbuf;
-	int				row, column;
-	byte			*targa_rgba;
-	int				realrow; //johnfitz -- fix for upside-down targas
-	qboolean		upside_down; //johnfitz -- fix for upside-down targas
-	stdio_buffer_t	*buf;
-
-	targa_header.id_length = fgetc(fin);
-	targa_header.colormap_type = fgetc(fin);
-	targa_header.image_type = fgetc(fin);
-
-	targa_header.colormap_index = fgetLittleShort(fin);
-	targa_header.colormap_length = fgetLittleShort(fin);
-	targa_header.colormap_size = fgetc(fin);
-	targa_header.x_origin = fgetLittleShort(fin);
-	targa_header.y_origin = fgetLittleShort(fin);
-	targa_header.width = fgetLittleShort(fin);
-	targa_header.height = fgetLittleShort(fin);
-	targa_header.pixel_size = fgetc(fin);
-	targa_header.attributes = fgetc(fin);
+	int		columns, rows, numPixels, bytes, pos, count, span;
+	byte		*targa_rgba, *out, pixel[4];
+	const byte	*in, *end;
+	qboolean	upside_down; //johnfitz -- fix for upside-down targas
+	targaheader_t	targa_header;
+
+	if (size < TARGAHEADERSIZE)
+		return NULL;
+
+	targa_header.id_length = data[0];
+	targa_header.colormap_type = data[1];
+	targa_header.image_type = data[2];
+	targa_header.colormap_index = data[3] + data[4]*256;
+	targa_header.colormap_length = data[5] + data[6]*256;
+	targa_header.colormap_size = data[7];
+	targa_header.x_origin = data[8] + data[9]*256;
+	targa_header.y_origin = data[10] + data[11]*256;
+	targa_header.width = data[12] + data[13]*256;
+	targa_header.height = data[14] + data[15]*256;
+	targa_header.pixel_size = data[16];
+	targa_header.attributes = data[17];
 
 	if (targa_header.image_type!=2 && targa_header.image_type!=10)
-		Sys_Error ("Image_LoadTGA: %s is not a type 2 or type 10 targa\n", loadfilename);
+		return NULL; //not a type 2 or type 10 targa
 
 	if (targa_header.colormap_type !=0 || (targa_header.pixel_size!=32 && targa_header.pixel_size!=24))
-		Sys_Error ("Image_LoadTGA: %s is not a 24bit or 32bit targa\n", loadfilename);
+		return NULL; //not a 24bit or 32bit targa
 
 	columns = targa_header.width;
 	rows = targa_header.height;
 	numPixels = columns * rows;
+	bytes = targa_header.pixel_size / 8;
 	upside_down = !(targa_header.attributes & 0x20); //johnfitz -- fix for upside-down targas
 
-	targa_rgba = (byte *) Hunk_Alloc (numPixels*4);
+	targa_rgba = (byte *) malloc (numPixels > 0 ? numPixels*4 : 1);
+	if (!targa_rgba)
+		return NULL;
 
-	if (targa_header.id_length != 0)
-		fseek(fin, targa_header.id_length, SEEK_CUR);  // skip TARGA image comment
-
-	buf = Buf_Alloc(fin);
+	in = data + TARGAHEADERSIZE + targa_header.id_length; // skip TARGA image comment
+	end = data + size;
+	pos = 0;
 
 	if (targa_header.image_type==2) // Uncompressed, RGB images
 	{
-		for(row=rows-1; row>=0; row--)
+		for ( ; pos < numPixels && end - in >= columns * bytes; pos += columns, in += columns * bytes)
 		{
-			//johnfitz -- fix for upside-down targas
-			realrow = upside_down ? row : rows - 1 - row;
-			pixbuf = targa_rgba + realrow*columns*4;
-			//johnfitz
-			for(column=0; column<columns; column++)
-			{
-				unsigned char red,green,blue,alphabyte;
-				switch (targa_header.pixel_size)
-				{
-				case 24:
-					blue = Buf_GetC(buf);
-					green = Buf_GetC(buf);
-					red = Buf_GetC(buf);
-					*pixbuf++ = red;
-					*pixbuf++ = green;
-					*pixbuf++ = blue;
-					*pixbuf++ = 255;
-					break;
-				case 32:
-					blue = Buf_GetC(buf);
-					green = Buf_GetC(buf);
-					red = Buf_GetC(buf);
-					alphabyte = Buf_GetC(buf);
-					*pixbuf++ = red;
-					*pixbuf++ = green;
-					*pixbuf++ = blue;
-					*pixbuf++ = alphabyte;
-					break;
-				}
-			}
+			out = Image_TGASpan (targa_rgba, pos, columns, rows, upside_down, &span);
+			Image_TGAPixels (out, in, columns, bytes);
 		}
 	}
-	else if (targa_header.image_type==10) // Runlength encoded RGB images
+	else // Runlength encoded RGB images
 	{
-		unsigned char red,green,blue,alphabyte,packetHeader,packetSize,j;
-		for(row=rows-1; row>=0; row--)
+		while (pos < numPixels && in < end)
 		{
-			//johnfitz -- fix for upside-down targas
-			realrow = upside_down ? row : rows - 1 - row;
-			pixbuf = targa_rgba + realrow*columns*4;
-			//johnfitz
-			for(column=0; column<columns; )
+			count = 1 + (*in & 0x7f);
+			if (*in++ & 0x80) // run-length packet
 			{
-				packetHeader=Buf_GetC(buf);
-				packetSize = 1 + (packetHeader & 0x7f);
-				if (packetHeader & 0x80) // run-length packet
+				if (end - in < bytes)
+					break;
+				Image_TGAPixels (pixel, in, 1, bytes);
+				in += bytes;
+				for (count = q_min (count, numPixels - pos); count; count -= span, pos += span)
 				{
-					switch (targa_header.pixel_size)
-					{
-					case 24:
-						blue = Buf_GetC(buf);
-						green = Buf_GetC(buf);
-						red = Buf_GetC(buf);
-						alphabyte = 255;
-						break;
-					case 32:
-						blue = Buf_GetC(buf);
-						green = Buf_GetC(buf);
-						red = Buf_GetC(buf);
-						alphabyte = Buf_GetC(buf);
-						break;
-					default: /* avoid compiler warnings */
-						blue = red = green = alphabyte = 0;
-					}
-
-					for(j=0;j<packetSize;j++)
-					{
-						*pixbuf++=red;
-						*pixbuf++=green;
-						*pixbuf++=blue;
-						*pixbuf++=alphabyte;
-						column++;
-						if (column==columns) // run spans across rows
-						{
-							column=0;
-							if (row>0)
-								row--;
-							else
-								goto breakOut;
-							//johnfitz -- fix for upside-down targas
-							realrow = upside_down ? row : rows - 1 - row;
-							pixbuf = targa_rgba + realrow*columns*4;
-							//johnfitz
-						}
-					}
+					out = Image_TGASpan (targa_rgba, pos, columns, rows, upside_down, &span);
+					span = q_min (span, count);
+					Image_FillPixels (out, pixel, span);
 				}
-				else // non run-length packet
+			}
+			else // non run-length packet
+			{
+				if (end - in < count * bytes)
+					break;
+				for (count = q_min (count, numPixels - pos); count; count -= span, pos += span)
 				{
-					for(j=0;j<packetSize;j++)
-					{
-						switch (targa_header.pixel_size)
-						{
-						case 24:
-							blue = Buf_GetC(buf);
-							green = Buf_GetC(buf);
-							red = Buf_GetC(buf);
-							*pixbuf++ = red;
-							*pixbuf++ = green;
-							*pixbuf++ = blue;
-							*pixbuf++ = 255;
-							break;
-						case 32:
-							blue = Buf_GetC(buf);
-							green = Buf_GetC(buf);
-							red = Buf_GetC(buf);
-							alphabyte = Buf_GetC(buf);
-							*pixbuf++ = red;
-							*pixbuf++ = green;
-							*pixbuf++ = blue;
-							*pixbuf++ = alphabyte;
-							break;
-						default: /* avoid compiler warnings */
-							blue = red = green = alphabyte = 0;
-						}
-						column++;
-						if (column==columns) // pixel packet run spans across rows
-						{
-							column=0;
-							if (row>0)
-								row--;
-							else
-								goto breakOut;
-							//johnfitz -- fix for upside-down targas
-							realrow = upside_down ? row : rows - 1 - row;
-							pixbuf = targa_rgba + realrow*columns*4;
-							//johnfitz
-						}
-					}
+					out = Image_TGASpan (targa_rgba, pos, columns, rows, upside_down, &span);
+					span = q_min (span, count);
+					Image_TGAPixels (out, in, span, bytes);
+					in += span * bytes;
 				}
 			}
-			breakOut:;
 		}
 	}
 
-	Buf_Free(buf);
-	fclose(fin);
+	for ( ; pos < numPixels; pos += span)
+	{
+		out = Image_TGASpan (targa_rgba, pos, columns, rows, upside_down, &span);
+		memset (out, 0, span * 4);
+	}
 
 	*width = (int)(targa_header.width);
 	*height = (int)(targa_header.height);
@@ -389,20 +460,24 @@ typedef struct
 
 /*
 ============
-Image_LoadPCX
+Image_DecodePCX
+
+each run is one fill of the palette color; runs past the visible width
+only cover the padding. a truncated file leaves the rest of the image black.
 ============
 */
-byte *Image_LoadPCX (FILE *f, int *width, int *height)
+byte *Image_DecodePCX (const byte *file, int size, int *width, int *height)
 {
 	pcxheader_t	pcx;
-	int			x, y, w, h, readbyte, runlength, start;
-	byte		*p, *data;
-	byte		palette[768];
-	stdio_buffer_t  *buf;
+	int			x, y, w, h, readbyte, runlength, count, i;
+	unsigned	colors[256], *p;
+	byte		*data, *color;
+	const byte	*palette, *in, *end;
 
-	start = ftell (f); //save start of file (since we might be inside a pak file, SEEK_SET might not be the start of the pcx)
+	if (size < (int) sizeof(pcx) + 768)
+		return NULL;
 
-	fread(&pcx, sizeof(pcx), 1, f);
+	memcpy (&pcx, file, sizeof(pcx));
 	pcx.xmin = (unsigned short)LittleShort (pcx.xmin);
 	pcx.ymin = (unsigned short)LittleShort (pcx.ymin);
 	pcx.xmax = (unsigned short)LittleShort (pcx.xmax);
@@ -410,60 +485,216 @@ byte *Image_LoadPCX (FILE *f, int *width, int *height)
 	pcx.bytes_per_line = (unsigned short)LittleShort (pcx.bytes_per_line);
 
 	if (pcx.signature != 0x0A)
-		Sys_Error ("'%s' is not a valid PCX file", loadfilename);
+		return NULL; //not a valid PCX file
 
 	if (pcx.version != 5)
-		Sys_Error ("'%s' is version %i, should be 5", loadfilename, pcx.version);
+		return NULL; //should be version 5
 
 	if (pcx.encoding != 1 || pcx.bits_per_pixel != 8 || pcx.color_planes != 1)
-		Sys_Error ("'%s' has wrong encoding or bit depth", loadfilename);
+		return NULL; //wrong encoding or bit depth
 
 	w = pcx.xmax - pcx.xmin + 1;
 	h = pcx.ymax - pcx.ymin + 1;
+	if (w <= 0 || h <= 0)
+		return NULL;
 
-	data = (byte *) Hunk_Alloc((w*h+1)*4); //+1 to allow reading padding byte on last line
-
-	//load palette
-	fseek (f, start + com_filesize - 768, SEEK_SET);
-	fread (palette, 1, 768, f);
+	data = (byte *) malloc (w*h*4);
+	if (!data)
+		return NULL;
 
-	//back to start of image data
-	fseek (f, start + sizeof(pcx), SEEK_SET);
+	//palette is at the end of the file
+	palette = file + size - 768;
+	for (x = 0; x < 256; x++)
+	{
+		color = (byte *) &colors[x];
+		color[0] = palette[x*3];
+		color[1] = palette[x*3+1];
+		color[2] = palette[x*3+2];
+		color[3] = 255;
+	}
 
-	buf = Buf_Alloc(f);
+	//image data follows the header
+	in = file + sizeof(pcx);
+	end = palette;
 
 	for (y=0; y<h; y++)
 	{
-		p = data + y * w * 4;
+		p = (unsigned *) (data + y * w * 4);
 
 		for (x=0; x<(pcx.bytes_per_line); ) //read the extra padding byte if necessary
 		{
-			readbyte = Buf_GetC(buf);
+			if (in == end)
+				goto truncated;
+			readbyte = *in++;
 
 			if(readbyte >= 0xC0)
 			{
+				if (in == end)
+					goto truncated;
 				runlength = readbyte & 0x3F;
-				readbyte = Buf_GetC(buf);
+				readbyte = *in++;
 			}
 			else
 				runlength = 1;
 
-			while(runlength--)
-			{
-				p[0] = palette[readbyte*3];
-				p[1] = palette[readbyte*3+1];
-				p[2] = palette[readbyte*3+2];
-				p[3] = 255;
-				p += 4;
-				x++;
-			}
+			count = q_min (runlength, w - x); //padding bytes are dropped
+			for (i = 0; i < count; i++)
+				p[x + i] = colors[readbyte];
+			x += runlength;
 		}
 	}
 
-	Buf_Free(buf);
-	fclose(f);
+	*width = w;
+	*height = h;
+	return data;
 
+truncated:
+	memset (data + (y * w + q_min (x, w)) * 4, 0, ((h - y) * w - q_min (x, w)) * 4);
 	*width = w;
 	*height = h;
 	return data;
 }
+
+//==============================================================================
+//
+//  BENCHMARK
+//
+//==============================================================================
+
+#define	MAX_BENCH_IMAGES	4096
+
+/*
+============
+Image_BenchAdd
+============
+*/
+static void Image_BenchAdd (char (*names)[MAX_QPATH], int *numnames, const char *name)
+{
+	const char *ext = COM_FileGetExtension (name);
+
+	if (*numnames < MAX_BENCH_IMAGES && (!q_strcasecmp (ext, "tga") || !q_strcasecmp (ext, "pcx")))
+		q_strlcpy (names[(*numnames)++], name, MAX_QPATH);
+}
+
+/*
+============
+Image_Benchmark_f -- imagebench [listfile] [passes]
+
+decodes a corpus of tga and pcx files: the ones listed in listfile, or
+all that are inside the loaded paks. reports the time to read them with
+stdio, to map them, and to decode them.
+============
+*/
+static void Image_Benchmark_f (void)
+{
+	char	(*names)[MAX_QPATH];
+	const char	*list;
+	byte	*listfile, *file, *data;
+	const byte	*mapped;
+	searchpath_t	*search;
+	FILE	*f;
+	int	numnames, passes, pass, i, type, length, width, height, nummapped;
+	int	count[3], bytes, pixels[3];
+	double	start, readtime, maptime, decodetime[3];
+
+	passes = (Cmd_Argc () > 2) ? q_max (atoi (Cmd_Argv (2)), 1) : 3;
+
+	names = (char (*)[MAX_QPATH]) malloc (MAX_BENCH_IMAGES * MAX_QPATH);
+	if (!names)
+		return;
+	numnames = 0;
+	if (Cmd_Argc () > 1 && strcmp (Cmd_Argv (1), "-"))
+	{
+		listfile = COM_LoadMallocFile (Cmd_Argv (1), NULL);
+		if (!listfile)
+		{
+			Con_Printf ("Couldn't load %s\n", Cmd_Argv (1));
+			free (names);
+			return;
+		}
+		for (list = COM_Parse ((const char *)listfile); list; list = COM_Parse (list))
+			Image_BenchAdd (names, &numnames, com_token);
+		free (listfile);
+	}
+	else
+	{
+		for (search = com_searchpaths; search; search = search->next)
+			if (search->pack)
+				for (i = 0; i < search->pack->numfiles; i++)
+					Image_BenchAdd (names, &numnames, search->pack->files[i].name);
+	}
+
+	if (!numnames)
+	{
+		Con_Printf ("usage: imagebench [listfile | -] [passes]\nno tga or pcx files found\n");
+		free (names);
+		return;
+	}
+
+	readtime = maptime = 0;
+	memset (decodetime, 0, sizeof(decodetime));
+	memset (count, 0, sizeof(count));
+	memset (pixels, 0, sizeof(pixels));
+	bytes = nummapped = 0;
+
+	for (pass = 0; pass < passes; pass++)
+	{
+		for (i = 0; i < numnames; i++)
+		{
+			type = q_strcasecmp (COM_FileGetExtension (names[i]), "tga") ? IMAGE_PCX : IMAGE_TGA;
+
+			start = Sys_DoubleTime ();
+			length = COM_FOpenFile (names[i], &f, NULL);
+			file = f ? Image_ReadImage (f, length) : NULL;
+			readtime += Sys_DoubleTime () - start;
+			if (!file)
+				continue;
+
+			start = Sys_DoubleTime ();
+			COM_MapFile (names[i], &f, &mapped, NULL);
+			maptime += Sys_DoubleTime () - start;
+			if (f)
+				fclose (f);
+
+			start = Sys_DoubleTime ();
+			data = Image_DecodeImage (type, file, length, &width, &height);
+			decodetime[type] += Sys_DoubleTime () - start;
+
+			if (!pass)
+			{
+				count[type]++;
+				bytes += length;
+				if (data)
+					pixels[type] += width * height;
+				if (mapped)
+					nummapped++;
+			}
+			free (file);
+			free (data);
+		}
+	}
+
+	Con_Printf ("%i images (%i tga, %i pcx), %.1f MB of files, %.1f Mpixels, %i passes\n",
+			count[IMAGE_TGA] + count[IMAGE_PCX], count[IMAGE_TGA], count[IMAGE_PCX],
+			bytes / (1024.0 * 1024.0), (pixels[IMAGE_TGA] + pixels[IMAGE_PCX]) / 1e6, passes);
+	Con_Printf ("read   %7.2f ms  %6.1f MB/s\n", readtime * 1000.0 / passes,
+			bytes / (1024.0 * 1024.0) / q_max (readtime / passes, 1e-6));
+	Con_Printf ("map    %7.2f ms  %i of %i from pak mappings\n", maptime * 1000.0 / passes,
+			nummapped, count[IMAGE_TGA] + count[IMAGE_PCX]);
+	Con_Printf ("tga    %7.2f ms  %6.1f Mpixels/s\n", decodetime[IMAGE_TGA] * 1000.0 / passes,
+			pixels[IMAGE_TGA] / 1e6 / q_max (decodetime[IMAGE_TGA] / passes, 1e-6));
+	Con_Printf ("pcx    %7.2f ms  %6.1f Mpixels/s\n", decodetime[IMAGE_PCX] * 1000.0 / passes,
+			pixels[IMAGE_PCX] / 1e6 / q_max (decodetime[IMAGE_PCX] / passes, 1e-6));
+
+	free (names);
+}
+
+/*
+============
+Image_Init
+============
+*/
+void Image_Init (void)
+{
+	Cmd_AddCommand ("imagebench", Image_Benchmark_f);
+}
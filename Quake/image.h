@@ -25,11 +25,23 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 //image.h -- image reading / writing
 
-//be sure to free the hunk after using these loading functions
-byte *Image_LoadTGA (FILE *f, int *width, int *height);
-byte *Image_LoadPCX (FILE *f, int *width, int *height);
+enum imagetype_e {IMAGE_NONE, IMAGE_TGA, IMAGE_PCX};
+
+void Image_Init (void);
+
+//be sure to free the hunk after using this loading function
 byte *Image_LoadImage (const char *name, int *width, int *height);
 
+//split up loading, so that reading and decoding can be done on worker
+//threads. these return malloc'd data. files inside paks are mapped
+//rather than read.
+int Image_OpenImage (const char *name, FILE **f, const byte **data, int *length);
+byte *Image_ReadImage (FILE *f, int length);
+qboolean Image_ImageSize (int type, FILE *f, const byte *data, int length, int *width, int *height);
+byte *Image_DecodeImage (int type, const byte *data, int length, int *width, int *height);
+byte *Image_DecodeTGA (const byte *data, int size, int *width, int *height);
+byte *Image_DecodePCX (const byte *data, int size, int *width, int *height);
+
 qboolean Image_WriteTGA (const char *name, byte *data, int width, int height, int bpp, qboolean upsidedown);
 
 #endif	/* __GL_IMAGE_H */
@@ -87,7 +87,11 @@ static void Sys_InitSDL (void)
 	atexit(Sys_AtExit);
 }
 
+#if defined(_WIN64) || defined(_LP64) || defined(__LP64__)
+#define DEFAULT_MEMORY (1024 * 1024 * 1024) // only reserved, the hunk commits what it uses
+#else
 #define DEFAULT_MEMORY (256 * 1024 * 1024) // ericw -- was 72MB (64-bit) / 64MB (32-bit)
+#endif
 
 static quakeparms_t	parms;
 
@@ -124,7 +128,10 @@ int main(int argc, char *argv[])
 			parms.memsize = Q_atoi(com_argv[t]) * 1024;
 	}
 
-	parms.membase = malloc (parms.memsize);
+	parms.membase = Sys_ReserveMemory (parms.memsize);
+	parms.memreserved = (parms.membase != NULL);
+	if (!parms.memreserved)
+		parms.membase = malloc (parms.memsize);
 
 	if (!parms.membase)
 		Sys_Error ("Not enough memory free; check disk space\n");
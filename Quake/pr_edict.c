@@ -727,6 +727,318 @@ void ED_ParseGlobals (const char *data)
 	}
 }
 
+/*
+==============================================================================
+
+BINARY SNAPSHOTS
+
+For binary savegames the edict fields and the globals are copied in blocks.
+Entity references become edict numbers, and strings that aren't in
+progs.dat go into a table, so a snapshot loads into any server running
+the same progs.dat. Layout after the edsnapshot_t: a free flag and an
+alpha byte per edict, padded to 4 bytes, the fields of every edict, the
+globals, and the strings.
+==============================================================================
+*/
+
+typedef struct
+{
+	int		progscrc;
+	int		entityfields;	// ints per edict
+	int		numglobals;
+	int		num_edicts;
+	int		numstrings;
+	int		stringsize;
+} edsnapshot_t;
+
+typedef struct
+{
+	int		*ofs;		// of string and entity fields, then globals
+	byte		*isstring;
+	int		numfields, numglobals;
+} edfixups_t;
+
+/*
+=============
+ED_GetFixups -- the string and entity fields, and the saved string and entity globals
+=============
+*/
+static void ED_GetFixups (edfixups_t *fix)
+{
+	int	i, type, count;
+
+	count = progs->numfielddefs + progs->numglobaldefs;
+	fix->ofs = (int *) malloc (count * sizeof(int));
+	fix->isstring = (byte *) malloc (count);
+	if (!fix->ofs || !fix->isstring)
+		Sys_Error ("ED_GetFixups: out of memory");
+
+	fix->numfields = 0;
+	for (i = 1; i < progs->numfielddefs; i++)
+	{
+		type = pr_fielddefs[i].type & ~DEF_SAVEGLOBAL;
+		if (type != ev_string && type != ev_entity)
+			continue;
+		fix->isstring[fix->numfields] = (type == ev_string);
+		fix->ofs[fix->numfields++] = pr_fielddefs[i].ofs;
+	}
+
+	fix->numglobals = 0;
+	for (i = 0; i < progs->numglobaldefs; i++)
+	{
+		type = pr_globaldefs[i].type;
+		if (!(type & DEF_SAVEGLOBAL))
+			continue;
+		type &= ~DEF_SAVEGLOBAL;
+		if (type != ev_string && type != ev_entity && type != ev_float)
+			continue;
+		fix->isstring[fix->numfields + fix->numglobals] = (type == ev_string) + 2 * (type == ev_float);
+		fix->ofs[fix->numfields + fix->numglobals++] = pr_globaldefs[i].ofs;
+	}
+}
+
+/*
+=============
+ED_SaveValue -- turns an entity reference into an edict number, and a string outside progs.dat into a table index
+=============
+*/
+static int ED_SaveValue (int value, int isstring, int *tableindex, char **table, int *tablesize, int *tablemax, int *numstrings)
+{
+	const char	*str;
+	int		len, known;
+
+	if (!isstring)
+		return value / pr_edict_size;
+	if (value >= 0)
+		return value < pr_stringssize ? value : 0;
+
+	known = -1 - value;
+	if (known >= pr_numknownstrings || !pr_knownstrings[known])
+		return 0;
+	if (tableindex[known] < 0)
+	{
+		str = pr_knownstrings[known];
+		len = strlen (str) + 1;
+		if (*tablesize + len > *tablemax)
+		{
+			*tablemax = q_max (*tablemax * 2, *tablesize + len);
+			*table = (char *) realloc (*table, *tablemax);
+			if (!*table)
+				Sys_Error ("ED_SaveValue: out of memory");
+		}
+		memcpy (*table + *tablesize, str, len);
+		*tablesize += len;
+		tableindex[known] = (*numstrings)++;
+	}
+	return -1 - tableindex[known];
+}
+
+/*
+=============
+ED_SaveSnapshot -- returns a malloced snapshot of the edicts and globals
+=============
+*/
+void *ED_SaveSnapshot (int *size)
+{
+	edsnapshot_t	head;
+	edfixups_t	fix;
+	edict_t		*ent;
+	byte		*data, *flags;
+	int		*fields, *v, *tableindex;
+	char		*table;
+	int		i, j, flagsize, fieldsize, tablesize, tablemax;
+
+	ED_GetFixups (&fix);
+	tableindex = (int *) malloc (q_max (pr_numknownstrings, 1) * sizeof(int));
+	tablemax = 4096;
+	table = (char *) malloc (tablemax);
+	if (!tableindex || !table)
+		Sys_Error ("ED_SaveSnapshot: out of memory");
+	for (i = 0; i < pr_numknownstrings; i++)
+		tableindex[i] = -1;
+	tablesize = 0;
+
+	head.progscrc = pr_crc;
+	head.entityfields = progs->entityfields;
+	head.numglobals = progs->numglobals;
+	head.num_edicts = sv.num_edicts;
+	head.numstrings = 0;
+
+	flagsize = (sv.num_edicts * 2 + 3) & ~3;
+	fieldsize = sv.num_edicts * progs->entityfields * 4;
+	data = (byte *) malloc (sizeof(head) + flagsize + fieldsize + progs->numglobals * 4);
+	if (!data)
+		Sys_Error ("ED_SaveSnapshot: out of memory");
+	flags = data + sizeof(head);
+	fields = (int *) (flags + flagsize);
+	memset (flags, 0, flagsize);
+
+	for (i = 0; i < sv.num_edicts; i++)
+	{
+		ent = EDICT_NUM(i);
+		v = fields + i * progs->entityfields;
+		flags[i] = ent->free;
+		flags[sv.num_edicts + i] = ent->alpha;
+		if (ent->free)
+		{
+			memset (v, 0, progs->entityfields * 4);
+			continue;
+		}
+		memcpy (v, &ent->v, progs->entityfields * 4);
+		for (j = 0; j < fix.numfields; j++)
+			v[fix.ofs[j]] = ED_SaveValue (v[fix.ofs[j]], fix.isstring[j], tableindex, &table, &tablesize, &tablemax, &head.numstrings);
+	}
+
+	v = fields + sv.num_edicts * progs->entityfields;
+	memcpy (v, pr_globals, progs->numglobals * 4);
+	for (j = fix.numfields; j < fix.numfields + fix.numglobals; j++)
+	{
+		if (fix.isstring[j] < 2)
+			v[fix.ofs[j]] = ED_SaveValue (v[fix.ofs[j]], fix.isstring[j], tableindex, &table, &tablesize, &tablemax, &head.numstrings);
+	}
+
+	head.stringsize = tablesize;
+	memcpy (data, &head, sizeof(head));
+	*size = sizeof(head) + flagsize + fieldsize + progs->numglobals * 4 + tablesize;
+	data = (byte *) realloc (data, *size);
+	if (!data)
+		Sys_Error ("ED_SaveSnapshot: out of memory");
+	memcpy (data + *size - tablesize, table, tablesize);
+
+	free (table);
+	free (tableindex);
+	free (fix.ofs);
+	free (fix.isstring);
+	return data;
+}
+
+/*
+=============
+ED_SnapshotCRC -- the progs.dat crc a snapshot was made with, or -1 if it's not one
+=============
+*/
+int ED_SnapshotCRC (const void *data, int size)
+{
+	edsnapshot_t	head;
+
+	if (size < (int) sizeof(head))
+		return -1;
+	memcpy (&head, data, sizeof(head));
+	return head.progscrc;
+}
+
+/*
+=============
+ED_LoadSnapshot -- restores the edicts and the saved globals into a freshly spawned server
+
+one block copy per edict, then the string and entity fixups
+=============
+*/
+qboolean ED_LoadSnapshot (const void *data, int size)
+{
+	edsnapshot_t	head;
+	edfixups_t	fix;
+	edict_t		*ent;
+	const byte	*flags;
+	const int	*fields;
+	const char	*table, *str;
+	char		*copy;
+	string_t	*strings;
+	int		*v, *globals;
+	int		i, j, value, len, flagsize, fieldsize;
+
+	if (size < (int) sizeof(head))
+		return false;
+	memcpy (&head, data, sizeof(head));
+	if (head.progscrc != pr_crc || head.entityfields != progs->entityfields || head.numglobals != progs->numglobals)
+	{
+		Con_Printf ("Savegame was made with a different progs.dat\n");
+		return false;
+	}
+	if (head.num_edicts < 1 || head.num_edicts > sv.max_edicts)
+	{
+		Con_Printf ("Savegame has %i edicts, max_edicts is %i\n", head.num_edicts, sv.max_edicts);
+		return false;
+	}
+	flagsize = (head.num_edicts * 2 + 3) & ~3;
+	fieldsize = head.num_edicts * head.entityfields * 4;
+	if (head.numstrings < 0 || head.stringsize < 0 ||
+	    size != (int) sizeof(head) + flagsize + fieldsize + head.numglobals * 4 + head.stringsize)
+	{
+		Con_Printf ("Savegame is truncated\n");
+		return false;
+	}
+
+	flags = (const byte *) data + sizeof(head);
+	fields = (const int *) (flags + flagsize);
+	table = (const char *) data + size - head.stringsize;
+
+// copy the strings into the progs string space, once each
+	strings = (string_t *) malloc (q_max (head.numstrings, 1) * sizeof(string_t));
+	if (!strings)
+		Sys_Error ("ED_LoadSnapshot: out of memory");
+	for (i = 0, str = table; i < head.numstrings; i++)
+	{
+		if (str >= table + head.stringsize || !memchr (str, 0, table + head.stringsize - str))
+		{
+			free (strings);
+			Con_Printf ("Savegame has bad strings\n");
+			return false;
+		}
+		len = strlen (str) + 1;
+		strings[i] = PR_AllocString (len, &copy);
+		memcpy (copy, str, len);
+		str += len;
+	}
+
+	ED_GetFixups (&fix);
+	for (i = 0; i < head.num_edicts; i++)
+	{
+		ent = EDICT_NUM(i);
+		v = (int *) &ent->v;
+		ent->alpha = flags[head.num_edicts + i];
+		if (flags[i])
+		{
+			memset (v, 0, progs->entityfields * 4);
+			ent->free = true;
+			continue;
+		}
+		memcpy (v, fields + i * head.entityfields, progs->entityfields * 4);
+		ent->free = false;
+
+		for (j = 0; j < fix.numfields; j++)
+		{
+			value = v[fix.ofs[j]];
+			if (!fix.isstring[j])
+				value = EDICT_TO_PROG(EDICT_NUM(CLAMP(0, value, head.num_edicts - 1)));
+			else if (value < 0)
+				value = (-1 - value < head.numstrings) ? strings[-1 - value] : 0;
+			v[fix.ofs[j]] = value;
+		}
+
+	// link it into the bsp tree
+		SV_LinkEdict (ent, false);
+	}
+	sv.num_edicts = head.num_edicts;
+
+	globals = (int *) pr_globals;
+	v = (int *) (fields + head.num_edicts * head.entityfields);
+	for (j = fix.numfields; j < fix.numfields + fix.numglobals; j++)
+	{
+		memcpy (&value, &v[fix.ofs[j]], 4);
+		if (fix.isstring[j] == 0)
+			value = EDICT_TO_PROG(EDICT_NUM(CLAMP(0, value, head.num_edicts - 1)));
+		else if (fix.isstring[j] == 1 && value < 0)
+			value = (-1 - value < head.numstrings) ? strings[-1 - value] : 0;
+		globals[fix.ofs[j]] = value;
+	}
+
+	free (strings);
+	free (fix.ofs);
+	free (fix.isstring);
+	return true;
+}
+
 //============================================================================
 
 
@@ -89,6 +89,10 @@ const char *ED_ParseEdict (const char *data, edict_t *ent);
 void ED_WriteGlobals (FILE *f);
 void ED_ParseGlobals (const char *data);
 
+void *ED_SaveSnapshot (int *size);	/* malloced */
+int ED_SnapshotCRC (const void *data, int size);
+qboolean ED_LoadSnapshot (const void *data, int size);
+
 void ED_LoadFromFile (const char *data);
 
 /*
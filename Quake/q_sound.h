@@ -111,12 +111,31 @@ void S_EndPrecaching (void);
 void S_PaintChannels (int endtime);
 void S_InitPaintChannels (void);
 
+/* mixer throughput counters, reported at the end of a timedemo */
+void S_ResetMixStats (void);
+void S_PrintMixStats (void);
+
 /* picks a channel based on priorities, empty slots, number of channels */
 channel_t *SND_PickChannel (int entnum, int entchannel);
 
 /* spatializes a channel */
 void SND_Spatialize (channel_t *ch);
 
+/* moves the play position of a channel that isn't mixed up to endtime */
+void SND_SyncChannel (channel_t *ch, int endtime);
+
+/* binaural spatialization of dynamic channels (snd_hrtf.c) */
+void SND_HRTF_Init (void);
+void SND_HRTF_Update (void);
+qboolean SND_HRTF_Enabled (void);
+qboolean SND_HRTF_Spatialize (channel_t *ch, vec3_t dir);
+qboolean SND_HRTF_IsVoice (channel_t *ch);
+void SND_HRTF_ResetChannel (channel_t *ch);
+void SND_HRTF_PaintChannel (channel_t *ch, sfxcache_t *sc, int count, int ltime, portable_samplepair_t *out);
+
+/* head orientation from the HMD, overrides the listener's for the HRTF */
+void S_SetHeadOrientation (vec3_t angles);
+
 /* music stream support */
 void S_RawSamples(int samples, int rate, int width, int channels, byte * data, float volume);
 				/* Expects data in signed 16 bit, or unsigned 8 bit format. */
@@ -183,6 +202,7 @@ extern	cvar_t		bgmvolume;
 
 void S_LocalSound (const char *name);
 sfxcache_t *S_LoadSound (sfx_t *s);
+void S_LoadSounds (sfx_t **sfx, int count);	/* loads a batch in parallel */
 
 wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength);
 
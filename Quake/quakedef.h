@@ -193,6 +193,7 @@ typedef struct
 	char	**argv;
 	void	*membase;
 	int	memsize;
+	qboolean	memreserved;	// membase is address space, committed on demand
 	int	numcpus;
 } quakeparms_t;
 
@@ -249,6 +250,8 @@ typedef struct
 #include "keys.h"
 #include "menu.h"
 #include "cdaudio.h"
+#include "tasks.h"
+#include "diskcache.h"
 #include "glquake.h"
 
 
@@ -290,6 +293,7 @@ void Host_Frame (float time);
 void Host_Quit_f (void);
 void Host_ClientCommands (const char *fmt, ...) __attribute__((__format__(__printf__,1,2)));
 void Host_ShutdownServer (qboolean crash);
+void Host_SaveFinished (qboolean wait);
 void Host_WriteConfiguration (void);
 
 void ExtraMaps_Init (void);
@@ -25,6 +25,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 
 extern cvar_t r_drawflat, gl_overbright_models, gl_fullbrights, r_lerpmodels, r_lerpmove; //johnfitz
+extern cvar_t r_instancing;
 
 //up to 16 color translated skins
 gltexture_t *playertextures[MAX_SCOREBOARD]; //johnfitz -- changed to an array of pointers
@@ -85,6 +86,25 @@ static const GLint pose2VertexAttrIndex = 2;
 static const GLint pose2NormalAttrIndex = 3;
 static const GLint texCoordsAttrIndex = 4;
 
+// instanced alias models
+static GLuint r_alias_instanced_program;
+
+static GLuint instTexLoc;
+static GLuint instFullbrightTexLoc;
+static GLuint instUseFullbrightTexLoc;
+static GLuint instUseOverbrightLoc;
+static GLuint instPoseTexLoc;
+static GLuint instPoseTexSizeLoc;
+
+static const GLint instTexCoordsAttrIndex = 0;	// per vertex
+static const GLint instVertNumAttrIndex = 1;
+static const GLint instRow0AttrIndex = 2;	// per instance, see aliasinstance_t
+static const GLint instRow1AttrIndex = 3;
+static const GLint instRow2AttrIndex = 4;
+static const GLint instPoseAttrIndex = 5;
+static const GLint instLightAttrIndex = 6;
+static const GLint instShadeAttrIndex = 7;
+
 /*
 =============
 GLARB_GetXYZOffset
@@ -187,6 +207,68 @@ void GLAlias_CreateShaders (void)
 		"	gl_FragColor = result;\n"
 		"}\n";
 
+	const glsl_attrib_binding_t instbindings[] = {
+		{ "TexCoords", instTexCoordsAttrIndex },
+		{ "VertNum", instVertNumAttrIndex },
+		{ "InstanceRow0", instRow0AttrIndex },
+		{ "InstanceRow1", instRow1AttrIndex },
+		{ "InstanceRow2", instRow2AttrIndex },
+		{ "InstancePose", instPoseAttrIndex },
+		{ "InstanceLight", instLightAttrIndex },
+		{ "InstanceShade", instShadeAttrIndex }
+	};
+
+	// same lighting as above, but the poses are read from the pose texture,
+	// and everything that varies per entity comes from the instance attributes
+	const GLchar *instVertSource = \
+		"#version 110\n"
+		"\n"
+		"uniform sampler2D PoseTex;\n"
+		"uniform vec4 PoseTexSize; // width, height, 1/width, 1/height\n"
+		"attribute vec4 TexCoords; // only xy are used \n"
+		"attribute float VertNum;\n"
+		"attribute vec4 InstanceRow0;\n"
+		"attribute vec4 InstanceRow1;\n"
+		"attribute vec4 InstanceRow2;\n"
+		"attribute vec4 InstancePose; // first texel of pose 1, of pose 2, blend\n"
+		"attribute vec4 InstanceLight;\n"
+		"attribute vec3 InstanceShade;\n"
+		"float r_avertexnormal_dot(vec3 vertexnormal) // from MH \n"
+		"{\n"
+		"        float dot = dot(vertexnormal, InstanceShade);\n"
+		"        // wtf - this reproduces anorm_dots within as reasonable a degree of tolerance as the >= 0 case\n"
+		"        if (dot < 0.0)\n"
+		"            return 1.0 + dot * (13.0 / 44.0);\n"
+		"        else\n"
+		"            return 1.0 + dot;\n"
+		"}\n"
+		"vec4 PoseTexel(float texel)\n"
+		"{\n"
+		"	float row = floor(texel * PoseTexSize.z);\n"
+		"	return texture2DLod(PoseTex, vec2(texel - row * PoseTexSize.x + 0.5, row + 0.5) * PoseTexSize.zw, 0.0);\n"
+		"}\n"
+		"vec3 PoseNormal(vec4 texel) // the signed bytes of meshxyz_t.normal\n"
+		"{\n"
+		"	vec3 n = floor(texel.xyz * 255.0 + 0.5);\n"
+		"	return (n - step(128.0, n) * 256.0) / 127.0;\n"
+		"}\n"
+		"void main()\n"
+		"{\n"
+		"	float texel = VertNum * 2.0;\n"
+		"	vec3 pose1Vert = floor(PoseTexel(InstancePose.x + texel).xyz * 255.0 + 0.5);\n"
+		"	vec3 pose2Vert = floor(PoseTexel(InstancePose.y + texel).xyz * 255.0 + 0.5);\n"
+		"	vec4 lerpedVert = vec4(mix(pose1Vert, pose2Vert, InstancePose.z), 1.0);\n"
+		"	vec4 worldVert = vec4(dot(InstanceRow0, lerpedVert), dot(InstanceRow1, lerpedVert), dot(InstanceRow2, lerpedVert), 1.0);\n"
+		"	gl_TexCoord[0] = TexCoords;\n"
+		"	gl_Position = gl_ModelViewProjectionMatrix * worldVert;\n"
+		"	float dot1 = r_avertexnormal_dot(PoseNormal(PoseTexel(InstancePose.x + texel + 1.0)));\n"
+		"	float dot2 = r_avertexnormal_dot(PoseNormal(PoseTexel(InstancePose.y + texel + 1.0)));\n"
+		"	gl_FrontColor = InstanceLight * vec4(vec3(mix(dot1, dot2, InstancePose.z)), 1.0);\n"
+		"	// fog\n"
+		"	vec3 ecPosition = vec3(gl_ModelViewMatrix * worldVert);\n"
+		"	gl_FogFragCoord = abs(ecPosition.z);\n"
+		"}\n";
+
 	if (!gl_glsl_alias_able)
 		return;
 
@@ -203,6 +285,22 @@ void GLAlias_CreateShaders (void)
 		useFullbrightTexLoc = GL_GetUniformLocation (&r_alias_program, "UseFullbrightTex");
 		useOverbrightLoc = GL_GetUniformLocation (&r_alias_program, "UseOverbright");
 	}
+
+	if (!gl_instancing_able)
+		return;
+
+	r_alias_instanced_program = GL_CreateProgram (instVertSource, fragSource, sizeof(instbindings)/sizeof(instbindings[0]), instbindings);
+
+	if (r_alias_instanced_program != 0)
+	{
+	// get uniform locations
+		instTexLoc = GL_GetUniformLocation (&r_alias_instanced_program, "Tex");
+		instFullbrightTexLoc = GL_GetUniformLocation (&r_alias_instanced_program, "FullbrightTex");
+		instUseFullbrightTexLoc = GL_GetUniformLocation (&r_alias_instanced_program, "UseFullbrightTex");
+		instUseOverbrightLoc = GL_GetUniformLocation (&r_alias_instanced_program, "UseOverbright");
+		instPoseTexLoc = GL_GetUniformLocation (&r_alias_instanced_program, "PoseTex");
+		instPoseTexSizeLoc = GL_GetUniformLocation (&r_alias_instanced_program, "PoseTexSize");
+	}
 }
 
 /*
@@ -271,6 +369,7 @@ void GL_DrawAliasFrame_GLSL (aliashdr_t *paliashdr, lerpdata_t lerpdata, gltextu
 
 // draw
 	glDrawElements (GL_TRIANGLES, paliashdr->numindexes, GL_UNSIGNED_SHORT, (void *)(intptr_t)currententity->model->vboindexofs);
+	rs_drawcalls++;
 
 // clean up
 	GL_DisableVertexAttribArrayFunc (texCoordsAttrIndex);
@@ -285,6 +384,419 @@ void GL_DrawAliasFrame_GLSL (aliashdr_t *paliashdr, lerpdata_t lerpdata, gltextu
 	rs_aliaspasses += paliashdr->numtris;
 }
 
+/*
+=============================================================
+
+  INSTANCED ALIAS MODELS
+
+All the poses of the alias models in view are packed into one RGBA8
+texture, two texels per vertex laid out like meshxyz_t, and read back in
+the vertex shader. R_DrawAliasModel queues the opaque entities it can
+draw this way, and R_FlushAliasInstances sorts them by model and skin,
+then draws each run with one instanced call. Transform, poses, blend and
+lighting come from a per-instance attribute buffer.
+
+=============================================================
+*/
+
+#define	POSETEX_MAX_WIDTH	4096
+#define	POSETEX_MIN_HEIGHT	256
+#define	POSETEX_MAX_TEXELS	(1 << 24)	// float texel numbers are exact up to here
+
+typedef struct
+{
+	float	rows[3][4];	// model to world, scale and scale_origin included
+	float	pose[4];	// first texel of pose 1, of pose 2, blend, unused
+	float	light[4];	// lightcolor, alpha
+	float	shade[4];	// shadevector, unused
+} aliasinstance_t;
+
+typedef struct
+{
+	entity_t	*e;
+	gltexture_t	*tx, *fb;
+	lerpdata_t	lerpdata;
+	vec3_t		lightcolor;
+	vec3_t		shadevector;
+} aliasqueued_t;
+
+static GLuint	r_posetexture;
+static int	r_posetexwidth, r_posetexheight, r_posetexmaxheight;
+static int	r_poserowsused;
+static int	r_posegeneration = 1;
+
+static GLuint	r_vertnumvbo;
+static GLuint	r_instancevbo;
+
+static aliasqueued_t	r_aliasqueue[MAX_VISEDICTS];
+static aliasinstance_t	r_aliasinstances[MAX_VISEDICTS];
+static int	r_numaliasqueued;
+
+/*
+=============
+GLAlias_PoseTexels -- texels a model takes in the pose texture
+=============
+*/
+static int GLAlias_PoseTexels (const aliashdr_t *hdr)
+{
+	return hdr->numposes * hdr->numverts_vbo * (sizeof (meshxyz_t) / 4);
+}
+
+/*
+=============
+GLAlias_CreatePoseTexture -- (re)allocates an empty pose texture of the given height
+=============
+*/
+static void GLAlias_CreatePoseTexture (int height)
+{
+	GLint	maxsize;
+
+	if (!r_posetexture)
+	{
+		glGetIntegerv (GL_MAX_TEXTURE_SIZE, &maxsize);
+		r_posetexwidth = q_min (maxsize, POSETEX_MAX_WIDTH);
+		r_posetexmaxheight = q_min (maxsize, POSETEX_MAX_TEXELS / r_posetexwidth);
+		glGenTextures (1, &r_posetexture);
+	}
+
+	r_posetexheight = q_min (height, r_posetexmaxheight);
+	r_poserowsused = 0;
+	r_posegeneration++;
+
+	GL_SelectTexture (GL_TEXTURE2);
+	glBindTexture (GL_TEXTURE_2D, r_posetexture);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, r_posetexwidth, r_posetexheight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	GL_ClearBindings ();
+	GL_SelectTexture (GL_TEXTURE0);
+}
+
+/*
+=============
+GLAlias_AddPoses -- uploads the poses of a model to the pose texture, if they aren't there yet
+
+when the texture is full it's doubled in height, or started over at the
+largest size, so callers must check r_posegeneration afterwards
+=============
+*/
+static void GLAlias_AddPoses (qmodel_t *m, const aliashdr_t *hdr)
+{
+	byte	*vbodata;
+	int	size, texels, rows, full;
+
+	if (m->posegeneration == r_posegeneration)
+		return;
+
+	texels = GLAlias_PoseTexels (hdr);
+	rows = (texels + r_posetexwidth - 1) / r_posetexwidth;
+	if (r_poserowsused + rows > r_posetexheight)
+		GLAlias_CreatePoseTexture (q_max (r_posetexheight * 2, rows));
+
+	vbodata = GLMesh_BuildVertexData (m, hdr, &size);
+	if (!vbodata)
+		return;
+
+	GL_SelectTexture (GL_TEXTURE2);
+	glBindTexture (GL_TEXTURE_2D, r_posetexture);
+	full = texels / r_posetexwidth;
+	if (full)
+		glTexSubImage2D (GL_TEXTURE_2D, 0, 0, r_poserowsused, r_posetexwidth, full, GL_RGBA, GL_UNSIGNED_BYTE, vbodata + m->vboxyzofs);
+	if (texels % r_posetexwidth)
+		glTexSubImage2D (GL_TEXTURE_2D, 0, 0, r_poserowsused + full, texels % r_posetexwidth, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+				vbodata + m->vboxyzofs + full * r_posetexwidth * 4);
+	GL_ClearBindings ();
+	GL_SelectTexture (GL_TEXTURE0);
+	free (vbodata);
+
+	m->posetexel = r_poserowsused * r_posetexwidth;
+	m->posegeneration = r_posegeneration;
+	r_poserowsused += rows;
+}
+
+/*
+=============
+GLAlias_CreateBuffers
+=============
+*/
+static void GLAlias_CreateBuffers (void)
+{
+	float	vertnums[MAXALIASTRIS * 3];
+	int	i;
+
+	for (i = 0; i < MAXALIASTRIS * 3; i++)
+		vertnums[i] = i;
+
+	GL_GenBuffersFunc (1, &r_vertnumvbo);
+	GL_BindBuffer (GL_ARRAY_BUFFER, r_vertnumvbo);
+	GL_BufferDataFunc (GL_ARRAY_BUFFER, sizeof(vertnums), vertnums, GL_STATIC_DRAW);
+
+	GL_GenBuffersFunc (1, &r_instancevbo);
+	GL_BindBuffer (GL_ARRAY_BUFFER, r_instancevbo);
+	GL_BufferDataFunc (GL_ARRAY_BUFFER, sizeof(r_aliasinstances), NULL, GL_STREAM_DRAW);
+
+	GL_BindBuffer (GL_ARRAY_BUFFER, 0);
+}
+
+/*
+=============
+GLAlias_DeleteObjects -- called on vid_restart, everything is recreated on demand
+=============
+*/
+void GLAlias_DeleteObjects (void)
+{
+	if (r_posetexture)
+		glDeleteTextures (1, &r_posetexture);
+	r_posetexture = 0;
+	r_posegeneration++;
+
+	if (r_vertnumvbo)
+		GL_DeleteBuffersFunc (1, &r_vertnumvbo);
+	if (r_instancevbo)
+		GL_DeleteBuffersFunc (1, &r_instancevbo);
+	r_vertnumvbo = r_instancevbo = 0;
+
+	r_alias_instanced_program = 0;	// deleted with the other programs
+	r_numaliasqueued = 0;
+}
+
+/*
+=============
+GLAlias_ResetPoses -- called on a new map, so the models of the last one don't pile up
+=============
+*/
+void GLAlias_ResetPoses (void)
+{
+	r_poserowsused = 0;
+	r_posegeneration++;
+}
+
+/*
+=============
+R_QueueAliasInstance -- returns false if the entity has to be drawn the usual way
+=============
+*/
+static qboolean R_QueueAliasInstance (entity_t *e, aliashdr_t *paliashdr, lerpdata_t *lerpdata, gltexture_t *tx, gltexture_t *fb)
+{
+	aliasqueued_t	*q;
+
+	if (!r_instancing.value || !r_alias_instanced_program)
+		return false;
+	if (r_drawflat_cheatsafe || r_fullbright_cheatsafe || r_lightmap_cheatsafe)
+		return false;
+	if (entalpha < 1 || e == &cl.viewent || !e->model->meshvbo)
+		return false;
+	if (r_numaliasqueued == MAX_VISEDICTS || paliashdr->numverts_vbo > MAXALIASTRIS * 3)
+		return false;
+
+	if (!r_posetexture)
+		GLAlias_CreatePoseTexture (POSETEX_MIN_HEIGHT);
+	if (!r_vertnumvbo)
+		GLAlias_CreateBuffers ();
+	if (GLAlias_PoseTexels (paliashdr) > r_posetexwidth * r_posetexmaxheight / 2)
+		return false;	// would keep the texture from holding anything else
+
+	q = &r_aliasqueue[r_numaliasqueued++];
+	q->e = e;
+	q->tx = tx;
+	q->fb = fb;
+	q->lerpdata = *lerpdata;
+	VectorCopy (lightcolor, q->lightcolor);
+	VectorCopy (shadevector, q->shadevector);
+	return true;
+}
+
+/*
+=============
+R_CompareAliasInstances -- qsort callback, groups by model then skin
+=============
+*/
+static int R_CompareAliasInstances (const void *a, const void *b)
+{
+	const aliasqueued_t *qa = (const aliasqueued_t *) a;
+	const aliasqueued_t *qb = (const aliasqueued_t *) b;
+
+	if (qa->e->model != qb->e->model)
+		return (uintptr_t) qa->e->model < (uintptr_t) qb->e->model ? -1 : 1;
+	if (qa->tx != qb->tx)
+		return (uintptr_t) qa->tx < (uintptr_t) qb->tx ? -1 : 1;
+	if (qa->fb != qb->fb)
+		return (uintptr_t) qa->fb < (uintptr_t) qb->fb ? -1 : 1;
+	return 0;
+}
+
+/*
+=============
+R_FillAliasInstance -- the entity transform, then scale_origin and scale
+=============
+*/
+static void R_FillAliasInstance (aliasinstance_t *inst, const aliasqueued_t *q, const aliashdr_t *hdr)
+{
+	float	m[3][4];
+	float	blend;
+	int	i, j, posetexels;
+
+	R_EntityTransformRows (q->lerpdata.origin, q->lerpdata.angles, m);
+	for (i = 0; i < 3; i++)
+	{
+		inst->rows[i][3] = m[i][3];
+		for (j = 0; j < 3; j++)
+		{
+			inst->rows[i][j] = m[i][j] * hdr->scale[j];
+			inst->rows[i][3] += m[i][j] * hdr->scale_origin[j];
+		}
+	}
+
+	// poses the same means either 1. the entity has paused its animation, or 2. r_lerpmodels is disabled
+	blend = (q->lerpdata.pose1 != q->lerpdata.pose2) ? q->lerpdata.blend : 0;
+
+	posetexels = hdr->numverts_vbo * (sizeof (meshxyz_t) / 4);
+	inst->pose[0] = q->e->model->posetexel + q->lerpdata.pose1 * posetexels;
+	inst->pose[1] = q->e->model->posetexel + q->lerpdata.pose2 * posetexels;
+	inst->pose[2] = blend;
+	inst->pose[3] = 0;
+
+	inst->light[0] = q->lightcolor[0];
+	inst->light[1] = q->lightcolor[1];
+	inst->light[2] = q->lightcolor[2];
+	inst->light[3] = 1;
+
+	inst->shade[0] = q->shadevector[0];
+	inst->shade[1] = q->shadevector[1];
+	inst->shade[2] = q->shadevector[2];
+	inst->shade[3] = 0;
+}
+
+/*
+=============
+R_FlushAliasInstances -- draws everything R_DrawAliasModel queued
+=============
+*/
+void R_FlushAliasInstances (void)
+{
+	const GLint instattribs[] = {instRow0AttrIndex, instRow1AttrIndex, instRow2AttrIndex,
+			instPoseAttrIndex, instLightAttrIndex, instShadeAttrIndex};
+	aliasqueued_t	*q;
+	aliashdr_t	*hdr;
+	qmodel_t	*m;
+	int		i, j, first, count, generation, passes;
+
+	if (!r_numaliasqueued)
+		return;
+
+	qsort (r_aliasqueue, r_numaliasqueued, sizeof(aliasqueued_t), R_CompareAliasInstances);
+
+// get all the models into the pose texture. if it had to start over, the ones
+// added before are gone, so go again
+	for (passes = 0; passes < 3; passes++)
+	{
+		generation = r_posegeneration;
+		for (i = 0; i < r_numaliasqueued; i++)
+		{
+			if (i && r_aliasqueue[i].e->model == r_aliasqueue[i-1].e->model)
+				continue;
+			m = r_aliasqueue[i].e->model;
+			GLAlias_AddPoses (m, (aliashdr_t *) Mod_Extradata (m));
+		}
+		if (generation == r_posegeneration)
+			break;
+	}
+
+	for (i = 0; i < r_numaliasqueued; i++)
+	{
+		q = &r_aliasqueue[i];
+		hdr = (aliashdr_t *) Mod_Extradata (q->e->model);
+		R_FillAliasInstance (&r_aliasinstances[i], q, hdr);
+	}
+
+	GL_BindBuffer (GL_ARRAY_BUFFER, r_instancevbo);
+	GL_BufferDataFunc (GL_ARRAY_BUFFER, sizeof(r_aliasinstances), NULL, GL_STREAM_DRAW); // orphan last frame's
+	GL_BufferSubDataFunc (GL_ARRAY_BUFFER, 0, r_numaliasqueued * sizeof(aliasinstance_t), r_aliasinstances);
+
+	GL_UseProgramFunc (r_alias_instanced_program);
+	GL_Uniform1iFunc (instTexLoc, 0);
+	GL_Uniform1iFunc (instFullbrightTexLoc, 1);
+	GL_Uniform1iFunc (instPoseTexLoc, 2);
+	GL_Uniform4fFunc (instPoseTexSizeLoc, r_posetexwidth, r_posetexheight, 1.0f / r_posetexwidth, 1.0f / r_posetexheight);
+	GL_Uniform1fFunc (instUseOverbrightLoc, gl_overbright_models.value ? 1 : 0);
+
+	GL_SelectTexture (GL_TEXTURE2);
+	glBindTexture (GL_TEXTURE_2D, r_posetexture);
+	GL_ClearBindings ();
+
+	if (gl_smoothmodels.value)
+		glShadeModel (GL_SMOOTH);
+	if (gl_affinemodels.value)
+		glHint (GL_PERSPECTIVE_CORRECTION_HINT, GL_FASTEST);
+
+	GL_EnableVertexAttribArrayFunc (instTexCoordsAttrIndex);
+	GL_EnableVertexAttribArrayFunc (instVertNumAttrIndex);
+	for (j = 0; j < (int) (sizeof(instattribs)/sizeof(instattribs[0])); j++)
+	{
+		GL_EnableVertexAttribArrayFunc (instattribs[j]);
+		GL_VertexAttribDivisorFunc (instattribs[j], 1);
+	}
+
+	GL_BindBuffer (GL_ARRAY_BUFFER, r_vertnumvbo);
+	GL_VertexAttribPointerFunc (instVertNumAttrIndex, 1, GL_FLOAT, GL_FALSE, 0, (void *) 0);
+
+	for (first = 0; first < r_numaliasqueued; first += count)
+	{
+		q = &r_aliasqueue[first];
+		m = q->e->model;
+		for (count = 1; first + count < r_numaliasqueued; count++)
+		{
+			if (R_CompareAliasInstances (q, q + count))
+				break;
+		}
+		if (m->posegeneration != r_posegeneration)
+			continue; // didn't fit, which takes a frame with more poses than the largest texture holds
+
+		hdr = (aliashdr_t *) Mod_Extradata (m);
+
+		GL_BindBuffer (GL_ARRAY_BUFFER, m->meshvbo);
+		GL_BindBuffer (GL_ELEMENT_ARRAY_BUFFER, m->meshindexesvbo);
+		GL_VertexAttribPointerFunc (instTexCoordsAttrIndex, 2, GL_FLOAT, GL_FALSE, 0, (void *)(intptr_t)m->vbostofs);
+
+		GL_BindBuffer (GL_ARRAY_BUFFER, r_instancevbo);
+		for (j = 0; j < (int) (sizeof(instattribs)/sizeof(instattribs[0])); j++)
+			GL_VertexAttribPointerFunc (instattribs[j], 4, GL_FLOAT, GL_FALSE, sizeof(aliasinstance_t),
+					(void *)(intptr_t)(first * sizeof(aliasinstance_t) + j * 4 * sizeof(float)));
+
+		GL_Uniform1iFunc (instUseFullbrightTexLoc, (q->fb != NULL) ? 1 : 0);
+		GL_SelectTexture (GL_TEXTURE0);
+		GL_Bind (q->tx);
+		if (q->fb)
+		{
+			GL_SelectTexture (GL_TEXTURE1);
+			GL_Bind (q->fb);
+		}
+
+		GL_DrawElementsInstancedFunc (GL_TRIANGLES, hdr->numindexes, GL_UNSIGNED_SHORT, (void *)(intptr_t)m->vboindexofs, count);
+		rs_aliaspasses += hdr->numtris * count;
+		rs_drawcalls++;
+	}
+
+// clean up
+	for (j = 0; j < (int) (sizeof(instattribs)/sizeof(instattribs[0])); j++)
+	{
+		GL_VertexAttribDivisorFunc (instattribs[j], 0);
+		GL_DisableVertexAttribArrayFunc (instattribs[j]);
+	}
+	GL_DisableVertexAttribArrayFunc (instTexCoordsAttrIndex);
+	GL_DisableVertexAttribArrayFunc (instVertNumAttrIndex);
+
+	GL_UseProgramFunc (0);
+	GL_ClearBufferBindings ();
+	GL_SelectTexture (GL_TEXTURE0);
+	glHint (GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
+	glShadeModel (GL_FLAT);
+
+	r_numaliasqueued = 0;
+}
+
 /*
 =============
 GL_DrawAliasFrame -- johnfitz -- rewritten to support colored light, lerping, entalpha, multitexture, and r_drawflat
@@ -391,6 +903,7 @@ void GL_DrawAliasFrame (aliashdr_t *paliashdr, lerpdata_t lerpdata)
 		} while (--count);
 
 		glEnd ();
+		rs_drawcalls++;
 	}
 
 	rs_aliaspasses += paliashdr->numtris;
@@ -703,7 +1216,9 @@ void R_DrawAliasModel (entity_t *e)
 	//
 	// draw it
 	//
-	if (r_drawflat_cheatsafe)
+	if (R_QueueAliasInstance (e, paliashdr, &lerpdata, tx, fb))
+		goto cleanup;
+	else if (r_drawflat_cheatsafe)
 	{
 		glDisable (GL_TEXTURE_2D);
 		GL_DrawAliasFrame (paliashdr, lerpdata);
@@ -980,3 +1495,99 @@ void R_DrawAliasModel_ShowTris (entity_t *e)
 	glPopMatrix ();
 }
 
+
+/*
+=================
+R_AliasBench_f -- aliasbench [passes]
+
+draws the vbo of every loaded alias model into the back buffer, which is
+never shown, with color and depth writes off so the vertex work dominates.
+reports the vertex cache miss ratio of the index buffers and the vertex
+throughput.
+=================
+*/
+void R_AliasBench_f (void)
+{
+	entity_t	ent, *oldentity;
+	lerpdata_t	lerpdata;
+	aliashdr_t	*hdr;
+	qmodel_t	*m;
+	int		passes, pass, i, count, tris, indexes;
+	float	misses;
+	double	start, time;
+
+	if (cls.state != ca_connected)
+	{
+		Con_Printf ("Not connected to a server\n");
+		return;
+	}
+	if (!gl_glsl_alias_able || !r_alias_program)
+	{
+		Con_Printf ("aliasbench needs GLSL alias models\n");
+		return;
+	}
+
+	passes = (Cmd_Argc () > 1) ? q_max (atoi (Cmd_Argv (1)), 1) : 100;
+
+	memset (&ent, 0, sizeof(ent));
+	memset (&lerpdata, 0, sizeof(lerpdata));
+	oldentity = currententity;
+	currententity = &ent;
+	shadevector[0] = shadevector[2] = 1;
+	shadevector[1] = 0;
+	lightcolor[0] = lightcolor[1] = lightcolor[2] = 1;
+	entalpha = 1;
+	overbright = false;
+
+	count = tris = indexes = 0;
+	misses = 0;
+	for (i = 1; i < MAX_MODELS; i++)
+	{
+		if (!(m = cl.model_precache[i]))
+			break;
+		if (m->type != mod_alias || !m->meshvbo)
+			continue;
+		hdr = (aliashdr_t *) Mod_Extradata (m);
+		count++;
+		tris += hdr->numtris;
+		indexes += hdr->numindexes;
+		misses += GLMesh_ACMR ((unsigned short *) ((byte *) hdr + hdr->indexes), hdr->numindexes, hdr->numverts_vbo) * hdr->numtris;
+	}
+
+	if (!count)
+	{
+		currententity = oldentity;
+		Con_Printf ("no alias models loaded\n");
+		return;
+	}
+
+	glColorMask (GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask (GL_FALSE);
+	glFinish ();
+	start = Sys_DoubleTime ();
+
+	for (pass = 0; pass < passes; pass++)
+	{
+		for (i = 1; i < MAX_MODELS; i++)
+		{
+			if (!(m = cl.model_precache[i]))
+				break;
+			if (m->type != mod_alias || !m->meshvbo)
+				continue;
+			hdr = (aliashdr_t *) Mod_Extradata (m);
+			ent.model = m;
+			GL_DrawAliasFrame_GLSL (hdr, lerpdata, hdr->gltextures[0][0], NULL);
+		}
+	}
+
+	glFinish ();
+	time = q_max (Sys_DoubleTime () - start, 1e-6);
+	glColorMask (GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask (GL_TRUE);
+	currententity = oldentity;
+
+	Con_Printf ("%i models, %i triangles, %i passes, acmr %.3f\n", count, tris, passes, misses / tris);
+	Con_Printf ("%.2f ms  %.1f Mtris/s  %.1f Mverts/s indexed  %.1f Mverts/s transformed\n",
+			time * 1000.0, (double) tris * passes / time / 1e6,
+			(double) indexes * passes / time / 1e6, (double) misses * passes / time / 1e6);
+}
@@ -105,6 +105,7 @@ void DrawGLPoly (glpoly_t *p)
 		glVertex3fv (v);
 	}
 	glEnd ();
+	rs_drawcalls++;
 }
 
 /*
@@ -124,6 +125,7 @@ void DrawGLTriangleFan (glpoly_t *p)
 		glVertex3fv (v);
 	}
 	glEnd ();
+	rs_drawcalls++;
 }
 
 /*
@@ -231,6 +233,7 @@ void R_DrawSequentialPoly (msurface_t *s)
 			glVertex3fv (v);
 		}
 		glEnd ();
+		rs_drawcalls++;
 		if (!gl_overbright.value)
 		{
 			glColor3f(1,1,1);
@@ -345,6 +348,7 @@ void R_DrawSequentialPoly (msurface_t *s)
 				glVertex3fv (v);
 			}
 			glEnd ();
+			rs_drawcalls++;
 			glTexEnvf(GL_TEXTURE_ENV, GL_RGB_SCALE_EXT, 1.0f);
 			glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 			GL_DisableMultitexture ();
@@ -380,6 +384,7 @@ void R_DrawSequentialPoly (msurface_t *s)
 				glVertex3fv (v);
 			}
 			glEnd ();
+			rs_drawcalls++;
 			Fog_StopAdditive ();
 			rs_brushpasses++;
 
@@ -420,6 +425,7 @@ void R_DrawSequentialPoly (msurface_t *s)
 				glVertex3fv (v);
 			}
 			glEnd ();
+			rs_drawcalls++;
 			GL_DisableMultitexture ();
 			rs_brushpasses++;
 		}
@@ -453,6 +459,7 @@ void R_DrawSequentialPoly (msurface_t *s)
 				glVertex3fv (v);
 			}
 			glEnd ();
+			rs_drawcalls++;
 			Fog_StopAdditive ();
 			rs_brushpasses++;
 
@@ -555,6 +562,9 @@ void R_DrawBrushModel (entity_t *e)
 		}
 	}
 
+	if (R_QueueBrushInstance (e))
+		return;
+
 	glPushMatrix ();
 	e->angles[0] = -e->angles[0];	// stupid quake bug
 	if (gl_zfix.value)
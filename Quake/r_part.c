@@ -893,6 +893,7 @@ void R_DrawParticles (void)
 			rs_particles++; //johnfitz //FIXME: just use r_numparticles
 		}
 		glEnd ();
+		rs_drawcalls++;
 	}
 	else //johnitz --  triangles save verts
 	{
@@ -934,6 +935,7 @@ void R_DrawParticles (void)
 			rs_particles++; //johnfitz //FIXME: just use r_numparticles
 		}
 		glEnd ();
+		rs_drawcalls++;
 	}
 
 	glDepthMask (GL_TRUE); //johnfitz -- fix for particle z-buffer bug
@@ -992,6 +994,7 @@ void R_DrawParticles_ShowTris (void)
 			glVertex3fv (p_right);
 
 			glEnd ();
+			rs_drawcalls++;
 		}
 	}
 	else
@@ -1019,6 +1022,7 @@ void R_DrawParticles_ShowTris (void)
 			glVertex3fv (p_right);
 		}
 		glEnd ();
+		rs_drawcalls++;
 	}
 }
 
@@ -174,6 +174,7 @@ void R_DrawSpriteModel (entity_t *e)
 	glVertex3fv (point);
 
 	glEnd ();
+	rs_drawcalls++;
 	glDisable (GL_ALPHA_TEST);
 
 	//johnfitz: offset decals
@@ -25,11 +25,13 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 
 extern cvar_t gl_fullbrights, r_drawflat, gl_overbright, r_oldwater, r_oldskyleaf, r_showtris; //johnfitz
+extern cvar_t gl_zfix, r_instancing;
 
 extern glpoly_t	*lightmap_polys[MAX_LIGHTMAPS];
 
 byte *SV_FatPVS (vec3_t org, qmodel_t *worldmodel);
 extern byte mod_novis[MAX_MAP_LEAFS/8];
+extern GLuint gl_bmodel_vbo;
 int vis_changed; //if true, force pvs to be refreshed
 
 //==============================================================================
@@ -456,6 +458,7 @@ static void R_TriangleIndicesForSurf (msurface_t *s, unsigned int *dest)
 
 static unsigned int vbo_indices[MAX_BATCH_SIZE];
 static unsigned int num_vbo_indices;
+static int num_vbo_instances; // 0 unless R_DrawBrushInstances is batching
 
 /*
 ================
@@ -478,8 +481,12 @@ static void R_FlushBatch ()
 {
 	if (num_vbo_indices > 0)
 	{
-		glDrawElements (GL_TRIANGLES, num_vbo_indices, GL_UNSIGNED_INT, vbo_indices);
+		if (num_vbo_instances)
+			GL_DrawElementsInstancedFunc (GL_TRIANGLES, num_vbo_indices, GL_UNSIGNED_INT, vbo_indices, num_vbo_instances);
+		else
+			glDrawElements (GL_TRIANGLES, num_vbo_indices, GL_UNSIGNED_INT, vbo_indices);
 		num_vbo_indices = 0;
+		rs_drawcalls++;
 	}
 }
 
@@ -548,6 +555,7 @@ void R_DrawTextureChains_Multitexture (qmodel_t *model, entity_t *ent, texchain_
 					glVertex3fv (v);
 				}
 				glEnd ();
+				rs_drawcalls++;
 				rs_brushpasses++;
 			}
 		GL_DisableMultitexture(); // selects TEXTURE0
@@ -790,12 +798,12 @@ void R_DrawLightmapChains (void)
 				glVertex3fv (v);
 			}
 			glEnd ();
+			rs_drawcalls++;
 			rs_brushpasses++;
 		}
 	}
 }
 
-extern GLuint gl_bmodel_vbo;
 
 /*
 ================
@@ -926,6 +934,345 @@ void R_DrawTextureChains_Multitexture_VBO (qmodel_t *model, entity_t *ent, texch
 	glDisableClientState (GL_TEXTURE_COORD_ARRAY);
 }
 
+/*
+================================================================================
+
+	INSTANCED BRUSH MODELS
+
+Opaque brush entities are queued by R_DrawBrushModel, and drawn by
+R_FlushBrushInstances grouped by model and frame, one instanced draw per
+texture and lightmap. The entity transform comes from a per-instance
+attribute buffer, the surfaces from gl_bmodel_vbo. There is no per-entity
+backface culling, which only matters for the fill rate of closed models.
+
+================================================================================
+*/
+
+typedef struct
+{
+	float	rows[3][4];	// model to world
+} brushinstance_t;
+
+typedef struct
+{
+	entity_t	*e;
+	brushinstance_t	inst;
+} brushqueued_t;
+
+static GLuint r_brush_instanced_program;
+
+static GLuint brushTexLoc;
+static GLuint brushLMTexLoc;
+static GLuint brushFullbrightTexLoc;
+static GLuint brushUseFullbrightTexLoc;
+static GLuint brushLightScaleLoc;
+
+static const GLint brushVertAttrIndex = 0;
+static const GLint brushTexCoordsAttrIndex = 1;
+static const GLint brushLMCoordsAttrIndex = 2;
+static const GLint brushRow0AttrIndex = 3;
+static const GLint brushRow1AttrIndex = 4;
+static const GLint brushRow2AttrIndex = 5;
+
+static GLuint	r_brushinstancevbo;
+
+static brushqueued_t	r_brushqueue[MAX_VISEDICTS];
+static brushinstance_t	r_brushinstances[MAX_VISEDICTS];
+static int	r_numbrushqueued;
+
+/*
+=============
+GLWorld_CreateShaders
+=============
+*/
+void GLWorld_CreateShaders (void)
+{
+	const glsl_attrib_binding_t bindings[] = {
+		{ "Vert", brushVertAttrIndex },
+		{ "TexCoords", brushTexCoordsAttrIndex },
+		{ "LMCoords", brushLMCoordsAttrIndex },
+		{ "InstanceRow0", brushRow0AttrIndex },
+		{ "InstanceRow1", brushRow1AttrIndex },
+		{ "InstanceRow2", brushRow2AttrIndex }
+	};
+
+	const GLchar *vertSource = \
+		"#version 110\n"
+		"\n"
+		"attribute vec3 Vert;\n"
+		"attribute vec2 TexCoords;\n"
+		"attribute vec2 LMCoords;\n"
+		"attribute vec4 InstanceRow0;\n"
+		"attribute vec4 InstanceRow1;\n"
+		"attribute vec4 InstanceRow2;\n"
+		"void main()\n"
+		"{\n"
+		"	vec4 vert = vec4(Vert, 1.0);\n"
+		"	vec4 worldVert = vec4(dot(InstanceRow0, vert), dot(InstanceRow1, vert), dot(InstanceRow2, vert), 1.0);\n"
+		"	gl_TexCoord[0] = vec4(TexCoords, 0.0, 0.0);\n"
+		"	gl_TexCoord[1] = vec4(LMCoords, 0.0, 0.0);\n"
+		"	gl_Position = gl_ModelViewProjectionMatrix * worldVert;\n"
+		"	// fog\n"
+		"	vec3 ecPosition = vec3(gl_ModelViewMatrix * worldVert);\n"
+		"	gl_FogFragCoord = abs(ecPosition.z);\n"
+		"}\n";
+
+	// same as the combiner setup of R_DrawTextureChains_Multitexture_VBO
+	const GLchar *fragSource = \
+		"#version 110\n"
+		"\n"
+		"uniform sampler2D Tex;\n"
+		"uniform sampler2D LMTex;\n"
+		"uniform sampler2D FullbrightTex;\n"
+		"uniform bool UseFullbrightTex;\n"
+		"uniform float LightScale;\n"
+		"void main()\n"
+		"{\n"
+		"	vec4 result = texture2D(Tex, gl_TexCoord[0].xy);\n"
+		"	float alpha = result.a;\n"
+		"	result.rgb *= texture2D(LMTex, gl_TexCoord[1].xy).rgb * LightScale;\n"
+		"	if (UseFullbrightTex)\n"
+		"		result.rgb += texture2D(FullbrightTex, gl_TexCoord[0].xy).rgb;\n"
+		"	result = clamp(result, 0.0, 1.0);\n"
+		"	// apply GL_EXP2 fog (from the orange book)\n"
+		"	float fog = exp(-gl_Fog.density * gl_Fog.density * gl_FogFragCoord * gl_FogFragCoord);\n"
+		"	fog = clamp(fog, 0.0, 1.0);\n"
+		"	result = mix(gl_Fog.color, result, fog);\n"
+		"	result.a = alpha; // for the alpha test of fence textures\n"
+		"	gl_FragColor = result;\n"
+		"}\n";
+
+	if (!gl_instancing_able)
+		return;
+
+	r_brush_instanced_program = GL_CreateProgram (vertSource, fragSource, sizeof(bindings)/sizeof(bindings[0]), bindings);
+
+	if (r_brush_instanced_program != 0)
+	{
+	// get uniform locations
+		brushTexLoc = GL_GetUniformLocation (&r_brush_instanced_program, "Tex");
+		brushLMTexLoc = GL_GetUniformLocation (&r_brush_instanced_program, "LMTex");
+		brushFullbrightTexLoc = GL_GetUniformLocation (&r_brush_instanced_program, "FullbrightTex");
+		brushUseFullbrightTexLoc = GL_GetUniformLocation (&r_brush_instanced_program, "UseFullbrightTex");
+		brushLightScaleLoc = GL_GetUniformLocation (&r_brush_instanced_program, "LightScale");
+	}
+}
+
+/*
+=============
+GLWorld_DeleteObjects -- called on vid_restart, the buffer is recreated on demand
+=============
+*/
+void GLWorld_DeleteObjects (void)
+{
+	if (r_brushinstancevbo)
+		GL_DeleteBuffersFunc (1, &r_brushinstancevbo);
+	r_brushinstancevbo = 0;
+
+	r_brush_instanced_program = 0;	// deleted with the other programs
+	r_numbrushqueued = 0;
+}
+
+/*
+=============
+R_QueueBrushInstance -- returns false if the entity has to be drawn the usual way
+=============
+*/
+qboolean R_QueueBrushInstance (entity_t *e)
+{
+	brushqueued_t	*q;
+	vec3_t		origin, angles;
+
+	if (!r_instancing.value || !r_brush_instanced_program || !gl_bmodel_vbo)
+		return false;
+	if (r_drawflat_cheatsafe || r_fullbright_cheatsafe || r_lightmap_cheatsafe)
+		return false;
+	if (ENTALPHA_DECODE(e->alpha) < 1 || (e->model->flags & MOD_NOINSTANCING))
+		return false;
+	if (r_numbrushqueued == MAX_VISEDICTS)
+		return false;
+
+	if (!r_brushinstancevbo)
+	{
+		GL_GenBuffersFunc (1, &r_brushinstancevbo);
+		GL_BindBuffer (GL_ARRAY_BUFFER, r_brushinstancevbo);
+		GL_BufferDataFunc (GL_ARRAY_BUFFER, sizeof(r_brushinstances), NULL, GL_STREAM_DRAW);
+	}
+
+	VectorCopy (e->origin, origin);
+	if (gl_zfix.value)
+	{
+		origin[0] -= DIST_EPSILON;
+		origin[1] -= DIST_EPSILON;
+		origin[2] -= DIST_EPSILON;
+	}
+	angles[0] = -e->angles[0];	// stupid quake bug
+	angles[1] = e->angles[1];
+	angles[2] = e->angles[2];
+
+	q = &r_brushqueue[r_numbrushqueued++];
+	q->e = e;
+	R_EntityTransformRows (origin, angles, q->inst.rows);
+	return true;
+}
+
+/*
+=============
+R_CompareBrushInstances -- qsort callback, groups by model then frame
+=============
+*/
+static int R_CompareBrushInstances (const void *a, const void *b)
+{
+	const brushqueued_t *qa = (const brushqueued_t *) a;
+	const brushqueued_t *qb = (const brushqueued_t *) b;
+
+	if (qa->e->model != qb->e->model)
+		return (uintptr_t) qa->e->model < (uintptr_t) qb->e->model ? -1 : 1;
+	return qa->e->frame - qb->e->frame;
+}
+
+/*
+=============
+R_DrawBrushInstances -- one model and frame, count instances starting at first
+=============
+*/
+static void R_DrawBrushInstances (entity_t *ent, int first, int count)
+{
+	const GLint rowattribs[] = {brushRow0AttrIndex, brushRow1AttrIndex, brushRow2AttrIndex};
+	qmodel_t	*model = ent->model;
+	msurface_t	*s;
+	texture_t	*t, *anim;
+	gltexture_t	*fullbright;
+	int		i, lastlightmap;
+
+	R_ClearTextureChains (model, chain_model);
+	s = &model->surfaces[model->firstmodelsurface];
+	for (i = 0; i < model->nummodelsurfaces; i++, s++)
+		R_ChainSurface (s, chain_model);
+	rs_brushpolys += model->nummodelsurfaces * count;
+
+	R_BuildLightmapChains (model, chain_model);
+	R_UploadLightmaps ();
+
+	GL_BindBuffer (GL_ARRAY_BUFFER, r_brushinstancevbo);
+	for (i = 0; i < 3; i++)
+		GL_VertexAttribPointerFunc (rowattribs[i], 4, GL_FLOAT, GL_FALSE, sizeof(brushinstance_t),
+				(void *)(intptr_t)(first * sizeof(brushinstance_t) + i * 4 * sizeof(float)));
+
+	num_vbo_instances = count;
+	for (i = 0; i < model->numtextures; i++)
+	{
+		t = model->textures[i];
+		if (!t || !t->texturechains[chain_model])
+			continue;
+
+		anim = R_TextureAnimation (t, ent->frame);
+		GL_SelectTexture (GL_TEXTURE0);
+		GL_Bind (anim->gltexture);
+
+		fullbright = gl_fullbrights.value ? anim->fullbright : NULL;
+		GL_Uniform1iFunc (brushUseFullbrightTexLoc, (fullbright != NULL) ? 1 : 0);
+		if (fullbright)
+		{
+			GL_SelectTexture (GL_TEXTURE2);
+			GL_Bind (fullbright);
+		}
+
+		if (t->texturechains[chain_model]->flags & SURF_DRAWFENCE)
+			glEnable (GL_ALPHA_TEST);
+
+		R_ClearBatch ();
+		lastlightmap = -1;
+		for (s = t->texturechains[chain_model]; s; s = s->texturechain)
+		{
+			if (s->lightmaptexturenum != lastlightmap)
+			{
+				R_FlushBatch ();
+				GL_SelectTexture (GL_TEXTURE1);
+				GL_Bind (lightmap_textures[s->lightmaptexturenum]);
+				lastlightmap = s->lightmaptexturenum;
+			}
+			R_BatchSurface (s);
+			rs_brushpasses += count;
+		}
+		R_FlushBatch ();
+
+		if (t->texturechains[chain_model]->flags & SURF_DRAWFENCE)
+			glDisable (GL_ALPHA_TEST);
+	}
+	num_vbo_instances = 0;
+}
+
+/*
+=============
+R_FlushBrushInstances -- draws everything R_DrawBrushModel queued
+=============
+*/
+void R_FlushBrushInstances (void)
+{
+	const GLint rowattribs[] = {brushRow0AttrIndex, brushRow1AttrIndex, brushRow2AttrIndex};
+	int	i, first, count;
+
+	if (!r_numbrushqueued)
+		return;
+
+	qsort (r_brushqueue, r_numbrushqueued, sizeof(brushqueued_t), R_CompareBrushInstances);
+	for (i = 0; i < r_numbrushqueued; i++)
+		r_brushinstances[i] = r_brushqueue[i].inst;
+
+	GL_BindBuffer (GL_ARRAY_BUFFER, r_brushinstancevbo);
+	GL_BufferDataFunc (GL_ARRAY_BUFFER, sizeof(r_brushinstances), NULL, GL_STREAM_DRAW); // orphan last frame's
+	GL_BufferSubDataFunc (GL_ARRAY_BUFFER, 0, r_numbrushqueued * sizeof(brushinstance_t), r_brushinstances);
+
+	GL_UseProgramFunc (r_brush_instanced_program);
+	GL_Uniform1iFunc (brushTexLoc, 0);
+	GL_Uniform1iFunc (brushLMTexLoc, 1);
+	GL_Uniform1iFunc (brushFullbrightTexLoc, 2);
+	GL_Uniform1fFunc (brushLightScaleLoc, gl_overbright.value ? 2.0f : 1.0f);
+
+// the surfaces, indices come from client memory
+	GL_BindBuffer (GL_ARRAY_BUFFER, gl_bmodel_vbo);
+	GL_BindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+	GL_EnableVertexAttribArrayFunc (brushVertAttrIndex);
+	GL_EnableVertexAttribArrayFunc (brushTexCoordsAttrIndex);
+	GL_EnableVertexAttribArrayFunc (brushLMCoordsAttrIndex);
+	GL_VertexAttribPointerFunc (brushVertAttrIndex, 3, GL_FLOAT, GL_FALSE, VERTEXSIZE * sizeof(float), ((float *)0));
+	GL_VertexAttribPointerFunc (brushTexCoordsAttrIndex, 2, GL_FLOAT, GL_FALSE, VERTEXSIZE * sizeof(float), ((float *)0) + 3);
+	GL_VertexAttribPointerFunc (brushLMCoordsAttrIndex, 2, GL_FLOAT, GL_FALSE, VERTEXSIZE * sizeof(float), ((float *)0) + 5);
+
+	for (i = 0; i < 3; i++)
+	{
+		GL_EnableVertexAttribArrayFunc (rowattribs[i]);
+		GL_VertexAttribDivisorFunc (rowattribs[i], 1);
+	}
+
+	for (first = 0; first < r_numbrushqueued; first += count)
+	{
+		for (count = 1; first + count < r_numbrushqueued; count++)
+		{
+			if (R_CompareBrushInstances (&r_brushqueue[first], &r_brushqueue[first + count]))
+				break;
+		}
+		R_DrawBrushInstances (r_brushqueue[first].e, first, count);
+	}
+
+// clean up
+	for (i = 0; i < 3; i++)
+	{
+		GL_VertexAttribDivisorFunc (rowattribs[i], 0);
+		GL_DisableVertexAttribArrayFunc (rowattribs[i]);
+	}
+	GL_DisableVertexAttribArrayFunc (brushVertAttrIndex);
+	GL_DisableVertexAttribArrayFunc (brushTexCoordsAttrIndex);
+	GL_DisableVertexAttribArrayFunc (brushLMCoordsAttrIndex);
+
+	GL_UseProgramFunc (0);
+	GL_ClearBufferBindings ();
+	GL_SelectTexture (GL_TEXTURE0);
+
+	r_numbrushqueued = 0;
+}
+
 /*
 =============
 R_DrawWorld -- johnfitz -- rewritten
@@ -227,5 +227,9 @@ void SV_RunClients (void);
 void SV_SaveSpawnparms ();
 void SV_SpawnServer (const char *server);
 
+void SV_InitStates (void);
+void SV_ClearStates (void);
+void SV_RecordState (void);
+
 #endif	/* _QUAKE_SERVER_H */
 
@@ -68,6 +68,12 @@ static int	num_sfx;
 
 static sfx_t	*ambient_sfx[NUM_AMBIENTS];
 
+// sounds precached between S_BeginPrecaching and S_EndPrecaching are
+// loaded as one batch, so they can be decoded in parallel
+static qboolean	snd_precaching;
+static sfx_t	*precache_queue[MAX_SFX];
+static int	num_precache_queue;
+
 static qboolean	sound_started = false;
 
 cvar_t		bgmvolume = {"bgmvolume", "1", CVAR_ARCHIVE};
@@ -96,6 +102,15 @@ static	cvar_t	ambient_fade = {"ambient_fade", "100", CVAR_NONE};
 static	cvar_t	snd_noextraupdate = {"snd_noextraupdate", "0", CVAR_NONE};
 static	cvar_t	snd_show = {"snd_show", "0", CVAR_NONE};
 static	cvar_t	_snd_mixahead = {"_snd_mixahead", "0.1", CVAR_ARCHIVE};
+static	cvar_t	snd_maxvoices = {"snd_maxvoices", "64", CVAR_ARCHIVE};
+
+// voice management stats, for snd_show
+static int	snd_realvoices;
+static int	snd_virtualvoices;
+
+// mixer throughput, for timedemo and soundinfo
+static double	snd_mixtime;
+static int	snd_mixsamples;
 
 
 static void S_SoundInfo_f (void)
@@ -113,6 +128,7 @@ static void S_SoundInfo_f (void)
 	Con_Printf("%5d submission_chunk\n", shm->submission_chunk);
 	Con_Printf("%5d total_channels\n", total_channels);
 	Con_Printf("%p dma buffer\n", shm->buffer);
+	S_PrintMixStats ();
 }
 
 
@@ -192,11 +208,13 @@ void S_Init (void)
 	Cvar_RegisterVariable(&snd_noextraupdate);
 	Cvar_RegisterVariable(&snd_show);
 	Cvar_RegisterVariable(&_snd_mixahead);
+	Cvar_RegisterVariable(&snd_maxvoices);
 	Cvar_RegisterVariable(&sndspeed);
 	Cvar_RegisterVariable(&snd_mixspeed);
 	Cvar_RegisterVariable(&snd_filterquality);
 	Cvar_RegisterVariable(&snd_device);
 	Cvar_SetCallback(&snd_device, S_Device_f);
+	SND_HRTF_Init ();
 	
 	if (safemode || COM_CheckParm("-nosound"))
 		return;
@@ -331,6 +349,28 @@ void S_TouchSound (const char *name)
 	Cache_Check (&sfx->cache);
 }
 
+/*
+==================
+S_QueuePrecache
+
+==================
+*/
+static void S_QueuePrecache (sfx_t *sfx)
+{
+	int	i;
+
+	if (Cache_Check (&sfx->cache))
+		return;
+
+	for (i = 0; i < num_precache_queue; i++)
+	{
+		if (precache_queue[i] == sfx)
+			return;
+	}
+
+	precache_queue[num_precache_queue++] = sfx;
+}
+
 /*
 ==================
 S_PrecacheSound
@@ -348,7 +388,12 @@ sfx_t *S_PrecacheSound (const char *name)
 
 // cache it in
 	if (precache.value)
-		S_LoadSound (sfx);
+	{
+		if (snd_precaching)
+			S_QueuePrecache (sfx);
+		else
+			S_LoadSound (sfx);
+	}
 
 	return sfx;
 }
@@ -361,6 +406,8 @@ sfx_t *S_PrecacheSound (const char *name)
 SND_PickChannel
 
 picks a channel based on priorities, empty slots, number of channels
+free channels are taken first, then virtual (inaudible) voices, and only
+then the audible voice with the least time left to play
 =================
 */
 channel_t *SND_PickChannel (int entnum, int entchannel)
@@ -368,27 +415,42 @@ channel_t *SND_PickChannel (int entnum, int entchannel)
 	int	ch_idx;
 	int	first_to_die;
 	int	life_left;
+	int	victim_class, ch_class;
+	channel_t	*ch;
 
 // Check for replacement sound, or find the best one to replace
 	first_to_die = -1;
 	life_left = 0x7fffffff;
+	victim_class = 3;
 	for (ch_idx = NUM_AMBIENTS; ch_idx < NUM_AMBIENTS + MAX_DYNAMIC_CHANNELS; ch_idx++)
 	{
+		ch = &snd_channels[ch_idx];
+
 		if (entchannel != 0		// channel 0 never overrides
-			&& snd_channels[ch_idx].entnum == entnum
-			&& (snd_channels[ch_idx].entchannel == entchannel || entchannel == -1) )
+			&& ch->entnum == entnum
+			&& (ch->entchannel == entchannel || entchannel == -1) )
 		{	// always override sound from same entity
 			first_to_die = ch_idx;
 			break;
 		}
 
 		// don't let monster sounds override player sounds
-		if (snd_channels[ch_idx].entnum == cl.viewentity && entnum != cl.viewentity && snd_channels[ch_idx].sfx)
+		if (ch->entnum == cl.viewentity && entnum != cl.viewentity && ch->sfx)
 			continue;
 
-		if (snd_channels[ch_idx].end - paintedtime < life_left)
+		// free slots go first, then virtual voices, then audible ones
+		if (!ch->sfx)
+			ch_class = 0;
+		else if (!ch->leftvol && !ch->rightvol)
+			ch_class = 1;
+		else
+			ch_class = 2;
+
+		if (ch_class < victim_class
+			|| (ch_class == victim_class && ch->end - paintedtime < life_left))
 		{
-			life_left = snd_channels[ch_idx].end - paintedtime;
+			victim_class = ch_class;
+			life_left = ch->end - paintedtime;
 			first_to_die = ch_idx;
 		}
 	}
@@ -424,9 +486,31 @@ void SND_Spatialize (channel_t *ch)
 		return;
 	}
 
-// calculate stereo seperation and distance attenuation
+// cull silent and out of range sounds before doing any real work
+	if (ch->master_vol <= 0)
+	{
+		ch->leftvol = ch->rightvol = 0;
+		return;
+	}
+
 	VectorSubtract(ch->origin, listener_origin, source_vec);
+	dist = DotProduct(source_vec, source_vec) * ch->dist_mult * ch->dist_mult;
+	if (dist >= 1.0)
+	{
+		ch->leftvol = ch->rightvol = 0;
+		return;
+	}
+
+// calculate stereo seperation and distance attenuation
 	dist = VectorNormalize(source_vec) * ch->dist_mult;
+
+// binaural voices get the direction from their HRIR, distance only here
+	if (SND_HRTF_Enabled() && SND_HRTF_Spatialize(ch, source_vec))
+	{
+		ch->leftvol = ch->rightvol = q_max((int) (ch->master_vol * (1.0 - dist)), 0);
+		return;
+	}
+
 	dot = DotProduct(listener_right, source_vec);
 
 	if (shm->channels == 1)
@@ -453,6 +537,184 @@ void SND_Spatialize (channel_t *ch)
 }
 
 
+// =======================================================================
+// Static sound spatial index
+// =======================================================================
+
+/*
+Static sounds are bucketed into a hashed grid of STATIC_CELL_SIZE cells by
+origin, so that S_Update only has to look at the ones in the cells around
+the listener. Sounds that carry further than STATIC_MAX_RANGE (ATTN_NONE and
+very low attenuations) are kept in a separate list and always considered.
+*/
+#define	STATIC_CELL_SIZE	512
+#define	STATIC_MAX_RANGE	(4 * STATIC_CELL_SIZE)
+#define	STATIC_HASH_SIZE	256
+
+static int	static_hash[STATIC_HASH_SIZE];	// first channel in bucket, -1 = empty
+static int	static_global;			// sounds not in the grid
+static int	static_next[MAX_CHANNELS];	// next channel in the same bucket
+static int	static_cell[MAX_CHANNELS][3];
+static float	static_maxrange;		// largest range of any gridded sound
+
+static int	active_statics[MAX_CHANNELS];	// statics spatialized last update
+static int	num_active_statics;
+
+static int S_StaticCell (float coord)
+{
+	return (int) floor (coord / STATIC_CELL_SIZE);
+}
+
+static int S_StaticHash (int x, int y, int z)
+{
+	return (((unsigned)x * 73856093) ^ ((unsigned)y * 19349663) ^ ((unsigned)z * 83492791)) & (STATIC_HASH_SIZE - 1);
+}
+
+/*
+=================
+S_ClearStaticIndex
+=================
+*/
+static void S_ClearStaticIndex (void)
+{
+	int	i;
+
+	for (i = 0; i < STATIC_HASH_SIZE; i++)
+		static_hash[i] = -1;
+	static_global = -1;
+	static_maxrange = 0;
+	num_active_statics = 0;
+}
+
+/*
+=================
+S_AddStaticToIndex
+=================
+*/
+static void S_AddStaticToIndex (int ch_idx)
+{
+	channel_t	*ch = &snd_channels[ch_idx];
+	float		range;
+	int		*cell, hash;
+
+	range = (ch->dist_mult > 0) ? 1.0 / ch->dist_mult : STATIC_MAX_RANGE + 1;
+	if (range > STATIC_MAX_RANGE)
+	{
+		static_next[ch_idx] = static_global;
+		static_global = ch_idx;
+		return;
+	}
+
+	cell = static_cell[ch_idx];
+	cell[0] = S_StaticCell (ch->origin[0]);
+	cell[1] = S_StaticCell (ch->origin[1]);
+	cell[2] = S_StaticCell (ch->origin[2]);
+	hash = S_StaticHash (cell[0], cell[1], cell[2]);
+
+	static_next[ch_idx] = static_hash[hash];
+	static_hash[hash] = ch_idx;
+
+	if (range > static_maxrange)
+		static_maxrange = range;
+}
+
+/*
+=================
+S_UpdateStaticSounds
+
+mutes the statics heard last update, then spatializes only those in the
+grid cells within reach of the listener
+=================
+*/
+static void S_UpdateStaticSounds (void)
+{
+	int		i, x, y, z, ch_idx;
+	int		mins[3], maxs[3];
+	int		*cell;
+	channel_t	*ch;
+
+	for (i = 0; i < num_active_statics; i++)
+	{
+		ch = &snd_channels[active_statics[i]];
+		ch->leftvol = ch->rightvol = 0;
+	}
+	num_active_statics = 0;
+
+	if (total_channels <= MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS)
+		return;
+
+	for (ch_idx = static_global; ch_idx != -1; ch_idx = static_next[ch_idx])
+		active_statics[num_active_statics++] = ch_idx;
+
+	if (static_maxrange > 0)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			mins[i] = S_StaticCell (listener_origin[i] - static_maxrange);
+			maxs[i] = S_StaticCell (listener_origin[i] + static_maxrange);
+		}
+
+		for (x = mins[0]; x <= maxs[0]; x++)
+		for (y = mins[1]; y <= maxs[1]; y++)
+		for (z = mins[2]; z <= maxs[2]; z++)
+		{
+			for (ch_idx = static_hash[S_StaticHash (x, y, z)]; ch_idx != -1; ch_idx = static_next[ch_idx])
+			{
+				cell = static_cell[ch_idx];
+				if (cell[0] == x && cell[1] == y && cell[2] == z)
+					active_statics[num_active_statics++] = ch_idx;
+			}
+		}
+	}
+
+	for (i = 0; i < num_active_statics; i++)
+	{
+		ch = &snd_channels[active_statics[i]];
+		if (!ch->sfx)
+			continue;
+		SND_Spatialize (ch);
+		if (ch->leftvol || ch->rightvol)
+		{	// statics aren't advanced while out of reach, so catch
+			// the loop up with the time that has passed since
+			SND_SyncChannel (ch, paintedtime);
+		}
+	}
+}
+
+/*
+=================
+S_CombineStaticSounds
+
+try to combine static sounds with a previous channel of the same
+sound effect so we don't mix five torches every frame
+=================
+*/
+static void S_CombineStaticSounds (void)
+{
+	int		i, j;
+	channel_t	*ch, *combine;
+
+	for (i = 0; i < num_active_statics; i++)
+	{
+		ch = &snd_channels[active_statics[i]];
+		if (!ch->sfx || (!ch->leftvol && !ch->rightvol))
+			continue;
+
+		for (j = 0; j < i; j++)
+		{
+			combine = &snd_channels[active_statics[j]];
+			if (combine->sfx == ch->sfx && (combine->leftvol || combine->rightvol))
+			{
+				combine->leftvol += ch->leftvol;
+				combine->rightvol += ch->rightvol;
+				ch->leftvol = ch->rightvol = 0;
+				break;
+			}
+		}
+	}
+}
+
+
 // =======================================================================
 // Start a sound effect
 // =======================================================================
@@ -485,6 +747,7 @@ void S_StartSound (int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float
 	target_chan->master_vol = (int) (fvol * 255);
 	target_chan->entnum = entnum;
 	target_chan->entchannel = entchannel;
+	SND_HRTF_ResetChannel(target_chan);
 	SND_Spatialize(target_chan);
 
 	if (!target_chan->leftvol && !target_chan->rightvol)
@@ -561,6 +824,7 @@ void S_StopAllSounds (qboolean clear)
 	}
 
 	memset(snd_channels, 0, MAX_CHANNELS * sizeof(channel_t));
+	S_ClearStaticIndex ();
 
 	if (clear)
 		S_ClearBuffer ();
@@ -633,7 +897,7 @@ void S_StaticSound (sfx_t *sfx, vec3_t origin, float vol, float attenuation)
 	ss->dist_mult = (attenuation / 64) / sound_nominal_clip_dist;
 	ss->end = paintedtime + sc->length;
 
-	SND_Spatialize (ss);
+	S_AddStaticToIndex (ss - snd_channels);
 }
 
 
@@ -693,6 +957,109 @@ static void S_UpdateAmbientSounds (void)
 }
 
 
+/*
+===================
+S_VoicePriority
+
+player sounds always win, everything else is ranked by loudness
+===================
+*/
+static int S_VoicePriority (channel_t *ch)
+{
+	int	vol;
+
+	vol = q_max(ch->leftvol, ch->rightvol);
+	if (vol > 255)
+		vol = 255;
+	if (ch->entnum == cl.viewentity)
+		vol += 256;
+	return vol;
+}
+
+/*
+===================
+S_LimitVoices
+
+Every channel with a sfx is a virtual voice; only the snd_maxvoices loudest
+of them (player sounds first) are left audible and get mixed. The others are
+muted, and the mixer keeps their play position moving so they pick up at the
+right offset once they make the cut again.
+===================
+*/
+#define	VOICE_PRIORITIES	512
+
+static void S_LimitVoices (void)
+{
+	static int	count[VOICE_PRIORITIES];
+	static channel_t	*voices[MAX_CHANNELS];
+	int		i, prio, cutoff, left, maxvoices, numvoices;
+	channel_t	*ch;
+
+	maxvoices = (int)snd_maxvoices.value;
+
+	memset (count, 0, sizeof(count));
+	numvoices = 0;
+	snd_virtualvoices = 0;
+
+// dynamic sounds, plus the static sounds near enough to be spatialized
+	ch = snd_channels + NUM_AMBIENTS;
+	for (i = NUM_AMBIENTS; i < MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS; i++, ch++)
+	{
+		if (ch->sfx)
+			voices[numvoices++] = ch;
+	}
+	for (i = 0; i < num_active_statics; i++)
+	{
+		ch = &snd_channels[active_statics[i]];
+		if (ch->sfx)
+			voices[numvoices++] = ch;
+	}
+
+	for (i = 0; i < numvoices; i++)
+	{
+		ch = voices[i];
+		if (!ch->leftvol && !ch->rightvol)
+		{
+			voices[i] = NULL;
+			snd_virtualvoices++;
+			continue;
+		}
+		count[S_VoicePriority (ch)]++;
+	}
+	snd_realvoices = numvoices - snd_virtualvoices;
+
+	if (maxvoices <= 0 || snd_realvoices <= maxvoices)
+		return;
+
+// find the priority that the last real voice has, then mute everything
+// below it and as many voices at that priority as it takes to fit
+	left = maxvoices;
+	for (cutoff = VOICE_PRIORITIES - 1; cutoff > 0; cutoff--)
+	{
+		if (count[cutoff] >= left)
+			break;
+		left -= count[cutoff];
+	}
+
+	for (i = 0; i < numvoices; i++)
+	{
+		ch = voices[i];
+		if (!ch)
+			continue;
+		prio = S_VoicePriority (ch);
+		if (prio > cutoff)
+			continue;
+		if (prio == cutoff && left > 0)
+		{
+			left--;
+			continue;
+		}
+		ch->leftvol = ch->rightvol = 0;
+		snd_realvoices--;
+		snd_virtualvoices++;
+	}
+}
+
 /*
 ===================
 S_RawSamples		(from QuakeII)
@@ -787,10 +1154,9 @@ Called once each time through the main loop
 */
 void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 {
-	int			i, j;
+	int			i;
 	int			total;
 	channel_t	*ch;
-	channel_t	*combine;
 
 	if (!sound_started || (snd_blocked > 0))
 		return;
@@ -799,59 +1165,26 @@ void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 	VectorCopy(forward, listener_forward);
 	VectorCopy(right, listener_right);
 	VectorCopy(up, listener_up);
+	SND_HRTF_Update ();
 
 // update general area ambient sound sources
 	S_UpdateAmbientSounds ();
 
-	combine = NULL;
-
-// update spatialization for static and dynamic sounds
+// update spatialization for dynamic sounds
 	ch = snd_channels + NUM_AMBIENTS;
-	for (i = NUM_AMBIENTS; i < total_channels; i++, ch++)
+	for (i = NUM_AMBIENTS; i < MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS; i++, ch++)
 	{
 		if (!ch->sfx)
 			continue;
 		SND_Spatialize(ch);	// respatialize channel
-		if (!ch->leftvol && !ch->rightvol)
-			continue;
-
-	// try to combine static sounds with a previous channel of the same
-	// sound effect so we don't mix five torches every frame
+	}
 
-		if (i >= MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS)
-		{
-		// see if it can just use the last one
-			if (combine && combine->sfx == ch->sfx)
-			{
-				combine->leftvol += ch->leftvol;
-				combine->rightvol += ch->rightvol;
-				ch->leftvol = ch->rightvol = 0;
-				continue;
-			}
-		// search for one
-			combine = snd_channels + MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS;
-			for (j = MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS; j < i; j++, combine++)
-			{
-				if (combine->sfx == ch->sfx)
-					break;
-			}
+// static sounds only near the listener
+	S_UpdateStaticSounds ();
+	S_CombineStaticSounds ();
 
-			if (j == total_channels)
-			{
-				combine = NULL;
-			}
-			else
-			{
-				if (combine != ch)
-				{
-					combine->leftvol += ch->leftvol;
-					combine->rightvol += ch->rightvol;
-					ch->leftvol = ch->rightvol = 0;
-				}
-				continue;
-			}
-		}
-	}
+// keep the number of mixed voices bounded
+	S_LimitVoices ();
 
 //
 // debugging output
@@ -869,7 +1202,9 @@ void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 			}
 		}
 
-		Con_Printf ("----(%i)----\n", total);
+		Con_Printf ("----(%i, %i real, %i virtual, %i/%i statics in reach)----\n",
+				total, snd_realvoices, snd_virtualvoices, num_active_statics,
+				total_channels - MAX_DYNAMIC_CHANNELS - NUM_AMBIENTS);
 	}
 
 // add raw data from streamed samples
@@ -919,6 +1254,7 @@ static void S_Update_ (void)
 {
 	unsigned int	endtime;
 	int		samps;
+	double		mixstart;
 
 	if (!sound_started || (snd_blocked > 0))
 		return;
@@ -942,11 +1278,43 @@ static void S_Update_ (void)
 	samps = shm->samples >> (shm->channels - 1);
 	endtime = q_min(endtime, (unsigned int)(soundtime + samps));
 
+	mixstart = Sys_DoubleTime ();
+	samps = paintedtime;
 	S_PaintChannels (endtime);
+	snd_mixtime += Sys_DoubleTime () - mixstart;
+	snd_mixsamples += paintedtime - samps;
 
 	SNDDMA_Submit ();
 }
 
+/*
+============
+S_ResetMixStats
+============
+*/
+void S_ResetMixStats (void)
+{
+	snd_mixtime = 0;
+	snd_mixsamples = 0;
+}
+
+/*
+============
+S_PrintMixStats
+
+reports how fast S_PaintChannels has been running
+============
+*/
+void S_PrintMixStats (void)
+{
+	if (!sound_started || !snd_mixsamples)
+		return;
+
+	Con_Printf ("%i samples mixed in %.3f seconds, %.0f samples/sec\n",
+			snd_mixsamples, snd_mixtime,
+			snd_mixtime > 0 ? snd_mixsamples / snd_mixtime : 0);
+}
+
 void S_BlockSound (void)
 {
 /* FIXME: do we really need the blocking at the
@@ -1076,10 +1444,19 @@ void S_ClearPrecache (void)
 
 void S_BeginPrecaching (void)
 {
+	snd_precaching = true;
+	num_precache_queue = 0;
 }
 
 
 void S_EndPrecaching (void)
 {
+	if (!snd_precaching)
+		return;
+
+	snd_precaching = false;
+	if (sound_started)
+		S_LoadSounds (precache_queue, num_precache_queue);
+	num_precache_queue = 0;
 }
 
@@ -0,0 +1,578 @@
+/*
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// snd_hrtf.c -- binaural (HRTF) spatialization of entity sounds
+
+#include "quakedef.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define HRTF_SSE 1
+#include <xmmintrin.h>
+#endif
+
+/*
+The head related impulse responses are synthesized at startup from the
+spherical head model of Brown and Duda ("A Structural Model for Binaural
+Sound Synthesis", 1998): an interaural delay, a one-pole/one-zero head
+shadow filter per ear and a handful of elevation dependent pinna echoes.
+This keeps the built-in set down to a few lines of code instead of a
+table of measured data.
+
+The responses are short enough that a direct block FIR (vectorized with
+SSE where available) beats FFT based partitioned convolution, so that is
+what each voice is run through.
+*/
+
+#define	HRIR_LENGTH		64	// taps, multiple of 4
+#define	HRIR_FADE		16	// taps faded out at the end of the response
+#define	HRIR_BUILD_LENGTH	128
+
+#define	HRTF_AZIMUTHS		24	// 15 degree steps all around
+#define	HRTF_ELEVATIONS		10	// -45 to 90 degrees in 15 degree steps
+#define	HRTF_MIN_ELEVATION	-45
+#define	HRTF_STEP		15
+#define	HRTF_DIRECTIONS		(HRTF_AZIMUTHS * HRTF_ELEVATIONS)
+
+#define	HEAD_RADIUS		0.0875	// meters
+#define	SPEED_OF_SOUND		343.0	// meters per second
+
+#define	HRTF_BLOCK		2048	// most samples painted in one go
+
+typedef struct
+{
+	float	left[HRIR_LENGTH];	// time reversed, ready for the FIR
+	float	right[HRIR_LENGTH];
+} hrir_t;
+
+typedef struct
+{
+	float	history[HRIR_LENGTH - 1];	// last input samples
+	int	dir;			// response in use, -1 = none yet
+	int	targetdir;		// response asked for by the last spatialize
+	int	paintedtime;		// where the last block ended
+} hrtfvoice_t;
+
+cvar_t		snd_hrtf = {"snd_hrtf", "0", CVAR_ARCHIVE};
+
+static hrir_t	*hrtf_table;		// [HRTF_DIRECTIONS]
+static int	hrtf_rate;		// sample rate the table was built for
+
+static hrtfvoice_t	hrtf_voices[MAX_DYNAMIC_CHANNELS];
+
+static vec3_t	head_forward, head_right, head_up;
+static qboolean	head_fed;		// VR set the orientation this frame
+
+// scratch space for one voice: history followed by the new samples
+static float	hrtf_input[HRIR_LENGTH - 1 + HRTF_BLOCK + 4];
+#define	hrtf_samples	(hrtf_input + HRIR_LENGTH - 1)
+static float	hrtf_outl[HRTF_BLOCK + 4], hrtf_outr[HRTF_BLOCK + 4];
+static float	hrtf_fadel[HRTF_BLOCK + 4], hrtf_fader[HRTF_BLOCK + 4];
+
+/*
+===============================================================================
+
+HRIR SYNTHESIS
+
+===============================================================================
+*/
+
+/*
+=================
+HRTF_BuildEar
+
+impulse response of one ear for a source at theta radians from the ear
+axis, and the given pinna azimuth and elevation in degrees
+=================
+*/
+static void HRTF_BuildEar (float *out, double theta, double azimuth, double elevation, double rate)
+{
+	static const double	rho[5] = {0.5, -1, 0.5, -0.25, 0.25};
+	static const double	A[5] = {1, 5, 5, 5, 5};
+	static const double	B[5] = {2, 4, 7, 11, 13};
+	static const double	D[5] = {1, 0.5, 0.5, 0.5, 0.5};
+	double	impulse[HRIR_BUILD_LENGTH];
+	double	delay, tau, alpha, K, x1, y1, x, y;
+	int	i, k;
+
+	memset (impulse, 0, sizeof(impulse));
+
+// interaural delay, Woodworth's formula
+	if (theta < M_PI / 2)
+		delay = (HEAD_RADIUS / SPEED_OF_SOUND) * (1 - cos (theta));
+	else
+		delay = (HEAD_RADIUS / SPEED_OF_SOUND) * (1 + theta - M_PI / 2);
+	delay *= rate;
+
+// direct sound plus pinna echoes, placed with linear interpolation
+	for (k = -1; k < 5; k++)
+	{
+		if (k < 0)
+		{
+			tau = delay;
+			x = 1;
+		}
+		else
+		{
+			tau = A[k] * cos (azimuth * M_PI / 360.0)
+				* sin (D[k] * (90.0 - elevation) * M_PI / 180.0) + B[k];
+			tau = delay + tau * rate / 44100.0;
+			x = rho[k];
+		}
+		i = (int) tau;
+		if (i < 0 || i + 1 >= HRIR_BUILD_LENGTH)
+			continue;
+		impulse[i] += x * (1 - (tau - i));
+		impulse[i + 1] += x * (tau - i);
+	}
+
+// head shadow: H(s) = (1 + alpha s / 2w0) / (1 + s / 2w0), w0 = c / a,
+// through the bilinear transform
+	alpha = 1.05 + 0.95 * cos (theta / (150.0 * M_PI / 180.0) * M_PI);
+	K = rate * HEAD_RADIUS / SPEED_OF_SOUND;
+	x1 = y1 = 0;
+	for (i = 0; i < HRIR_BUILD_LENGTH; i++)
+	{
+		x = impulse[i];
+		y = ((1 + alpha * K) * x + (1 - alpha * K) * x1 - (1 - K) * y1) / (1 + K);
+		x1 = x;
+		y1 = y;
+		out[i] = y;
+	}
+}
+
+/*
+=================
+HRTF_BuildTable
+=================
+*/
+static void HRTF_BuildTable (int rate)
+{
+	float	left[HRIR_BUILD_LENGTH], right[HRIR_BUILD_LENGTH];
+	double	azimuth, elevation, source[3], theta_l, theta_r, fade;
+	int	a, e, i, start;
+	hrir_t	*hrir;
+
+	if (!hrtf_table)
+		hrtf_table = (hrir_t *) malloc (HRTF_DIRECTIONS * sizeof(hrir_t));
+	if (!hrtf_table)
+		return;
+
+	for (e = 0; e < HRTF_ELEVATIONS; e++)
+	{
+		for (a = 0; a < HRTF_AZIMUTHS; a++)
+		{
+			azimuth = a * HRTF_STEP;		// clockwise from the front
+			if (azimuth > 180)
+				azimuth -= 360;
+			elevation = HRTF_MIN_ELEVATION + e * HRTF_STEP;
+
+			source[0] = cos (elevation * M_PI / 180.0) * cos (azimuth * M_PI / 180.0);
+			source[1] = cos (elevation * M_PI / 180.0) * sin (azimuth * M_PI / 180.0);
+			source[2] = sin (elevation * M_PI / 180.0);
+			theta_r = acos (CLAMP (-1.0, source[1], 1.0));
+			theta_l = acos (CLAMP (-1.0, -source[1], 1.0));
+
+			HRTF_BuildEar (left, theta_l, -azimuth, elevation, rate);
+			HRTF_BuildEar (right, theta_r, azimuth, elevation, rate);
+
+		// drop the delay both ears have in common
+			for (start = 0; start < HRIR_BUILD_LENGTH - HRIR_LENGTH; start++)
+			{
+				if (fabs (left[start]) > 1e-4 || fabs (right[start]) > 1e-4)
+					break;
+			}
+
+			hrir = &hrtf_table[e * HRTF_AZIMUTHS + a];
+			for (i = 0; i < HRIR_LENGTH; i++)
+			{
+				fade = 1.0;
+				if (i >= HRIR_LENGTH - HRIR_FADE)
+					fade = 0.5 + 0.5 * cos ((i - (HRIR_LENGTH - HRIR_FADE) + 1) * M_PI / (HRIR_FADE + 1));
+				hrir->left[HRIR_LENGTH - 1 - i] = left[start + i] * fade;
+				hrir->right[HRIR_LENGTH - 1 - i] = right[start + i] * fade;
+			}
+		}
+	}
+
+	hrtf_rate = rate;
+}
+
+/*
+=================
+HRTF_Direction
+
+picks the nearest response for a direction in head space
+=================
+*/
+static int HRTF_Direction (float forward, float right, float up)
+{
+	float	azimuth, elevation;
+	int	a, e;
+
+	azimuth = atan2 (right, forward) * 180.0 / M_PI;
+	if (azimuth < 0)
+		azimuth += 360;
+	elevation = asin (CLAMP (-1.0f, up, 1.0f)) * 180.0 / M_PI;
+
+	a = (int) (azimuth / HRTF_STEP + 0.5) % HRTF_AZIMUTHS;
+	e = (int) ((elevation - HRTF_MIN_ELEVATION) / HRTF_STEP + 0.5);
+	e = CLAMP (0, e, HRTF_ELEVATIONS - 1);
+
+	return e * HRTF_AZIMUTHS + a;
+}
+
+/*
+===============================================================================
+
+CONVOLUTION
+
+===============================================================================
+*/
+
+/*
+=================
+HRTF_Convolve
+
+runs count samples of in (preceded by HRIR_LENGTH-1 samples of history)
+through both ears of a response. count is rounded up to a multiple of
+four, the outputs need room for that.
+=================
+*/
+static void HRTF_Convolve (const float *in, int count, const hrir_t *hrir, float *outl, float *outr)
+{
+	int	n, k;
+#ifdef HRTF_SSE
+	__m128	accl, accr, x;
+
+	for (n = 0; n < count; n += 4)
+	{
+		accl = accr = _mm_setzero_ps ();
+		for (k = 0; k < HRIR_LENGTH; k++)
+		{
+			x = _mm_loadu_ps (in + n + k);
+			accl = _mm_add_ps (accl, _mm_mul_ps (_mm_set1_ps (hrir->left[k]), x));
+			accr = _mm_add_ps (accr, _mm_mul_ps (_mm_set1_ps (hrir->right[k]), x));
+		}
+		_mm_storeu_ps (outl + n, accl);
+		_mm_storeu_ps (outr + n, accr);
+	}
+#else
+	float	l, r;
+
+	for (n = 0; n < count; n++)
+	{
+		l = r = 0;
+		for (k = 0; k < HRIR_LENGTH; k++)
+		{
+			l += hrir->left[k] * in[n + k];
+			r += hrir->right[k] * in[n + k];
+		}
+		outl[n] = l;
+		outr[n] = r;
+	}
+#endif
+}
+
+/*
+=================
+HRTF_RunVoice
+
+convolves count samples already placed in hrtf_samples, crossfading to a new response if the direction changed,
+and leaves the result in hrtf_outl/hrtf_outr
+=================
+*/
+static void HRTF_RunVoice (hrtfvoice_t *voice, int count)
+{
+	float	step, t;
+	int	i;
+
+	memcpy (hrtf_input, voice->history, sizeof(voice->history));
+	memset (hrtf_samples + count, 0, 4 * sizeof(float));
+
+	if (voice->dir < 0)
+		voice->dir = voice->targetdir;
+
+	HRTF_Convolve (hrtf_input, count, &hrtf_table[voice->targetdir], hrtf_outl, hrtf_outr);
+
+	if (voice->dir != voice->targetdir)
+	{
+		HRTF_Convolve (hrtf_input, count, &hrtf_table[voice->dir], hrtf_fadel, hrtf_fader);
+		step = 1.0f / count;
+		for (i = 0, t = 0; i < count; i++, t += step)
+		{
+			hrtf_outl[i] = hrtf_fadel[i] + (hrtf_outl[i] - hrtf_fadel[i]) * t;
+			hrtf_outr[i] = hrtf_fader[i] + (hrtf_outr[i] - hrtf_fader[i]) * t;
+		}
+		voice->dir = voice->targetdir;
+	}
+
+// keep the tail of the input for the next block
+	memcpy (voice->history, hrtf_input + count, sizeof(voice->history));
+}
+
+/*
+===============================================================================
+
+INTERFACE
+
+===============================================================================
+*/
+
+static hrtfvoice_t *HRTF_Voice (channel_t *ch)
+{
+	int	i = ch - snd_channels - NUM_AMBIENTS;
+
+	if (i < 0 || i >= MAX_DYNAMIC_CHANNELS)
+		return NULL;
+	return &hrtf_voices[i];
+}
+
+/*
+=================
+SND_HRTF_Enabled
+=================
+*/
+qboolean SND_HRTF_Enabled (void)
+{
+	if (!snd_hrtf.value || !shm || shm->channels != 2)
+		return false;
+
+	if (hrtf_rate != shm->speed)
+		HRTF_BuildTable (shm->speed);
+
+	return hrtf_table != NULL;
+}
+
+/*
+=================
+SND_HRTF_Spatialize
+
+sets the response for a dynamic channel from the normalized direction
+to its source in world space. returns false for channels that are not
+spatialized with the HRTF.
+=================
+*/
+qboolean SND_HRTF_Spatialize (channel_t *ch, vec3_t dir)
+{
+	hrtfvoice_t	*voice;
+
+	voice = HRTF_Voice (ch);
+	if (!voice)
+		return false;
+
+	voice->targetdir = HRTF_Direction (DotProduct (dir, head_forward),
+			DotProduct (dir, head_right), DotProduct (dir, head_up));
+	return true;
+}
+
+/*
+=================
+SND_HRTF_ResetChannel
+
+forgets the state of a channel that starts playing a new sound
+=================
+*/
+void SND_HRTF_ResetChannel (channel_t *ch)
+{
+	hrtfvoice_t	*voice;
+
+	voice = HRTF_Voice (ch);
+	if (!voice)
+		return;
+
+	memset (voice->history, 0, sizeof(voice->history));
+	voice->dir = -1;
+	voice->targetdir = 0;
+	voice->paintedtime = -1;
+}
+
+/*
+=================
+SND_HRTF_IsVoice
+
+true for channels that the mixer has to run through SND_HRTF_PaintChannel
+=================
+*/
+qboolean SND_HRTF_IsVoice (channel_t *ch)
+{
+	return SND_HRTF_Enabled () && HRTF_Voice (ch) != NULL && ch->entnum != cl.viewentity;
+}
+
+/*
+=================
+SND_HRTF_PaintChannel
+
+mixes count samples of a channel starting at time ltime into out
+=================
+*/
+void SND_HRTF_PaintChannel (channel_t *ch, sfxcache_t *sc, int count, int ltime, portable_samplepair_t *out)
+{
+	hrtfvoice_t	*voice;
+	float	gain;
+	int	i, done, chunk;
+
+	voice = HRTF_Voice (ch);
+
+	// the voice was skipped for a while, its history is stale
+	if (voice->paintedtime != ltime)
+		memset (voice->history, 0, sizeof(voice->history));
+
+	// same scale as SND_PaintChannelFrom16
+	gain = ch->leftvol * sfxvolume.value;
+
+	for (done = 0; done < count; done += chunk)
+	{
+		chunk = q_min (count - done, HRTF_BLOCK);
+
+		if (sc->width == 1)
+		{
+			signed char *sfx = (signed char *)sc->data + ch->pos;
+			for (i = 0; i < chunk; i++)
+				hrtf_samples[i] = sfx[i] * 256 * gain;
+		}
+		else
+		{
+			signed short *sfx = (signed short *)sc->data + ch->pos;
+			for (i = 0; i < chunk; i++)
+				hrtf_samples[i] = sfx[i] * gain;
+		}
+
+		HRTF_RunVoice (voice, chunk);
+
+		for (i = 0; i < chunk; i++)
+		{
+			out[done + i].left += (int) hrtf_outl[i];
+			out[done + i].right += (int) hrtf_outr[i];
+		}
+
+		ch->pos += chunk;
+	}
+
+	voice->paintedtime = ltime + count;
+}
+
+/*
+=================
+S_SetHeadOrientation
+
+VR_UpdateScreenContent hands us the freshest head orientation each frame;
+without VR the listener orientation of S_Update is used.
+=================
+*/
+void S_SetHeadOrientation (vec3_t angles)
+{
+	AngleVectors (angles, head_forward, head_right, head_up);
+	head_fed = true;
+}
+
+/*
+=================
+SND_HRTF_Update
+
+called from S_Update after the listener has moved
+=================
+*/
+void SND_HRTF_Update (void)
+{
+	if (!head_fed)
+	{
+		VectorCopy (listener_forward, head_forward);
+		VectorCopy (listener_right, head_right);
+		VectorCopy (listener_up, head_up);
+	}
+	head_fed = false;
+}
+
+/*
+=================
+SND_HRTF_Benchmark_f
+
+snd_hrtfbench [voices] [seconds]: times the convolution of noise through
+the HRTF for the given number of voices, switching directions every
+block like moving sources would
+=================
+*/
+static void SND_HRTF_Benchmark_f (void)
+{
+	static hrtfvoice_t	benchvoices[MAX_DYNAMIC_CHANNELS];
+	int	voices, rate, samples, block, done, v, i;
+	double	seconds, time, pervoice;
+
+	voices = (Cmd_Argc () > 1) ? Q_atoi (Cmd_Argv (1)) : 32;
+	voices = CLAMP (1, voices, MAX_DYNAMIC_CHANNELS);
+	seconds = (Cmd_Argc () > 2) ? Q_atof (Cmd_Argv (2)) : 10;
+	seconds = CLAMP (0.1, seconds, 600);
+
+	rate = shm ? shm->speed : 44100;
+	if (hrtf_rate != rate)
+		HRTF_BuildTable (rate);
+	if (!hrtf_table)
+	{
+		Con_Printf ("HRTF table not available\n");
+		return;
+	}
+
+	for (v = 0; v < voices; v++)
+	{
+		memset (&benchvoices[v], 0, sizeof(hrtfvoice_t));
+		benchvoices[v].dir = -1;
+	}
+
+	samples = (int) (seconds * rate);
+	block = 512;
+	time = Sys_DoubleTime ();
+	for (done = 0; done < samples; done += block)
+	{
+		for (v = 0; v < voices; v++)
+		{
+			for (i = 0; i < block; i++)
+				hrtf_samples[i] = (float) ((rand () & 0xffff) - 0x8000);
+			benchvoices[v].targetdir = (v * 7 + done / block) % HRTF_DIRECTIONS;
+			HRTF_RunVoice (&benchvoices[v], block);
+		}
+	}
+	time = Sys_DoubleTime () - time;
+
+	pervoice = time / voices / (samples / (double) rate);
+	Con_Printf ("%i voices, %.1f seconds at %i Hz in %.3f seconds\n", voices, seconds, rate, time);
+	Con_Printf ("%.3f ms per voice per second of audio, %.2f%% of a core for %i voices\n",
+			pervoice * 1000.0, pervoice * voices * 100.0, voices);
+#ifdef HRTF_SSE
+	Con_Printf ("(includes noise generation, SSE convolution)\n");
+#else
+	Con_Printf ("(includes noise generation, scalar convolution)\n");
+#endif
+}
+
+/*
+=================
+SND_HRTF_Init
+=================
+*/
+void SND_HRTF_Init (void)
+{
+	int	i;
+
+	Cvar_RegisterVariable (&snd_hrtf);
+	Cmd_AddCommand ("snd_hrtfbench", SND_HRTF_Benchmark_f);
+
+	for (i = 0; i < MAX_DYNAMIC_CHANNELS; i++)
+		SND_HRTF_ResetChannel (&snd_channels[NUM_AMBIENTS + i]);
+}
+
@@ -25,20 +25,17 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 /*
 ================
 ResampleSfx
+
+safe to run on a worker thread: only touches sc and data
 ================
 */
-static void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
+static void ResampleSfx (sfxcache_t *sc, int inrate, int inwidth, byte *data)
 {
 	int		outcount;
 	int		srcsample;
 	float	stepscale;
 	int		i;
 	int		sample, samplefrac, fracstep;
-	sfxcache_t	*sc;
-
-	sc = (sfxcache_t *) Cache_Check (&sfx->cache);
-	if (!sc)
-		return;
 
 	stepscale = (float)inrate / shm->speed;	// this is usually 0.5, 1, or 2
 
@@ -83,6 +80,65 @@ static void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
 	}
 }
 
+/*
+==============
+S_ParseSound
+
+reads the wav header of a loaded sound and works out the size of its
+cache entry. returns false if the sound can't be used.
+==============
+*/
+static qboolean S_ParseSound (sfx_t *s, byte *data, int datalen, wavinfo_t *info, int *size)
+{
+	float	stepscale;
+	int		len;
+
+	*info = GetWavinfo (s->name, data, datalen);
+	if (info->channels != 1)
+	{
+		Con_Printf ("%s is a stereo sample\n",s->name);
+		return false;
+	}
+
+	if (info->width != 1 && info->width != 2)
+	{
+		Con_Printf("%s is not 8 or 16 bit\n", s->name);
+		return false;
+	}
+
+	stepscale = (float)info->rate / shm->speed;
+	len = info->samples / stepscale;
+
+	len = len * info->width * info->channels;
+
+	if (info->samples == 0 || len == 0)
+	{
+		Con_Printf("%s has zero samples\n", s->name);
+		return false;
+	}
+
+	*size = len + sizeof(sfxcache_t);
+	return true;
+}
+
+/*
+==============
+S_DecodeSound
+
+fills in a cache entry from the wav data. safe to run on a worker thread.
+==============
+*/
+static void S_DecodeSound (sfxcache_t *sc, const wavinfo_t *info, byte *data)
+{
+	sc->length = info->samples;
+	sc->loopstart = info->loopstart;
+	sc->speed = info->rate;
+	sc->width = info->width;
+	sc->stereo = info->channels;
+
+	ResampleSfx (sc, sc->speed, sc->width, data + info->dataofs);
+}
+
 //=============================================================================
 
 /*
@@ -95,8 +151,7 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	char	namebuffer[256];
 	byte	*data;
 	wavinfo_t	info;
-	int		len;
-	float	stepscale;
+	int		size;
 	sfxcache_t	*sc;
 	byte	stackbuf[1*1024];		// avoid dirtying the cache heap
 
@@ -121,43 +176,111 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 		return NULL;
 	}
 
-	info = GetWavinfo (s->name, data, com_filesize);
-	if (info.channels != 1)
-	{
-		Con_Printf ("%s is a stereo sample\n",s->name);
+	if (!S_ParseSound (s, data, com_filesize, &info, &size))
 		return NULL;
-	}
 
-	if (info.width != 1 && info.width != 2)
-	{
-		Con_Printf("%s is not 8 or 16 bit\n", s->name);
+	sc = (sfxcache_t *) Cache_Alloc ( &s->cache, size, s->name);
+	if (!sc)
 		return NULL;
-	}
 
-	stepscale = (float)info.rate / shm->speed;
-	len = info.samples / stepscale;
+	S_DecodeSound (sc, &info, data);
+
+	return sc;
+}
+
+/*
+==============
+S_LoadSounds
+
+loads a batch of sounds, as collected between S_BeginPrecaching and
+S_EndPrecaching. The files are read and the cache entries allocated
+here, since neither the filesystem nor the cache is thread safe, then
+the worker threads resample straight into the cache entries. Nothing
+touches the cache while they run, so the entries stay put.
+==============
+*/
+#define	SOUND_BATCH	64
+
+typedef struct
+{
+	sfx_t		*sfx;
+	byte		*data;		// malloc'd file contents
+	wavinfo_t	info;
+	int		size;		// of the cache entry
+	sfxcache_t	*sc;		// the cache entry, NULL if it was pushed out
+} soundload_t;
+
+static void S_DecodeSoundTask (int index, void *data)
+{
+	soundload_t	*load = (soundload_t *) data + index;
+
+	if (load->sc)
+		S_DecodeSound (load->sc, &load->info, load->data);
+}
+
+void S_LoadSounds (sfx_t **sfx, int count)
+{
+	soundload_t	batch[SOUND_BATCH];
+	char	namebuffer[256];
+	int		i, first, num;
+	double	time1, time2, time3;
+	double	readtime, decodetime, alloctime;
 
-	len = len * info.width * info.channels;
+	readtime = decodetime = alloctime = 0;
 
-	if (info.samples == 0 || len == 0)
+	for (first = 0; first < count; first += SOUND_BATCH)
 	{
-		Con_Printf("%s has zero samples\n", s->name);
-		return NULL;
-	}
+		time1 = Sys_DoubleTime ();
 
-	sc = (sfxcache_t *) Cache_Alloc ( &s->cache, len + sizeof(sfxcache_t), s->name);
-	if (!sc)
-		return NULL;
+	// read the files and parse the headers
+		num = 0;
+		for (i = first; i < count && i < first + SOUND_BATCH; i++)
+		{
+			if (Cache_Check (&sfx[i]->cache))
+				continue;
+
+			q_strlcpy(namebuffer, "sound/", sizeof(namebuffer));
+			q_strlcat(namebuffer, sfx[i]->name, sizeof(namebuffer));
+			batch[num].data = COM_LoadMallocFile (namebuffer, NULL);
+			if (!batch[num].data)
+			{
+				Con_Printf ("Couldn't load %s\n", namebuffer);
+				continue;
+			}
+			if (!S_ParseSound (sfx[i], batch[num].data, com_filesize, &batch[num].info, &batch[num].size))
+			{
+				free (batch[num].data);
+				continue;
+			}
+			batch[num].sfx = sfx[i];
+			batch[num].sc = NULL;
+			num++;
+		}
 
-	sc->length = info.samples;
-	sc->loopstart = info.loopstart;
-	sc->speed = info.rate;
-	sc->width = info.width;
-	sc->stereo = info.channels;
+		time2 = Sys_DoubleTime ();
 
-	ResampleSfx (s, sc->speed, sc->width, data + info.dataofs);
+	// make the cache entries. a small cache may push out earlier ones of
+	// the batch again, those are left to S_LoadSound
+		for (i = 0; i < num; i++)
+			Cache_Alloc (&batch[i].sfx->cache, batch[i].size, batch[i].sfx->name);
+		for (i = 0; i < num; i++)
+			batch[i].sc = (sfxcache_t *) batch[i].sfx->cache.data;
 
-	return sc;
+		time3 = Sys_DoubleTime ();
+
+	// resample
+		Tasks_ParallelFor (S_DecodeSoundTask, num, batch);
+
+		for (i = 0; i < num; i++)
+			free (batch[i].data);
+
+		readtime += time2 - time1;
+		alloctime += time3 - time2;
+		decodetime += Sys_DoubleTime () - time3;
+	}
+
+	Con_DPrintf ("%i sounds loaded: read %.1f ms, cache %.1f ms, decode %.1f ms, %i workers\n",
+			count, readtime * 1000.0, alloctime * 1000.0, decodetime * 1000.0, Tasks_NumWorkers ());
 }
 
 
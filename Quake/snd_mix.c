@@ -333,10 +333,50 @@ CHANNEL MIXING
 static void SND_PaintChannelFrom8 (channel_t *ch, sfxcache_t *sc, int endtime, int paintbufferstart);
 static void SND_PaintChannelFrom16 (channel_t *ch, sfxcache_t *sc, int endtime, int paintbufferstart);
 
+/*
+==============
+SND_SyncChannel
+
+moves the play position of a silent (virtual) channel up to endtime
+without mixing it, so that it resumes at the right offset once it
+becomes audible again. pos + (end - time) == length always holds for
+a playing channel, which lets us jump there directly.
+==============
+*/
+void SND_SyncChannel (channel_t *ch, int endtime)
+{
+	sfxcache_t	*sc;
+	int		looplength;
+
+	// don't pull evicted sounds back in from disk just to skip them
+	sc = (sfxcache_t *) Cache_Check (&ch->sfx->cache);
+	if (!sc)
+		return;
+
+	if (endtime < ch->end)
+	{
+		ch->pos = sc->length - (ch->end - endtime);
+		if (ch->pos < 0)
+			ch->pos = 0;
+		return;
+	}
+
+	looplength = sc->length - sc->loopstart;
+	if (sc->loopstart < 0 || looplength <= 0)
+	{	// channel just stopped
+		ch->sfx = NULL;
+		return;
+	}
+
+	ch->pos = sc->loopstart + (endtime - ch->end) % looplength;
+	ch->end = endtime + sc->length - ch->pos;
+}
+
 void S_PaintChannels (int endtime)
 {
 	int		i;
 	int		end, ltime, count;
+	qboolean	hrtf;
 	channel_t	*ch;
 	sfxcache_t	*sc;
 
@@ -359,12 +399,17 @@ void S_PaintChannels (int endtime)
 			if (!ch->sfx)
 				continue;
 			if (!ch->leftvol && !ch->rightvol)
+			{	// static sounds are synced when they come back in reach
+				if (i < MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS)
+					SND_SyncChannel (ch, end);
 				continue;
+			}
 			sc = S_LoadSound (ch->sfx);
 			if (!sc)
 				continue;
 
 			ltime = paintedtime;
+			hrtf = SND_HRTF_IsVoice(ch);
 
 			while (ltime < end)
 			{	// paint up to end
@@ -377,7 +422,9 @@ void S_PaintChannels (int endtime)
 				{
 					// the last param to SND_PaintChannelFrom is the index
 					// to start painting to in the paintbuffer, usually 0.
-					if (sc->width == 1)
+					if (hrtf)
+						SND_HRTF_PaintChannel(ch, sc, count, ltime, paintbuffer + (ltime - paintedtime));
+					else if (sc->width == 1)
 						SND_PaintChannelFrom8(ch, sc, count, ltime - paintedtime);
 					else
 						SND_PaintChannelFrom16(ch, sc, count, ltime - paintedtime);
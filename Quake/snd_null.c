@@ -0,0 +1,239 @@
+/*
+ * snd_null.c - headless sound output driver
+ *
+ * Mixes into a memory buffer that is "played" at the pace of the game
+ * clock instead of an audio device, so the mixer can be run without
+ * sound hardware. With -sndwav <file>, everything the mixer produces
+ * is written to a WAV file in the game directory. During a timedemo
+ * the clock follows the demo's own timestamps, which makes the output
+ * reproducible from run to run.
+ *
+ * Copyright (C) 2010-2014 QuakeSpasm developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "quakedef.h"
+
+#define	NULL_BUFFER_SAMPLES	65536	/* mono samples, power of two */
+
+static FILE	*wavfile;
+static int	wavbytes;		/* bytes of sample data written */
+
+static double	clock_last;		/* game clock at the last DMA query */
+static double	clock_frames;		/* sample pairs played, unrounded */
+static int	played;			/* sample pairs played */
+static int	written;		/* sample pairs written to the wav */
+
+static void WAV_PutLong (int val)
+{
+	val = LittleLong (val);
+	fwrite (&val, 4, 1, wavfile);
+}
+
+static void WAV_PutShort (short val)
+{
+	val = LittleShort (val);
+	fwrite (&val, 2, 1, wavfile);
+}
+
+static void WAV_WriteHeader (void)
+{
+	int	bytes_per_sample = shm->samplebits / 8;
+
+	fseek (wavfile, 0, SEEK_SET);
+	fwrite ("RIFF", 4, 1, wavfile);
+	WAV_PutLong (36 + wavbytes);
+	fwrite ("WAVEfmt ", 8, 1, wavfile);
+	WAV_PutLong (16);
+	WAV_PutShort (WAV_FORMAT_PCM);
+	WAV_PutShort (shm->channels);
+	WAV_PutLong (shm->speed);
+	WAV_PutLong (shm->speed * shm->channels * bytes_per_sample);
+	WAV_PutShort (shm->channels * bytes_per_sample);
+	WAV_PutShort (shm->samplebits);
+	fwrite ("data", 4, 1, wavfile);
+	WAV_PutLong (wavbytes);
+	fseek (wavfile, 0, SEEK_END);
+}
+
+static void WAV_Open (const char *filename)
+{
+	char	name[MAX_OSPATH];
+
+	q_snprintf (name, sizeof(name), "%s/%s", com_gamedir, filename);
+	COM_AddExtension (name, ".wav", sizeof(name));
+
+	wavfile = fopen (name, "wb");
+	if (!wavfile)
+	{
+		Con_Printf ("Couldn't open %s for writing\n", name);
+		return;
+	}
+	wavbytes = 0;
+	WAV_WriteHeader ();
+	Con_Printf ("Writing sound output to %s\n", name);
+}
+
+static void WAV_Close (void)
+{
+	if (!wavfile)
+		return;
+	WAV_WriteHeader ();
+	fclose (wavfile);
+	wavfile = NULL;
+	Con_Printf ("Wrote %i bytes of sound output\n", wavbytes);
+}
+
+/* writes count samples (not pairs) starting at ring buffer index ofs */
+static void WAV_WriteSamples (int ofs, int count)
+{
+	int	i;
+	short	*in;
+
+	if (shm->samplebits == 16 && host_bigendian)
+	{
+		in = (short *)shm->buffer + ofs;
+		for (i = 0; i < count; i++)
+			WAV_PutShort (in[i]);
+	}
+	else
+	{
+		fwrite (shm->buffer + ofs * (shm->samplebits / 8), shm->samplebits / 8, count, wavfile);
+	}
+	wavbytes += count * (shm->samplebits / 8);
+}
+
+qboolean SNDDMA_UsesDefaultDevice (void)
+{
+	return true;
+}
+
+qboolean SNDDMA_Init (dma_t *dma)
+{
+	int	i;
+
+	memset ((void *) dma, 0, sizeof(dma_t));
+	shm = dma;
+
+	shm->samplebits = (loadas8bit.value) ? 8 : 16;
+	shm->signed8 = 0;
+	shm->speed = snd_mixspeed.value;
+	shm->channels = 2;
+	shm->samples = NULL_BUFFER_SAMPLES;
+	shm->samplepos = 0;
+	shm->submission_chunk = 1;
+
+	shm->buffer = (unsigned char *) calloc (1, shm->samples * (shm->samplebits / 8));
+	if (!shm->buffer)
+	{
+		shm = NULL;
+		Con_Printf ("Failed allocating memory for null sound\n");
+		return false;
+	}
+	if (shm->samplebits == 8)
+		memset (shm->buffer, 0x80, shm->samples);
+
+	clock_last = -1;
+	clock_frames = 0;
+	played = written = 0;
+
+	Con_Printf ("Null sound driver: %d samples buffer\n", shm->samples);
+
+	i = COM_CheckParm ("-sndwav");
+	if (i && i < com_argc-1)
+		WAV_Open (com_argv[i+1]);
+
+	return true;
+}
+
+/*
+the device plays at the rate of the game clock: demo time in a timedemo,
+real time otherwise. It never plays past what the mixer has painted, so
+the output has no gaps however fast the frames go by.
+*/
+int SNDDMA_GetDMAPos (void)
+{
+	double	now, delta;
+	int	target;
+
+	now = (cls.timedemo) ? cl.time : realtime;
+	delta = (clock_last < 0) ? 0 : now - clock_last;
+	clock_last = now;
+	if (delta > 0)	/* cl.time goes back to zero on map changes */
+		clock_frames += delta * shm->speed;
+
+	if (paintedtime < played)	/* S_Update_ chopped the 32 bit time */
+		played = written = paintedtime;
+
+	target = (int) clock_frames;
+	target = q_min (target, paintedtime);
+	target = q_min (target, played + (shm->samples / shm->channels) - 1);
+	if (target > played)
+		played = target;
+	/* don't let a backlog grow past what the buffer can hold */
+	clock_frames = q_min (clock_frames, (double) played + (shm->samples / shm->channels));
+
+	shm->samplepos = (played * shm->channels) & (shm->samples - 1);
+	return shm->samplepos;
+}
+
+void SNDDMA_Shutdown (void)
+{
+	if (shm)
+	{
+		Con_Printf ("Shutting down null sound\n");
+		WAV_Close ();
+		if (shm->buffer)
+			free (shm->buffer);
+		shm->buffer = NULL;
+		shm = NULL;
+	}
+}
+
+void SNDDMA_LockBuffer (void)
+{
+}
+
+/* writes out everything painted since the last submit */
+void SNDDMA_Submit (void)
+{
+	int	ofs, count, mask;
+
+	if (!shm || !wavfile)
+	{
+		written = paintedtime;
+		return;
+	}
+
+	mask = shm->samples - 1;
+	while (written < paintedtime)
+	{
+		ofs = (written * shm->channels) & mask;
+		count = q_min ((paintedtime - written) * shm->channels, shm->samples - ofs);
+		WAV_WriteSamples (ofs, count);
+		written += count / shm->channels;
+	}
+}
+
+void SNDDMA_BlockSound (void)
+{
+}
+
+void SNDDMA_UnblockSound (void)
+{
+}
+
@@ -103,6 +103,7 @@ void SV_Init (void)
 	Cvar_RegisterVariable (&sv_altnoclip); //johnfitz
 
 	Cmd_AddCommand ("sv_protocol", &SV_Protocol_f); //johnfitz
+	SV_InitStates ();
 
 	for (i=0 ; i<MAX_MODELS ; i++)
 		sprintf (localmodels[i], "*%i", i);
@@ -1294,6 +1295,7 @@ void SV_SpawnServer (const char *server)
 
 	Con_DPrintf ("SpawnServer: %s\n",server);
 	svs.changelevel_issued = false;		// now safe to issue another
+	SV_ClearStates ();			// they point into the old map's hunk
 
 //
 // tell all connected clients that we are going to a new level
@@ -1323,6 +1325,7 @@ void SV_SpawnServer (const char *server)
 	Host_ClearMemory ();
 
 	q_strlcpy (sv.name, server, sizeof(sv.name));
+	Memory_BeginMap (sv.name);
 
 	sv.protocol = sv_protocol; // johnfitz
 
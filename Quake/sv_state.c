@@ -0,0 +1,315 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2002-2009 John Fitzgibbons and others
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sv_state.c -- in-memory server states, for quick restarts and rewinding
+
+#include "quakedef.h"
+
+/*
+A state is a raw copy of the edicts, the progs globals, the light styles
+and the client spawn parms. Strings allocated by the progs are never
+freed while the map is up, so string_t values stay valid and nothing
+needs fixing up: restoring is a couple of block copies and a relink.
+All states are dropped when a new map is spawned.
+*/
+
+#define	MAX_REWIND_STATES	64
+
+typedef struct
+{
+	qboolean	valid;
+	double		time;			// sv.time
+	int		num_edicts;
+	byte		*edicts;		// num_edicts * pr_edict_size
+	int		maxedicts;		// room in edicts
+	int		*globals;		// progs->numglobals
+	const char	*lightstyles[MAX_LIGHTSTYLES];
+	float		spawn_parms[MAX_SCOREBOARD][NUM_SPAWN_PARMS];
+} svstate_t;
+
+static svstate_t	sv_quickstate;			// savestate / loadstate
+static svstate_t	sv_rewind[MAX_REWIND_STATES];	// ring of periodic states
+static int		rewind_slots;			// sv_rewind_states the ring was started with
+static int		rewind_head;			// next slot to record into
+static int		rewind_count;
+static double		rewind_last;			// sv.time of the last periodic state
+
+cvar_t	sv_rewind_interval = {"sv_rewind_interval", "0", CVAR_NONE}; // seconds, 0 disables
+cvar_t	sv_rewind_states = {"sv_rewind_states", "10", CVAR_NONE};
+
+/*
+================
+SV_FreeState
+================
+*/
+static void SV_FreeState (svstate_t *st)
+{
+	free (st->edicts);
+	free (st->globals);
+	memset (st, 0, sizeof(*st));
+}
+
+/*
+================
+SV_ClearStates -- drops every state, they only apply to the map they were taken on
+================
+*/
+void SV_ClearStates (void)
+{
+	int	i;
+
+	SV_FreeState (&sv_quickstate);
+	for (i = 0; i < MAX_REWIND_STATES; i++)
+		SV_FreeState (&sv_rewind[i]);
+	rewind_slots = rewind_head = rewind_count = 0;
+	rewind_last = 0;
+}
+
+/*
+================
+SV_CaptureState -- reuses the buffers of whatever st held before
+================
+*/
+static void SV_CaptureState (svstate_t *st)
+{
+	int	i;
+
+	if (!st->globals)
+		st->globals = (int *) malloc (progs->numglobals * 4);
+	if (st->maxedicts < sv.num_edicts)
+	{
+		st->maxedicts = sv.max_edicts;
+		free (st->edicts);
+		st->edicts = (byte *) malloc (st->maxedicts * pr_edict_size);
+	}
+	if (!st->globals || !st->edicts)
+		Sys_Error ("SV_CaptureState: out of memory");
+
+	st->time = sv.time;
+	st->num_edicts = sv.num_edicts;
+	memcpy (st->edicts, sv.edicts, sv.num_edicts * pr_edict_size);
+	memcpy (st->globals, pr_globals, progs->numglobals * 4);
+	memcpy (st->lightstyles, sv.lightstyles, sizeof(st->lightstyles));
+	for (i = 0; i < svs.maxclients && i < MAX_SCOREBOARD; i++)
+		memcpy (st->spawn_parms[i], svs.clients[i].spawn_parms, sizeof(st->spawn_parms[i]));
+	st->valid = true;
+}
+
+/*
+================
+SV_RestoreState
+================
+*/
+static void SV_RestoreState (const svstate_t *st)
+{
+	edict_t		*ent;
+	client_t	*client;
+	int		i, j;
+
+// take everything out of the world before the links get overwritten
+	for (i = 0; i < sv.num_edicts; i++)
+		SV_UnlinkEdict (EDICT_NUM(i));
+
+	memcpy (sv.edicts, st->edicts, st->num_edicts * pr_edict_size);
+	for (i = st->num_edicts; i < sv.num_edicts; i++)
+	{
+		ent = EDICT_NUM(i);
+		memset (&ent->v, 0, progs->entityfields * 4);
+		ent->free = true;
+		ent->freetime = 0;
+	}
+	sv.num_edicts = st->num_edicts;
+	sv.time = st->time;
+	memcpy (pr_globals, st->globals, progs->numglobals * 4);
+
+	for (i = 0; i < sv.num_edicts; i++)
+	{
+		ent = EDICT_NUM(i);
+		ent->area.prev = ent->area.next = NULL;
+		if (!ent->free)
+			SV_LinkEdict (ent, false);
+	}
+
+	memcpy (sv.lightstyles, st->lightstyles, sizeof(sv.lightstyles));
+	for (j = 0, client = svs.clients; j < svs.maxclients; j++, client++)
+	{
+		if (!client->active)
+			continue;
+		if (j < MAX_SCOREBOARD)
+			memcpy (client->spawn_parms, st->spawn_parms[j], sizeof(client->spawn_parms));
+		client->old_frags = -1;		// resend the frags
+		client->edict->v.fixangle = 1;	// turn the view to the restored angles
+		for (i = 0; i < MAX_LIGHTSTYLES; i++)
+		{
+			MSG_WriteChar (&client->message, svc_lightstyle);
+			MSG_WriteChar (&client->message, i);
+			MSG_WriteString (&client->message, sv.lightstyles[i] ? sv.lightstyles[i] : "");
+		}
+	}
+}
+
+/*
+================
+SV_RecordState -- called every server frame, keeps the rewind ring going
+================
+*/
+void SV_RecordState (void)
+{
+	int	slots;
+
+	if (sv_rewind_interval.value <= 0 || sv.state != ss_active)
+		return;
+	if (sv.time < rewind_last + sv_rewind_interval.value && rewind_count)
+		return;
+
+	slots = CLAMP (1, (int) sv_rewind_states.value, MAX_REWIND_STATES);
+	if (slots != rewind_slots)
+	{	// start over
+		rewind_slots = slots;
+		rewind_head = rewind_count = 0;
+	}
+	SV_CaptureState (&sv_rewind[rewind_head]);
+	rewind_head = (rewind_head + 1) % slots;
+	rewind_count = q_min (rewind_count + 1, slots);
+	rewind_last = sv.time;
+}
+
+/*
+================
+SV_CanUseStates
+================
+*/
+static qboolean SV_CanUseStates (void)
+{
+	if (cmd_source != src_command)
+		return false;
+
+	if (!sv.active || sv.state != ss_active)
+	{
+		Con_Printf ("Not playing a local game.\n");
+		return false;
+	}
+	return true;
+}
+
+/*
+================
+SV_SaveState_f
+================
+*/
+static void SV_SaveState_f (void)
+{
+	double	start;
+
+	if (!SV_CanUseStates ())
+		return;
+
+	start = Sys_DoubleTime ();
+	SV_CaptureState (&sv_quickstate);
+	Con_Printf ("State saved (%i edicts, %.2f ms)\n", sv.num_edicts, (Sys_DoubleTime () - start) * 1000.0);
+}
+
+/*
+================
+SV_LoadState_f
+================
+*/
+static void SV_LoadState_f (void)
+{
+	double	start;
+
+	if (!SV_CanUseStates ())
+		return;
+
+	if (!sv_quickstate.valid)
+	{
+		Con_Printf ("No state saved on this map.\n");
+		return;
+	}
+
+	start = Sys_DoubleTime ();
+	SV_RestoreState (&sv_quickstate);
+	rewind_last = sv.time;
+	Con_Printf ("State restored (%.2f ms)\n", (Sys_DoubleTime () - start) * 1000.0);
+}
+
+/*
+================
+SV_Rewind_f
+
+rewind [states] -- goes back that many periodic states, 1 by default.
+the state rewound to and the newer ones are dropped, so rewinding again
+goes further back.
+================
+*/
+static void SV_Rewind_f (void)
+{
+	int	steps, slot;
+	double	start, from;
+
+	if (!SV_CanUseStates ())
+		return;
+
+	steps = (Cmd_Argc () > 1) ? atoi (Cmd_Argv (1)) : 1;
+	if (steps < 1)
+	{
+		Con_Printf ("rewind [states] : go back to an earlier state, %i recorded\n", rewind_count);
+		return;
+	}
+	if (!rewind_count)
+	{
+		if (sv_rewind_interval.value <= 0)
+			Con_Printf ("Nothing to rewind to, set sv_rewind_interval to record states.\n");
+		else
+			Con_Printf ("Nothing to rewind to.\n");
+		return;
+	}
+	steps = q_min (steps, rewind_count);
+
+	slot = (rewind_head - steps + rewind_slots) % rewind_slots;
+	if (!sv_rewind[slot].valid)
+	{
+		Con_Printf ("Nothing to rewind to.\n");
+		return;
+	}
+
+	start = Sys_DoubleTime ();
+	from = sv.time;
+	SV_RestoreState (&sv_rewind[slot]);
+	rewind_head = slot;
+	rewind_count -= steps;
+	rewind_last = sv.time;
+	Con_Printf ("Rewound %.1f seconds (%.2f ms)\n", from - sv.time, (Sys_DoubleTime () - start) * 1000.0);
+}
+
+/*
+================
+SV_InitStates
+================
+*/
+void SV_InitStates (void)
+{
+	Cvar_RegisterVariable (&sv_rewind_interval);
+	Cvar_RegisterVariable (&sv_rewind_states);
+	Cmd_AddCommand ("savestate", SV_SaveState_f);
+	Cmd_AddCommand ("loadstate", SV_LoadState_f);
+	Cmd_AddCommand ("rewind", SV_Rewind_f);
+}
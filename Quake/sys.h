@@ -42,6 +42,17 @@ int Sys_FileWrite (int handle,const void *data, int count);
 int Sys_FileTime (const char *path);
 void Sys_mkdir (const char *path);
 
+// maps a whole file read-only into memory, returns NULL if it can't.
+// the view keeps its size if the file grows, until Sys_UnmapFile.
+void *Sys_MapFile (const char *path, int *size);
+void Sys_UnmapFile (void *base, int size);
+
+// reserves address space without backing it, returns NULL if it can't.
+// committed pages read as zero, decommitted ones go back to the system.
+void *Sys_ReserveMemory (int size);
+qboolean Sys_CommitMemory (void *base, int size);
+void Sys_DecommitMemory (void *base, int size);
+
 //
 // system IO
 //
@@ -32,6 +32,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <time.h>
 #ifdef DO_USERDIRS
@@ -367,6 +368,62 @@ void Sys_mkdir (const char *path)
 	}
 }
 
+void *Sys_MapFile (const char *path, int *size)
+{
+	struct stat st;
+	void	*base;
+	int	fd;
+
+	*size = 0;
+	fd = open (path, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+	if (fstat (fd, &st) != 0 || st.st_size <= 0 || st.st_size > 0x7fffffff)
+	{
+		close (fd);
+		return NULL;
+	}
+
+	base = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd); //the mapping holds its own reference
+	if (base == MAP_FAILED)
+		return NULL;
+
+	*size = (int) st.st_size;
+	return base;
+}
+
+void Sys_UnmapFile (void *base, int size)
+{
+	if (base)
+		munmap (base, (size_t) size);
+}
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+void *Sys_ReserveMemory (int size)
+{
+	void	*base;
+
+	base = mmap (NULL, (size_t) size, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+	if (base == MAP_FAILED)
+		return NULL;
+	return base;
+}
+
+qboolean Sys_CommitMemory (void *base, int size)
+{
+	return mprotect (base, (size_t) size, PROT_READ | PROT_WRITE) == 0;
+}
+
+void Sys_DecommitMemory (void *base, int size)
+{
+	//mapping fresh pages over the range drops the old ones
+	mmap (base, (size_t) size, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE | MAP_FIXED, -1, 0);
+}
+
 static const char errortxt1[] = "\nERROR-OUT BEGIN\n\n";
 static const char errortxt2[] = "\nQUAKE ERROR: ";
 
@@ -287,6 +287,58 @@ void Sys_mkdir (const char *path)
 		Sys_Error("Unable to create directory %s", path);
 }
 
+void *Sys_MapFile (const char *path, int *size)
+{
+	HANDLE	file, mapping;
+	DWORD	high, low;
+	void	*base;
+
+	*size = 0;
+	file = CreateFile (path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+			   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+	low = GetFileSize (file, &high);
+	if (low == INVALID_FILE_SIZE || high || !low || low > 0x7fffffff)
+	{
+		CloseHandle (file);
+		return NULL;
+	}
+
+	mapping = CreateFileMapping (file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle (file);
+	if (!mapping)
+		return NULL;
+	base = MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle (mapping); //the view holds its own reference
+	if (!base)
+		return NULL;
+
+	*size = (int) low;
+	return base;
+}
+
+void Sys_UnmapFile (void *base, int size)
+{
+	if (base)
+		UnmapViewOfFile (base);
+}
+
+void *Sys_ReserveMemory (int size)
+{
+	return VirtualAlloc (NULL, (SIZE_T) size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+qboolean Sys_CommitMemory (void *base, int size)
+{
+	return VirtualAlloc (base, (SIZE_T) size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+void Sys_DecommitMemory (void *base, int size)
+{
+	VirtualFree (base, (SIZE_T) size, MEM_DECOMMIT);
+}
+
 static const char errortxt1[] = "\nERROR-OUT BEGIN\n\n";
 static const char errortxt2[] = "\nQUAKE ERROR: ";
 
@@ -0,0 +1,303 @@
+/*
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// tasks.c -- worker thread pool
+
+#include "quakedef.h"
+
+#if defined(SDL_FRAMEWORK) || defined(NO_SDL_CONFIG)
+#if defined(USE_SDL2)
+#include <SDL2/SDL.h>
+#else
+#include <SDL/SDL.h>
+#endif
+#else
+#include "SDL.h"
+#endif
+
+#define	MAX_WORKERS	16
+
+static SDL_Thread	*workers[MAX_WORKERS];
+static int		num_workers;
+
+static SDL_mutex	*task_lock;
+static SDL_cond		*task_wake;	// signalled when there is work, or on shutdown
+static SDL_cond		*task_done;	// signalled when the last item of a job is done
+
+static taskfunc_t	task_func;	// NULL when no job is running
+static void		*task_data;
+static int		task_count;
+static int		task_next;	// next item to hand out
+static int		task_pending;	// items not finished yet
+static qboolean		task_quit;
+
+static SDL_Thread	*bg_thread;	// the background job, NULL when there is none
+static SDL_mutex	*bg_lock;
+static taskfunc_t	bg_func;
+static void		*bg_data;
+static qboolean		bg_done;
+
+/*
+================
+Tasks_RunItems
+
+hands out and runs items of the current job until there are none left.
+called and returns with task_lock held.
+================
+*/
+static void Tasks_RunItems (void)
+{
+	taskfunc_t	func;
+	void		*data;
+	int		index;
+
+	while (task_func && task_next < task_count)
+	{
+		func = task_func;
+		data = task_data;
+		index = task_next++;
+
+		SDL_UnlockMutex (task_lock);
+		func (index, data);
+		SDL_LockMutex (task_lock);
+
+		if (--task_pending == 0)
+			SDL_CondBroadcast (task_done);
+	}
+}
+
+static int SDLCALL Tasks_Worker (void *unused)
+{
+	SDL_LockMutex (task_lock);
+	while (!task_quit)
+	{
+		Tasks_RunItems ();
+		if (!task_quit)
+			SDL_CondWait (task_wake, task_lock);
+	}
+	SDL_UnlockMutex (task_lock);
+	return 0;
+}
+
+/*
+================
+Tasks_Init
+
+the number of workers defaults to one less than the number of CPUs,
+and can be set with -threads <n>. -threads 0 runs everything serially.
+================
+*/
+void Tasks_Init (void)
+{
+	int	i, count;
+
+#if defined(USE_SDL2)
+	count = SDL_GetCPUCount () - 1;
+#else
+	count = 1;
+#endif
+	i = COM_CheckParm ("-threads");
+	if (i && i < com_argc-1)
+		count = Q_atoi (com_argv[i+1]);
+	count = CLAMP (0, count, MAX_WORKERS);
+
+	num_workers = 0;
+	if (!count)
+		return;
+
+	task_lock = SDL_CreateMutex ();
+	task_wake = SDL_CreateCond ();
+	task_done = SDL_CreateCond ();
+	if (!task_lock || !task_wake || !task_done)
+	{
+		Con_Printf ("Tasks_Init: %s\n", SDL_GetError ());
+		return;
+	}
+
+	task_quit = false;
+	for (i = 0; i < count; i++)
+	{
+#if defined(USE_SDL2)
+		workers[i] = SDL_CreateThread (Tasks_Worker, "worker", NULL);
+#else
+		workers[i] = SDL_CreateThread (Tasks_Worker, NULL);
+#endif
+		if (!workers[i])
+			break;
+		num_workers++;
+	}
+
+	Con_Printf ("%d worker threads\n", num_workers);
+}
+
+/*
+================
+Tasks_Shutdown
+================
+*/
+void Tasks_Shutdown (void)
+{
+	int	i;
+
+	Tasks_WaitBackground ();
+	if (bg_lock)
+	{
+		SDL_DestroyMutex (bg_lock);
+		bg_lock = NULL;
+	}
+
+	if (!num_workers)
+		return;
+
+	SDL_LockMutex (task_lock);
+	task_quit = true;
+	SDL_CondBroadcast (task_wake);
+	SDL_UnlockMutex (task_lock);
+
+	for (i = 0; i < num_workers; i++)
+		SDL_WaitThread (workers[i], NULL);
+	num_workers = 0;
+
+	SDL_DestroyCond (task_done);
+	SDL_DestroyCond (task_wake);
+	SDL_DestroyMutex (task_lock);
+}
+
+int Tasks_NumWorkers (void)
+{
+	return num_workers;
+}
+
+/*
+================
+Tasks_ParallelFor
+================
+*/
+void Tasks_ParallelFor (taskfunc_t func, int count, void *data)
+{
+	int	i;
+
+	if (!num_workers || count <= 1)
+	{
+		for (i = 0; i < count; i++)
+			func (i, data);
+		return;
+	}
+
+	SDL_LockMutex (task_lock);
+	task_func = func;
+	task_data = data;
+	task_count = count;
+	task_next = 0;
+	task_pending = count;
+	SDL_CondBroadcast (task_wake);
+
+// lend a hand, then wait for the items still running on the workers
+	Tasks_RunItems ();
+	while (task_pending > 0)
+		SDL_CondWait (task_done, task_lock);
+
+	task_func = NULL;
+	SDL_UnlockMutex (task_lock);
+}
+
+/*
+================
+Tasks_BackgroundThread
+================
+*/
+static int SDLCALL Tasks_BackgroundThread (void *unused)
+{
+	bg_func (0, bg_data);
+
+	SDL_LockMutex (bg_lock);
+	bg_done = true;
+	SDL_UnlockMutex (bg_lock);
+	return 0;
+}
+
+/*
+================
+Tasks_Background
+
+waits for the previous background job, then runs func (0, data) on a
+thread of its own. if no thread can be started the job runs right away.
+returns true if it went to the background.
+================
+*/
+qboolean Tasks_Background (taskfunc_t func, void *data)
+{
+	Tasks_WaitBackground ();
+
+	if (!bg_lock)
+		bg_lock = SDL_CreateMutex ();
+	if (bg_lock)
+	{
+		bg_func = func;
+		bg_data = data;
+		bg_done = false;
+#if defined(USE_SDL2)
+		bg_thread = SDL_CreateThread (Tasks_BackgroundThread, "background", NULL);
+#else
+		bg_thread = SDL_CreateThread (Tasks_BackgroundThread, NULL);
+#endif
+		if (bg_thread)
+			return true;
+	}
+
+	func (0, data);
+	return false;
+}
+
+/*
+================
+Tasks_BackgroundBusy -- whether the background job is still running, reaps it once it's done
+================
+*/
+qboolean Tasks_BackgroundBusy (void)
+{
+	qboolean	done;
+
+	if (!bg_thread)
+		return false;
+
+	SDL_LockMutex (bg_lock);
+	done = bg_done;
+	SDL_UnlockMutex (bg_lock);
+	if (!done)
+		return true;
+
+	SDL_WaitThread (bg_thread, NULL);
+	bg_thread = NULL;
+	return false;
+}
+
+/*
+================
+Tasks_WaitBackground
+================
+*/
+void Tasks_WaitBackground (void)
+{
+	if (!bg_thread)
+		return;
+
+	SDL_WaitThread (bg_thread, NULL);
+	bg_thread = NULL;
+}
@@ -0,0 +1,48 @@
+/*
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef __TASKS_H
+#define __TASKS_H
+
+/* worker thread pool for load time work.
+ * task functions run on other threads: they must not touch the hunk,
+ * zone, cache, filesystem, console or GL. */
+
+typedef void (*taskfunc_t) (int index, void *data);
+
+void	Tasks_Init (void);
+void	Tasks_Shutdown (void);
+int	Tasks_NumWorkers (void);
+
+/* runs func (i, data) for every i in [0, count) spread over the workers
+ * and the calling thread, and returns once all of them are done.
+ * must only be called from the main thread. */
+void	Tasks_ParallelFor (taskfunc_t func, int count, void *data);
+
+/* one job at a time on a thread of its own, for work the main thread
+ * shouldn't wait for, like writing a file out. the same restrictions
+ * apply, except that it may use stdio on files nobody else touches.
+ * main thread only. */
+qboolean	Tasks_Background (taskfunc_t func, void *data);
+qboolean	Tasks_BackgroundBusy (void);
+void	Tasks_WaitBackground (void);
+
+#endif	/* __TASKS_H */
+
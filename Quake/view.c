@@ -546,6 +546,7 @@ void V_PolyBlend (void)
 	glVertex2f (1, 1);
 	glVertex2f (0, 1);
 	glEnd ();
+	rs_drawcalls++;
 
 	glDisable (GL_BLEND);
 	glEnable (GL_DEPTH_TEST);
@@ -542,6 +542,9 @@ void VR_UpdateScreenContent()
 	VectorCopy (cl.viewangles, r_refdef.viewangles);
 	VectorCopy (cl.aimangles, r_refdef.aimangles);
 
+	// Let the HRTF follow the freshest head pose
+	S_SetHeadOrientation (r_refdef.viewangles);
+
 
 	// Calculate eye poses
 	view_offset[0] = eyes[0].render_desc.HmdToEyeOffset;
@@ -688,6 +691,7 @@ void VR_ShowCrosshair ()
 			glBegin(GL_POINTS);
 			glVertex3f (impact[0], impact[1], impact[2]);
 			glEnd();
+			rs_drawcalls++;
 			glDisable(GL_POINT_SMOOTH);
 			break;
 
@@ -702,6 +706,7 @@ void VR_ShowCrosshair ()
 			glVertex3f (start[0], start[1], start[2]);
 			glVertex3f (impact[0], impact[1], impact[2]);
 			glEnd ();
+			rs_drawcalls++;
 			break;
 	}
 
@@ -792,6 +797,7 @@ void VR_Draw2D()
 		M_Draw ();
 	}
 
+	Draw_Flush ();
 	glDisable (GL_BLEND);
 	glEnable (GL_DEPTH_TEST);
 	glPopMatrix();
@@ -831,6 +837,7 @@ void VR_DrawSbar()
 
 	Sbar_Draw ();
 
+	Draw_Flush ();
 	glEnable (GL_DEPTH_TEST);
 	glPopMatrix();
 }
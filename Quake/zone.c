@@ -26,26 +26,69 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define	DYNAMIC_SIZE	(4 * 1024 * 1024) // ericw -- was 512KB (64-bit) / 384KB (32-bit)
 
 #define	ZONEID	0x1d4a11
+#define	SLABID	0x5ab1d
 #define MINFRAGMENT	64
 
+#define	ZONETAG_SLAB	2	// zone block holding a slab of small objects
+
 typedef struct memblock_s
 {
 	int	size;		// including the header and possibly tiny fragments
 	int	tag;		// a tag of 0 is a free block
-	int	id;		// should be ZONEID
-	int	pad;		// pad to 64 bit boundary
 	struct	memblock_s	*next, *prev;
+	int	pad;		// pad to 64 bit boundary
+	int	id;		// should be ZONEID, last so it's just before the data like slabobj_t's
 } memblock_t;
 
+/*
+small blocks come from slabs: zone blocks of SLAB_SIZE split into equal
+objects of one size class, each with a slabobj_t header instead of a
+memblock_t. the id just before the data tells the two kinds apart.
+*/
+#define	SLAB_SIZE		(16 * 1024)
+#define	NUM_SIZECLASSES		8
+#define	MAX_SLAB_ALLOC		256
+
+static const int z_classsizes[NUM_SIZECLASSES] = {16, 32, 48, 64, 96, 128, 192, MAX_SLAB_ALLOC};
+static byte z_classforsize[MAX_SLAB_ALLOC / 8 + 1];	// (size + 7) / 8 -> class
+
+typedef struct
+{
+	int	offset;		// from the start of the slab
+	int	id;		// should be SLABID
+} slabobj_t;
+
+typedef struct slab_s
+{
+	struct	slab_s	*next, *prev;	// partial list of the class, only when not full
+	slabobj_t	*freelist;	// links are in the data of the free objects
+	int	used;
+	int	sizeclass;
+} slab_t;
+
+#define	SLAB_HEADER	((sizeof(slab_t) + 7) & ~7)
+
+typedef struct
+{
+	int		objsize;	// including the slabobj_t
+	int		perslab;
+	slab_t		*partial;	// slabs with free objects
+	int		numslabs;
+	int		used, peak;	// objects
+	int		allocs;
+} sizeclass_t;
+
 typedef struct
 {
 	int		size;		// total bytes malloced, including header
 	memblock_t	blocklist;	// start / end cap for linked list
 	memblock_t	*rover;
+	sizeclass_t	classes[NUM_SIZECLASSES];
 } memzone_t;
 
 void Cache_FreeLow (int new_low_hunk);
 void Cache_FreeHigh (int new_high_hunk);
+static void Hunk_Trim (int mark);
 
 
 /*
@@ -60,29 +103,29 @@ The rover can be left pointing at a non-empty block
 
 The zone calls are pretty much only used for small strings and structures,
 all big things are allocated on the hunk.
+
+Anything up to MAX_SLAB_ALLOC bytes is taken from a slab of its size class
+without walking the block list; the slabs themselves are zone blocks.
 ==============================================================================
 */
 
 static memzone_t	*mainzone;
+static qboolean		z_noslabs;	// zone_bench compares against the plain zone
+static qboolean		z_benching;	// no Z_CheckHeap per call while zone_bench replays
 
+static void Z_TraceOp (int op, void *ptr, void *newptr, int size);
+static qboolean		z_tracing;
+
+enum { ZTRACE_MALLOC, ZTRACE_FREE, ZTRACE_REALLOC };
 
 /*
 ========================
-Z_Free
+Z_FreeBlock -- returns a zone block to the free list
 ========================
 */
-void Z_Free (void *ptr)
+static void Z_FreeBlock (memblock_t *block)
 {
-	memblock_t	*block, *other;
-
-	if (!ptr)
-		Sys_Error ("Z_Free: NULL pointer");
-
-	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
-	if (block->id != ZONEID)
-		Sys_Error ("Z_Free: freed a pointer without ZONEID");
-	if (block->tag == 0)
-		Sys_Error ("Z_Free: freed a freed pointer");
+	memblock_t	*other;
 
 	block->tag = 0;		// mark as free
 
@@ -108,6 +151,78 @@ void Z_Free (void *ptr)
 	}
 }
 
+/*
+========================
+Z_SlabFree
+========================
+*/
+static void Z_SlabFree (slabobj_t *obj)
+{
+	slab_t		*slab = (slab_t *) ((byte *)obj - obj->offset);
+	sizeclass_t	*sc = &mainzone->classes[slab->sizeclass];
+
+	if (obj->offset < (int) SLAB_HEADER || obj->offset >= SLAB_SIZE)
+		Sys_Error ("Z_Free: bad slab object");
+
+	obj->id = 0;	// catches freeing it twice
+	if (!slab->freelist)
+	{	// was full, make it available again
+		slab->prev = NULL;
+		slab->next = sc->partial;
+		if (sc->partial)
+			sc->partial->prev = slab;
+		sc->partial = slab;
+	}
+	*(slabobj_t **)(obj + 1) = slab->freelist;
+	slab->freelist = obj;
+	slab->used--;
+	sc->used--;
+
+// give empty slabs back to the zone, but keep the last one of each class
+// so a single object going back and forth doesn't churn whole slabs
+	if (!slab->used && (slab->next || slab->prev))
+	{
+		if (slab->prev)
+			slab->prev->next = slab->next;
+		else
+			sc->partial = slab->next;
+		if (slab->next)
+			slab->next->prev = slab->prev;
+		sc->numslabs--;
+		Z_FreeBlock ((memblock_t *)((byte *)slab - sizeof(memblock_t)));
+	}
+}
+
+/*
+========================
+Z_Free
+========================
+*/
+void Z_Free (void *ptr)
+{
+	memblock_t	*block;
+
+	if (!ptr)
+		Sys_Error ("Z_Free: NULL pointer");
+
+	if (z_tracing)
+		Z_TraceOp (ZTRACE_FREE, ptr, NULL, 0);
+
+	if (((slabobj_t *)ptr - 1)->id == SLABID)
+	{
+		Z_SlabFree ((slabobj_t *)ptr - 1);
+		return;
+	}
+
+	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
+	if (block->id != ZONEID)
+		Sys_Error ("Z_Free: freed a pointer without ZONEID");
+	if (block->tag == 0)
+		Sys_Error ("Z_Free: freed a freed pointer");
+
+	Z_FreeBlock (block);
+}
+
 
 static void *Z_TagMalloc (int size, int tag)
 {
@@ -167,6 +282,92 @@ static void *Z_TagMalloc (int size, int tag)
 	return (void *) ((byte *)base + sizeof(memblock_t));
 }
 
+/*
+========================
+Z_SizeClass -- the slab class for an allocation, or -1 if it goes to the zone
+========================
+*/
+static int Z_SizeClass (int size)
+{
+	if (z_noslabs || size > MAX_SLAB_ALLOC)
+		return -1;
+	return z_classforsize[(size + 7) >> 3];
+}
+
+/*
+========================
+Z_SlabAlloc
+========================
+*/
+static void *Z_SlabAlloc (int sizeclass)
+{
+	sizeclass_t	*sc = &mainzone->classes[sizeclass];
+	slab_t		*slab;
+	slabobj_t	*obj;
+	int		i;
+
+	slab = sc->partial;
+	if (!slab)
+	{
+		slab = (slab_t *) Z_TagMalloc (SLAB_SIZE - sizeof(memblock_t) - 4, ZONETAG_SLAB);
+		if (!slab)
+			return NULL;
+		slab->next = slab->prev = NULL;
+		slab->used = 0;
+		slab->sizeclass = sizeclass;
+		slab->freelist = NULL;
+		for (i = sc->perslab - 1; i >= 0; i--)
+		{
+			obj = (slabobj_t *) ((byte *)slab + SLAB_HEADER + i * sc->objsize);
+			obj->offset = (byte *)obj - (byte *)slab;
+			obj->id = 0;
+			*(slabobj_t **)(obj + 1) = slab->freelist;
+			slab->freelist = obj;
+		}
+		sc->partial = slab;
+		sc->numslabs++;
+	}
+
+	obj = slab->freelist;
+	slab->freelist = *(slabobj_t **)(obj + 1);
+	if (!slab->freelist)
+	{	// full, take it off the partial list
+		sc->partial = slab->next;
+		if (sc->partial)
+			sc->partial->prev = NULL;
+		slab->next = slab->prev = NULL;
+	}
+	obj->id = SLABID;
+	slab->used++;
+
+	sc->allocs++;
+	if (++sc->used > sc->peak)
+		sc->peak = sc->used;
+
+	return (void *)(obj + 1);
+}
+
+/*
+========================
+Z_BlockSize -- usable bytes of an allocation
+========================
+*/
+static int Z_BlockSize (void *ptr)
+{
+	slabobj_t	*obj = (slabobj_t *)ptr - 1;
+	memblock_t	*block;
+
+	if (obj->id == SLABID)
+		return mainzone->classes[((slab_t *)((byte *)obj - obj->offset))->sizeclass].objsize - sizeof(slabobj_t);
+
+	block = (memblock_t *) ((byte *) ptr - sizeof (memblock_t));
+	if (block->id != ZONEID)
+		Sys_Error ("Z_Realloc: realloced a pointer without ZONEID");
+	if (block->tag == 0)
+		Sys_Error ("Z_Realloc: realloced a freed pointer");
+	return block->size - (4 + (int)sizeof(memblock_t));	/* see Z_TagMalloc() */
+}
+
 /*
 ========================
 Z_CheckHeap
@@ -175,6 +376,9 @@ Z_CheckHeap
 static void Z_CheckHeap (void)
 {
 	memblock_t	*block;
+	slab_t		*slab;
+	slabobj_t	*obj;
+	int		i, numfree;
 
 	for (block = mainzone->blocklist.next ; ; block = block->next)
 	{
@@ -187,20 +391,45 @@ static void Z_CheckHeap (void)
 		if (!block->tag && !block->next->tag)
 			Sys_Error ("Z_CheckHeap: two consecutive free blocks\n");
 	}
-}
 
+	for (i = 0; i < NUM_SIZECLASSES; i++)
+	{
+		for (slab = mainzone->classes[i].partial; slab; slab = slab->next)
+		{
+			if (((memblock_t *)slab - 1)->tag != ZONETAG_SLAB || slab->sizeclass != i)
+				Sys_Error ("Z_CheckHeap: bad slab\n");
+			if (slab->next && slab->next->prev != slab)
+				Sys_Error ("Z_CheckHeap: next slab doesn't have proper back link\n");
+			for (numfree = 0, obj = slab->freelist; obj; obj = *(slabobj_t **)(obj + 1), numfree++)
+			{
+				if ((byte *)obj - (byte *)slab != obj->offset || obj->id)
+					Sys_Error ("Z_CheckHeap: bad free slab object\n");
+			}
+			if (numfree + slab->used != mainzone->classes[i].perslab)
+				Sys_Error ("Z_CheckHeap: slab object count doesn't add up\n");
+		}
+	}
+}
 
 /*
 ========================
-Z_Malloc
+Z_DoMalloc -- Z_Malloc without the trace
 ========================
 */
-void *Z_Malloc (int size)
+static void *Z_DoMalloc (int size)
 {
 	void	*buf;
+	int	sizeclass;
 
-	Z_CheckHeap ();	// DEBUG
-	buf = Z_TagMalloc (size, 1);
+	sizeclass = Z_SizeClass (size);
+	if (sizeclass >= 0)
+		buf = Z_SlabAlloc (sizeclass);
+	else
+	{
+		if (!z_benching)
+			Z_CheckHeap ();	// DEBUG
+		buf = Z_TagMalloc (size, 1);
+	}
 	if (!buf)
 		Sys_Error ("Z_Malloc: failed on allocation of %i bytes",size);
 	Q_memset (buf, 0, size);
@@ -208,6 +437,20 @@ void *Z_Malloc (int size)
 	return buf;
 }
 
+/*
+========================
+Z_Malloc
+========================
+*/
+void *Z_Malloc (int size)
+{
+	void	*buf = Z_DoMalloc (size);
+
+	if (z_tracing)
+		Z_TraceOp (ZTRACE_MALLOC, NULL, buf, size);
+	return buf;
+}
+
 /*
 ========================
 Z_Realloc
@@ -217,31 +460,45 @@ void *Z_Realloc(void *ptr, int size)
 {
 	int old_size;
 	void *old_ptr;
-	memblock_t *block;
+	int sizeclass;
 
 	if (!ptr)
 		return Z_Malloc (size);
 
-	block = (memblock_t *) ((byte *) ptr - sizeof (memblock_t));
-	if (block->id != ZONEID)
-		Sys_Error ("Z_Realloc: realloced a pointer without ZONEID");
-	if (block->tag == 0)
-		Sys_Error ("Z_Realloc: realloced a freed pointer");
-
-	old_size = block->size;
-	old_size -= (4 + (int)sizeof(memblock_t));	/* see Z_TagMalloc() */
+	old_size = Z_BlockSize (ptr);
 	old_ptr = ptr;
+	sizeclass = Z_SizeClass (size);
 
-	Z_Free (ptr);
-	ptr = Z_TagMalloc (size, 1);
-	if (!ptr)
-		Sys_Error ("Z_Realloc: failed on allocation of %i bytes", size);
+	if (((slabobj_t *)ptr - 1)->id == SLABID)
+	{
+		if (sizeclass != ((slab_t *)((byte *)ptr - sizeof(slabobj_t) - ((slabobj_t *)ptr - 1)->offset))->sizeclass)
+		{	// moving to another class or to the zone
+			ptr = Z_DoMalloc (size);
+			memcpy (ptr, old_ptr, q_min(old_size, size));
+			Z_SlabFree ((slabobj_t *)old_ptr - 1);
+		}
+	}
+	else if (sizeclass >= 0)
+	{	// shrunk into a slab
+		ptr = Z_DoMalloc (size);
+		memcpy (ptr, old_ptr, q_min(old_size, size));
+		Z_FreeBlock ((memblock_t *) ((byte *)old_ptr - sizeof(memblock_t)));
+	}
+	else
+	{
+		Z_FreeBlock ((memblock_t *) ((byte *)ptr - sizeof(memblock_t)));
+		ptr = Z_TagMalloc (size, 1);
+		if (!ptr)
+			Sys_Error ("Z_Realloc: failed on allocation of %i bytes", size);
 
-	if (ptr != old_ptr)
-		memmove (ptr, old_ptr, q_min(old_size, size));
+		if (ptr != old_ptr)
+			memmove (ptr, old_ptr, q_min(old_size, size));
+	}
 	if (old_size < size)
 		memset ((byte *)ptr + old_size, 0, size - old_size);
 
+	if (z_tracing)
+		Z_TraceOp (ZTRACE_REALLOC, old_ptr, ptr, size);
 	return ptr;
 }
 
@@ -259,16 +516,28 @@ char *Z_Strdup (const char *s)
 Z_Print
 ========================
 */
-void Z_Print (memzone_t *zone)
+void Z_Print (memzone_t *zone, qboolean all)
 {
 	memblock_t	*block;
+	sizeclass_t	*sc;
+	int		i, used, unused, slabs, blocks;
 
-	Con_Printf ("zone size: %i  location: %p\n",mainzone->size,mainzone);
+	Con_Printf ("zone size: %i  location: %p\n",zone->size,zone);
 
+	used = unused = slabs = blocks = 0;
 	for (block = zone->blocklist.next ; ; block = block->next)
 	{
-		Con_Printf ("block:%p    size:%7i    tag:%3i\n",
-			block, block->size, block->tag);
+		if (all)
+			Con_Printf ("block:%p    size:%7i    tag:%3i\n",
+				block, block->size, block->tag);
+
+		blocks++;
+		if (!block->tag)
+			unused += block->size;
+		else if (block->tag == ZONETAG_SLAB)
+			slabs += block->size;
+		else
+			used += block->size;
 
 		if (block->next == &zone->blocklist)
 			break;			// all blocks have been hit
@@ -279,8 +548,320 @@ void Z_Print (memzone_t *zone)
 		if (!block->tag && !block->next->tag)
 			Con_Printf ("ERROR: two consecutive free blocks\n");
 	}
+	Con_Printf ("%i blocks: %i used, %i in slabs, %i free\n", blocks, used, slabs, unused);
+
+	Con_Printf ("class  slabs  objects   peak   allocs  bytes used\n");
+	for (i = 0; i < NUM_SIZECLASSES; i++)
+	{
+		sc = &zone->classes[i];
+		Con_Printf ("%5i %6i %8i %6i %8i %8i/%i\n", z_classsizes[i], sc->numslabs, sc->used, sc->peak, sc->allocs,
+				sc->used * z_classsizes[i], sc->numslabs * sc->perslab * z_classsizes[i]);
+	}
+}
+
+/*
+========================
+Z_Print_f -- console command, "zone_print all" lists every block
+========================
+*/
+static void Z_Print_f (void)
+{
+	Z_Print (mainzone, Cmd_Argc () > 1 && !q_strcasecmp (Cmd_Argv (1), "all"));
+}
+
+/*
+==============================================================================
+
+	ALLOCATION TRACES
+
+zone_trace records the zone calls until it's toggled off (say, around a
+map load) and saves them to zonetrace.dat; zone_bench replays the trace in
+a scratch zone, with and without slabs. Pointers are turned into the
+number of the allocation that returned them when the trace is saved.
+The file stores them as native intptr_t, so a trace can't be moved
+between 32-bit and 64-bit builds.
+
+==============================================================================
+*/
+
+#define	ZTRACE_IDENT	(('R'<<24)+('T'<<16)+('Z'<<8)+'Q') // little-endian "QZTR"
+#define	ZTRACE_VERSION	1
+#define	ZTRACE_FILENAME	"zonetrace.dat"
+
+typedef struct
+{
+	int	op;
+	int	size;
+	intptr_t	ptr, newptr;	// while recording; numbers once saved
+} ztraceop_t;
+
+static ztraceop_t	*z_trace;
+static int		z_tracecount, z_tracemax;
+static qboolean		z_tracesaved;
+
+static void Z_TraceOp (int op, void *ptr, void *newptr, int size)
+{
+	if (z_tracecount == z_tracemax)
+	{
+		z_tracemax = q_max (z_tracemax * 2, 4096);
+		z_trace = (ztraceop_t *) realloc (z_trace, z_tracemax * sizeof(ztraceop_t));
+		if (!z_trace)
+			Sys_Error ("Z_TraceOp: out of memory");
+	}
+	z_trace[z_tracecount].op = op;
+	z_trace[z_tracecount].size = size;
+	z_trace[z_tracecount].ptr = (intptr_t) ptr;
+	z_trace[z_tracecount].newptr = (intptr_t) newptr;
+	z_tracecount++;
 }
 
+/*
+========================
+Z_TraceNumber -- open addressing map from pointers to allocation numbers
+========================
+*/
+static intptr_t *Z_TraceSlot (intptr_t *keys, int mask, intptr_t ptr)
+{
+	int	i = (int) ((ptr >> 3) * 2654435761u) & mask;
+
+	while (keys[i*2] && keys[i*2] != ptr)
+		i = (i + 1) & mask;
+	return &keys[i*2];
+}
+
+/*
+========================
+Z_NumberTrace -- turns recorded pointers into allocation numbers, -1 if allocated before the trace
+========================
+*/
+static void Z_NumberTrace (void)
+{
+	intptr_t	*map, *slot;
+	int		i, mask, number;
+	ztraceop_t	*t;
+
+	for (mask = 1; mask < z_tracecount * 2; mask <<= 1)
+		;
+	map = (intptr_t *) calloc (mask * 2, sizeof(intptr_t));	// key, number pairs
+	if (!map)
+		Sys_Error ("Z_NumberTrace: out of memory");
+	mask--;
+
+	for (i = 0, number = 0, t = z_trace; i < z_tracecount; i++, t++)
+	{
+		if (t->ptr)
+		{
+			slot = Z_TraceSlot (map, mask, t->ptr);
+			t->ptr = slot[0] ? slot[1] : -1;
+			slot[1] = -1;	// stale from here on
+		}
+		else
+			t->ptr = -1;
+
+		if (t->newptr)
+		{
+			slot = Z_TraceSlot (map, mask, t->newptr);
+			slot[0] = t->newptr;
+			slot[1] = number;
+			t->newptr = number++;
+		}
+		else
+			t->newptr = -1;
+	}
+
+	free (map);
+}
+
+/*
+========================
+Z_Trace_f
+========================
+*/
+static void Z_Trace_f (void)
+{
+	char	name[MAX_OSPATH];
+	FILE	*f;
+	int	header[3];
+
+	if (!z_tracing)
+	{
+		z_tracecount = 0;
+		z_tracesaved = false;
+		z_tracing = true;
+		Con_Printf ("zone trace started\n");
+		return;
+	}
+
+	z_tracing = false;
+	Z_NumberTrace ();
+	z_tracesaved = true;
+
+	q_snprintf (name, sizeof(name), "%s/%s", com_gamedir, ZTRACE_FILENAME);
+	f = fopen (name, "wb");
+	if (!f)
+	{
+		Con_Printf ("zone trace: couldn't write %s\n", name);
+		return;
+	}
+	header[0] = LittleLong (ZTRACE_IDENT);
+	header[1] = LittleLong (ZTRACE_VERSION);
+	header[2] = LittleLong (z_tracecount);
+	fwrite (header, sizeof(header), 1, f);
+	fwrite (z_trace, sizeof(ztraceop_t), z_tracecount, f);
+	fclose (f);
+
+	Con_Printf ("zone trace: %i calls written to %s\n", z_tracecount, ZTRACE_FILENAME);
+}
+
+/*
+========================
+Z_LoadTrace -- reads zonetrace.dat unless a trace was just recorded
+========================
+*/
+static qboolean Z_LoadTrace (void)
+{
+	char	name[MAX_OSPATH];
+	FILE	*f;
+	int	header[3];
+
+	if (z_tracesaved)
+		return true;
+
+	q_snprintf (name, sizeof(name), "%s/%s", com_gamedir, ZTRACE_FILENAME);
+	f = fopen (name, "rb");
+	if (!f)
+		return false;
+	if (fread (header, sizeof(header), 1, f) != 1 || LittleLong (header[0]) != ZTRACE_IDENT ||
+		LittleLong (header[1]) != ZTRACE_VERSION || LittleLong (header[2]) < 0)
+	{
+		fclose (f);
+		return false;
+	}
+
+	z_tracecount = LittleLong (header[2]);
+	z_tracemax = q_max (z_tracecount, 1);
+	z_trace = (ztraceop_t *) realloc (z_trace, z_tracemax * sizeof(ztraceop_t));
+	if (!z_trace || fread (z_trace, sizeof(ztraceop_t), z_tracecount, f) != (size_t) z_tracecount)
+		z_tracecount = 0;
+	fclose (f);
+
+	z_tracesaved = z_tracecount > 0;
+	return z_tracesaved;
+}
+
+static void Memory_InitZone (memzone_t *zone, int size);
+
+/*
+========================
+Z_ReplayTrace -- one pass in the current mainzone, returns seconds
+========================
+*/
+static double Z_ReplayTrace (void **live, int numlive)
+{
+	double		start;
+	ztraceop_t	*t;
+	int		i;
+
+	memset (live, 0, numlive * sizeof(void *));
+
+	start = Sys_DoubleTime ();
+	for (i = 0, t = z_trace; i < z_tracecount; i++, t++)
+	{
+		switch (t->op)
+		{
+		case ZTRACE_MALLOC:
+			live[t->newptr] = Z_DoMalloc (t->size);
+			break;
+		case ZTRACE_FREE:
+			if (t->ptr >= 0 && live[t->ptr])
+			{
+				Z_Free (live[t->ptr]);
+				live[t->ptr] = NULL;
+			}
+			break;
+		case ZTRACE_REALLOC:
+			if (t->ptr >= 0 && live[t->ptr])
+			{
+				live[t->newptr] = Z_Realloc (live[t->ptr], t->size);
+				live[t->ptr] = NULL;
+			}
+			else
+				live[t->newptr] = Z_DoMalloc (t->size);
+			break;
+		}
+	}
+	for (i = 0; i < numlive; i++)
+	{
+		if (live[i])
+			Z_Free (live[i]);
+	}
+	return Sys_DoubleTime () - start;
+}
+
+/*
+========================
+Z_Bench_f -- "zone_bench [passes]" replays the last zone trace with and without slabs
+
+Z_CheckHeap is left out of the replay, so the two paths are compared on
+the allocator alone, and run once after each mode instead
+========================
+*/
+static void Z_Bench_f (void)
+{
+	memzone_t	*realzone, *scratch;
+	void		**live;
+	double		time[2];
+	int		i, mode, passes, numlive;
+
+	if (z_tracing)
+	{
+		Con_Printf ("stop the zone trace first\n");
+		return;
+	}
+	if (!Z_LoadTrace ())
+	{
+		Con_Printf ("no zone trace, record one with zone_trace\n");
+		Con_Printf ("(traces store native pointers, they don't move between 32 and 64 bit builds)\n");
+		return;
+	}
+
+	passes = (Cmd_Argc () > 1) ? q_max (Q_atoi (Cmd_Argv (1)), 1) : 10;
+
+	for (i = 0, numlive = 0; i < z_tracecount; i++)
+		numlive = q_max (numlive, (int) z_trace[i].newptr + 1);
+
+	live = (void **) malloc (q_max (numlive, 1) * sizeof(void *));
+	scratch = (memzone_t *) malloc (mainzone->size);
+	if (!live || !scratch)
+	{
+		free (live);
+		free (scratch);
+		Con_Printf ("zone_bench: out of memory\n");
+		return;
+	}
+
+	realzone = mainzone;
+	mainzone = scratch;
+	z_benching = true;
+	for (mode = 0; mode < 2; mode++)
+	{
+		z_noslabs = (mode == 1);
+		Memory_InitZone (scratch, realzone->size);
+		time[mode] = 0;
+		for (i = 0; i < passes; i++)
+			time[mode] += Z_ReplayTrace (live, numlive);
+		Z_CheckHeap ();
+	}
+	z_benching = false;
+	z_noslabs = false;
+	mainzone = realzone;
+
+	free (scratch);
+	free (live);
+
+	Con_Printf ("%i calls, %i passes: slabs %.2f ms, zone only %.2f ms per pass\n",
+			z_tracecount, passes, time[0] * 1000 / passes, time[1] * 1000 / passes);
+}
 
 //============================================================================
 
@@ -303,6 +884,125 @@ int		hunk_high_used;
 qboolean	hunk_tempactive;
 int		hunk_tempmark;
 
+/*
+==============================================================================
+
+	COMMITTED PAGES
+
+A reserved hunk is committed in chunks as the low hunk, the high hunk and
+the cache reach into them. Hunk_FreeToLowMark decommits the whole chunks
+that are left unused, except for some slack above the low mark, so the
+scratch allocations freed again every frame don't hit the system.
+
+==============================================================================
+*/
+
+#define HUNK_CHUNK_SIZE		0x10000		// the allocation granularity on windows
+#define HUNK_COMMIT_SLACK	0x100000
+
+static qboolean	hunk_reserved;
+static byte	*hunk_chunks;		// true if committed
+static int	hunk_committed;
+static int	hunk_commitpeak;
+
+/*
+===================
+Hunk_ChunkEnd
+===================
+*/
+static int Hunk_ChunkEnd (int chunk)
+{
+	return q_min ((chunk + 1) * HUNK_CHUNK_SIZE, hunk_size);
+}
+
+/*
+===================
+Hunk_Commit -- backs the bytes [start, end) of the hunk with memory
+===================
+*/
+static void Hunk_Commit (int start, int end)
+{
+	int	i, run, size;
+
+	if (!hunk_reserved || end <= start)
+		return;
+
+	for (i = start / HUNK_CHUNK_SIZE; i * HUNK_CHUNK_SIZE < end; i++)
+	{
+		if (hunk_chunks[i])
+			continue;
+		for (run = i; Hunk_ChunkEnd (run) < end && !hunk_chunks[run + 1]; run++)
+			;
+		size = Hunk_ChunkEnd (run) - i * HUNK_CHUNK_SIZE;
+		if (!Sys_CommitMemory (hunk_base + i * HUNK_CHUNK_SIZE, size))
+			Sys_Error ("Hunk_Commit: couldn't commit %i KB, %i KB in use", size / 1024, hunk_committed / 1024);
+		memset (hunk_chunks + i, 1, run - i + 1);
+		hunk_committed += size;
+		i = run;
+	}
+	hunk_commitpeak = q_max (hunk_commitpeak, hunk_committed);
+}
+
+/*
+===================
+Hunk_Decommit -- gives back the whole chunks inside [start, end)
+===================
+*/
+static void Hunk_Decommit (int start, int end)
+{
+	int	i, run, size;
+
+	if (!hunk_reserved)
+		return;
+
+	for (i = (start + HUNK_CHUNK_SIZE - 1) / HUNK_CHUNK_SIZE; i * HUNK_CHUNK_SIZE < end && Hunk_ChunkEnd (i) <= end; i++)
+	{
+		if (!hunk_chunks[i])
+			continue;
+		for (run = i; Hunk_ChunkEnd (run) < end && Hunk_ChunkEnd (run + 1) <= end && hunk_chunks[run + 1]; run++)
+			;
+		size = Hunk_ChunkEnd (run) - i * HUNK_CHUNK_SIZE;
+		Sys_DecommitMemory (hunk_base + i * HUNK_CHUNK_SIZE, size);
+		memset (hunk_chunks + i, 0, run - i + 1);
+		hunk_committed -= size;
+		i = run;
+	}
+}
+
+/*
+===================
+Hunk_Clear -- zeroes [start, end), skipping the chunks that aren't committed
+===================
+*/
+static void Hunk_Clear (int start, int end)
+{
+	int	i, stop;
+
+	if (!hunk_reserved)
+	{
+		memset (hunk_base + start, 0, end - start);
+		return;
+	}
+
+	for (i = start / HUNK_CHUNK_SIZE; start < end; i++)
+	{
+		stop = q_min (Hunk_ChunkEnd (i), end);
+		if (hunk_chunks[i])
+			memset (hunk_base + start, 0, stop - start);
+		start = stop;
+	}
+}
+
+/*
+===================
+Hunk_Committed
+===================
+*/
+int Hunk_Committed (void)
+{
+	return hunk_reserved ? hunk_committed : hunk_size;
+}
+
 /*
 ==============
 Hunk_Check
@@ -349,6 +1049,8 @@ void Hunk_Print (qboolean all)
 	endhigh = (hunk_t *)(hunk_base + hunk_size);
 
 	Con_Printf ("          :%8i total hunk size\n", hunk_size);
+	if (hunk_reserved)
+		Con_Printf ("          :%8i committed (peak %i)\n", hunk_committed, hunk_commitpeak);
 	Con_Printf ("-------------------------\n");
 
 	while (1)
@@ -420,6 +1122,313 @@ void Hunk_Print_f (void)
 	Hunk_Print (false);
 }
 
+/*
+==============================================================================
+
+	MEMORY TIMELINE
+
+With mem_timeline set, hunk and cache allocations are recorded in a ring
+of events. Peak usage per map and the cache eviction log are always kept,
+they only cost a few compares. mem_report prints all of it.
+
+==============================================================================
+*/
+
+#define	MEM_MAX_EVENTS		8192	// must be power of 2
+#define	MEM_MAX_EVICTIONS	256	// must be power of 2
+#define	MEM_MAX_MAPS		16
+#define	MEM_NAME_LEN		24
+
+enum { MEM_HUNK, MEM_HIGHHUNK, MEM_FREETOLOW, MEM_CACHEALLOC, MEM_CACHEFREE, MEM_CACHEMOVE, MEM_EVICT, MEM_MAP };
+
+static const char *mem_eventnames[] = {"hunk", "high", "freelow", "cache", "uncache", "move", "evict", "map"};
+
+typedef struct
+{
+	double	time;
+	int	kind;
+	int	size;
+	int	lowused, highused, cacheused;	// after the event
+	char	name[MEM_NAME_LEN];
+} memevent_t;
+
+typedef struct
+{
+	double	time;
+	int	size;
+	char	name[MEM_NAME_LEN];
+	char	reason[MEM_NAME_LEN];	// what needed the space
+	char	map[MEM_NAME_LEN];
+} memeviction_t;
+
+typedef struct
+{
+	char	name[MEM_NAME_LEN];
+	double	start;
+	int	lowpeak, highpeak, cachepeak, totalpeak;
+	int	evictions, evictedbytes;
+} memmap_t;
+
+static cvar_t	mem_timeline = {"mem_timeline", "0", CVAR_NONE};
+
+static memevent_t	*mem_events;
+static int		mem_numevents;	// total recorded, the ring keeps the last MEM_MAX_EVENTS
+static memeviction_t	mem_evictions[MEM_MAX_EVICTIONS];
+static int		mem_numevictions;
+static memmap_t		mem_maps[MEM_MAX_MAPS];
+static int		mem_nummaps;
+
+static int		cache_used;	// bytes in cache blocks, headers included
+static const char	*cache_evictreason;	// set around the Cache_Free calls that evict
+
+/*
+===================
+Mem_CurrentMap
+===================
+*/
+static memmap_t *Mem_CurrentMap (void)
+{
+	if (!mem_nummaps)
+	{
+		q_strlcpy (mem_maps[0].name, "startup", MEM_NAME_LEN);
+		mem_nummaps = 1;
+	}
+	return &mem_maps[(mem_nummaps - 1) % MEM_MAX_MAPS];
+}
+
+/*
+===================
+Mem_Event -- updates the peaks, and records the event if mem_timeline is on
+===================
+*/
+static void Mem_Event (int kind, int size, const char *name)
+{
+	memmap_t	*map = Mem_CurrentMap ();
+	memevent_t	*ev;
+
+	// the others happen halfway through making room, when the hunk has grown over the cache
+	if (kind == MEM_HUNK || kind == MEM_HIGHHUNK || kind == MEM_CACHEALLOC)
+	{
+		map->lowpeak = q_max (map->lowpeak, hunk_low_used);
+		map->highpeak = q_max (map->highpeak, hunk_high_used);
+		map->cachepeak = q_max (map->cachepeak, cache_used);
+		map->totalpeak = q_max (map->totalpeak, hunk_low_used + hunk_high_used + cache_used);
+	}
+
+	if (!mem_timeline.value)
+		return;
+	if (!mem_events)
+	{
+		mem_events = (memevent_t *) malloc (MEM_MAX_EVENTS * sizeof(memevent_t));
+		if (!mem_events)
+			return;
+	}
+
+	ev = &mem_events[mem_numevents++ & (MEM_MAX_EVENTS - 1)];
+	ev->time = Sys_DoubleTime ();
+	ev->kind = kind;
+	ev->size = size;
+	ev->lowused = hunk_low_used;
+	ev->highused = hunk_high_used;
+	ev->cacheused = cache_used;
+	q_strlcpy (ev->name, name, MEM_NAME_LEN);
+}
+
+/*
+===================
+Mem_Eviction -- logs a cache block thrown out to make room
+===================
+*/
+static void Mem_Eviction (int size, const char *name)
+{
+	memmap_t	*map = Mem_CurrentMap ();
+	memeviction_t	*ev;
+
+	map->evictions++;
+	map->evictedbytes += size;
+
+	ev = &mem_evictions[mem_numevictions++ & (MEM_MAX_EVICTIONS - 1)];
+	ev->time = Sys_DoubleTime ();
+	ev->size = size;
+	q_strlcpy (ev->name, name, MEM_NAME_LEN);
+	q_strlcpy (ev->reason, cache_evictreason ? cache_evictreason : "?", MEM_NAME_LEN);
+	q_strlcpy (ev->map, map->name, MEM_NAME_LEN);
+
+	Mem_Event (MEM_EVICT, size, name);
+}
+
+/*
+===================
+Memory_BeginMap -- starts the peak record of a map
+===================
+*/
+void Memory_BeginMap (const char *name)
+{
+	memmap_t	*map;
+
+	Mem_CurrentMap ();
+	map = &mem_maps[mem_nummaps++ % MEM_MAX_MAPS];
+	memset (map, 0, sizeof(*map));
+	q_strlcpy (map->name, name, MEM_NAME_LEN);
+	map->start = Sys_DoubleTime ();
+	Mem_Event (MEM_MAP, 0, name);
+}
+
+/*
+===================
+Mem_PrintTimeline -- the recorded events, optionally only the names containing filter
+===================
+*/
+static void Mem_PrintTimeline (const char *filter)
+{
+	memevent_t	*ev;
+	int		i, first;
+	double		start;
+
+	if (!mem_numevents)
+	{
+		Con_Printf ("no events, set mem_timeline 1 to record them\n");
+		return;
+	}
+
+	first = q_max (mem_numevents - MEM_MAX_EVENTS, 0);
+	start = mem_events[first & (MEM_MAX_EVENTS - 1)].time;
+	Con_Printf ("    time  event         size  name                     low KB  high KB cache KB\n");
+	for (i = first; i < mem_numevents; i++)
+	{
+		ev = &mem_events[i & (MEM_MAX_EVENTS - 1)];
+		if (filter && !strstr (ev->name, filter))
+			continue;
+		Con_Printf ("%8.3f  %-7s %10i  %-22s %8i %8i %8i\n", ev->time - start, mem_eventnames[ev->kind],
+				ev->size, ev->name, ev->lowused / 1024, ev->highused / 1024, ev->cacheused / 1024);
+	}
+	if (first)
+		Con_Printf ("(%i older events dropped)\n", first);
+}
+
+/*
+===================
+Mem_PrintTags -- bytes allocated per name tag in the recorded events
+===================
+*/
+static void Mem_PrintTags (void)
+{
+	struct { char name[MEM_NAME_LEN]; int count, hunk, cache; } tags[64];
+	memevent_t	*ev;
+	int		i, j, numtags, first;
+
+	first = q_max (mem_numevents - MEM_MAX_EVENTS, 0);
+	numtags = 0;
+	for (i = first; i < mem_numevents; i++)
+	{
+		ev = &mem_events[i & (MEM_MAX_EVENTS - 1)];
+		if (ev->kind != MEM_HUNK && ev->kind != MEM_HIGHHUNK && ev->kind != MEM_CACHEALLOC)
+			continue;
+		for (j = 0; j < numtags; j++)
+			if (!strcmp (tags[j].name, ev->name))
+				break;
+		if (j == numtags)
+		{
+			if (numtags == (int) (sizeof(tags)/sizeof(tags[0])))
+				j = numtags - 1;	// lump the rest into the last one
+			else
+			{
+				memset (&tags[j], 0, sizeof(tags[j]));
+				q_strlcpy (tags[j].name, ev->name, MEM_NAME_LEN);
+				numtags++;
+			}
+		}
+		tags[j].count++;
+		if (ev->kind == MEM_CACHEALLOC)
+			tags[j].cache += ev->size;
+		else
+			tags[j].hunk += ev->size;
+	}
+
+	Con_Printf ("name                    allocs   hunk KB  cache KB\n");
+	for (j = 0; j < numtags; j++)
+		Con_Printf ("%-22s %7i %9i %9i\n", tags[j].name, tags[j].count, tags[j].hunk / 1024, tags[j].cache / 1024);
+}
+
+/*
+===================
+Mem_PrintPeaks
+===================
+*/
+static void Mem_PrintPeaks (void)
+{
+	memmap_t	*map;
+	int		i;
+
+	Mem_CurrentMap ();
+	Con_Printf ("hunk size %i KB, %i KB committed (peak %i KB)\n", hunk_size / 1024, Hunk_Committed () / 1024,
+			(hunk_reserved ? hunk_commitpeak : hunk_size) / 1024);
+	Con_Printf ("map                      low KB  high KB cache KB total KB    %%  evicted\n");
+	for (i = q_max (mem_nummaps - MEM_MAX_MAPS, 0); i < mem_nummaps; i++)
+	{
+		map = &mem_maps[i % MEM_MAX_MAPS];
+		Con_Printf ("%-22s %8i %8i %8i %8i %4.0f %4i (%i KB)\n", map->name, map->lowpeak / 1024, map->highpeak / 1024,
+				map->cachepeak / 1024, map->totalpeak / 1024, 100.0 * map->totalpeak / hunk_size,
+				map->evictions, map->evictedbytes / 1024);
+	}
+}
+
+/*
+===================
+Mem_PrintEvictions
+===================
+*/
+static void Mem_PrintEvictions (void)
+{
+	memeviction_t	*ev;
+	int		i;
+
+	if (!mem_numevictions)
+	{
+		Con_Printf ("nothing evicted from the cache\n");
+		return;
+	}
+
+	Con_Printf ("map                     evicted                     KB  to make room for\n");
+	for (i = q_max (mem_numevictions - MEM_MAX_EVICTIONS, 0); i < mem_numevictions; i++)
+	{
+		ev = &mem_evictions[i & (MEM_MAX_EVICTIONS - 1)];
+		Con_Printf ("%-22s %-22s %8i  %s\n", ev->map, ev->name, ev->size / 1024, ev->reason);
+	}
+}
+
+/*
+===================
+Mem_Report_f -- "mem_report [timeline [filter] | tags | peaks | evictions]"
+===================
+*/
+static void Mem_Report_f (void)
+{
+	const char	*what = (Cmd_Argc () > 1) ? Cmd_Argv (1) : "";
+
+	if (!q_strcasecmp (what, "timeline"))
+		Mem_PrintTimeline ((Cmd_Argc () > 2) ? Cmd_Argv (2) : NULL);
+	else if (!q_strcasecmp (what, "tags"))
+		Mem_PrintTags ();
+	else if (!q_strcasecmp (what, "peaks"))
+		Mem_PrintPeaks ();
+	else if (!q_strcasecmp (what, "evictions"))
+		Mem_PrintEvictions ();
+	else if (!*what)
+	{
+		Mem_PrintPeaks ();
+		Con_Printf ("\n");
+		Mem_PrintEvictions ();
+		if (mem_numevents)
+		{
+			Con_Printf ("\n");
+			Mem_PrintTags ();
+		}
+	}
+	else
+		Con_Printf ("usage: mem_report [timeline [filter] | tags | peaks | evictions]\n");
+}
+
 /*
 ===================
 Hunk_AllocName
@@ -444,7 +1453,11 @@ void *Hunk_AllocName (int size, const char *name)
 	h = (hunk_t *)(hunk_base + hunk_low_used);
 	hunk_low_used += size;
 
+	cache_evictreason = name;
 	Cache_FreeLow (hunk_low_used);
+	cache_evictreason = NULL;
+
+	Hunk_Commit ((byte *)h - hunk_base, hunk_low_used);
 
 	memset (h, 0, size);
 
@@ -452,6 +1465,8 @@ void *Hunk_AllocName (int size, const char *name)
 	h->sentinal = HUNK_SENTINAL;
 	q_strlcpy (h->name, name, HUNKNAME_LEN);
 
+	Mem_Event (MEM_HUNK, size, name);
+
 	return (void *)(h+1);
 }
 
@@ -474,8 +1489,10 @@ void Hunk_FreeToLowMark (int mark)
 {
 	if (mark < 0 || mark > hunk_low_used)
 		Sys_Error ("Hunk_FreeToLowMark: bad mark %i", mark);
-	memset (hunk_base + mark, 0, hunk_low_used - mark);
+	Hunk_Trim (mark);
+	Hunk_Clear (mark, hunk_low_used);
 	hunk_low_used = mark;
+	Mem_Event (MEM_FREETOLOW, 0, "");
 }
 
 int	Hunk_HighMark (void)
@@ -534,15 +1551,21 @@ void *Hunk_HighAllocName (int size, const char *name)
 	}
 
 	hunk_high_used += size;
+	cache_evictreason = name;
 	Cache_FreeHigh (hunk_high_used);
+	cache_evictreason = NULL;
 
 	h = (hunk_t *)(hunk_base + hunk_size - hunk_high_used);
+	Hunk_Commit ((byte *)h - hunk_base, hunk_size - hunk_high_used + size);
 
 	memset (h, 0, size);
 	h->size = size;
 	h->sentinal = HUNK_SENTINAL;
 	q_strlcpy (h->name, name, HUNKNAME_LEN);
 
+	if (strcmp (name, "temp"))	// far too many of those, and they're gone again at once
+		Mem_Event (MEM_HIGHHUNK, size, name);
+
 	return (void *)(h+1);
 }
 
@@ -625,11 +1648,14 @@ void Cache_Move ( cache_system_t *c)
 		Q_memcpy (new_cs->name, c->name, sizeof(new_cs->name));
 		Cache_Free (c->user, false); //johnfitz -- added second argument
 		new_cs->user->data = (void *)(new_cs+1);
+		cache_used += new_cs->size;	// Cache_Free took the old copy off
+		Mem_Event (MEM_CACHEMOVE, new_cs->size, new_cs->name);
 	}
 	else
 	{
 //		Con_Printf ("cache_move failed\n");
 
+		Mem_Eviction (c->size, c->name);
 		Cache_Free (c->user, true); // tough luck... //johnfitz -- added second argument
 	}
 }
@@ -676,7 +1702,10 @@ void Cache_FreeHigh (int new_high_hunk)
 		if ( (byte *)c + c->size <= hunk_base + hunk_size - new_high_hunk)
 			return;		// there is space to grow the hunk
 		if (c == prev)
+		{
+			Mem_Eviction (c->size, c->name);
 			Cache_Free (c->user, true);	// didn't move out of the way //johnfitz -- added second argument
+		}
 		else
 		{
 			Cache_Move (c);	// try to move it
@@ -727,6 +1756,7 @@ cache_system_t *Cache_TryAlloc (int size, qboolean nobottom)
 			Sys_Error ("Cache_TryAlloc: %i is greater then free hunk", size);
 
 		new_cs = (cache_system_t *) (hunk_base + hunk_low_used);
+		Hunk_Commit ((byte *)new_cs - hunk_base, (byte *)new_cs - hunk_base + size);
 		memset (new_cs, 0, sizeof(*new_cs));
 		new_cs->size = size;
 
@@ -748,6 +1778,7 @@ cache_system_t *Cache_TryAlloc (int size, qboolean nobottom)
 		{
 			if ( (byte *)cs - (byte *)new_cs >= size)
 			{	// found space
+				Hunk_Commit ((byte *)new_cs - hunk_base, (byte *)new_cs - hunk_base + size);
 				memset (new_cs, 0, sizeof(*new_cs));
 				new_cs->size = size;
 
@@ -771,6 +1802,7 @@ cache_system_t *Cache_TryAlloc (int size, qboolean nobottom)
 // try to allocate one at the very end
 	if ( hunk_base + hunk_size - hunk_high_used - (byte *)new_cs >= size)
 	{
+		Hunk_Commit ((byte *)new_cs - hunk_base, (byte *)new_cs - hunk_base + size);
 		memset (new_cs, 0, sizeof(*new_cs));
 		new_cs->size = size;
 
@@ -787,6 +1819,30 @@ cache_system_t *Cache_TryAlloc (int size, qboolean nobottom)
 	return NULL;		// couldn't allocate
 }
 
+/*
+============
+Hunk_Trim -- decommits the free space between the low mark and the high hunk
+
+the cache blocks are in address order
+============
+*/
+static void Hunk_Trim (int mark)
+{
+	cache_system_t	*cs;
+	int		start;
+
+	if (!hunk_reserved)
+		return;
+
+	start = mark + HUNK_COMMIT_SLACK;
+	for (cs = cache_head.next ; cs != &cache_head ; cs = cs->next)
+	{
+		Hunk_Decommit (start, (byte *)cs - hunk_base);
+		start = q_max (start, (int) ((byte *)cs - hunk_base) + cs->size);
+	}
+	Hunk_Decommit (start, hunk_size - hunk_high_used);
+}
+
 /*
 ============
 Cache_Flush
@@ -798,6 +1854,7 @@ void Cache_Flush (void)
 {
 	while (cache_head.next != &cache_head)
 		Cache_Free ( cache_head.next->user, true); // reclaim the space //johnfitz -- added second argument
+	Mem_Event (MEM_CACHEFREE, 0, "flush");
 }
 
 /*
@@ -825,6 +1882,7 @@ Cache_Report
 void Cache_Report (void)
 {
 	Con_DPrintf ("%4.1f megabyte data cache\n", (hunk_size - hunk_high_used - hunk_low_used) / (float)(1024*1024) );
+	Con_DPrintf ("%4.1f megabytes cached, %i evictions this map\n", cache_used / (float)(1024*1024), Mem_CurrentMap ()->evictions);
 }
 
 /*
@@ -865,6 +1923,10 @@ void Cache_Free (cache_user_t *c, qboolean freetextures) //johnfitz -- added sec
 
 	Cache_UnlinkLRU (cs);
 
+	cache_used -= cs->size;
+	if (freetextures)	// moves only look like frees
+		Mem_Event (MEM_CACHEFREE, cs->size, cs->name);
+
 	//johnfitz -- if a model becomes uncached, free the gltextures.  This only works
 	//becuase the cache_user_t is the last component of the qmodel_t struct.  Should
 	//fail harmlessly if *c is actually part of an sfx_t struct.  I FEEL DIRTY
@@ -922,6 +1984,8 @@ void *Cache_Alloc (cache_user_t *c, int size, const char *name)
 			q_strlcpy (cs->name, name, CACHENAME_LEN);
 			c->data = (void *)(cs+1);
 			cs->user = c;
+			cache_used += size;
+			Mem_Event (MEM_CACHEALLOC, size, name);
 			break;
 		}
 
@@ -929,6 +1993,9 @@ void *Cache_Alloc (cache_user_t *c, int size, const char *name)
 		if (cache_head.lru_prev == &cache_head)
 			Sys_Error ("Cache_Alloc: out of memory"); // not enough memory at all
 
+		cache_evictreason = name;
+		Mem_Eviction (cache_head.lru_prev->size, cache_head.lru_prev->name);
+		cache_evictreason = NULL;
 		Cache_Free (cache_head.lru_prev->user, true); //johnfitz -- added second argument
 	}
 
@@ -941,6 +2008,7 @@ void *Cache_Alloc (cache_user_t *c, int size, const char *name)
 static void Memory_InitZone (memzone_t *zone, int size)
 {
 	memblock_t	*block;
+	int		i;
 
 // set the entire zone to one free block
 
@@ -955,6 +2023,14 @@ static void Memory_InitZone (memzone_t *zone, int size)
 	block->tag = 0;			// free block
 	block->id = ZONEID;
 	block->size = size - sizeof(memzone_t);
+
+	zone->size = size;
+	for (i = 0; i < NUM_SIZECLASSES; i++)
+	{
+		memset (&zone->classes[i], 0, sizeof(sizeclass_t));
+		zone->classes[i].objsize = sizeof(slabobj_t) + z_classsizes[i];
+		zone->classes[i].perslab = (SLAB_SIZE - sizeof(memblock_t) - 4 - SLAB_HEADER) / zone->classes[i].objsize;
+	}
 }
 
 /*
@@ -962,9 +2038,9 @@ static void Memory_InitZone (memzone_t *zone, int size)
 Memory_Init
 ========================
 */
-void Memory_Init (void *buf, int size)
+void Memory_Init (void *buf, int size, qboolean reserved)
 {
-	int p;
+	int p, i;
 	int zonesize = DYNAMIC_SIZE;
 
 	hunk_base = (byte *) buf;
@@ -972,6 +2048,14 @@ void Memory_Init (void *buf, int size)
 	hunk_low_used = 0;
 	hunk_high_used = 0;
 
+	hunk_reserved = reserved;
+	if (reserved)
+	{
+		hunk_chunks = (byte *) calloc ((size + HUNK_CHUNK_SIZE - 1) / HUNK_CHUNK_SIZE, 1);
+		if (!hunk_chunks)
+			Sys_Error ("Memory_Init: couldn't allocate the chunk map");
+	}
+
 	Cache_Init ();
 	p = COM_CheckParm ("-zone");
 	if (p)
@@ -981,9 +2065,21 @@ void Memory_Init (void *buf, int size)
 		else
 			Sys_Error ("Memory_Init: you must specify a size in KB after -zone");
 	}
+	for (p = 0, i = 0; p <= MAX_SLAB_ALLOC / 8; p++)
+	{
+		while (z_classsizes[i] < p * 8)
+			i++;
+		z_classforsize[p] = i;
+	}
+
 	mainzone = (memzone_t *) Hunk_AllocName (zonesize, "zone" );
 	Memory_InitZone (mainzone, zonesize);
 
 	Cmd_AddCommand ("hunk_print", Hunk_Print_f); //johnfitz
+	Cmd_AddCommand ("zone_print", Z_Print_f);
+	Cmd_AddCommand ("zone_trace", Z_Trace_f);
+	Cmd_AddCommand ("zone_bench", Z_Bench_f);
+	Cmd_AddCommand ("mem_report", Mem_Report_f);
+	Cvar_RegisterVariable (&mem_timeline);
 }
 
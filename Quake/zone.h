@@ -37,13 +37,18 @@ can display usage.
 
 Hunk allocations are guaranteed to be 16 byte aligned.
 
+When the system can reserve address space, the hunk is a large reserved
+range and only the pages in use are committed.  Hunk_FreeToLowMark gives
+back the pages no longer used below the high hunk and outside the cache.
+
 The video buffers are allocated high to avoid leaving a hole underneath
 server allocations when changing to a higher video mode.
 
 
 Z_??? Zone memory functions used for small, dynamic allocations like text
 strings from command input.  There is only about 48K for it, allocated at
-the very bottom of the hunk.
+the very bottom of the hunk.  Blocks of up to 256 bytes come from size
+class slabs inside the zone; zone_print shows their usage.
 
 Cache_??? Cache memory is for objects that can be dynamically loaded and
 can usefully stay persistant between levels.  The size of the cache
@@ -89,7 +94,8 @@ Zone block
 
 */
 
-void Memory_Init (void *buf, int size);
+void Memory_Init (void *buf, int size, qboolean reserved);
+void Memory_BeginMap (const char *name);	// starts the peak usage record of a map
 
 void Z_Free (void *ptr);
 void *Z_Malloc (int size);			// returns 0 filled memory
@@ -110,6 +116,7 @@ void Hunk_FreeToHighMark (int mark);
 void *Hunk_TempAlloc (int size);
 
 void Hunk_Check (void);
+int Hunk_Committed (void);		// bytes of the hunk backed by memory
 
 typedef struct cache_user_s
 {